@@ -3,101 +3,150 @@
 
 #include "ProceduralMeshesPrivatePCH.h"
 #include "BranchingLinesActor.h"
+#include "VertexWelding.h"
+
+DECLARE_CYCLE_STAT(TEXT("Branching lines"), STAT_GenerateBranchingLines, STATGROUP_ProceduralMeshes);
 
 ABranchingLinesActor::ABranchingLinesActor()
+	: SegmentsStage(INDEX_NONE)
+	, GeometryStage(INDEX_NONE)
+	, OptimizationStage(INDEX_NONE)
+	, UploadStage(INDEX_NONE)
+	, MaterialStage(INDEX_NONE)
+	, CollisionStage(INDEX_NONE)
 {
-	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootScene"));
-	ProcMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("ProceduralMesh"));
-	ProcMesh->AttachTo(RootComponent);
-	// Make sure the PMC doesnt save any mesh data with the map
-	ProcMesh->SetFlags(EObjectFlags::RF_Transient);
-
 	// Setup random offset directions
 	OffsetDirections.Add(FVector(1, 0, 0));
 	OffsetDirections.Add(FVector(0, 0, 1));
-}
 
-#if WITH_EDITOR  
-void ABranchingLinesActor::OnConstruction(const FTransform& Transform)
-{
-	Super::OnConstruction(Transform);
-	PreCacheCrossSection();
-	GenerateMesh();
+	FProceduralMeshLODChain::GetDefaultScreenSizes(LODScreenSizes);
 }
-#endif // WITH_EDITOR
 
-void ABranchingLinesActor::BeginPlay()
+void ABranchingLinesActor::UpdateLOD()
 {
-	Super::BeginPlay();
-	PreCacheCrossSection();
-	GenerateMesh();
-
-	// Fix for PCM location/rotation/scale since the whole component is Transient
-	ProcMesh->SetWorldLocation(this->GetActorLocation());
-	ProcMesh->SetWorldRotation(this->GetActorRotation());
-	ProcMesh->SetWorldScale3D(this->GetActorScale3D());
+	LODChain.Update(ProcMesh, LODScreenSizes, [this](int32 LODIndex) { GenerateLOD(LODIndex); });
 }
 
-void ABranchingLinesActor::GenerateMesh()
+void ABranchingLinesActor::SetupStages()
 {
+	Pipeline.SetOwner(this, GET_STATID(STAT_GenerateBranchingLines));
+
 	// -------------------------------------------------------
 	// Setup the random number generator and create the branching structure
-	RngStream = FRandomStream::FRandomStream(RandomSeed);
-	CreateSegments();
+	SegmentsStage = Pipeline.AddStage(TEXT("Segments"), GET_STATID(STAT_ProceduralMeshStructure), [this]()
+	{
+		GenerationRngStream = FRandomStream::FRandomStream(RandomSeed);
+		CreateSegments();
+	}, TArray<int32>());
 
 	// -------------------------------------------------------
-	// Calculate and pre-allocate buffers
-	int32 TotalNumberOfVerticesPerSection = RadialSegmentCount * 4; // 4 verts per face 
-	int32 TotalNumberOfTrianglesPerSection = TotalNumberOfVerticesPerSection + 2 * RadialSegmentCount;
+	// All LODs are built from the same segments, but only LOD0 is built up front. Segments that are the same as last time are copied
+	// from the previous mesh instead of being extruded again.
+	GeometryStage = Pipeline.AddStage(TEXT("Geometry"), GET_STATID(STAT_ProceduralMeshVertexFill), [this]()
+	{
+		// The editor preview while dragging a slider is one of the lower LODs
+		const int32 GeometryLOD = GetPreviewLOD();
+		FScratchLineSegmentStreams LODSegments;
+		GetLODSegments(GeometryLOD, LODSegments);
+		LOD0Tubes.Build(LODSegments, FProceduralMeshLODChain::GetRadialSegmentCountForLOD(RadialSegmentCount, GeometryLOD), bSmoothNormals);
+	}, { SegmentsStage });
+
+	// Welds a copy, so turning welding off again doesn't need the geometry to be rebuilt
+	OptimizationStage = Pipeline.AddStage(TEXT("Optimization"), GET_STATID(STAT_ProceduralMeshOptimization), [this]()
+	{
+		LOD0WeldedMeshData.Reset();
+		if (bWeldVertices)
+		{
+			LOD0WeldedMeshData = LOD0Tubes.GetMeshData();
+			FVertexWelder::Weld(LOD0WeldedMeshData);
+		}
+	}, { GeometryStage });
 
-	FProceduralMeshData MeshData = FProceduralMeshData();
-	MeshData.Vertices.AddUninitialized(TotalNumberOfVerticesPerSection * Segments.Num());
-	MeshData.Triangles.AddUninitialized(TotalNumberOfTrianglesPerSection * Segments.Num());
-	MeshData.Normals.AddUninitialized(TotalNumberOfVerticesPerSection * Segments.Num());
-	MeshData.UVs.AddUninitialized(TotalNumberOfVerticesPerSection * Segments.Num());
-	MeshData.Tangents.AddUninitialized(TotalNumberOfVerticesPerSection * Segments.Num());
+	UploadStage = Pipeline.AddStage(TEXT("Upload"), GET_STATID(STAT_ProceduralMeshUpload), [this]()
+	{
+		RngStream = GenerationRngStream;
 
-	// -------------------------------------------------------
-	// Now lets loop through all the defined segments and create a cylinder for each
-	int32 CurrentIndexStart = 0;
+		// The reflected copy is only made when someone wants to look at it, on the game thread like every other property
+		DebugSegments.Reset();
+		if (bShowSegmentsInDetails)
+		{
+			DebugSegments.Reserve(Segments.Num());
+			for (int32 SegmentIndex = 0; SegmentIndex < Segments.Num(); SegmentIndex++)
+			{
+				DebugSegments.Add(FBranchSegment(Segments.GetStart(SegmentIndex), Segments.GetEnd(SegmentIndex), Segments.Width[SegmentIndex], (int8)Segments.Generation[SegmentIndex]));
+			}
+		}
 
-	for (int32 i = 0; i < Segments.Num(); i++)
+		ProcMesh->ClearAllMeshSections();
+		LODChain.Reset(NumLODs);
+		SetActorTickEnabled(NumLODs > 1);
+		UploadLOD(0, bWeldVertices ? LOD0WeldedMeshData : LOD0Tubes.GetMeshData());
+		LODChain.ShowLOD(ProcMesh, 0);
+		MeshDataMemory.Set(LOD0Tubes.GetMeshData().GetAllocatedSize() + LOD0WeldedMeshData.GetAllocatedSize());
+	}, { OptimizationStage }, true);
+
+	MaterialStage = Pipeline.AddStage(TEXT("Material"), GET_STATID(STAT_ProceduralMeshUpload), [this]()
 	{
-		CurrentIndexStart = i * TotalNumberOfVerticesPerSection;
-		GenerateCylinder(MeshData, Segments[i].Start, Segments[i].End, Segments[i].Width, RadialSegmentCount, CurrentIndexStart, bSmoothNormals);
-	}
+		for (int32 LODIndex = 0; LODIndex < NumLODs; LODIndex++)
+		{
+			ProcMesh->SetMaterial(LODIndex, Material);
+		}
+	}, { UploadStage }, true);
 
-	ProcMesh->ClearAllMeshSections();
-	ProcMesh->CreateMeshSection(0, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, false);
-	ProcMesh->SetMaterial(0, Material);
-}
+	CollisionStage = Pipeline.AddStage(TEXT("Collision"), GET_STATID(STAT_ProceduralMeshCollision), [this]()
+	{
+		GenerateCollision();
+	}, { SegmentsStage }, true);
 
-FVector ABranchingLinesActor::RotatePointAroundPivot(FVector InPoint, FVector InPivot, FVector InAngles)
-{
-	FVector direction = InPoint - InPivot; // get point direction relative to pivot
-	direction = FQuat::MakeFromEuler(InAngles) * direction; // rotate it
-	return direction + InPivot; // calculate rotated point
+	// The preview is built from the same segments
+	PreviewStage = GeometryStage;
+
+	// -------------------------------------------------------
+	// The properties that only affect part of the work. Everything else shapes the segments, which all the stages are built from.
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ABranchingLinesActor, Material), MaterialStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ABranchingLinesActor, RadialSegmentCount), GeometryStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ABranchingLinesActor, bSmoothNormals), GeometryStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ABranchingLinesActor, bWeldVertices), OptimizationStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ABranchingLinesActor, NumLODs), UploadStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ABranchingLinesActor, bShowSegmentsInDetails), UploadStage);
+
+	// Complex collision is cooked as part of the upload
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ABranchingLinesActor, CollisionMode), UploadStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ABranchingLinesActor, CollisionMode), CollisionStage);
+
+	// Only read when switching LODs
+	Pipeline.IgnoreProperty(GET_MEMBER_NAME_CHECKED(ABranchingLinesActor, LODScreenSizes));
+	Pipeline.IgnoreProperty(GET_MEMBER_NAME_CHECKED(ABranchingLinesActor, EditorPreviewLOD));
 }
 
-void ABranchingLinesActor::PreCacheCrossSection()
+void ABranchingLinesActor::GenerateLOD(int32 LODIndex)
 {
-	if (LastCachedCrossSectionCount == RadialSegmentCount)
-	{
-		return;
-	}
+	FScratchLineSegmentStreams LODSegments;
+	GetLODSegments(LODIndex, LODSegments);
 
-	// Generate a cross-section for use in cylinder generation
-	const float AngleBetweenQuads = (2.0f / (float)(RadialSegmentCount)) * PI;
-	CachedCrossSectionPoints.Empty();
-
-	// Pre-calculate cross section points of a circle, two more than needed
-	for (int32 PointIndex = 0; PointIndex < (RadialSegmentCount + 2); PointIndex++)
+	FProceduralMeshData MeshData;
+	FTubeSegmentCache::Extrude(MeshData, LODSegments, FProceduralMeshLODChain::GetRadialSegmentCountForLOD(RadialSegmentCount, LODIndex), bSmoothNormals);
+	if (bWeldVertices)
 	{
-		float Angle = (float)PointIndex * AngleBetweenQuads;
-		CachedCrossSectionPoints.Add(FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0));
+		FVertexWelder::Weld(MeshData);
 	}
+	UploadLOD(LODIndex, MeshData);
+	ProcMesh->SetMaterial(LODIndex, Material);
+}
 
-	LastCachedCrossSectionCount = RadialSegmentCount;
+void ABranchingLinesActor::GetLODSegments(int32 LODIndex, FScratchLineSegmentStreams& OutSegments) const
+{
+	// Each LOD drops the thinnest fork generation, but we always keep the trunk
+	const int32 LODMaxForkGeneration = FMath::Max(0, Segments.GetMaxGeneration() - LODIndex);
+	OutSegments.Reset();
+	OutSegments.Append(Segments, LODMaxForkGeneration);
+}
+
+void ABranchingLinesActor::UploadLOD(int32 LODIndex, const FProceduralMeshData& MeshData)
+{
+	FProceduralMeshStats::CountUpload(MeshData);
+	ProcMesh->CreateMeshSection(LODIndex, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, LODIndex == 0 && CollisionMode == EProceduralCollisionMode::Complex);
+	LODChain.MarkGenerated(LODIndex);
 }
 
 void ABranchingLinesActor::CreateSegments()
@@ -107,7 +156,7 @@ void ABranchingLinesActor::CreateSegments()
 	// Next we take both of the newly created line halves, and subdivide them the same way.
 	// Each new midpoint also has a chance to create a new branch
 	// TODO This should really be recursive
-	Segments.Empty();
+	Segments.Reset();
 	float CurrentBranchOffset = MaxBranchOffset;
 
 	if (bMaxBranchOffsetAsPercentageOfLength)
@@ -119,143 +168,129 @@ void ABranchingLinesActor::CreateSegments()
 	float ChangeOfFork = FMath::Clamp(ChanceOfForkPercentage, 0.0f, 100.0f) / 100.0f;
 	float BranchOffsetReductionEachGeneration = FMath::Clamp(BranchOffsetReductionEachGenerationPercentage, 0.0f, 100.0f) / 100.0f;
 
-	// Add the first segment which is simply between the start and end points
-	Segments.Add(FBranchSegment(Start, End, TrunkWidth));
+	// Add the first segment which is simply between the start and end points.
+	// The generations in between are only needed to build the next one, so they live in scratch memory and only the last one is kept.
+	FScratchLineSegmentStreams currentGen;
+	currentGen.Add(Start, End, TrunkWidth, 0);
 
 	for (int32 iGen = 0; iGen < Iterations; iGen++)
 	{
-		TArray<FBranchSegment> newGen;
+		const int32 NumSegments = currentGen.Num();
+
+		// -------------------------------------------------------
+		// The random numbers are drawn one segment at a time, in the order the segments come in. Each segment draws which offset direction
+		// to use, how far to offset its midpoint and whether it forks, and a fork then draws its length, its rotation and the axis to rotate
+		// around, in that order on every compiler.
+		TArray<int32, FScratchAllocator> DirectionIndices;
+		TArray<float, FScratchAllocator> MidpointOffsets;
+		TArray<int32, FScratchAllocator> ForkSegments;
+		TArray<float, FScratchAllocator> ForkLengths;
+		TArray<float, FScratchAllocator> ForkRotations;
+		TArray<int32, FScratchAllocator> ForkAxisIndices;
+		DirectionIndices.SetNumUninitialized(NumSegments);
+		MidpointOffsets.SetNumUninitialized(NumSegments);
+
+		for (int32 SegmentIndex = 0; SegmentIndex < NumSegments; SegmentIndex++)
+		{
+			DirectionIndices[SegmentIndex] = GenerationRngStream.RandRange(0, 1);
+			MidpointOffsets[SegmentIndex] = GenerationRngStream.RandRange(-CurrentBranchOffset, CurrentBranchOffset);
 
-		for (const FBranchSegment& EachSegment : Segments)
+			// Chance of fork?
+			if (GenerationRngStream.FRand() > (1 - ChangeOfFork))
+			{
+				ForkSegments.Add(SegmentIndex);
+				ForkLengths.Add(GenerationRngStream.FRandRange(ForkLengthMin, ForkLengthMax));
+				ForkRotations.Add(GenerationRngStream.FRandRange(ForkRotationMin, ForkRotationMax));
+				ForkAxisIndices.Add(GenerationRngStream.RandRange(0, 1));
+			}
+		}
+
+		// -------------------------------------------------------
+		// Offset every midpoint along the normal of its segment. This reads and writes nothing but the packed streams and has no branches,
+		// so it runs over several segments per instruction.
+		TArray<float, FScratchAllocator> MidpointX;
+		TArray<float, FScratchAllocator> MidpointY;
+		TArray<float, FScratchAllocator> MidpointZ;
+		MidpointX.SetNumUninitialized(NumSegments);
+		MidpointY.SetNumUninitialized(NumSegments);
+		MidpointZ.SetNumUninitialized(NumSegments);
+
+		const FVector OffsetDirectionA = OffsetDirections[0];
+		const FVector OffsetDirectionB = OffsetDirections[1];
+		for (int32 SegmentIndex = 0; SegmentIndex < NumSegments; SegmentIndex++)
 		{
-			FVector Midpoint = (EachSegment.End + EachSegment.Start) / 2;
+			const bool bDirectionB = DirectionIndices[SegmentIndex] != 0;
+			const float AxisX = bDirectionB ? OffsetDirectionB.X : OffsetDirectionA.X;
+			const float AxisY = bDirectionB ? OffsetDirectionB.Y : OffsetDirectionA.Y;
+			const float AxisZ = bDirectionB ? OffsetDirectionB.Z : OffsetDirectionA.Z;
+
+			const float LineX = currentGen.EndX[SegmentIndex] - currentGen.StartX[SegmentIndex];
+			const float LineY = currentGen.EndY[SegmentIndex] - currentGen.StartY[SegmentIndex];
+			const float LineZ = currentGen.EndZ[SegmentIndex] - currentGen.StartZ[SegmentIndex];
+
+			// Cross product with the offset direction, normalized the same way FVector::Normalize does it (too short is left alone)
+			const float NormalX = LineY * AxisZ - LineZ * AxisY;
+			const float NormalY = LineZ * AxisX - LineX * AxisZ;
+			const float NormalZ = LineX * AxisY - LineY * AxisX;
+			const float NormalSizeSquared = NormalX * NormalX + NormalY * NormalY + NormalZ * NormalZ;
+			const float NormalScale = NormalSizeSquared > SMALL_NUMBER ? 1.0f / FMath::Sqrt(FMath::Max(NormalSizeSquared, SMALL_NUMBER)) : 1.0f;
+			const float Offset = MidpointOffsets[SegmentIndex] * NormalScale;
+
+			MidpointX[SegmentIndex] = (currentGen.EndX[SegmentIndex] + currentGen.StartX[SegmentIndex]) / 2 + NormalX * Offset;
+			MidpointY[SegmentIndex] = (currentGen.EndY[SegmentIndex] + currentGen.StartY[SegmentIndex]) / 2 + NormalY * Offset;
+			MidpointZ[SegmentIndex] = (currentGen.EndZ[SegmentIndex] + currentGen.StartZ[SegmentIndex]) / 2 + NormalZ * Offset;
+		}
 
-			// Offset the midpoint by a random number along the normal
-			FVector normal = FVector::CrossProduct(EachSegment.End - EachSegment.Start, OffsetDirections[RngStream.RandRange(0, 1)]);
-			normal.Normalize();
-			Midpoint += normal * RngStream.RandRange(-CurrentBranchOffset, CurrentBranchOffset);
+		// -------------------------------------------------------
+		// Create two new segments for each one, followed by its fork if it has one
+		FScratchLineSegmentStreams newGen;
+		newGen.Reserve(NumSegments * 2 + ForkSegments.Num());
+		int32 NextFork = 0;
 
-			 // Create two new segments
-			newGen.Add(FBranchSegment(EachSegment.Start, Midpoint, EachSegment.Width, EachSegment.ForkGeneration));
-			newGen.Add(FBranchSegment(Midpoint, EachSegment.End, EachSegment.Width, EachSegment.ForkGeneration));
+		for (int32 SegmentIndex = 0; SegmentIndex < NumSegments; SegmentIndex++)
+		{
+			const FVector SegmentStart = currentGen.GetStart(SegmentIndex);
+			const FVector Midpoint = FVector(MidpointX[SegmentIndex], MidpointY[SegmentIndex], MidpointZ[SegmentIndex]);
+			const float Width = currentGen.Width[SegmentIndex];
+			const int32 ForkGeneration = currentGen.Generation[SegmentIndex];
 
-			// Chance of fork?
-			if (RngStream.FRand() > (1 - ChangeOfFork))
+			newGen.Add(SegmentStart, Midpoint, Width, ForkGeneration);
+			newGen.Add(Midpoint, currentGen.GetEnd(SegmentIndex), Width, ForkGeneration);
+
+			if (NextFork < ForkSegments.Num() && ForkSegments[NextFork] == SegmentIndex)
 			{
 				// TODO Normalize the direction vector and calculate a new total length and then subdiv that for X generations
-				FVector direction = Midpoint - EachSegment.Start;
-				FVector splitEnd = (direction * RngStream.FRandRange(ForkLengthMin, ForkLengthMax)).RotateAngleAxis(RngStream.FRandRange(ForkRotationMin, ForkRotationMax), OffsetDirections[RngStream.RandRange(0, 1)]) + Midpoint;
-				newGen.Add(FBranchSegment(Midpoint, splitEnd, EachSegment.Width * WidthReductionOnFork, EachSegment.ForkGeneration + 1));
+				FVector direction = Midpoint - SegmentStart;
+				FVector splitEnd = (direction * ForkLengths[NextFork]).RotateAngleAxis(ForkRotations[NextFork], OffsetDirections[ForkAxisIndices[NextFork]]) + Midpoint;
+				newGen.Add(Midpoint, splitEnd, Width * WidthReductionOnFork, ForkGeneration + 1);
+				NextFork++;
 			}
 		}
 
-		Segments.Empty();
-		Segments = newGen;
+		currentGen = MoveTemp(newGen);
 
 		// Reduce the offset slightly each generation
 		CurrentBranchOffset = CurrentBranchOffset * BranchOffsetReductionEachGeneration;
 	}
+
+	Segments.Append(currentGen);
 }
 
-void ABranchingLinesActor::GenerateCylinder(FProceduralMeshData& MeshData, FVector StartPoint, FVector EndPoint, float InWidth, int32 InCrossSectionCount, int32 InVertexIndexStart, bool bInSmoothNormals/* = true*/)
+void ABranchingLinesActor::GenerateCollision()
 {
-	// Basic setup
-	int32 VertexIndex = InVertexIndexStart;
-	int32 NumVerts = InCrossSectionCount * 4; // 4 verts per face
-
-	// Make a cylinder section
-	const float AngleBetweenQuads = (2.0f / (float)(InCrossSectionCount)) * PI;
-	const float UMapPerQuad = 1.0f / (float)InCrossSectionCount;
-
-	FVector StartOffset = StartPoint - FVector(0, 0, 0);
-	FVector Offset = EndPoint - StartPoint;
-
-	// Find angle between vectors
-	FVector LineDirection = (StartPoint - EndPoint);
-	LineDirection.Normalize();
-	FVector RotationAngle = LineDirection.Rotation().Add(90.f, 0.f, 0.f).Euler();
+	if (CollisionMode != EProceduralCollisionMode::Simple)
+	{
+		Collision->ClearCollision();
+		return;
+	}
 
-	// Start by building up vertices that make up the cylinder sides
-	for (int32 QuadIndex = 0; QuadIndex < InCrossSectionCount; QuadIndex++)
+	// The worker thread gets its own copy of the segments and builds the capsules from those
+	FLineSegmentStreams CollisionSegments = Segments;
+	Collision->BuildCollisionAsync([CollisionSegments](FKAggregateGeom& Shapes)
 	{
-		float Angle = (float)QuadIndex * AngleBetweenQuads;
-		float NextAngle = (float)(QuadIndex + 1) * AngleBetweenQuads;
-
-		// Set up the vertices
-		FVector p0 = (CachedCrossSectionPoints[QuadIndex] * InWidth) + StartOffset;
-		p0 = RotatePointAroundPivot(p0, StartPoint, RotationAngle);
-		FVector p1 = CachedCrossSectionPoints[QuadIndex + 1] * InWidth + StartOffset;
-		p1 = RotatePointAroundPivot(p1, StartPoint, RotationAngle);
-		FVector p2 = p1 + Offset;
-		FVector p3 = p0 + Offset;
-
-		// Set up the quad triangles
-		int32 VertIndex1 = VertexIndex++;
-		int32 VertIndex2 = VertexIndex++;
-		int32 VertIndex3 = VertexIndex++;
-		int32 VertIndex4 = VertexIndex++;
-
-		MeshData.Vertices[VertIndex1] = p0;
-		MeshData.Vertices[VertIndex2] = p1;
-		MeshData.Vertices[VertIndex3] = p2;
-		MeshData.Vertices[VertIndex4] = p3;
-
-		// Now create two triangles from those four vertices
-		// The order of these (clockwise/counter-clockwise) dictates which way the normal will face. 
-		MeshData.Triangles.Add(VertIndex4);
-		MeshData.Triangles.Add(VertIndex3);
-		MeshData.Triangles.Add(VertIndex1);
-
-		MeshData.Triangles.Add(VertIndex3);
-		MeshData.Triangles.Add(VertIndex2);
-		MeshData.Triangles.Add(VertIndex1);
-
-		// UVs.  Note that Unreal UV origin (0,0) is top left
-		MeshData.UVs[VertIndex1] = FVector2D(1.0f - (UMapPerQuad * QuadIndex), 1.0f);
-		MeshData.UVs[VertIndex2] = FVector2D(1.0f - (UMapPerQuad * (QuadIndex + 1)), 1.0f);
-		MeshData.UVs[VertIndex3] = FVector2D(1.0f - (UMapPerQuad * (QuadIndex + 1)), 0.0f);
-		MeshData.UVs[VertIndex4] = FVector2D(1.0f - (UMapPerQuad * QuadIndex), 0.0f);
-
-		// Normals
-		FVector NormalCurrent = FVector::CrossProduct(MeshData.Vertices[VertIndex1] - MeshData.Vertices[VertIndex3], MeshData.Vertices[VertIndex2] - MeshData.Vertices[VertIndex3]).GetSafeNormal();
-
-		if (bInSmoothNormals)
-		{
-			// To smooth normals we give the vertices different values than the polygon they belong to.
-			// GPUs know how to interpolate between those.
-			// I do this here as an average between normals of two adjacent polygons
-			float NextNextAngle = (float)(QuadIndex + 2) * AngleBetweenQuads;
-			FVector p4 = (CachedCrossSectionPoints[QuadIndex + 2] * InWidth) + StartOffset;
-			p4 = RotatePointAroundPivot(p4, StartPoint, RotationAngle);
-
-			// p1 to p4 to p2
-			FVector NormalNext = FVector::CrossProduct(p1 - p2, p4 - p2).GetSafeNormal();
-			FVector AverageNormalRight = (NormalCurrent + NormalNext) / 2;
-			AverageNormalRight = AverageNormalRight.GetSafeNormal();
-
-			float PreviousAngle = (float)(QuadIndex - 1) * AngleBetweenQuads;
-			FVector pMinus1 = FVector(FMath::Cos(PreviousAngle) * InWidth, FMath::Sin(PreviousAngle) * InWidth, 0.f) + StartOffset;
-			pMinus1 = RotatePointAroundPivot(pMinus1, StartPoint, RotationAngle);
-
-			// p0 to p3 to pMinus1
-			FVector NormalPrevious = FVector::CrossProduct(p0 - pMinus1, p3 - pMinus1).GetSafeNormal();
-			FVector AverageNormalLeft = (NormalCurrent + NormalPrevious) / 2;
-			AverageNormalLeft = AverageNormalLeft.GetSafeNormal();
-
-			MeshData.Normals[VertIndex1] = AverageNormalLeft;
-			MeshData.Normals[VertIndex2] = AverageNormalRight;
-			MeshData.Normals[VertIndex3] = AverageNormalRight;
-			MeshData.Normals[VertIndex4] = AverageNormalLeft;
-		}
-		else
+		for (int32 SegmentIndex = 0; SegmentIndex < CollisionSegments.Num(); SegmentIndex++)
 		{
-			// If not smoothing we just set the vertex normal to the same normal as the polygon they belong to
-			MeshData.Normals[VertIndex1] = MeshData.Normals[VertIndex2] = MeshData.Normals[VertIndex3] = MeshData.Normals[VertIndex4] = NormalCurrent;
+			UProceduralCollisionComponent::AddCapsule(Shapes, CollisionSegments.GetStart(SegmentIndex), CollisionSegments.GetEnd(SegmentIndex), CollisionSegments.Width[SegmentIndex]);
 		}
-
-		// Tangents (perpendicular to the surface)
-		FVector SurfaceTangent = p0 - p1;
-		SurfaceTangent = SurfaceTangent.GetSafeNormal();
-		MeshData.Tangents[VertIndex1] = MeshData.Tangents[VertIndex2] = MeshData.Tangents[VertIndex3] = MeshData.Tangents[VertIndex4] = FProcMeshTangent(SurfaceTangent, true);
-	}
+	});
 }
@@ -0,0 +1,263 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Generated mesh data stored with packed normals and tangents, half precision UVs and optionally quantized positions
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "CompactMeshData.h"
+#include "ProceduralMeshThreading.h"
+
+namespace CompactMeshData
+{
+	// Enough work per task to be worth handing to another thread, and small enough to stay in cache while each attribute is converted
+	const int32 VerticesPerTask = 4096;
+
+	const float MaxQuantizedPosition = 65535.0f;
+
+	// Runs Function(Begin, End) over [0, Num) in blocks of VerticesPerTask, so it can run a tight loop over each block
+	template<typename FunctionType>
+	void ParallelForRanges(int32 Num, const FunctionType& Function)
+	{
+		const int32 NumTasks = FMath::DivideAndRoundUp(Num, VerticesPerTask);
+		FProceduralMeshThreading::ParallelFor(NumTasks, [&Function, Num](int32 TaskIndex)
+		{
+			Function(TaskIndex * VerticesPerTask, FMath::Min((TaskIndex + 1) * VerticesPerTask, Num));
+		}, NumTasks < 2);
+	}
+
+	// Signed 10 bit components in the low 30 bits, W in the top two
+	uint32 PackUnitVector(const FVector& Vector, uint32 W)
+	{
+		const uint32 X = (uint32)FMath::RoundToInt(FMath::Clamp(Vector.X, -1.0f, 1.0f) * 511.0f) & 0x3FF;
+		const uint32 Y = (uint32)FMath::RoundToInt(FMath::Clamp(Vector.Y, -1.0f, 1.0f) * 511.0f) & 0x3FF;
+		const uint32 Z = (uint32)FMath::RoundToInt(FMath::Clamp(Vector.Z, -1.0f, 1.0f) * 511.0f) & 0x3FF;
+		return X | (Y << 10) | (Z << 20) | (W << 30);
+	}
+
+	FVector UnpackUnitVector(uint32 Packed)
+	{
+		// Shifting the sign bit of each component up to bit 31 and back down again sign extends it
+		const float Scale = 1.0f / 511.0f;
+		return FVector(
+			(float)((int32)(Packed << 22) >> 22) * Scale,
+			(float)((int32)(Packed << 12) >> 22) * Scale,
+			(float)((int32)(Packed << 2) >> 22) * Scale);
+	}
+}
+
+FCompactMeshData::FCompactMeshData()
+	: PositionOrigin(FVector::ZeroVector), PositionScale(FVector::ZeroVector)
+{
+}
+
+FCompactMeshStats FCompactMeshData::Encode(const FProceduralMeshData& MeshData, bool bQuantizePositions)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	FCompactMeshStats Stats;
+	Stats.BytesPerVertexBefore = GetBytesPerVertex(MeshData);
+
+	Reset();
+	const int32 NumVertices = MeshData.Vertices.Num();
+	Triangles = MeshData.Triangles;
+	if (MeshData.VertexColors.Num() == NumVertices)
+	{
+		VertexColors = MeshData.VertexColors;
+	}
+
+	// -------------------------------------------------------
+	// Positions, spread over the bounds of the mesh. An axis the mesh is flat along gets a scale of 0 and decodes to the origin exactly.
+	if (bQuantizePositions && NumVertices > 0)
+	{
+		FVector BoundsMin = MeshData.Vertices[0];
+		FVector BoundsMax = MeshData.Vertices[0];
+		for (const FVector& Vertex : MeshData.Vertices)
+		{
+			BoundsMin = BoundsMin.ComponentMin(Vertex);
+			BoundsMax = BoundsMax.ComponentMax(Vertex);
+		}
+
+		PositionOrigin = BoundsMin;
+		PositionScale = (BoundsMax - BoundsMin) / CompactMeshData::MaxQuantizedPosition;
+		const FVector InverseScale = FVector(
+			PositionScale.X > 0.0f ? 1.0f / PositionScale.X : 0.0f,
+			PositionScale.Y > 0.0f ? 1.0f / PositionScale.Y : 0.0f,
+			PositionScale.Z > 0.0f ? 1.0f / PositionScale.Z : 0.0f);
+
+		QuantizedVertices.SetNumUninitialized(NumVertices);
+		CompactMeshData::ParallelForRanges(NumVertices, [&](int32 Begin, int32 End)
+		{
+			const FVector* Source = MeshData.Vertices.GetData();
+			FCompactPosition* Destination = QuantizedVertices.GetData();
+			for (int32 Index = Begin; Index < End; Index++)
+			{
+				const FVector Position = (Source[Index] - PositionOrigin) * InverseScale;
+				Destination[Index].X = (uint16)FMath::Clamp(FMath::RoundToInt(Position.X), 0, 65535);
+				Destination[Index].Y = (uint16)FMath::Clamp(FMath::RoundToInt(Position.Y), 0, 65535);
+				Destination[Index].Z = (uint16)FMath::Clamp(FMath::RoundToInt(Position.Z), 0, 65535);
+			}
+		});
+
+		// Rounding moves each axis at most half a step
+		Stats.MaxPositionError = (PositionScale * 0.5f).Size();
+	}
+	else
+	{
+		Vertices = MeshData.Vertices;
+	}
+
+	// -------------------------------------------------------
+	// Normals, tangents and UVs, each in its own loop so every loop body is the same few instructions for all vertices
+	const bool bHasNormals = MeshData.Normals.Num() == NumVertices;
+	const bool bHasTangents = MeshData.Tangents.Num() == NumVertices;
+	const bool bHasUVs = MeshData.UVs.Num() == NumVertices;
+	Normals.SetNumUninitialized(bHasNormals ? NumVertices : 0);
+	Tangents.SetNumUninitialized(bHasTangents ? NumVertices : 0);
+	UVs.SetNumUninitialized(bHasUVs ? NumVertices : 0);
+
+	CompactMeshData::ParallelForRanges(NumVertices, [&](int32 Begin, int32 End)
+	{
+		if (bHasNormals)
+		{
+			const FVector* Source = MeshData.Normals.GetData();
+			uint32* Destination = Normals.GetData();
+			for (int32 Index = Begin; Index < End; Index++)
+			{
+				Destination[Index] = CompactMeshData::PackUnitVector(Source[Index], 0);
+			}
+		}
+
+		if (bHasTangents)
+		{
+			const FProcMeshTangent* Source = MeshData.Tangents.GetData();
+			uint32* Destination = Tangents.GetData();
+			for (int32 Index = Begin; Index < End; Index++)
+			{
+				Destination[Index] = CompactMeshData::PackUnitVector(Source[Index].TangentX, Source[Index].bFlipTangentY ? 1 : 0);
+			}
+		}
+
+		if (bHasUVs)
+		{
+			const FVector2D* Source = MeshData.UVs.GetData();
+			FVector2DHalf* Destination = UVs.GetData();
+			for (int32 Index = Begin; Index < End; Index++)
+			{
+				Destination[Index] = FVector2DHalf(Source[Index]);
+			}
+		}
+	});
+
+	Stats.BytesPerVertexAfter = GetBytesPerVertex();
+	Stats.Seconds = FPlatformTime::Seconds() - StartTime;
+	return Stats;
+}
+
+void FCompactMeshData::DecodeVertices(FProceduralMeshData& OutMeshData, int32 FirstVertex) const
+{
+	const int32 NumVertices = GetNumVertices();
+	if (Vertices.Num() > 0)
+	{
+		FMemory::Memcpy(OutMeshData.Vertices.GetData() + FirstVertex, Vertices.GetData(), NumVertices * sizeof(FVector));
+	}
+	if (VertexColors.Num() > 0)
+	{
+		FMemory::Memcpy(OutMeshData.VertexColors.GetData() + FirstVertex, VertexColors.GetData(), NumVertices * sizeof(FColor));
+	}
+
+	CompactMeshData::ParallelForRanges(NumVertices, [&](int32 Begin, int32 End)
+	{
+		if (QuantizedVertices.Num() > 0)
+		{
+			const FCompactPosition* Source = QuantizedVertices.GetData();
+			FVector* Destination = OutMeshData.Vertices.GetData() + FirstVertex;
+			for (int32 Index = Begin; Index < End; Index++)
+			{
+				Destination[Index] = PositionOrigin + FVector(Source[Index].X, Source[Index].Y, Source[Index].Z) * PositionScale;
+			}
+		}
+
+		if (Normals.Num() > 0)
+		{
+			const uint32* Source = Normals.GetData();
+			FVector* Destination = OutMeshData.Normals.GetData() + FirstVertex;
+			for (int32 Index = Begin; Index < End; Index++)
+			{
+				Destination[Index] = CompactMeshData::UnpackUnitVector(Source[Index]);
+			}
+		}
+
+		if (Tangents.Num() > 0)
+		{
+			const uint32* Source = Tangents.GetData();
+			FProcMeshTangent* Destination = OutMeshData.Tangents.GetData() + FirstVertex;
+			for (int32 Index = Begin; Index < End; Index++)
+			{
+				Destination[Index] = FProcMeshTangent(CompactMeshData::UnpackUnitVector(Source[Index]), (Source[Index] >> 30) != 0);
+			}
+		}
+
+		if (UVs.Num() > 0)
+		{
+			const FVector2DHalf* Source = UVs.GetData();
+			FVector2D* Destination = OutMeshData.UVs.GetData() + FirstVertex;
+			for (int32 Index = Begin; Index < End; Index++)
+			{
+				Destination[Index] = Source[Index];
+			}
+		}
+	});
+}
+
+void FCompactMeshData::Decode(FProceduralMeshData& OutMeshData) const
+{
+	const int32 NumVertices = GetNumVertices();
+	OutMeshData.Reset();
+	OutMeshData.Vertices.AddUninitialized(NumVertices);
+	OutMeshData.Normals.AddUninitialized(Normals.Num());
+	OutMeshData.Tangents.AddUninitialized(Tangents.Num());
+	OutMeshData.UVs.AddUninitialized(UVs.Num());
+	OutMeshData.VertexColors.AddUninitialized(VertexColors.Num());
+	OutMeshData.Triangles = Triangles;
+	DecodeVertices(OutMeshData, 0);
+}
+
+void FCompactMeshData::Reset()
+{
+	Vertices.Reset();
+	QuantizedVertices.Reset();
+	PositionOrigin = FVector::ZeroVector;
+	PositionScale = FVector::ZeroVector;
+	Triangles.Reset();
+	Normals.Reset();
+	Tangents.Reset();
+	UVs.Reset();
+	VertexColors.Reset();
+}
+
+int32 FCompactMeshData::GetNumVertices() const
+{
+	return FMath::Max(Vertices.Num(), QuantizedVertices.Num());
+}
+
+SIZE_T FCompactMeshData::GetAllocatedSize() const
+{
+	return Vertices.GetAllocatedSize() + QuantizedVertices.GetAllocatedSize() + Triangles.GetAllocatedSize() + Normals.GetAllocatedSize()
+		+ Tangents.GetAllocatedSize() + UVs.GetAllocatedSize() + VertexColors.GetAllocatedSize();
+}
+
+int32 FCompactMeshData::GetBytesPerVertex(const FProceduralMeshData& MeshData)
+{
+	const int32 NumVertices = MeshData.Vertices.Num();
+	return sizeof(FVector)
+		+ (MeshData.Normals.Num() == NumVertices ? sizeof(FVector) : 0)
+		+ (MeshData.Tangents.Num() == NumVertices ? sizeof(FProcMeshTangent) : 0)
+		+ (MeshData.UVs.Num() == NumVertices ? sizeof(FVector2D) : 0)
+		+ (MeshData.VertexColors.Num() == NumVertices ? sizeof(FColor) : 0);
+}
+
+int32 FCompactMeshData::GetBytesPerVertex() const
+{
+	return (QuantizedVertices.Num() > 0 ? sizeof(FCompactPosition) : sizeof(FVector))
+		+ (Normals.Num() > 0 ? sizeof(uint32) : 0)
+		+ (Tangents.Num() > 0 ? sizeof(uint32) : 0)
+		+ (UVs.Num() > 0 ? sizeof(FVector2DHalf) : 0)
+		+ (VertexColors.Num() > 0 ? sizeof(FColor) : 0);
+}
@@ -0,0 +1,75 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Generated mesh data stored with packed normals and tangents, half precision UVs and optionally quantized positions
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshData.h"
+
+struct PROCEDURALMESHES_API FCompactMeshStats
+{
+	// Size of the vertex attributes that are present, triangles not included
+	int32 BytesPerVertexBefore;
+	int32 BytesPerVertexAfter;
+
+	// Half a quantization step along each axis, which is about as far as quantizing moves a position. 0 if positions are kept as they are.
+	float MaxPositionError;
+	double Seconds;
+
+	FCompactMeshStats()
+		: BytesPerVertexBefore(0), BytesPerVertexAfter(0), MaxPositionError(0.0f), Seconds(0.0)
+	{
+	}
+};
+
+// 16 bits per axis, relative to the bounds of the mesh it belongs to
+struct FCompactPosition
+{
+	uint16 X;
+	uint16 Y;
+	uint16 Z;
+};
+
+// Normals and tangents are unit length, so 10 bits per component is plenty (about 0.1 degrees). The two spare bits of the tangent hold
+// bFlipTangentY. UVs are half floats, which keeps about three decimal digits between 0 and 1 but still allows tiling past it.
+// Vertex colors and triangles are kept as they are. Encoding and decoding go through each attribute in blocks of plain loops without
+// branches, which the compiler turns into SIMD code, and the blocks are spread over the task graph.
+struct PROCEDURALMESHES_API FCompactMeshData
+{
+	// Only one of these is used, depending on whether the positions were quantized
+	TArray<FVector> Vertices;
+	TArray<FCompactPosition> QuantizedVertices;
+
+	// Quantized positions are PositionOrigin + Position * PositionScale
+	FVector PositionOrigin;
+	FVector PositionScale;
+
+	TArray<int32> Triangles;
+	TArray<uint32> Normals;
+	TArray<uint32> Tangents;
+	TArray<FVector2DHalf> UVs;
+	TArray<FColor> VertexColors;
+
+	FCompactMeshData();
+
+	// Replaces the contents with MeshData. Attributes MeshData doesn't have are left empty here too.
+	FCompactMeshStats Encode(const FProceduralMeshData& MeshData, bool bQuantizePositions);
+
+	// Writes the vertex attributes into OutMeshData starting at FirstVertex. The arrays of OutMeshData must already be large enough
+	// for every attribute this has, which lets several compact meshes be decoded straight into one merged buffer.
+	void DecodeVertices(FProceduralMeshData& OutMeshData, int32 FirstVertex) const;
+
+	// Replaces the contents of OutMeshData with the decoded mesh
+	void Decode(FProceduralMeshData& OutMeshData) const;
+
+	void Reset();
+
+	int32 GetNumVertices() const;
+
+	// Memory held by all the arrays
+	SIZE_T GetAllocatedSize() const;
+
+	// Bytes per vertex of the attributes MeshData has
+	static int32 GetBytesPerVertex(const FProceduralMeshData& MeshData);
+	int32 GetBytesPerVertex() const;
+};
@@ -0,0 +1,66 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Process-wide cache of unit circle cross sections shared by all the tube generating actors
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "CrossSectionCache.h"
+
+FCrossSectionRing::FCrossSectionRing(int32 InSegmentCount)
+	: SegmentCount(FMath::Max(InSegmentCount, 1))
+{
+	const float AngleBetweenQuads = (2.0f / (float)(SegmentCount)) * PI;
+	const float UMapPerQuad = 1.0f / (float)SegmentCount;
+
+	Points.AddUninitialized(SegmentCount + 1);
+	UColumns.AddUninitialized(SegmentCount + 1);
+	FaceNormals.AddUninitialized(SegmentCount);
+	FaceTangents.AddUninitialized(SegmentCount);
+
+	for (int32 PointIndex = 0; PointIndex < SegmentCount + 1; PointIndex++)
+	{
+		float Angle = (float)PointIndex * AngleBetweenQuads;
+		float Sin, Cos;
+		FMath::SinCos(&Sin, &Cos, Angle);
+		Points[PointIndex] = FVector(Cos, Sin, 0);
+
+		// Note that Unreal UV origin (0,0) is top left
+		UColumns[PointIndex] = 1.0f - (UMapPerQuad * PointIndex);
+	}
+
+	// A flat quad faces straight out through the middle of its two points, and its tangent runs from the second point back to the first
+	for (int32 QuadIndex = 0; QuadIndex < SegmentCount; QuadIndex++)
+	{
+		float MidAngle = ((float)QuadIndex + 0.5f) * AngleBetweenQuads;
+		float Sin, Cos;
+		FMath::SinCos(&Sin, &Cos, MidAngle);
+		FaceNormals[QuadIndex] = FVector(Cos, Sin, 0);
+		FaceTangents[QuadIndex] = FVector(Sin, -Cos, 0);
+	}
+}
+
+FCrossSectionRingRef FCrossSectionCache::Get(int32 SegmentCount)
+{
+	SegmentCount = FMath::Max(SegmentCount, 1);
+	FScopeLock Lock(&GetLock());
+
+	TMap<int32, FCrossSectionRingRef>& Rings = GetRings();
+	if (const FCrossSectionRingRef* ExistingRing = Rings.Find(SegmentCount))
+	{
+		return *ExistingRing;
+	}
+
+	FCrossSectionRingRef NewRing = MakeShareable(new FCrossSectionRing(SegmentCount));
+	Rings.Add(SegmentCount, NewRing);
+	return NewRing;
+}
+
+FCriticalSection& FCrossSectionCache::GetLock()
+{
+	static FCriticalSection Lock;
+	return Lock;
+}
+
+TMap<int32, FCrossSectionRingRef>& FCrossSectionCache::GetRings()
+{
+	static TMap<int32, FCrossSectionRingRef> Rings;
+	return Rings;
+}
@@ -0,0 +1,42 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Process-wide cache of unit circle cross sections shared by all the tube generating actors
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+
+// Everything a cylinder needs to know about its cross section, precomputed once per segment count.
+// All vectors are in cross section space (circle in the XY plane, cylinder extends along +Z),
+// so a generator only has to rotate them into place.
+struct PROCEDURALMESHES_API FCrossSectionRing
+{
+	int32 SegmentCount;
+
+	// Points on the unit circle, X is the cosine and Y the sine of the angle.
+	// There is one more point than segments so the last quad doesn't need to wrap around.
+	// On a unit circle these double as the smoothed vertex normals.
+	TArray<FVector> Points;
+
+	// U texture coordinate for each point
+	TArray<float> UColumns;
+
+	// Outward facing normal and surface tangent of each quad, used when not smoothing normals
+	TArray<FVector> FaceNormals;
+	TArray<FVector> FaceTangents;
+
+	explicit FCrossSectionRing(int32 InSegmentCount);
+};
+
+typedef TSharedRef<const FCrossSectionRing, ESPMode::ThreadSafe> FCrossSectionRingRef;
+
+class PROCEDURALMESHES_API FCrossSectionCache
+{
+public:
+	// Returns the cross section for the given number of segments, building it the first time it is asked for.
+	// Safe to call from any thread, the returned ring is immutable.
+	static FCrossSectionRingRef Get(int32 SegmentCount);
+
+private:
+	static FCriticalSection& GetLock();
+	static TMap<int32, FCrossSectionRingRef>& GetRings();
+};
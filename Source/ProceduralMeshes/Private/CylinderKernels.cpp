@@ -0,0 +1,464 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Cylinder and tube builders specialised at compile time for each combination of options
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "CylinderKernels.h"
+
+namespace CylinderKernels
+{
+	// FixedSegmentCount of 0 means the count is only known at runtime and is read from the cross section
+	template <bool bSmoothNormals, int32 FixedSegmentCount>
+	void GenerateTube(FProceduralMeshData& MeshData, const FCrossSectionRing& CrossSection, const FVector& StartPoint, const FVector& EndPoint, float InWidth, const FQuat& Rotation, int32 InVertexIndexStart)
+	{
+		// Basic setup
+		int32 VertexIndex = InVertexIndexStart;
+		int32 TriangleIndex = (InVertexIndexStart / 4) * 6; // Every quad has 4 verts and 2x3 vertex indexes
+		const int32 NumQuads = FixedSegmentCount > 0 ? FixedSegmentCount : CrossSection.SegmentCount;
+
+		FVector Offset = EndPoint - StartPoint;
+
+		// All the sines and cosines come from the shared cross section, so all that is left per quad is rotating them into place
+		FVector RingDirection = Rotation.RotateVector(CrossSection.Points[0]);
+
+		// Start by building up vertices that make up the cylinder sides
+		for (int32 QuadIndex = 0; QuadIndex < NumQuads; QuadIndex++)
+		{
+			FVector NextRingDirection = Rotation.RotateVector(CrossSection.Points[QuadIndex + 1]);
+
+			// Set up the vertices
+			FVector p0 = StartPoint + (RingDirection * InWidth);
+			FVector p1 = StartPoint + (NextRingDirection * InWidth);
+			FVector p2 = p1 + Offset;
+			FVector p3 = p0 + Offset;
+
+			// Set up the quad triangles
+			int32 VertIndex1 = VertexIndex++;
+			int32 VertIndex2 = VertexIndex++;
+			int32 VertIndex3 = VertexIndex++;
+			int32 VertIndex4 = VertexIndex++;
+
+			MeshData.Vertices[VertIndex1] = p0;
+			MeshData.Vertices[VertIndex2] = p1;
+			MeshData.Vertices[VertIndex3] = p2;
+			MeshData.Vertices[VertIndex4] = p3;
+
+			// Now create two triangles from those four vertices
+			// The order of these (clockwise/counter-clockwise) dictates which way the normal will face.
+			MeshData.Triangles[TriangleIndex++] = VertIndex4;
+			MeshData.Triangles[TriangleIndex++] = VertIndex3;
+			MeshData.Triangles[TriangleIndex++] = VertIndex1;
+
+			MeshData.Triangles[TriangleIndex++] = VertIndex3;
+			MeshData.Triangles[TriangleIndex++] = VertIndex2;
+			MeshData.Triangles[TriangleIndex++] = VertIndex1;
+
+			// UVs.  Note that Unreal UV origin (0,0) is top left
+			MeshData.UVs[VertIndex1] = FVector2D(CrossSection.UColumns[QuadIndex], 1.0f);
+			MeshData.UVs[VertIndex2] = FVector2D(CrossSection.UColumns[QuadIndex + 1], 1.0f);
+			MeshData.UVs[VertIndex3] = FVector2D(CrossSection.UColumns[QuadIndex + 1], 0.0f);
+			MeshData.UVs[VertIndex4] = FVector2D(CrossSection.UColumns[QuadIndex], 0.0f);
+
+			if (bSmoothNormals)
+			{
+				// On a circle the average of two adjacent polygon normals is simply the direction from the center to the vertex.
+				MeshData.Normals[VertIndex1] = RingDirection;
+				MeshData.Normals[VertIndex2] = NextRingDirection;
+				MeshData.Normals[VertIndex3] = NextRingDirection;
+				MeshData.Normals[VertIndex4] = RingDirection;
+			}
+			else
+			{
+				// If not smoothing we just set the vertex normal to the same normal as the polygon they belong to
+				MeshData.Normals[VertIndex1] = MeshData.Normals[VertIndex2] = MeshData.Normals[VertIndex3] = MeshData.Normals[VertIndex4] = Rotation.RotateVector(CrossSection.FaceNormals[QuadIndex]);
+			}
+
+			// Tangents (perpendicular to the surface)
+			FVector SurfaceTangent = Rotation.RotateVector(CrossSection.FaceTangents[QuadIndex]);
+			MeshData.Tangents[VertIndex1] = MeshData.Tangents[VertIndex2] = MeshData.Tangents[VertIndex3] = MeshData.Tangents[VertIndex4] = FProcMeshTangent(SurfaceTangent, true);
+
+			RingDirection = NextRingDirection;
+		}
+	}
+
+	template <bool bCapEnds, bool bDoubleSided, bool bSmoothNormals, int32 FixedSegmentCount>
+	void GenerateCylinder(FProceduralMeshData& MeshData, const FCrossSectionRing& CrossSection, float InHeight, float InWidth)
+	{
+		// -------------------------------------------------------
+		// Basic setup
+		// The sides are made of a bottom and a top ring of vertices, connected by index.
+		// Smooth rings repeat the first vertex at the end so the UVs can wrap around, flat rings need two vertices per quad so each quad can have its own normal.
+		// The inside of a double sided cylinder needs its own rings since its normals point the other way.
+		// Each cap is a fan of triangles around a shared center vertex, with its own ring since cap normals point along the axis.
+		const int32 NumQuads = FixedSegmentCount > 0 ? FixedSegmentCount : CrossSection.SegmentCount;
+		const int32 RingVertexCount = bSmoothNormals ? NumQuads + 1 : NumQuads * 2;
+		const int32 NumSides = bDoubleSided ? 2 : 1;
+		const int32 NumSideVerts = NumSides * 2 * RingVertexCount;
+		const int32 NumCapVerts = bCapEnds ? 2 * (NumQuads + 1) : 0;
+		const int32 NumVerts = NumSideVerts + NumCapVerts;
+		const int32 NumTriangleIndexes = (NumSides * NumQuads * 2 * 3) + (bCapEnds ? 2 * NumQuads * 3 : 0);
+
+		MeshData.Vertices.AddUninitialized(NumVerts);
+		MeshData.Triangles.AddUninitialized(NumTriangleIndexes);
+		MeshData.Normals.AddUninitialized(NumVerts);
+		MeshData.Tangents.AddUninitialized(NumVerts);
+		MeshData.UVs.AddUninitialized(NumVerts);
+
+		// Write straight into the buffers we just sized
+		FVector* Vertices = MeshData.Vertices.GetData();
+		int32* Triangles = MeshData.Triangles.GetData();
+		FVector* Normals = MeshData.Normals.GetData();
+		FProcMeshTangent* Tangents = MeshData.Tangents.GetData();
+		FVector2D* UVs = MeshData.UVs.GetData();
+
+		const FVector Offset = FVector(0, 0, InHeight);
+		int32 VertexIndex = 0;
+		int32 TriangleIndex = 0;
+
+		// -------------------------------------------------------
+		// Cylinder sides, outside first and then the inside if double sided
+		for (int32 SideIndex = 0; SideIndex < NumSides; SideIndex++)
+		{
+			const bool bInside = SideIndex == 1;
+			const float NormalSign = bInside ? -1.0f : 1.0f;
+			const int32 BottomRingStart = VertexIndex;
+			const int32 TopRingStart = VertexIndex + RingVertexCount;
+
+			for (int32 RingIndex = 0; RingIndex < RingVertexCount; RingIndex++)
+			{
+				// Flat rings have the right edge of the previous quad and the left edge of the next one on top of each other
+				const int32 QuadIndex = bSmoothNormals ? RingIndex : RingIndex / 2;
+				const int32 CrossSectionIndex = bSmoothNormals ? RingIndex : QuadIndex + (RingIndex & 1);
+				const FVector& Point = CrossSection.Points[CrossSectionIndex];
+
+				const int32 BottomIndex = BottomRingStart + RingIndex;
+				const int32 TopIndex = TopRingStart + RingIndex;
+
+				Vertices[BottomIndex] = Point * InWidth;
+				Vertices[TopIndex] = Vertices[BottomIndex] + Offset;
+
+				// UVs.  Note that Unreal UV origin (0,0) is top left
+				UVs[BottomIndex] = FVector2D(CrossSection.UColumns[CrossSectionIndex], 1.0f);
+				UVs[TopIndex] = FVector2D(CrossSection.UColumns[CrossSectionIndex], 0.0f);
+
+				if (bSmoothNormals)
+				{
+					// On a circle the average of two adjacent polygon normals is simply the direction from the center to the vertex.
+					Normals[BottomIndex] = Normals[TopIndex] = Point * NormalSign;
+					Tangents[BottomIndex] = Tangents[TopIndex] = FProcMeshTangent(FVector(Point.Y, -Point.X, 0), true);
+				}
+				else
+				{
+					// If not smoothing we just set the vertex normal to the same normal as the polygon they belong to
+					Normals[BottomIndex] = Normals[TopIndex] = CrossSection.FaceNormals[QuadIndex] * NormalSign;
+					Tangents[BottomIndex] = Tangents[TopIndex] = FProcMeshTangent(CrossSection.FaceTangents[QuadIndex], true);
+				}
+			}
+
+			for (int32 QuadIndex = 0; QuadIndex < NumQuads; QuadIndex++)
+			{
+				const int32 LeftOffset = bSmoothNormals ? QuadIndex : QuadIndex * 2;
+				const int32 RightOffset = LeftOffset + 1;
+
+				int32 VertIndex1 = BottomRingStart + LeftOffset;
+				int32 VertIndex2 = BottomRingStart + RightOffset;
+				int32 VertIndex3 = TopRingStart + RightOffset;
+				int32 VertIndex4 = TopRingStart + LeftOffset;
+
+				// The order of these (clockwise/counter-clockwise) dictates which way the normal will face.
+				// The inside uses the reverse order so it faces the other way.
+				if (bInside)
+				{
+					Triangles[TriangleIndex++] = VertIndex4;
+					Triangles[TriangleIndex++] = VertIndex1;
+					Triangles[TriangleIndex++] = VertIndex3;
+
+					Triangles[TriangleIndex++] = VertIndex3;
+					Triangles[TriangleIndex++] = VertIndex1;
+					Triangles[TriangleIndex++] = VertIndex2;
+				}
+				else
+				{
+					Triangles[TriangleIndex++] = VertIndex4;
+					Triangles[TriangleIndex++] = VertIndex3;
+					Triangles[TriangleIndex++] = VertIndex1;
+
+					Triangles[TriangleIndex++] = VertIndex3;
+					Triangles[TriangleIndex++] = VertIndex2;
+					Triangles[TriangleIndex++] = VertIndex1;
+				}
+			}
+
+			VertexIndex += 2 * RingVertexCount;
+		}
+
+		// -------------------------------------------------------
+		// Caps, each one a fan of triangles around a center vertex
+		if (bCapEnds)
+		{
+			for (int32 CapIndex = 0; CapIndex < 2; CapIndex++)
+			{
+				const bool bTopCap = CapIndex == 1;
+				const FVector CapOffset = bTopCap ? Offset : FVector::ZeroVector;
+				const FVector CapNormal = FVector(0, 0, bTopCap ? 1.0f : -1.0f);
+				// U runs along -X on both caps
+				const FProcMeshTangent CapTangent = FProcMeshTangent(-1, 0, 0);
+				// The bottom cap is seen from below, so its texture is mirrored
+				const float VSign = bTopCap ? -1.0f : 1.0f;
+
+				const int32 CenterIndex = VertexIndex++;
+				Vertices[CenterIndex] = CapOffset;
+				UVs[CenterIndex] = FVector2D(0.5f, 0.5f);
+				Normals[CenterIndex] = CapNormal;
+				Tangents[CenterIndex] = CapTangent;
+
+				const int32 RingStart = VertexIndex;
+				for (int32 PointIndex = 0; PointIndex < NumQuads; PointIndex++)
+				{
+					const FVector& Point = CrossSection.Points[PointIndex];
+					const int32 RingVertexIndex = VertexIndex++;
+
+					Vertices[RingVertexIndex] = (Point * InWidth) + CapOffset;
+					UVs[RingVertexIndex] = FVector2D(0.5f - (Point.X / 2.0f), 0.5f + (VSign * Point.Y / 2.0f));
+					Normals[RingVertexIndex] = CapNormal;
+					Tangents[RingVertexIndex] = CapTangent;
+				}
+
+				for (int32 QuadIndex = 0; QuadIndex < NumQuads; QuadIndex++)
+				{
+					const int32 RingVertex = RingStart + QuadIndex;
+					const int32 NextRingVertex = RingStart + ((QuadIndex + 1) % NumQuads);
+
+					if (bTopCap)
+					{
+						Triangles[TriangleIndex++] = NextRingVertex;
+						Triangles[TriangleIndex++] = RingVertex;
+						Triangles[TriangleIndex++] = CenterIndex;
+					}
+					else
+					{
+						Triangles[TriangleIndex++] = CenterIndex;
+						Triangles[TriangleIndex++] = RingVertex;
+						Triangles[TriangleIndex++] = NextRingVertex;
+					}
+				}
+			}
+		}
+	}
+
+	template <bool bSmoothNormals>
+	FCylinderKernels::FTubeKernel SelectTubeKernelForSegmentCount(int32 SegmentCount)
+	{
+		switch (SegmentCount)
+		{
+		case 4: return &GenerateTube<bSmoothNormals, 4>;
+		case 6: return &GenerateTube<bSmoothNormals, 6>;
+		case 8: return &GenerateTube<bSmoothNormals, 8>;
+		case 16: return &GenerateTube<bSmoothNormals, 16>;
+		default: return &GenerateTube<bSmoothNormals, 0>;
+		}
+	}
+
+	template <bool bCapEnds, bool bDoubleSided, bool bSmoothNormals>
+	FCylinderKernels::FCylinderKernel SelectCylinderKernelForSegmentCount(int32 SegmentCount)
+	{
+		switch (SegmentCount)
+		{
+		case 4: return &GenerateCylinder<bCapEnds, bDoubleSided, bSmoothNormals, 4>;
+		case 6: return &GenerateCylinder<bCapEnds, bDoubleSided, bSmoothNormals, 6>;
+		case 8: return &GenerateCylinder<bCapEnds, bDoubleSided, bSmoothNormals, 8>;
+		case 16: return &GenerateCylinder<bCapEnds, bDoubleSided, bSmoothNormals, 16>;
+		default: return &GenerateCylinder<bCapEnds, bDoubleSided, bSmoothNormals, 0>;
+		}
+	}
+
+	template <bool bCapEnds, bool bDoubleSided>
+	FCylinderKernels::FCylinderKernel SelectCylinderKernelForNormals(bool bSmoothNormals, int32 SegmentCount)
+	{
+		return bSmoothNormals
+			? SelectCylinderKernelForSegmentCount<bCapEnds, bDoubleSided, true>(SegmentCount)
+			: SelectCylinderKernelForSegmentCount<bCapEnds, bDoubleSided, false>(SegmentCount);
+	}
+}
+
+FCylinderKernels::FTubeKernel FCylinderKernels::SelectTubeKernel(bool bSmoothNormals, int32 SegmentCount)
+{
+	return bSmoothNormals
+		? CylinderKernels::SelectTubeKernelForSegmentCount<true>(SegmentCount)
+		: CylinderKernels::SelectTubeKernelForSegmentCount<false>(SegmentCount);
+}
+
+void FCylinderKernels::GetTubeRotations(int32 NumTubes, const float* StartX, const float* StartY, const float* StartZ, const float* EndX, const float* EndY, const float* EndZ,
+	float* OutX, float* OutY, float* OutZ, float* OutW)
+{
+	// The rotation that aligns the cross section with a line is (Start - End).Rotation() with 90 degrees added to the pitch. Going through
+	// a rotator takes two atan2 and three sin/cos per line, but with the line direction normalized the sine of the pitch is simply its Z
+	// and the cosine of the yaw is X over the horizontal length, so the half angles the quaternion needs come out of half angle identities.
+	for (int32 Index = 0; Index < NumTubes; Index++)
+	{
+		float X = StartX[Index] - EndX[Index];
+		float Y = StartY[Index] - EndY[Index];
+		float Z = StartZ[Index] - EndZ[Index];
+		const float LengthSquared = X * X + Y * Y + Z * Z;
+		const float InverseLength = LengthSquared > SMALL_NUMBER ? 1.0f / FMath::Sqrt(FMath::Max(LengthSquared, SMALL_NUMBER)) : 0.0f;
+		X *= InverseLength;
+		Y *= InverseLength;
+		Z *= InverseLength;
+
+		// Adding 90 degrees to the pitch turns its sine into minus the cosine, and the half pitch is then between 0 and 90 degrees
+		const float SinHalfPitch = FMath::Sqrt(FMath::Max(0.0f, (1.0f + Z) * 0.5f));
+		const float CosHalfPitch = FMath::Sqrt(FMath::Max(0.0f, (1.0f - Z) * 0.5f));
+
+		// Lines straight up or down have no yaw. The half yaw is between -90 and 90 degrees and takes its sign from Y.
+		const float HorizontalLength = FMath::Sqrt(X * X + Y * Y);
+		const float CosYaw = HorizontalLength > SMALL_NUMBER ? X / FMath::Max(HorizontalLength, SMALL_NUMBER) : 1.0f;
+		const float CosHalfYaw = FMath::Sqrt(FMath::Max(0.0f, (1.0f + CosYaw) * 0.5f));
+		const float SinHalfYawSize = FMath::Sqrt(FMath::Max(0.0f, (1.0f - CosYaw) * 0.5f));
+		const float SinHalfYaw = Y < 0.0f ? -SinHalfYawSize : SinHalfYawSize;
+
+		// FRotator::Quaternion with no roll
+		OutX[Index] = SinHalfPitch * SinHalfYaw;
+		OutY[Index] = -SinHalfPitch * CosHalfYaw;
+		OutZ[Index] = CosHalfPitch * SinHalfYaw;
+		OutW[Index] = CosHalfPitch * CosHalfYaw;
+	}
+}
+
+FQuat FCylinderKernels::GetTubeRotation(const FVector& StartPoint, const FVector& EndPoint)
+{
+	FQuat Rotation;
+	GetTubeRotations(1, &StartPoint.X, &StartPoint.Y, &StartPoint.Z, &EndPoint.X, &EndPoint.Y, &EndPoint.Z, &Rotation.X, &Rotation.Y, &Rotation.Z, &Rotation.W);
+	return Rotation;
+}
+
+FCylinderKernels::FCylinderKernel FCylinderKernels::SelectCylinderKernel(bool bCapEnds, bool bDoubleSided, bool bSmoothNormals, int32 SegmentCount)
+{
+	if (bCapEnds)
+	{
+		return bDoubleSided
+			? CylinderKernels::SelectCylinderKernelForNormals<true, true>(bSmoothNormals, SegmentCount)
+			: CylinderKernels::SelectCylinderKernelForNormals<true, false>(bSmoothNormals, SegmentCount);
+	}
+
+	return bDoubleSided
+		? CylinderKernels::SelectCylinderKernelForNormals<false, true>(bSmoothNormals, SegmentCount)
+		: CylinderKernels::SelectCylinderKernelForNormals<false, false>(bSmoothNormals, SegmentCount);
+}
+
+bool FCylinderKernels::IsSpecialisedSegmentCount(int32 SegmentCount)
+{
+	return SegmentCount == 4 || SegmentCount == 6 || SegmentCount == 8 || SegmentCount == 16;
+}
+
+void FCylinderKernels::RunBenchmark(const TArray<FString>& Args)
+{
+	// Usage: ProceduralMeshes.BenchmarkCylinderKernels [QuadsPerRun]
+	const int32 QuadsPerRun = Args.Num() > 0 ? FMath::Max(1024, FCString::Atoi(*Args[0])) : 1000000;
+	const int32 SegmentCounts[] = { 4, 6, 8, 16, 10 };
+	FRandomStream RngStream(1238);
+
+	UE_LOG(LogProceduralMeshes, Log, TEXT("Cylinder kernel benchmark, %d quads per run"), QuadsPerRun);
+
+	// -------------------------------------------------------
+	// Tubes: many open cylinders in one big buffer, like the line actors build them
+	for (int32 SegmentCount : SegmentCounts)
+	{
+		FCrossSectionRingRef CrossSection = FCrossSectionCache::Get(SegmentCount);
+		const int32 NumTubes = QuadsPerRun / SegmentCount;
+		const int32 VerticesPerTube = SegmentCount * 4;
+
+		// The lines and their rotations are worked out before anything is timed, so only the kernels are measured
+		TArray<FVector> StartPoints;
+		TArray<FVector> EndPoints;
+		TArray<FQuat> Rotations;
+		StartPoints.AddUninitialized(NumTubes);
+		EndPoints.AddUninitialized(NumTubes);
+		Rotations.AddUninitialized(NumTubes);
+		for (int32 TubeIndex = 0; TubeIndex < NumTubes; TubeIndex++)
+		{
+			StartPoints[TubeIndex] = RngStream.GetUnitVector() * 100.0f;
+			EndPoints[TubeIndex] = StartPoints[TubeIndex] + RngStream.GetUnitVector() * 50.0f;
+			Rotations[TubeIndex] = GetTubeRotation(StartPoints[TubeIndex], EndPoints[TubeIndex]);
+		}
+
+		// Both variants write into the same buffers
+		FProceduralMeshData MeshData;
+		MeshData.Vertices.AddUninitialized(NumTubes * VerticesPerTube);
+		MeshData.Triangles.AddUninitialized(NumTubes * SegmentCount * 2 * 3);
+		MeshData.Normals.AddUninitialized(NumTubes * VerticesPerTube);
+		MeshData.UVs.AddUninitialized(NumTubes * VerticesPerTube);
+		MeshData.Tangents.AddUninitialized(NumTubes * VerticesPerTube);
+
+		auto RunVariant = [&](FTubeKernel Kernel) -> double
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 TubeIndex = 0; TubeIndex < NumTubes; TubeIndex++)
+			{
+				Kernel(MeshData, *CrossSection, StartPoints[TubeIndex], EndPoints[TubeIndex], 2.0f, Rotations[TubeIndex], TubeIndex * VerticesPerTube);
+			}
+			return FPlatformTime::Seconds() - StartTime;
+		};
+
+		for (int32 SmoothIndex = 0; SmoothIndex < 2; SmoothIndex++)
+		{
+			const bool bSmoothNormals = SmoothIndex == 1;
+			FTubeKernel Variants[] = { SelectTubeKernel(bSmoothNormals, SegmentCount), bSmoothNormals ? &CylinderKernels::GenerateTube<true, 0> : &CylinderKernels::GenerateTube<false, 0> };
+
+			// One untimed pass of each warms up the buffers and caches, then the variants take turns going first and the best pass counts
+			RunVariant(Variants[0]);
+			RunVariant(Variants[1]);
+			double BestSeconds[2] = { MAX_dbl, MAX_dbl };
+			for (int32 Pass = 0; Pass < 4; Pass++)
+			{
+				for (int32 Turn = 0; Turn < 2; Turn++)
+				{
+					const int32 VariantIndex = (Pass + Turn) & 1;
+					BestSeconds[VariantIndex] = FMath::Min(BestSeconds[VariantIndex], RunVariant(Variants[VariantIndex]));
+				}
+			}
+
+			double QuadsPerSecond[2];
+			for (int32 VariantIndex = 0; VariantIndex < 2; VariantIndex++)
+			{
+				QuadsPerSecond[VariantIndex] = (double)(NumTubes * SegmentCount) / FMath::Max(BestSeconds[VariantIndex], 1e-9);
+			}
+
+			UE_LOG(LogProceduralMeshes, Log, TEXT("Tube       segments=%2d smooth=%d: %s %.2f Mquads/s, generic %.2f Mquads/s"),
+				SegmentCount, bSmoothNormals, IsSpecialisedSegmentCount(SegmentCount) ? TEXT("specialised") : TEXT("dispatched "), QuadsPerSecond[0] / 1e6, QuadsPerSecond[1] / 1e6);
+		}
+	}
+
+	// -------------------------------------------------------
+	// Standing cylinders: one small mesh per call, like the simple cylinder actor builds them
+	for (int32 SegmentCount : SegmentCounts)
+	{
+		FCrossSectionRingRef CrossSection = FCrossSectionCache::Get(SegmentCount);
+		const int32 NumCylinders = FMath::Max(1, QuadsPerRun / SegmentCount);
+
+		for (int32 Flags = 0; Flags < 8; Flags++)
+		{
+			const bool bCapEnds = (Flags & 1) != 0;
+			const bool bDoubleSided = (Flags & 2) != 0;
+			const bool bSmoothNormals = (Flags & 4) != 0;
+			FCylinderKernel Kernel = SelectCylinderKernel(bCapEnds, bDoubleSided, bSmoothNormals, SegmentCount);
+
+			// The first call grows the buffers, keep it out of the timing
+			FProceduralMeshData MeshData;
+			Kernel(MeshData, *CrossSection, 100.0f, 10.0f);
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 CylinderIndex = 0; CylinderIndex < NumCylinders; CylinderIndex++)
+			{
+				MeshData.Reset();
+				Kernel(MeshData, *CrossSection, 100.0f, 10.0f);
+			}
+			const double QuadsPerSecond = (double)(NumCylinders * SegmentCount) / FMath::Max(FPlatformTime::Seconds() - StartTime, 1e-9);
+
+			UE_LOG(LogProceduralMeshes, Log, TEXT("Cylinder   segments=%2d caps=%d doublesided=%d smooth=%d: %.2f Mquads/s"),
+				SegmentCount, bCapEnds, bDoubleSided, bSmoothNormals, QuadsPerSecond / 1e6);
+		}
+	}
+}
+
+static FAutoConsoleCommand BenchmarkCylinderKernelsCommand(
+	TEXT("ProceduralMeshes.BenchmarkCylinderKernels"),
+	TEXT("Measures quads/sec for every specialised cylinder kernel. Optional argument: number of quads per run."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&FCylinderKernels::RunBenchmark));
@@ -0,0 +1,37 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Cylinder and tube builders specialised at compile time for each combination of options
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshData.h"
+#include "CrossSectionCache.h"
+
+// Every option that used to be checked inside the per-quad loops is a template parameter instead,
+// and the most common radial segment counts get their own instantiation so the compiler can unroll the loop.
+// Callers pick a kernel once and then call it for every cylinder they build.
+struct PROCEDURALMESHES_API FCylinderKernels
+{
+	// Builds an open cylinder between two points, writing 4 vertices and 2x3 vertex indexes per quad starting at InVertexIndexStart.
+	// The buffers must already be sized for it. Rotation lines the cross section up with the line, see GetTubeRotations.
+	typedef void(*FTubeKernel)(FProceduralMeshData& MeshData, const FCrossSectionRing& CrossSection, const FVector& StartPoint, const FVector& EndPoint, float InWidth, const FQuat& Rotation, int32 InVertexIndexStart);
+
+	// Builds a standing cylinder centered on the origin, allocating the buffers it needs
+	typedef void(*FCylinderKernel)(FProceduralMeshData& MeshData, const FCrossSectionRing& CrossSection, float InHeight, float InWidth);
+
+	static FTubeKernel SelectTubeKernel(bool bSmoothNormals, int32 SegmentCount);
+
+	// Works out the tube rotation of many lines at once, one quaternion component per output array. The end points come in as one packed
+	// array per component and the loop has no branches, so the compiler can do several lines per instruction.
+	static void GetTubeRotations(int32 NumTubes, const float* StartX, const float* StartY, const float* StartZ, const float* EndX, const float* EndY, const float* EndZ,
+		float* OutX, float* OutY, float* OutZ, float* OutW);
+
+	static FQuat GetTubeRotation(const FVector& StartPoint, const FVector& EndPoint);
+	static FCylinderKernel SelectCylinderKernel(bool bCapEnds, bool bDoubleSided, bool bSmoothNormals, int32 SegmentCount);
+
+	// True if the segment count has its own unrolled instantiation
+	static bool IsSpecialisedSegmentCount(int32 SegmentCount);
+
+	// Logs quads/sec for every kernel variant, both specialised and generic
+	static void RunBenchmark(const TArray<FString>& Args);
+};
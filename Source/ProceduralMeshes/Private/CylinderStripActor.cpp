@@ -3,197 +3,464 @@
 
 #include "ProceduralMeshesPrivatePCH.h"
 #include "CylinderStripActor.h"
+#include "VertexWelding.h"
+
+DECLARE_CYCLE_STAT(TEXT("Cylinder strip"), STAT_GenerateCylinderStrip, STATGROUP_ProceduralMeshes);
 
 ACylinderStripActor::ACylinderStripActor()
+	: PointsStage(INDEX_NONE)
+	, GeometryStage(INDEX_NONE)
+	, OptimizationStage(INDEX_NONE)
+	, UploadStage(INDEX_NONE)
+	, MaterialStage(INDEX_NONE)
+	, CollisionStage(INDEX_NONE)
+{
+	FProceduralMeshLODChain::GetDefaultScreenSizes(LODScreenSizes);
+}
+
+void ACylinderStripActor::UpdateLOD()
 {
-	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootScene"));
-	ProcMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("ProceduralMesh"));
-	ProcMesh->AttachTo(RootComponent);
-	// Make sure the PMC doesnt save any mesh data with the map
-	ProcMesh->SetFlags(EObjectFlags::RF_Transient);
+	LODChain.Update(ProcMesh, LODScreenSizes, [this](int32 LODIndex) { GenerateLOD(LODIndex); });
 }
 
-#if WITH_EDITOR  
-void ACylinderStripActor::OnConstruction(const FTransform& Transform)
+void ACylinderStripActor::SetupStages()
 {
-	Super::OnConstruction(Transform);
-	PreCacheCrossSection();
-	GenerateMesh();
+	Pipeline.SetOwner(this, GET_STATID(STAT_GenerateCylinderStrip));
+
+	// -------------------------------------------------------
+	// Work out which points the tube runs through
+	PointsStage = Pipeline.AddStage(TEXT("Points"), GET_STATID(STAT_ProceduralMeshStructure), [this]()
+	{
+		if (bSplineInterpolation)
+		{
+			// Each segment between two points costs two triangles per radial segment
+			int32 MaxSegments = MaxTriangleCount > 0 ? FMath::Max(1, MaxTriangleCount / (FMath::Max(1, RadialSegmentCount) * 2)) : MAX_int32;
+			const int32 NumSpans = LinePoints.Num() - 1;
+			if (MaxSegments < NumSpans)
+			{
+				UE_LOG(LogProceduralMeshes, Warning, TEXT("%s: MaxTriangleCount %d is less than one segment for each of the %d spans, the tube will have %d triangles"),
+					*GetName(), MaxTriangleCount, NumSpans, NumSpans * FMath::Max(1, RadialSegmentCount) * 2);
+			}
+			ResampleSpline(TubePoints, LinePoints, SplineChordTolerance, MaxSegments);
+		}
+		else
+		{
+			TubePoints = LinePoints;
+		}
+	}, TArray<int32>());
+
+	// -------------------------------------------------------
+	// Only LOD0 is built up front, the rest are generated the first time they are needed. Separate cylinders that are the same as last
+	// time are copied from the previous mesh, so moving one point only extrudes the two cylinders next to it again.
+	GeometryStage = Pipeline.AddStage(TEXT("Geometry"), GET_STATID(STAT_ProceduralMeshVertexFill), [this]()
+	{
+		// The editor preview while dragging a slider has the radial segments of one of the lower LODs
+		const int32 GeometryRadialSegmentCount = FProceduralMeshLODChain::GetRadialSegmentCountForLOD(RadialSegmentCount, GetPreviewLOD());
+		if (bContinuousTube)
+		{
+			LOD0Tubes.Reset();
+			LOD0ContinuousMeshData.Reset();
+			GenerateContinuousTube(LOD0ContinuousMeshData, *FCrossSectionCache::Get(GeometryRadialSegmentCount), TubePoints, Radius, bSmoothNormals);
+			return;
+		}
+
+		FScratchLineSegmentStreams TubeSegments;
+		GetTubeSegments(TubeSegments);
+		LOD0ContinuousMeshData.Reset();
+		LOD0Tubes.Build(TubeSegments, GeometryRadialSegmentCount, bSmoothNormals);
+	}, { PointsStage });
+
+	// Welds a copy, so turning welding off again doesn't need the geometry to be rebuilt
+	OptimizationStage = Pipeline.AddStage(TEXT("Optimization"), GET_STATID(STAT_ProceduralMeshOptimization), [this]()
+	{
+		LOD0WeldedMeshData.Reset();
+		if (bWeldVertices && !bContinuousTube)
+		{
+			LOD0WeldedMeshData = LOD0Tubes.GetMeshData();
+			FVertexWelder::Weld(LOD0WeldedMeshData);
+		}
+	}, { GeometryStage });
+
+	UploadStage = Pipeline.AddStage(TEXT("Upload"), GET_STATID(STAT_ProceduralMeshUpload), [this]()
+	{
+		ProcMesh->ClearAllMeshSections();
+		LODChain.Reset(NumLODs);
+		SetActorTickEnabled(NumLODs > 1);
+		UploadLOD(0, GetLOD0MeshData());
+		GeneratedTriangleCount = GetLOD0MeshData().Triangles.Num() / 3;
+		LODChain.ShowLOD(ProcMesh, 0);
+		MeshDataMemory.Set(LOD0Tubes.GetMeshData().GetAllocatedSize() + LOD0ContinuousMeshData.GetAllocatedSize() + LOD0WeldedMeshData.GetAllocatedSize());
+	}, { OptimizationStage }, true);
+
+	MaterialStage = Pipeline.AddStage(TEXT("Material"), GET_STATID(STAT_ProceduralMeshUpload), [this]()
+	{
+		for (int32 LODIndex = 0; LODIndex < NumLODs; LODIndex++)
+		{
+			ProcMesh->SetMaterial(LODIndex, Material);
+		}
+	}, { UploadStage }, true);
+
+	CollisionStage = Pipeline.AddStage(TEXT("Collision"), GET_STATID(STAT_ProceduralMeshCollision), [this]()
+	{
+		GenerateCollision();
+	}, { PointsStage }, true);
+
+	// The preview only has fewer radial segments
+	PreviewStage = GeometryStage;
+
+	// -------------------------------------------------------
+	// The properties that only affect part of the work. Everything else moves the points, which all the stages are built from.
+	// RadialSegmentCount is one of those since it sets the triangle budget of the spline.
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ACylinderStripActor, Material), MaterialStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ACylinderStripActor, bSmoothNormals), GeometryStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ACylinderStripActor, bContinuousTube), GeometryStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ACylinderStripActor, bWeldVertices), OptimizationStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ACylinderStripActor, NumLODs), UploadStage);
+
+	// Complex collision is cooked as part of the upload
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ACylinderStripActor, CollisionMode), UploadStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ACylinderStripActor, CollisionMode), CollisionStage);
+
+	// Only read when switching LODs
+	Pipeline.IgnoreProperty(GET_MEMBER_NAME_CHECKED(ACylinderStripActor, LODScreenSizes));
+	Pipeline.IgnoreProperty(GET_MEMBER_NAME_CHECKED(ACylinderStripActor, EditorPreviewLOD));
 }
-#endif // WITH_EDITOR
 
-void ACylinderStripActor::BeginPlay()
+bool ACylinderStripActor::CanRunPipeline() const
 {
-	Super::BeginPlay();
-	PreCacheCrossSection();
-	GenerateMesh();
-
-	// Fix for PCM location/rotation/scale since the whole component is Transient
-	ProcMesh->SetWorldLocation(this->GetActorLocation());
-	ProcMesh->SetWorldRotation(this->GetActorRotation());
-	ProcMesh->SetWorldScale3D(this->GetActorScale3D());
+	return LinePoints.Num() >= 2;
 }
 
-void ACylinderStripActor::GenerateMesh()
+void ACylinderStripActor::GenerateLOD(int32 LODIndex)
 {
-	if (LinePoints.Num() < 2)
+	if (TubePoints.Num() < 2)
 	{
 		return;
 	}
 
-	// Calculate and pre-allocate buffers
-	int32 TotalNumberOfVerticesPerSection = RadialSegmentCount * 4; // 4 verts per face 
-	int32 TotalNumberOfTrianglesPerSection = TotalNumberOfVerticesPerSection + 2 * RadialSegmentCount;
-	int32 NumberOfSections = LinePoints.Num() - 1;
-
+	int32 LODRadialSegmentCount = FProceduralMeshLODChain::GetRadialSegmentCountForLOD(RadialSegmentCount, LODIndex);
 	FProceduralMeshData MeshData = FProceduralMeshData();
-	MeshData.Vertices.AddUninitialized(TotalNumberOfVerticesPerSection * NumberOfSections);
-	MeshData.Triangles.AddUninitialized(TotalNumberOfTrianglesPerSection * NumberOfSections);
-	MeshData.Normals.AddUninitialized(TotalNumberOfVerticesPerSection * NumberOfSections);
-	MeshData.UVs.AddUninitialized(TotalNumberOfVerticesPerSection * NumberOfSections);
-	MeshData.Tangents.AddUninitialized(TotalNumberOfVerticesPerSection * NumberOfSections);
-
-	// Now lets loop through all the defined points and create a cylinder between each two defined points
-	int32 CurrentIndexStart = 0;
 
-	for (int32 i = 0; i < NumberOfSections; i++)
+	if (bContinuousTube)
 	{
-		CurrentIndexStart = i * TotalNumberOfVerticesPerSection;
-		GenerateCylinder(MeshData, LinePoints[i], LinePoints[i + 1], Radius, RadialSegmentCount, CurrentIndexStart, bSmoothNormals);
+		GenerateContinuousTube(MeshData, *FCrossSectionCache::Get(LODRadialSegmentCount), TubePoints, Radius, bSmoothNormals);
+	}
+	else
+	{
+		FScratchLineSegmentStreams TubeSegments;
+		GetTubeSegments(TubeSegments);
+		FTubeSegmentCache::Extrude(MeshData, TubeSegments, LODRadialSegmentCount, bSmoothNormals);
+		if (bWeldVertices)
+		{
+			FVertexWelder::Weld(MeshData);
+		}
 	}
 
-	ProcMesh->ClearAllMeshSections();
-	ProcMesh->CreateMeshSection(0, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, false);
-	ProcMesh->SetMaterial(0, Material);
+	UploadLOD(LODIndex, MeshData);
+	ProcMesh->SetMaterial(LODIndex, Material);
 }
 
-FVector ACylinderStripActor::RotatePointAroundPivot(FVector InPoint, FVector InPivot, FVector InAngles)
+void ACylinderStripActor::UploadLOD(int32 LODIndex, const FProceduralMeshData& MeshData)
 {
-	FVector direction = InPoint - InPivot; // get point direction relative to pivot
-	direction = FQuat::MakeFromEuler(InAngles) * direction; // rotate it
-	return direction + InPivot; // calculate rotated point
+	FProceduralMeshStats::CountUpload(MeshData);
+	ProcMesh->CreateMeshSection(LODIndex, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, LODIndex == 0 && CollisionMode == EProceduralCollisionMode::Complex);
+	LODChain.MarkGenerated(LODIndex);
 }
 
-void ACylinderStripActor::PreCacheCrossSection()
+const FProceduralMeshData& ACylinderStripActor::GetLOD0MeshData() const
 {
-	if (LastCachedCrossSectionCount == RadialSegmentCount)
+	if (bContinuousTube)
 	{
-		return;
+		return LOD0ContinuousMeshData;
+	}
+	return bWeldVertices ? LOD0WeldedMeshData : LOD0Tubes.GetMeshData();
+}
+
+void ACylinderStripActor::GetTubeSegments(FScratchLineSegmentStreams& OutSegments) const
+{
+	// A separate cylinder between each two points
+	OutSegments.Reset(FMath::Max(0, TubePoints.Num() - 1));
+	for (int32 PointIndex = 0; PointIndex < TubePoints.Num() - 1; PointIndex++)
+	{
+		OutSegments.Add(TubePoints[PointIndex], TubePoints[PointIndex + 1], Radius, 0);
+	}
+}
+
+void ACylinderStripActor::GenerateContinuousTube(FProceduralMeshData& MeshData, const FCrossSectionRing& CrossSection, const TArray<FVector>& InPoints, float InWidth, bool bInSmoothNormals/* = true*/)
+{
+	// -------------------------------------------------------
+	// Basic setup
+	// Every point gets one ring of vertices that is shared by the segments on either side of it.
+	// Smooth rings repeat the first vertex at the end so the UVs can wrap around, flat rings need two vertices per quad so each quad can have its own normal.
+	const int32 NumPoints = InPoints.Num();
+	const int32 NumQuads = CrossSection.SegmentCount;
+	const int32 RingVertexCount = bInSmoothNormals ? NumQuads + 1 : NumQuads * 2;
+
+	MeshData.Vertices.AddUninitialized(NumPoints * RingVertexCount);
+	MeshData.Triangles.AddUninitialized((NumPoints - 1) * NumQuads * 2 * 3); // 2x3 vertex indexes per quad
+	MeshData.Normals.AddUninitialized(NumPoints * RingVertexCount);
+	MeshData.UVs.AddUninitialized(NumPoints * RingVertexCount);
+	MeshData.Tangents.AddUninitialized(NumPoints * RingVertexCount);
+
+	// Texture V runs along the tube so that one circumference of length covers the texture once, keeping texels roughly square
+	const float VMapPerUnitLength = 1.0f / FMath::Max(2.0f * PI * InWidth, KINDA_SMALL_NUMBER);
+	float DistanceAlongTube = 0.0f;
+
+	// -------------------------------------------------------
+	// Set up the frame of the first ring the same way the separate cylinders do, so both modes line up.
+	// Points on top of each other at the start have no direction, so take the first one that does, or point up if none of them do.
+	FVector PreviousDirection = FVector::ZeroVector;
+	for (int32 PointIndex = 1; PointIndex < NumPoints && PreviousDirection.IsNearlyZero(); PointIndex++)
+	{
+		PreviousDirection = (InPoints[PointIndex] - InPoints[PointIndex - 1]).GetSafeNormal();
+	}
+	if (PreviousDirection.IsNearlyZero())
+	{
+		PreviousDirection = FVector::UpVector;
 	}
+	FVector RingTangent = PreviousDirection;
+	const FQuat StartRotation = (-RingTangent).Rotation().Add(90.f, 0.f, 0.f).Quaternion();
+	FVector RingNormal = StartRotation.RotateVector(FVector(1, 0, 0));
 
-	// Generate a cross-section for use in cylinder generation
-	const float AngleBetweenQuads = (2.0f / (float)(RadialSegmentCount)) * PI;
-	CachedCrossSectionPoints.Empty();
+	int32 VertexIndex = 0;
+	int32 TriangleIndex = 0;
 
-	// Pre-calculate cross section points of a circle, two more than needed
-	for (int32 PointIndex = 0; PointIndex < (RadialSegmentCount + 2); PointIndex++)
+	for (int32 PointIndex = 0; PointIndex < NumPoints; PointIndex++)
 	{
-		float Angle = (float)PointIndex * AngleBetweenQuads;
-		CachedCrossSectionPoints.Add(FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0));
+		// The ring is oriented along the bisector of the segments that meet here
+		FVector NextDirection = PointIndex < NumPoints - 1 ? (InPoints[PointIndex + 1] - InPoints[PointIndex]).GetSafeNormal() : PreviousDirection;
+		if (NextDirection.IsNearlyZero())
+		{
+			// Two points on top of each other, just keep going in the same direction
+			NextDirection = PreviousDirection;
+		}
+
+		FVector NewRingTangent = (PreviousDirection + NextDirection).GetSafeNormal();
+		if (NewRingTangent.IsNearlyZero())
+		{
+			// The line doubles back on itself, there is no sensible bisector
+			NewRingTangent = NextDirection;
+		}
+
+		// Parallel transport: rotate the previous frame by the smallest rotation between the two tangents, so the rings don't twist
+		RingNormal = FQuat::FindBetween(RingTangent, NewRingTangent).RotateVector(RingNormal);
+		RingTangent = NewRingTangent;
+		RingNormal = (RingNormal - (RingTangent * FVector::DotProduct(RingNormal, RingTangent))).GetSafeNormal();
+		const FVector RingBinormal = FVector::CrossProduct(RingTangent, RingNormal);
+
+		// Stretch the ring across the bend so the tube keeps its thickness through the joint
+		const FVector BendDirection = (NextDirection - PreviousDirection).GetSafeNormal();
+		const float MiterScale = 1.0f / FMath::Max(FVector::DotProduct(PreviousDirection, RingTangent), 0.25f);
+
+		if (PointIndex > 0)
+		{
+			DistanceAlongTube += FVector::Dist(InPoints[PointIndex - 1], InPoints[PointIndex]);
+		}
+		const float V = DistanceAlongTube * VMapPerUnitLength;
+		const FVector& Center = InPoints[PointIndex];
+		const int32 RingStart = VertexIndex;
+
+		// -------------------------------------------------------
+		// Ring vertices
+		for (int32 RingIndex = 0; RingIndex < RingVertexCount; RingIndex++)
+		{
+			// Flat rings have the right edge of the previous quad and the left edge of the next one on top of each other
+			const int32 QuadIndex = bInSmoothNormals ? RingIndex : RingIndex / 2;
+			const int32 CrossSectionIndex = bInSmoothNormals ? RingIndex : QuadIndex + (RingIndex & 1);
+
+			const FVector& CrossSectionPoint = CrossSection.Points[CrossSectionIndex];
+			const FVector RingDirection = (RingNormal * CrossSectionPoint.X) + (RingBinormal * CrossSectionPoint.Y);
+			const FVector MiterOffset = BendDirection * (FVector::DotProduct(RingDirection, BendDirection) * (MiterScale - 1.0f));
+
+			MeshData.Vertices[VertexIndex] = Center + ((RingDirection + MiterOffset) * InWidth);
+
+			// UVs.  Note that Unreal UV origin (0,0) is top left
+			MeshData.UVs[VertexIndex] = FVector2D(CrossSection.UColumns[CrossSectionIndex], V);
+
+			if (bInSmoothNormals)
+			{
+				// On a circle the smoothed normal is simply the direction from the center to the vertex
+				MeshData.Normals[VertexIndex] = RingDirection;
+				MeshData.Tangents[VertexIndex] = FProcMeshTangent((RingNormal * CrossSectionPoint.Y) - (RingBinormal * CrossSectionPoint.X), true);
+			}
+			else
+			{
+				const FVector& FaceNormal = CrossSection.FaceNormals[QuadIndex];
+				const FVector& FaceTangent = CrossSection.FaceTangents[QuadIndex];
+				MeshData.Normals[VertexIndex] = (RingNormal * FaceNormal.X) + (RingBinormal * FaceNormal.Y);
+				MeshData.Tangents[VertexIndex] = FProcMeshTangent((RingNormal * FaceTangent.X) + (RingBinormal * FaceTangent.Y), true);
+			}
+
+			VertexIndex++;
+		}
+
+		// -------------------------------------------------------
+		// Connect this ring to the previous one
+		if (PointIndex > 0)
+		{
+			const int32 PreviousRingStart = RingStart - RingVertexCount;
+
+			for (int32 QuadIndex = 0; QuadIndex < NumQuads; QuadIndex++)
+			{
+				const int32 LeftOffset = bInSmoothNormals ? QuadIndex : QuadIndex * 2;
+				const int32 RightOffset = LeftOffset + 1;
+
+				int32 VertIndex1 = PreviousRingStart + LeftOffset;
+				int32 VertIndex2 = PreviousRingStart + RightOffset;
+				int32 VertIndex3 = RingStart + RightOffset;
+				int32 VertIndex4 = RingStart + LeftOffset;
+
+				// Same winding as the separate cylinders
+				MeshData.Triangles[TriangleIndex++] = VertIndex4;
+				MeshData.Triangles[TriangleIndex++] = VertIndex3;
+				MeshData.Triangles[TriangleIndex++] = VertIndex1;
+
+				MeshData.Triangles[TriangleIndex++] = VertIndex3;
+				MeshData.Triangles[TriangleIndex++] = VertIndex2;
+				MeshData.Triangles[TriangleIndex++] = VertIndex1;
+			}
+		}
+
+		PreviousDirection = NextDirection;
 	}
+}
 
-	LastCachedCrossSectionCount = RadialSegmentCount;
+FVector ACylinderStripActor::EvaluateCentripetalCatmullRom(const FVector& P0, const FVector& P1, const FVector& P2, const FVector& P3, float T)
+{
+	// Barry and Goldman's pyramidal formulation, with knots spaced by the square root of the distance between points.
+	// Unlike the uniform version this never overshoots into loops or cusps when points are unevenly spaced.
+	const float K0 = 0.0f;
+	const float K1 = K0 + FMath::Max(FMath::Sqrt(FVector::Dist(P0, P1)), KINDA_SMALL_NUMBER);
+	const float K2 = K1 + FMath::Max(FMath::Sqrt(FVector::Dist(P1, P2)), KINDA_SMALL_NUMBER);
+	const float K3 = K2 + FMath::Max(FMath::Sqrt(FVector::Dist(P2, P3)), KINDA_SMALL_NUMBER);
+	const float K = FMath::Lerp(K1, K2, T);
+
+	const FVector A1 = (P0 * (K1 - K) + P1 * (K - K0)) / (K1 - K0);
+	const FVector A2 = (P1 * (K2 - K) + P2 * (K - K1)) / (K2 - K1);
+	const FVector A3 = (P2 * (K3 - K) + P3 * (K - K2)) / (K3 - K2);
+	const FVector B1 = (A1 * (K2 - K) + A2 * (K - K0)) / (K2 - K0);
+	const FVector B2 = (A2 * (K3 - K) + A3 * (K - K1)) / (K3 - K1);
+	return (B1 * (K2 - K) + B2 * (K - K1)) / (K2 - K1);
 }
 
-void ACylinderStripActor::GenerateCylinder(FProceduralMeshData& MeshData, FVector StartPoint, FVector EndPoint, float InWidth, int32 InCrossSectionCount, int32 InVertexIndexStart, bool bInSmoothNormals/* = true*/)
+void ACylinderStripActor::ResampleSpline(TArray<FVector>& OutPoints, const TArray<FVector>& InControlPoints, float InChordTolerance, int32 InMaxSegments)
 {
-	// Basic setup
-	int32 VertexIndex = InVertexIndexStart;
-	int32 NumVerts = InCrossSectionCount * 4; // 4 verts per face
-
-	// Make a cylinder section
-	const float AngleBetweenQuads = (2.0f / (float)(InCrossSectionCount)) * PI;
-	const float UMapPerQuad = 1.0f / (float)InCrossSectionCount;
-
-	FVector StartOffset = StartPoint - FVector(0, 0, 0);
-	FVector Offset = EndPoint - StartPoint;
-
-	// Find angle between vectors
-	FVector LineDirection = (StartPoint - EndPoint);
-	LineDirection.Normalize();
-	FVector RotationAngle = LineDirection.Rotation().Add(90.f, 0.f, 0.f).Euler();
-
-	// Start by building up vertices that make up the cylinder sides
-	for (int32 QuadIndex = 0; QuadIndex < InCrossSectionCount; QuadIndex++)
-	{
-		float Angle = (float)QuadIndex * AngleBetweenQuads;
-		float NextAngle = (float)(QuadIndex + 1) * AngleBetweenQuads;
-
-		// Set up the vertices
-		FVector p0 = (CachedCrossSectionPoints[QuadIndex] * InWidth) + StartOffset;
-		p0 = RotatePointAroundPivot(p0, StartPoint, RotationAngle);
-		FVector p1 = CachedCrossSectionPoints[QuadIndex + 1] * InWidth + StartOffset;
-		p1 = RotatePointAroundPivot(p1, StartPoint, RotationAngle);
-		FVector p2 = p1 + Offset;
-		FVector p3 = p0 + Offset;
-
-		// Set up the quad triangles
-		int32 VertIndex1 = VertexIndex++;
-		int32 VertIndex2 = VertexIndex++;
-		int32 VertIndex3 = VertexIndex++;
-		int32 VertIndex4 = VertexIndex++;
-
-		MeshData.Vertices[VertIndex1] = p0;
-		MeshData.Vertices[VertIndex2] = p1;
-		MeshData.Vertices[VertIndex3] = p2;
-		MeshData.Vertices[VertIndex4] = p3;
-
-		// Now create two triangles from those four vertices
-		// The order of these (clockwise/counter-clockwise) dictates which way the normal will face. 
-		MeshData.Triangles.Add(VertIndex4);
-		MeshData.Triangles.Add(VertIndex3);
-		MeshData.Triangles.Add(VertIndex1);
-
-		MeshData.Triangles.Add(VertIndex3);
-		MeshData.Triangles.Add(VertIndex2);
-		MeshData.Triangles.Add(VertIndex1);
-
-		// UVs.  Note that Unreal UV origin (0,0) is top left
-		MeshData.UVs[VertIndex1] = FVector2D(1.0f - (UMapPerQuad * QuadIndex), 1.0f);
-		MeshData.UVs[VertIndex2] = FVector2D(1.0f - (UMapPerQuad * (QuadIndex + 1)), 1.0f);
-		MeshData.UVs[VertIndex3] = FVector2D(1.0f - (UMapPerQuad * (QuadIndex + 1)), 0.0f);
-		MeshData.UVs[VertIndex4] = FVector2D(1.0f - (UMapPerQuad * QuadIndex), 0.0f);
-
-		// Normals
-		FVector NormalCurrent = FVector::CrossProduct(MeshData.Vertices[VertIndex1] - MeshData.Vertices[VertIndex3], MeshData.Vertices[VertIndex2] - MeshData.Vertices[VertIndex3]).GetSafeNormal();
-
-		if (bInSmoothNormals)
-		{
-			// To smooth normals we give the vertices different values than the polygon they belong to.
-			// GPUs know how to interpolate between those.
-			// I do this here as an average between normals of two adjacent polygons
-			float NextNextAngle = (float)(QuadIndex + 2) * AngleBetweenQuads;
-			FVector p4 = (CachedCrossSectionPoints[QuadIndex + 2] * InWidth) + StartOffset;
-			p4 = RotatePointAroundPivot(p4, StartPoint, RotationAngle);
-
-			// p1 to p4 to p2
-			FVector NormalNext = FVector::CrossProduct(p1 - p2, p4 - p2).GetSafeNormal();
-			FVector AverageNormalRight = (NormalCurrent + NormalNext) / 2;
-			AverageNormalRight = AverageNormalRight.GetSafeNormal();
-
-			float PreviousAngle = (float)(QuadIndex - 1) * AngleBetweenQuads;
-			FVector pMinus1 = FVector(FMath::Cos(PreviousAngle) * InWidth, FMath::Sin(PreviousAngle) * InWidth, 0.f) + StartOffset;
-			pMinus1 = RotatePointAroundPivot(pMinus1, StartPoint, RotationAngle);
-
-			// p0 to p3 to pMinus1
-			FVector NormalPrevious = FVector::CrossProduct(p0 - pMinus1, p3 - pMinus1).GetSafeNormal();
-			FVector AverageNormalLeft = (NormalCurrent + NormalPrevious) / 2;
-			AverageNormalLeft = AverageNormalLeft.GetSafeNormal();
-
-			MeshData.Normals[VertIndex1] = AverageNormalLeft;
-			MeshData.Normals[VertIndex2] = AverageNormalRight;
-			MeshData.Normals[VertIndex3] = AverageNormalRight;
-			MeshData.Normals[VertIndex4] = AverageNormalLeft;
+	// -------------------------------------------------------
+	// We start with one segment per span between control points, then keep splitting whichever segment strays furthest from the curve.
+	// Splitting stops once every segment is within tolerance, or once we run out of triangle budget.
+	// Since the error of a chord grows with curvature, straight stretches end up with few rings and tight bends with many.
+	struct FSplineSegment
+	{
+		int32 Span;
+		float T0;
+		float T1;
+		FVector Start;
+		FVector End;
+		float Error;
+	};
+
+	const int32 NumSpans = InControlPoints.Num() - 1;
+	OutPoints.Empty();
+	if (NumSpans < 1)
+	{
+		OutPoints = InControlPoints;
+		return;
+	}
+
+	// The end points get a mirrored neighbour so the curve has something to bend towards
+	auto GetControlPoint = [&InControlPoints](int32 Index) -> FVector
+	{
+		const int32 LastIndex = InControlPoints.Num() - 1;
+		if (Index < 0)
+		{
+			return InControlPoints[0] * 2.0f - InControlPoints[1];
 		}
-		else
+		if (Index > LastIndex)
 		{
-			// If not smoothing we just set the vertex normal to the same normal as the polygon they belong to
-			MeshData.Normals[VertIndex1] = MeshData.Normals[VertIndex2] = MeshData.Normals[VertIndex3] = MeshData.Normals[VertIndex4] = NormalCurrent;
+			return InControlPoints[LastIndex] * 2.0f - InControlPoints[LastIndex - 1];
 		}
+		return InControlPoints[Index];
+	};
+
+	auto Evaluate = [&GetControlPoint](int32 Span, float T) -> FVector
+	{
+		return EvaluateCentripetalCatmullRom(GetControlPoint(Span - 1), GetControlPoint(Span), GetControlPoint(Span + 1), GetControlPoint(Span + 2), T);
+	};
 
-		// Tangents (perpendicular to the surface)
-		FVector SurfaceTangent = p0 - p1;
-		SurfaceTangent = SurfaceTangent.GetSafeNormal();
-		MeshData.Tangents[VertIndex1] = MeshData.Tangents[VertIndex2] = MeshData.Tangents[VertIndex3] = MeshData.Tangents[VertIndex4] = FProcMeshTangent(SurfaceTangent, true);
+	// Sample a few points inside the segment, a single midpoint would miss S-shaped spans
+	auto MakeSegment = [&Evaluate](int32 Span, float T0, float T1, const FVector& Start, const FVector& End) -> FSplineSegment
+	{
+		FSplineSegment Segment = { Span, T0, T1, Start, End, 0.0f };
+		for (int32 Sample = 1; Sample < 4; Sample++)
+		{
+			FVector CurvePoint = Evaluate(Span, FMath::Lerp(T0, T1, Sample * 0.25f));
+			Segment.Error = FMath::Max(Segment.Error, FMath::PointDistToSegment(CurvePoint, Start, End));
+		}
+		return Segment;
+	};
+
+	auto HasLargerError = [](const FSplineSegment& A, const FSplineSegment& B) { return A.Error > B.Error; };
+
+	TArray<FSplineSegment> Segments;
+	Segments.Reserve(FMath::Min(InMaxSegments, NumSpans * 16));
+	for (int32 Span = 0; Span < NumSpans; Span++)
+	{
+		Segments.HeapPush(MakeSegment(Span, 0.0f, 1.0f, InControlPoints[Span], InControlPoints[Span + 1]), HasLargerError);
+	}
+
+	// Don't split forever on degenerate input, 2^16 segments per span is far more than anyone can see
+	const float MinParameterStep = 1.0f / 65536.0f;
+
+	while (Segments.Num() < InMaxSegments && Segments.HeapTop().Error > InChordTolerance)
+	{
+		FSplineSegment Worst;
+		Segments.HeapPop(Worst, HasLargerError, false);
+
+		if (Worst.T1 - Worst.T0 < MinParameterStep)
+		{
+			// Can't improve this one, stop considering it
+			Worst.Error = 0.0f;
+			Segments.HeapPush(Worst, HasLargerError);
+			continue;
+		}
+
+		const float MidT = (Worst.T0 + Worst.T1) * 0.5f;
+		const FVector MidPoint = Evaluate(Worst.Span, MidT);
+		Segments.HeapPush(MakeSegment(Worst.Span, Worst.T0, MidT, Worst.Start, MidPoint), HasLargerError);
+		Segments.HeapPush(MakeSegment(Worst.Span, MidT, Worst.T1, MidPoint, Worst.End), HasLargerError);
+	}
+
+	// -------------------------------------------------------
+	// Put the segments back in order along the curve and chain them together
+	Segments.Sort([](const FSplineSegment& A, const FSplineSegment& B)
+	{
+		return A.Span < B.Span || (A.Span == B.Span && A.T0 < B.T0);
+	});
+
+	OutPoints.Reserve(Segments.Num() + 1);
+	OutPoints.Add(Segments[0].Start);
+	for (const FSplineSegment& Segment : Segments)
+	{
+		OutPoints.Add(Segment.End);
 	}
 }
+
+void ACylinderStripActor::GenerateCollision()
+{
+	if (CollisionMode != EProceduralCollisionMode::Simple)
+	{
+		Collision->ClearCollision();
+		return;
+	}
+
+	// The worker thread gets its own copy of the points and builds the capsules from those
+	TArray<FVector> CollisionPoints = TubePoints;
+	const float CollisionRadius = Radius;
+	Collision->BuildCollisionAsync([CollisionPoints, CollisionRadius](FKAggregateGeom& Shapes)
+	{
+		for (int32 PointIndex = 0; PointIndex < CollisionPoints.Num() - 1; PointIndex++)
+		{
+			UProceduralCollisionComponent::AddCapsule(Shapes, CollisionPoints[PointIndex], CollisionPoints[PointIndex + 1], CollisionRadius);
+		}
+	});
+}
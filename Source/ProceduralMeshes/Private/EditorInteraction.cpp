@@ -0,0 +1,60 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Tells the actors when a property is being dragged in the editor, so they can build a cheap preview until it settles
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "EditorInteraction.h"
+
+const float FEditorInteraction::SettleSeconds = 0.5f;
+
+FEditorInteraction::FEditorInteraction()
+	: bInteracting(false)
+	, LastChangeTime(0.0)
+{
+}
+
+FEditorInteraction::~FEditorInteraction()
+{
+	StopTicking();
+}
+
+void FEditorInteraction::NotifyPropertyChanged(EPropertyChangeType::Type ChangeType)
+{
+	LastChangeTime = FPlatformTime::Seconds();
+	bInteracting = ChangeType == EPropertyChangeType::Interactive;
+
+	if (!bInteracting)
+	{
+		// The change that ends the interaction rebuilds the mesh by itself
+		StopTicking();
+	}
+	else if (!TickerHandle.IsValid())
+	{
+		TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FEditorInteraction::Tick), 0.1f);
+	}
+}
+
+bool FEditorInteraction::Tick(float DeltaTime)
+{
+	if (FPlatformTime::Seconds() - LastChangeTime < SettleSeconds)
+	{
+		return true;
+	}
+
+	// Returning false removes the ticker
+	TickerHandle.Reset();
+	bInteracting = false;
+	if (OnSettled)
+	{
+		OnSettled();
+	}
+	return false;
+}
+
+void FEditorInteraction::StopTicking()
+{
+	if (TickerHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+		TickerHandle.Reset();
+	}
+}
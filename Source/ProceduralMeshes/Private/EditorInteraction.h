@@ -0,0 +1,36 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Tells the actors when a property is being dragged in the editor, so they can build a cheap preview until it settles
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "Ticker.h"
+
+// The details panel sends an Interactive change for every step of a slider drag and a final ValueSet when it is released.
+// Anything else (typing a value, undo, a checkbox) ends the interaction straight away. Should a drag never send its final change,
+// the interaction ends once nothing has changed for SettleSeconds and OnSettled is called, so the full mesh still gets built.
+class PROCEDURALMESHES_API FEditorInteraction
+{
+public:
+	FEditorInteraction();
+	~FEditorInteraction();
+
+	// Call from PostEditChangeProperty, before the construction script runs again
+	void NotifyPropertyChanged(EPropertyChangeType::Type ChangeType);
+
+	bool IsInteracting() const { return bInteracting; }
+
+	// Called on the game thread when an interaction ends without a final change
+	void SetOnSettled(TFunction<void()> InOnSettled) { OnSettled = InOnSettled; }
+
+	static const float SettleSeconds;
+
+private:
+	bool Tick(float DeltaTime);
+	void StopTicking();
+
+	bool bInteracting;
+	double LastChangeTime;
+	FDelegateHandle TickerHandle;
+	TFunction<void()> OnSettled;
+};
@@ -3,6 +3,9 @@
 
 #include "ProceduralMeshesPrivatePCH.h"
 #include "HeightFieldAnimatedActor.h"
+#include "ProceduralMeshStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Height field animated"), STAT_GenerateHeightFieldAnimated, STATGROUP_ProceduralMeshes);
 
 AHeightFieldAnimatedActor::AHeightFieldAnimatedActor()
 {
@@ -19,6 +22,9 @@ AHeightFieldAnimatedActor::AHeightFieldAnimatedActor()
 void AHeightFieldAnimatedActor::OnConstruction(const FTransform& Transform)
 {
 	Super::OnConstruction(Transform);
+
+	// Any property may have changed the shape of the grid, so the tree is built again rather than refit
+	BVH.Reset();
 	GenerateMesh();
 }
 #endif // WITH_EDITOR
@@ -51,40 +57,103 @@ void AHeightFieldAnimatedActor::GenerateMesh()
 		return;
 	}
 
+	FProceduralMeshGenerationScope GenerationScope(this, GET_STATID(STAT_GenerateHeightFieldAnimated));
+
+	// The heights are rebuilt every frame while animating, so they go in this thread's scratch arena instead of a fresh heap allocation
+	FScratchScope ScratchScope;
+
 	// Setup example height data
 	int32 NumberOfPoints = (LengthSections + 1) * (WidthSections + 1);
-	TArray<float> HeightValues;
+	TArray<float, FScratchAllocator> HeightValues;
 	HeightValues.AddUninitialized(NumberOfPoints);
 
 	// Combine variations of sine and cosine to create some variable waves
-	int32 VertexIndex = 0;
-
-	for (int32 X = 0; X < LengthSections + 1; X++)
 	{
-		for (int32 Y = 0; Y < WidthSections + 1; Y++)
+		SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshStructure);
+		int32 VertexIndex = 0;
+
+		for (int32 X = 0; X < LengthSections + 1; X++)
 		{
-			// Just some quick hardcoded offset numbers in there
-			float ValueOne = FMath::Cos((X + CurrentAnimationFrameX)*ScaleFactor) + FMath::Sin((Y + CurrentAnimationFrameY)*ScaleFactor);
-			float ValueTwo = FMath::Cos((X + CurrentAnimationFrameX*0.7f)*ScaleFactor*2.5f) + FMath::Sin((Y - CurrentAnimationFrameY*0.7f)*ScaleFactor*2.5f);
-			HeightValues[VertexIndex++] = ((ValueOne + ValueTwo) / 2) * Height;
+			for (int32 Y = 0; Y < WidthSections + 1; Y++)
+			{
+				// Just some quick hardcoded offset numbers in there
+				float ValueOne = FMath::Cos((X + CurrentAnimationFrameX)*ScaleFactor) + FMath::Sin((Y + CurrentAnimationFrameY)*ScaleFactor);
+				float ValueTwo = FMath::Cos((X + CurrentAnimationFrameX*0.7f)*ScaleFactor*2.5f) + FMath::Sin((Y - CurrentAnimationFrameY*0.7f)*ScaleFactor*2.5f);
+				HeightValues[VertexIndex++] = ((ValueOne + ValueTwo) / 2) * Height;
+			}
 		}
 	}
 
 	// This example re-uses vertices between polygons.
 	FProceduralMeshData MeshData = FProceduralMeshData();
-	MeshData.Vertices.AddUninitialized(NumberOfPoints);
-	MeshData.Triangles.AddUninitialized(LengthSections * WidthSections * 2 * 3); // 2x3 vertex per quad
-	MeshData.Normals.AddUninitialized(NumberOfPoints);
-	MeshData.UVs.AddUninitialized(NumberOfPoints);
-	MeshData.Tangents.AddUninitialized(NumberOfPoints);
-
-	GenerateGrid(MeshData, Length, Width, LengthSections, WidthSections, HeightValues);
-	ProcMesh->ClearAllMeshSections();
-	ProcMesh->CreateMeshSection(0, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, false);
-	ProcMesh->SetMaterial(0, Material);
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshVertexFill);
+		MeshData.Vertices.AddUninitialized(NumberOfPoints);
+		MeshData.Triangles.AddUninitialized(LengthSections * WidthSections * 2 * 3); // 2x3 vertex per quad
+		MeshData.Normals.AddUninitialized(NumberOfPoints);
+		MeshData.UVs.AddUninitialized(NumberOfPoints);
+		MeshData.Tangents.AddUninitialized(NumberOfPoints);
+
+		GenerateGrid(MeshData, Length, Width, LengthSections, WidthSections, HeightValues);
+	}
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshUpload);
+		FProceduralMeshStats::CountUpload(MeshData);
+		ProcMesh->ClearAllMeshSections();
+		ProcMesh->CreateMeshSection(0, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, false);
+		ProcMesh->SetMaterial(0, Material);
+	}
+	SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshOptimization);
+	UpdateBVH(MeshData);
+}
+
+void AHeightFieldAnimatedActor::UpdateBVH(const FProceduralMeshData& MeshData)
+{
+	if (!bBuildBVH)
+	{
+		BVH.Reset();
+		return;
+	}
+
+	// The triangles only change with the number of sections, and OnConstruction resets the tree when those are edited
+	const double StartTime = FPlatformTime::Seconds();
+	const bool bRefit = BVH.IsBuilt() && BVH.GetNumVertices() == MeshData.Vertices.Num() && BVH.GetNumTriangles() * 3 == MeshData.Triangles.Num();
+	if (bRefit)
+	{
+		BVH.Refit(MeshData.Vertices);
+	}
+	else
+	{
+		BVH.Build(MeshData);
+	}
+
+	UE_LOG(LogProceduralMeshes, VeryVerbose, TEXT("%s: %s BVH with %d nodes, %.2f ms"),
+		*GetName(), bRefit ? TEXT("refit") : TEXT("built"), BVH.GetNumNodes(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+bool AHeightFieldAnimatedActor::RaycastMesh(FVector Start, FVector End, FVector& HitLocation, FVector& HitNormal) const
+{
+	// The mesh component sits at the root of the actor, so the grid is in actor space
+	const FTransform& ActorTransform = GetActorTransform();
+	FMeshBVHHit Hit;
+	if (!BVH.Raycast(ActorTransform.InverseTransformPosition(Start), ActorTransform.InverseTransformPosition(End), Hit))
+	{
+		return false;
+	}
+
+	HitLocation = ActorTransform.TransformPosition(Hit.Location);
+	HitNormal = ActorTransform.TransformVectorNoScale(Hit.Normal / ActorTransform.GetScale3D()).GetSafeNormal();
+	return true;
+}
+
+int32 AHeightFieldAnimatedActor::CountTrianglesInBox(FVector BoxCenter, FVector BoxExtent) const
+{
+	const FBox LocalBox = FBox(BoxCenter - BoxExtent, BoxCenter + BoxExtent).TransformBy(GetActorTransform().Inverse());
+	TArray<int32> TriangleIndices;
+	return BVH.OverlapBox(LocalBox, TriangleIndices);
 }
 
-void AHeightFieldAnimatedActor::GenerateGrid(FProceduralMeshData& MeshData, float InLength, float InWidth, int32 InLengthSections, int32 InWidthSections, const TArray<float>& InHeightValues)
+void AHeightFieldAnimatedActor::GenerateGrid(FProceduralMeshData& MeshData, float InLength, float InWidth, int32 InLengthSections, int32 InWidthSections, const TArray<float, FScratchAllocator>& InHeightValues)
 {
 	// Note the coordinates are a bit weird here since I aligned it to the transform (X is forwards or "up", which Y is to the right)
 	// Should really fix this up and use standard X, Y coords then transform into object space?
@@ -3,67 +3,376 @@
 
 #include "ProceduralMeshesPrivatePCH.h"
 #include "HeightFieldNoiseActor.h"
+#include "HeightmapFileSource.h"
+#include "MeshDecimation.h"
+#include "VertexCacheOptimizer.h"
+#include "ProceduralMeshThreading.h"
+
+DECLARE_CYCLE_STAT(TEXT("Height field noise"), STAT_GenerateHeightFieldNoise, STATGROUP_ProceduralMeshes);
 
 AHeightFieldNoiseActor::AHeightFieldNoiseActor()
+	: HeightsStage(INDEX_NONE)
+	, GridStage(INDEX_NONE)
+	, OptimizationStage(INDEX_NONE)
+	, BVHStage(INDEX_NONE)
+	, UploadStage(INDEX_NONE)
+	, MaterialStage(INDEX_NONE)
+	, CollisionStage(INDEX_NONE)
+	, GridLengthSections(0)
+	, GridWidthSections(0)
 {
-	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootScene"));
-	ProcMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("ProceduralMesh"));
-	ProcMesh->AttachTo(RootComponent);
-	// Make sure the PMC doesnt save any mesh data with the map
-	ProcMesh->SetFlags(EObjectFlags::RF_Transient);
 }
 
-#if WITH_EDITOR  
-void AHeightFieldNoiseActor::OnConstruction(const FTransform& Transform)
+void AHeightFieldNoiseActor::SetupStages()
 {
-	Super::OnConstruction(Transform);
-	GenerateMesh();
+	Pipeline.SetOwner(this, GET_STATID(STAT_GenerateHeightFieldNoise));
+
+	HeightsStage = Pipeline.AddStage(TEXT("Heights"), GET_STATID(STAT_ProceduralMeshStructure), [this]()
+	{
+		GenerationRngStream = FRandomStream::FRandomStream(RandomSeed);
+
+		// Setup example height data
+		int32 NumberOfPoints = (GridLengthSections + 1) * (GridWidthSections + 1);
+		HeightValues.SetNumUninitialized(NumberOfPoints);
+
+		// Use the heightmap if we have one, otherwise fill height data with random values
+		if (!SampleHeightmap(GridLengthSections + 1, GridWidthSections + 1, HeightValues))
+		{
+			for (int32 i = 0; i < NumberOfPoints; i++)
+			{
+				HeightValues[i] = GenerationRngStream.FRandRange(0, Height);
+			}
+		}
+	}, TArray<int32>());
+
+	GridStage = Pipeline.AddStage(TEXT("Grid"), GET_STATID(STAT_ProceduralMeshVertexFill), [this]()
+	{
+		int32 NumberOfVertices = GridLengthSections * GridWidthSections * 4; // 4x vertices per quad/section
+		GridMeshData.Reset();
+		GridMeshData.Vertices.AddUninitialized(NumberOfVertices);
+		GridMeshData.Triangles.AddUninitialized(GridLengthSections * GridWidthSections * 2 * 3); // 2x3 vertex indexes per quad
+		GridMeshData.Normals.AddUninitialized(NumberOfVertices);
+		GridMeshData.UVs.AddUninitialized(NumberOfVertices);
+		GridMeshData.Tangents.AddUninitialized(NumberOfVertices);
+		GenerateGrid(GridMeshData, Length, Width, GridLengthSections, GridWidthSections, HeightValues);
+	}, { HeightsStage });
+
+	// -------------------------------------------------------
+	// Decimation or vertex cache optimization, and the BVH, both only read the grid so they run at the same time
+	OptimizationStage = Pipeline.AddStage(TEXT("Optimization"), GET_STATID(STAT_ProceduralMeshOptimization), [this]()
+	{
+		if (bDecimate)
+		{
+			DecimateInChunks(GridMeshData);
+			return;
+		}
+
+		SectionMeshData.SetNum(1);
+		SectionMeshData[0] = GridMeshData;
+		if (bOptimizeVertexCache)
+		{
+			FVertexCacheStats CacheStats = FVertexCacheOptimizer::Optimize(SectionMeshData[0]);
+			UE_LOG(LogProceduralMeshes, Log, TEXT("%s: vertex cache ACMR %.3f -> %.3f, %.2f ms"), *GetName(), CacheStats.ACMRBefore, CacheStats.ACMRAfter, CacheStats.Seconds * 1000.0);
+		}
+	}, { GridStage });
+
+	BVHStage = Pipeline.AddStage(TEXT("BVH"), GET_STATID(STAT_ProceduralMeshOptimization), [this]()
+	{
+		if (!bBuildBVH)
+		{
+			BVH.Reset();
+			return;
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		BVH.Build(GridMeshData);
+		UE_LOG(LogProceduralMeshes, Verbose, TEXT("%s: built BVH with %d nodes over %d triangles, %.2f ms"),
+			*GetName(), BVH.GetNumNodes(), BVH.GetNumTriangles(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	}, { GridStage });
+
+	// -------------------------------------------------------
+	// The component and the reflected properties can only be updated from the game thread
+	UploadStage = Pipeline.AddStage(TEXT("Upload"), GET_STATID(STAT_ProceduralMeshUpload), [this]()
+	{
+		RngStream = GenerationRngStream;
+		GeneratedTriangleCount = 0;
+		ProcMesh->ClearAllMeshSections();
+		SIZE_T MeshDataBytes = GridMeshData.GetAllocatedSize();
+		for (int32 SectionIndex = 0; SectionIndex < SectionMeshData.Num(); SectionIndex++)
+		{
+			const FProceduralMeshData& Section = SectionMeshData[SectionIndex];
+			FProceduralMeshStats::CountUpload(Section);
+			GeneratedTriangleCount += Section.Triangles.Num() / 3;
+			MeshDataBytes += Section.GetAllocatedSize();
+			ProcMesh->CreateMeshSection(SectionIndex, Section.Vertices, Section.Triangles, Section.Normals, Section.UVs, Section.VertexColors, Section.Tangents, CollisionMode == EProceduralCollisionMode::Complex);
+		}
+		MeshDataMemory.Set(MeshDataBytes);
+	}, { OptimizationStage }, true);
+
+	MaterialStage = Pipeline.AddStage(TEXT("Material"), GET_STATID(STAT_ProceduralMeshUpload), [this]()
+	{
+		for (int32 SectionIndex = 0; SectionIndex < SectionMeshData.Num(); SectionIndex++)
+		{
+			ProcMesh->SetMaterial(SectionIndex, Material);
+		}
+	}, { UploadStage }, true);
+
+	CollisionStage = Pipeline.AddStage(TEXT("Collision"), GET_STATID(STAT_ProceduralMeshCollision), [this]()
+	{
+		GenerateCollision(HeightValues);
+	}, { HeightsStage }, true);
+
+	// -------------------------------------------------------
+	// The properties that only affect part of the work. Everything else changes the heights, which all the stages are built from.
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, Material), MaterialStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, bDecimate), OptimizationStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, DecimationMaxError), OptimizationStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, DecimationTargetPercentage), OptimizationStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, DecimationChunkSections), OptimizationStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, bOptimizeVertexCache), OptimizationStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, bBuildBVH), BVHStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, CollisionGridSections), CollisionStage);
+
+	// Complex collision is cooked as part of the upload
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, CollisionMode), UploadStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, CollisionMode), CollisionStage);
+
+	// Stretching the grid keeps the heights, and the collision is built from the heights and the size
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, Length), GridStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, Length), CollisionStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, Width), GridStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, Width), CollisionStage);
+
+	// Only applies while dragging
+	Pipeline.IgnoreProperty(GET_MEMBER_NAME_CHECKED(AHeightFieldNoiseActor, EditorPreviewLOD));
 }
-#endif // WITH_EDITOR
 
-void AHeightFieldNoiseActor::BeginPlay()
+bool AHeightFieldNoiseActor::CanRunPipeline() const
 {
-	Super::BeginPlay();
-	GenerateMesh();
+	return Length >= 1 && Width >= 1 && LengthSections >= 1 && WidthSections >= 1;
+}
 
-	// Fix for PCM location/rotation/scale since the whole component is Transient
-	ProcMesh->SetWorldLocation(this->GetActorLocation());
-	ProcMesh->SetWorldRotation(this->GetActorRotation());
-	ProcMesh->SetWorldScale3D(this->GetActorScale3D());
+void AHeightFieldNoiseActor::PrepareRun()
+{
+	// The preview is a coarser grid, and every stage is built from the grid size
+	const int32 NewLengthSections = FMath::Max(1, LengthSections >> GetPreviewLOD());
+	const int32 NewWidthSections = FMath::Max(1, WidthSections >> GetPreviewLOD());
+	if (NewLengthSections != GridLengthSections || NewWidthSections != GridWidthSections)
+	{
+		Pipeline.InvalidateAll();
+		GridLengthSections = NewLengthSections;
+		GridWidthSections = NewWidthSections;
+	}
 }
 
-void AHeightFieldNoiseActor::GenerateMesh()
+void AHeightFieldNoiseActor::DecimateInChunks(const FProceduralMeshData& MeshData)
 {
-	if (Length < 1 || Width < 1 || LengthSections < 1 || WidthSections < 1)
+	// -------------------------------------------------------
+	// Copy the quads of each chunk out of the grid. GenerateGrid writes 4 vertices and 6 indexes per quad, row by row.
+	// ClampMin doesn't stop Blueprint from setting less than that
+	const int32 ChunkSections = FMath::Max(2, DecimationChunkSections);
+	const int32 NumChunksX = FMath::DivideAndRoundUp(GridLengthSections, ChunkSections);
+	const int32 NumChunksY = FMath::DivideAndRoundUp(GridWidthSections, ChunkSections);
+	TArray<FProceduralMeshData> Chunks;
+	Chunks.AddDefaulted(NumChunksX * NumChunksY);
+
+	for (int32 ChunkX = 0; ChunkX < NumChunksX; ChunkX++)
+	{
+		for (int32 ChunkY = 0; ChunkY < NumChunksY; ChunkY++)
+		{
+			FProceduralMeshData& Chunk = Chunks[ChunkX * NumChunksY + ChunkY];
+			const int32 EndX = FMath::Min((ChunkX + 1) * ChunkSections, GridLengthSections);
+			const int32 EndY = FMath::Min((ChunkY + 1) * ChunkSections, GridWidthSections);
+
+			for (int32 X = ChunkX * ChunkSections; X < EndX; X++)
+			{
+				for (int32 Y = ChunkY * ChunkSections; Y < EndY; Y++)
+				{
+					const int32 QuadIndex = X * GridWidthSections + Y;
+					const int32 ChunkVertexOffset = Chunk.Vertices.Num() - QuadIndex * 4;
+					for (int32 Corner = 0; Corner < 4; Corner++)
+					{
+						Chunk.Vertices.Add(MeshData.Vertices[QuadIndex * 4 + Corner]);
+						Chunk.Normals.Add(MeshData.Normals[QuadIndex * 4 + Corner]);
+						Chunk.UVs.Add(MeshData.UVs[QuadIndex * 4 + Corner]);
+						Chunk.Tangents.Add(MeshData.Tangents[QuadIndex * 4 + Corner]);
+					}
+					for (int32 Index = 0; Index < 6; Index++)
+					{
+						Chunk.Triangles.Add(MeshData.Triangles[QuadIndex * 6 + Index] + ChunkVertexOffset);
+					}
+				}
+			}
+		}
+	}
+
+	// -------------------------------------------------------
+	// Each chunk is simplified on its own, so they can all run at the same time
+	const float TargetFraction = FMath::Clamp(DecimationTargetPercentage, 0.0f, 100.0f) / 100.0f;
+	TArray<FProceduralMeshData> DecimatedChunks;
+	TArray<FMeshDecimationStats> ChunkStats;
+	TArray<FVertexCacheStats> ChunkCacheStats;
+	DecimatedChunks.AddDefaulted(Chunks.Num());
+	ChunkStats.AddDefaulted(Chunks.Num());
+	ChunkCacheStats.AddDefaulted(Chunks.Num());
+
+	const double StartTime = FPlatformTime::Seconds();
+	FProceduralMeshThreading::ParallelFor(Chunks.Num(), [&](int32 ChunkIndex)
 	{
+		const int32 TargetTriangleCount = FMath::CeilToInt(Chunks[ChunkIndex].Triangles.Num() / 3 * TargetFraction);
+		ChunkStats[ChunkIndex] = FMeshDecimation::Simplify(Chunks[ChunkIndex], DecimatedChunks[ChunkIndex], DecimationMaxError, TargetTriangleCount);
+		if (bOptimizeVertexCache)
+		{
+			ChunkCacheStats[ChunkIndex] = FVertexCacheOptimizer::Optimize(DecimatedChunks[ChunkIndex]);
+		}
+	});
+	const double WallSeconds = FPlatformTime::Seconds() - StartTime;
+
+	// Each chunk becomes its own section when uploaded
+	int32 InputTriangleCount = 0;
+	int32 OutputTriangleCount = 0;
+	double ChunkSeconds = 0.0;
+	float ChunkMissesBefore = 0.0f;
+	float ChunkMissesAfter = 0.0f;
+	for (int32 ChunkIndex = 0; ChunkIndex < DecimatedChunks.Num(); ChunkIndex++)
+	{
+		InputTriangleCount += ChunkStats[ChunkIndex].InputTriangleCount;
+		OutputTriangleCount += ChunkStats[ChunkIndex].OutputTriangleCount;
+		ChunkSeconds += ChunkStats[ChunkIndex].Seconds;
+		ChunkMissesBefore += ChunkCacheStats[ChunkIndex].ACMRBefore * ChunkStats[ChunkIndex].OutputTriangleCount;
+		ChunkMissesAfter += ChunkCacheStats[ChunkIndex].ACMRAfter * ChunkStats[ChunkIndex].OutputTriangleCount;
+	}
+
+	UE_LOG(LogProceduralMeshes, Log, TEXT("%s: decimated %d to %d triangles (%.1f%% removed) in %d chunks, %.2f ms (%.2f ms per million triangles per thread)"),
+		*GetName(), InputTriangleCount, OutputTriangleCount, 100.0f * (1.0f - (float)OutputTriangleCount / FMath::Max(InputTriangleCount, 1)),
+		Chunks.Num(), WallSeconds * 1000.0, ChunkSeconds * 1000.0 * 1000000.0 / FMath::Max(InputTriangleCount, 1));
+
+	if (bOptimizeVertexCache)
+	{
+		UE_LOG(LogProceduralMeshes, Log, TEXT("%s: vertex cache ACMR %.3f -> %.3f"),
+			*GetName(), ChunkMissesBefore / FMath::Max(OutputTriangleCount, 1), ChunkMissesAfter / FMath::Max(OutputTriangleCount, 1));
+	}
+
+	SectionMeshData = MoveTemp(DecimatedChunks);
+}
+
+void AHeightFieldNoiseActor::GenerateCollision(const TArray<float>& InHeightValues)
+{
+	if (CollisionMode != EProceduralCollisionMode::Simple)
+	{
+		Collision->ClearCollision();
 		return;
 	}
 
-	RngStream = FRandomStream::FRandomStream(RandomSeed);
+	// The worker thread gets its own copy of the heights and builds the columns from those
+	const int32 NumRows = GridLengthSections + 1;
+	const int32 NumColumns = GridWidthSections + 1;
+	const FVector2D SectionSize = FVector2D(Length / GridLengthSections, Width / GridWidthSections);
+	const int32 GridSectionsX = FMath::Clamp(CollisionGridSections, 1, GridLengthSections);
+	const int32 GridSectionsY = FMath::Clamp(CollisionGridSections, 1, GridWidthSections);
+	TArray<float> CollisionHeights = InHeightValues;
+
+	Collision->BuildCollisionAsync([CollisionHeights, NumRows, NumColumns, SectionSize, GridSectionsX, GridSectionsY](FKAggregateGeom& Shapes)
+	{
+		// All columns go down to the same floor a bit below the lowest point, so there are no gaps between them
+		float MinHeight = MAX_flt;
+		float MaxHeight = -MAX_flt;
+		for (float EachHeight : CollisionHeights)
+		{
+			MinHeight = FMath::Min(MinHeight, EachHeight);
+			MaxHeight = FMath::Max(MaxHeight, EachHeight);
+		}
+		const float Floor = MinHeight - FMath::Max((MaxHeight - MinHeight) * 0.1f, 1.0f);
+
+		// -------------------------------------------------------
+		// Each column is a convex hull of the four grid points at its corners and the floor below them
+		for (int32 GridX = 0; GridX < GridSectionsX; GridX++)
+		{
+			const int32 X0 = GridX * (NumRows - 1) / GridSectionsX;
+			const int32 X1 = (GridX + 1) * (NumRows - 1) / GridSectionsX;
+			for (int32 GridY = 0; GridY < GridSectionsY; GridY++)
+			{
+				const int32 Y0 = GridY * (NumColumns - 1) / GridSectionsY;
+				const int32 Y1 = (GridY + 1) * (NumColumns - 1) / GridSectionsY;
+				const FIntPoint Corners[4] = { FIntPoint(X0, Y0), FIntPoint(X0, Y1), FIntPoint(X1, Y1), FIntPoint(X1, Y0) };
+
+				FKConvexElem Column;
+				for (const FIntPoint& Corner : Corners)
+				{
+					const FVector2D Position = FVector2D(Corner.X * SectionSize.X, Corner.Y * SectionSize.Y);
+					Column.VertexData.Add(FVector(Position.X, Position.Y, CollisionHeights[Corner.X * NumColumns + Corner.Y]));
+					Column.VertexData.Add(FVector(Position.X, Position.Y, Floor));
+				}
+				Column.UpdateElemBox();
+				Shapes.ConvexElems.Add(Column);
+			}
+		}
+	});
+}
+
+bool AHeightFieldNoiseActor::RaycastMesh(FVector Start, FVector End, FVector& HitLocation, FVector& HitNormal) const
+{
+	// The BVH is being built again in the background
+	if (Pipeline.IsRunning())
+	{
+		return false;
+	}
+
+	// The mesh component sits at the root of the actor, so the grid is in actor space
+	const FTransform& ActorTransform = GetActorTransform();
+	FMeshBVHHit Hit;
+	if (!BVH.Raycast(ActorTransform.InverseTransformPosition(Start), ActorTransform.InverseTransformPosition(End), Hit))
+	{
+		return false;
+	}
 
-	// Setup example height data
-	int32 NumberOfPoints = (LengthSections + 1) * (WidthSections + 1);
-	TArray<float> HeightValues;
-	HeightValues.AddUninitialized(NumberOfPoints);
+	HitLocation = ActorTransform.TransformPosition(Hit.Location);
+	HitNormal = ActorTransform.TransformVectorNoScale(Hit.Normal / ActorTransform.GetScale3D()).GetSafeNormal();
+	return true;
+}
 
-	// Fill height data with random values
-	for (int32 i = 0; i < NumberOfPoints; i++)
+int32 AHeightFieldNoiseActor::CountTrianglesInBox(FVector BoxCenter, FVector BoxExtent) const
+{
+	if (Pipeline.IsRunning())
 	{
-		HeightValues[i] = RngStream.FRandRange(0, Height);
+		return 0;
 	}
 
-	FProceduralMeshData MeshData = FProceduralMeshData();
-	int32 NumberOfVertices = LengthSections * WidthSections * 4; // 4x vertices per quad/section
-	MeshData.Vertices.AddUninitialized(NumberOfVertices);
-	MeshData.Triangles.AddUninitialized(LengthSections * WidthSections * 2 * 3); // 2x3 vertex indexes per quad
-	MeshData.Normals.AddUninitialized(NumberOfVertices);
-	MeshData.UVs.AddUninitialized(NumberOfVertices);
-	MeshData.Tangents.AddUninitialized(NumberOfVertices);
-
-	GenerateGrid(MeshData, Length, Width, LengthSections, WidthSections, HeightValues);
-	ProcMesh->ClearAllMeshSections();
-	ProcMesh->CreateMeshSection(0, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, false);
-	ProcMesh->SetMaterial(0, Material);
+	const FBox LocalBox = FBox(BoxCenter - BoxExtent, BoxCenter + BoxExtent).TransformBy(GetActorTransform().Inverse());
+	TArray<int32> TriangleIndices;
+	return BVH.OverlapBox(LocalBox, TriangleIndices);
+}
+
+bool AHeightFieldNoiseActor::SampleHeightmap(int32 NumberOfRows, int32 NumberOfColumns, TArray<float>& OutHeightValues) const
+{
+	if (HeightmapFile.FilePath.IsEmpty())
+	{
+		return false;
+	}
+
+	FString Filename = HeightmapFile.FilePath;
+	if (FPaths::IsRelative(Filename))
+	{
+		Filename = FPaths::ConvertRelativePathToFull(FPaths::GameDir(), Filename);
+	}
+
+	FHeightmapFileSource HeightmapSource(MaxResidentTiles);
+	if (!HeightmapSource.Open(Filename, HeightmapRawWidth))
+	{
+		return false;
+	}
+
+	// The file runs across the grid along Width, and its rows follow Length
+	FIntPoint RegionStart = FIntPoint(FMath::Clamp(HeightmapRegionStart.X, 0, HeightmapSource.GetWidth() - 1), FMath::Clamp(HeightmapRegionStart.Y, 0, HeightmapSource.GetHeight() - 1));
+	FIntPoint RegionSize = FIntPoint(
+		HeightmapRegionSize.X > 0 ? HeightmapRegionSize.X : HeightmapSource.GetWidth() - 1 - RegionStart.X,
+		HeightmapRegionSize.Y > 0 ? HeightmapRegionSize.Y : HeightmapSource.GetHeight() - 1 - RegionStart.Y);
+
+	HeightmapSource.SampleGrid(RegionStart.X, RegionStart.Y, RegionSize.X, RegionSize.Y, NumberOfRows, NumberOfColumns, Height, OutHeightValues);
+
+	UE_LOG(LogProceduralMeshes, Verbose, TEXT("%s: sampled %dx%d points from %dx%d heightmap, %d tiles read"),
+		*GetName(), NumberOfColumns, NumberOfRows, HeightmapSource.GetWidth(), HeightmapSource.GetHeight(), HeightmapSource.GetNumTileReads());
+	return true;
 }
 
 void AHeightFieldNoiseActor::GenerateGrid(FProceduralMeshData& MeshData, float InLength, float InWidth, int32 InLengthSections, int32 InWidthSections, const TArray<float>& InHeightValues)
@@ -84,9 +393,10 @@ void AHeightFieldNoiseActor::GenerateGrid(FProceduralMeshData& MeshData, float I
 			int32 TopRightIndex = VertexIndex++;
 			int32 TopLeftIndex = VertexIndex++;
 
-			int32 NoiseIndex_BottomLeft = (X * InWidthSections) + Y;
+			// There is one more height value than quads along each side
+			int32 NoiseIndex_BottomLeft = (X * (InWidthSections + 1)) + Y;
 			int32 NoiseIndex_BottomRight = NoiseIndex_BottomLeft + 1;
-			int32 NoiseIndex_TopLeft = ((X+1) * InWidthSections) + Y;
+			int32 NoiseIndex_TopLeft = ((X+1) * (InWidthSections + 1)) + Y;
 			int32 NoiseIndex_TopRight = NoiseIndex_TopLeft + 1;
 
 			FVector pBottomLeft = FVector(X * SectionSize.X, Y * SectionSize.Y, InHeightValues[NoiseIndex_BottomLeft]);
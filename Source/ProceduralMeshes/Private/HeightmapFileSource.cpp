@@ -0,0 +1,283 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Reads heights from 16 bit RAW or binary PGM heightmap files a tile at a time
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "HeightmapFileSource.h"
+
+FHeightmapFileSource::FHeightmapFileSource(int32 InMaxResidentTiles/* = 16*/)
+	: DataOffset(0)
+	, Width(0)
+	, Height(0)
+	, BytesPerSample(2)
+	, bBigEndian(false)
+	, MaxValue(65535.0f)
+	, MaxResidentTiles(FMath::Max(InMaxResidentTiles, 4))
+	, NumTileReads(0)
+{
+}
+
+bool FHeightmapFileSource::Open(const FString& Filename, int32 RawWidth/* = 0*/)
+{
+	Close();
+
+	FileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Filename));
+	if (!FileHandle.IsValid())
+	{
+		UE_LOG(LogProceduralMeshes, Warning, TEXT("Could not open heightmap %s"), *Filename);
+		return false;
+	}
+
+	if (FPaths::GetExtension(Filename).Equals(TEXT("pgm"), ESearchCase::IgnoreCase))
+	{
+		if (!ReadPGMHeader())
+		{
+			UE_LOG(LogProceduralMeshes, Warning, TEXT("%s is not a binary (P5) PGM file"), *Filename);
+			Close();
+			return false;
+		}
+	}
+	else
+	{
+		// -------------------------------------------------------
+		// RAW files have no header, so the size has to come from the caller or from the file being square
+		int64 NumSamples = FileHandle->Size() / 2;
+		DataOffset = 0;
+		BytesPerSample = 2;
+		bBigEndian = false;
+		MaxValue = 65535.0f;
+
+		if (RawWidth > 0)
+		{
+			Width = RawWidth;
+			Height = (int32)(NumSamples / RawWidth);
+		}
+		else
+		{
+			Width = Height = FMath::RoundToInt(FMath::Sqrt((float)NumSamples));
+		}
+
+		if (Width <= 0 || Height <= 0 || (int64)Width * Height > NumSamples)
+		{
+			UE_LOG(LogProceduralMeshes, Warning, TEXT("%s is not a square 16 bit RAW file, set the width explicitly"), *Filename);
+			Close();
+			return false;
+		}
+	}
+
+	RowBuffer.SetNumUninitialized(TileSize * BytesPerSample);
+	return true;
+}
+
+void FHeightmapFileSource::Close()
+{
+	FileHandle.Reset();
+	Tiles.Empty();
+	Width = Height = 0;
+	NumTileReads = 0;
+}
+
+bool FHeightmapFileSource::ReadPGMHeader()
+{
+	// The header is plain text: P5, width, height and max value separated by whitespace, with # comments allowed in between
+	uint8 Header[512];
+	int64 HeaderSize = FMath::Min<int64>(sizeof(Header), FileHandle->Size());
+	if (!FileHandle->Read(Header, HeaderSize))
+	{
+		return false;
+	}
+
+	int32 Position = 0;
+	int32 Values[4] = { 0 };
+	for (int32 Token = 0; Token < 4; Token++)
+	{
+		// Skip whitespace and comments
+		while (Position < HeaderSize && (FChar::IsWhitespace(Header[Position]) || Header[Position] == '#'))
+		{
+			if (Header[Position] == '#')
+			{
+				while (Position < HeaderSize && Header[Position] != '\n')
+				{
+					Position++;
+				}
+			}
+			Position++;
+		}
+
+		if (Token == 0)
+		{
+			if (Position + 1 >= HeaderSize || Header[Position] != 'P' || Header[Position + 1] != '5')
+			{
+				return false;
+			}
+			Position += 2;
+			continue;
+		}
+
+		while (Position < HeaderSize && FChar::IsDigit(Header[Position]))
+		{
+			Values[Token] = Values[Token] * 10 + (Header[Position] - '0');
+			Position++;
+		}
+	}
+
+	// Exactly one whitespace character separates the header from the samples
+	Width = Values[1];
+	Height = Values[2];
+	MaxValue = (float)Values[3];
+	DataOffset = Position + 1;
+	BytesPerSample = Values[3] > 255 ? 2 : 1;
+	bBigEndian = true;
+
+	return Width > 0 && Height > 0 && MaxValue > 0 && DataOffset + (int64)Width * Height * BytesPerSample <= FileHandle->Size();
+}
+
+const FHeightmapFileSource::FTile& FHeightmapFileSource::GetTile(int32 TileX, int32 TileY)
+{
+	const int32 TilesX = FMath::DivideAndRoundUp(Width, TileSize);
+	const int32 TileIndex = TileX + TileY * TilesX;
+
+	// -------------------------------------------------------
+	// Most lookups hit the tile we used last, otherwise move it to the back so it is dropped last
+	for (int32 ResidentIndex = Tiles.Num() - 1; ResidentIndex >= 0; ResidentIndex--)
+	{
+		if (Tiles[ResidentIndex].TileIndex == TileIndex)
+		{
+			if (ResidentIndex != Tiles.Num() - 1)
+			{
+				FTile UsedTile = MoveTemp(Tiles[ResidentIndex]);
+				Tiles.RemoveAt(ResidentIndex, 1, false);
+				Tiles.Add(MoveTemp(UsedTile));
+			}
+			return Tiles.Last();
+		}
+	}
+
+	// -------------------------------------------------------
+	// Not resident, reuse the memory of the least recently used tile if we are at the limit
+	FTile NewTile;
+	if (Tiles.Num() >= MaxResidentTiles)
+	{
+		NewTile = MoveTemp(Tiles[0]);
+		Tiles.RemoveAt(0, 1, false);
+	}
+	NewTile.TileIndex = TileIndex;
+	NewTile.Samples.SetNumZeroed(TileSize * TileSize);
+
+	const int32 StartX = TileX * TileSize;
+	const int32 StartY = TileY * TileSize;
+	const int32 TileWidth = FMath::Min(TileSize, Width - StartX);
+	const int32 TileHeight = FMath::Min(TileSize, Height - StartY);
+
+	for (int32 Row = 0; Row < TileHeight; Row++)
+	{
+		FileHandle->Seek(DataOffset + ((int64)(StartY + Row) * Width + StartX) * BytesPerSample);
+		FileHandle->Read(RowBuffer.GetData(), TileWidth * BytesPerSample);
+
+		uint16* TileRow = &NewTile.Samples[Row * TileSize];
+		for (int32 Column = 0; Column < TileWidth; Column++)
+		{
+			if (BytesPerSample == 1)
+			{
+				TileRow[Column] = RowBuffer[Column];
+			}
+			else if (bBigEndian)
+			{
+				TileRow[Column] = (uint16)((RowBuffer[Column * 2] << 8) | RowBuffer[Column * 2 + 1]);
+			}
+			else
+			{
+				TileRow[Column] = (uint16)(RowBuffer[Column * 2] | (RowBuffer[Column * 2 + 1] << 8));
+			}
+		}
+	}
+
+	NumTileReads++;
+	Tiles.Add(MoveTemp(NewTile));
+	return Tiles.Last();
+}
+
+float FHeightmapFileSource::GetSample(int32 X, int32 Y)
+{
+	if (!IsOpen())
+	{
+		return 0.0f;
+	}
+
+	X = FMath::Clamp(X, 0, Width - 1);
+	Y = FMath::Clamp(Y, 0, Height - 1);
+	const FTile& Tile = GetTile(X / TileSize, Y / TileSize);
+	return Tile.Samples[(X % TileSize) + (Y % TileSize) * TileSize] / MaxValue;
+}
+
+float FHeightmapFileSource::SampleBilinear(float X, float Y)
+{
+	const int32 X0 = FMath::FloorToInt(X);
+	const int32 Y0 = FMath::FloorToInt(Y);
+	const float AlphaX = X - X0;
+	const float AlphaY = Y - Y0;
+
+	const float Top = FMath::Lerp(GetSample(X0, Y0), GetSample(X0 + 1, Y0), AlphaX);
+	const float Bottom = FMath::Lerp(GetSample(X0, Y0 + 1), GetSample(X0 + 1, Y0 + 1), AlphaX);
+	return FMath::Lerp(Top, Bottom, AlphaY);
+}
+
+void FHeightmapFileSource::SampleGrid(float RegionX, float RegionY, float RegionWidth, float RegionHeight, int32 NumRows, int32 NumColumns, float HeightScale, TArray<float>& OutHeights)
+{
+	OutHeights.SetNumZeroed(NumRows * NumColumns);
+	if (!IsOpen() || NumRows < 1 || NumColumns < 1)
+	{
+		return;
+	}
+
+	// -------------------------------------------------------
+	// Work out where each row and column lands in the file, they only ever move forwards
+	TArray<float> ColumnPositions;
+	TArray<float> RowPositions;
+	ColumnPositions.AddUninitialized(NumColumns);
+	RowPositions.AddUninitialized(NumRows);
+	for (int32 Column = 0; Column < NumColumns; Column++)
+	{
+		ColumnPositions[Column] = FMath::Clamp(RegionX + RegionWidth * Column / FMath::Max(NumColumns - 1, 1), 0.0f, (float)(Width - 1));
+	}
+	for (int32 Row = 0; Row < NumRows; Row++)
+	{
+		RowPositions[Row] = FMath::Clamp(RegionY + RegionHeight * Row / FMath::Max(NumRows - 1, 1), 0.0f, (float)(Height - 1));
+	}
+
+	// -------------------------------------------------------
+	// Visit the points one tile at a time. Bilinear filtering can reach one pixel into the tiles to the right and below,
+	// the one to the right is still resident when we get to it but the row below may have to be read again.
+	int32 FirstRow = 0;
+	while (FirstRow < NumRows)
+	{
+		const int32 TileY = FMath::FloorToInt(RowPositions[FirstRow]) / TileSize;
+		int32 EndRow = FirstRow;
+		while (EndRow < NumRows && FMath::FloorToInt(RowPositions[EndRow]) / TileSize == TileY)
+		{
+			EndRow++;
+		}
+
+		int32 FirstColumn = 0;
+		while (FirstColumn < NumColumns)
+		{
+			const int32 TileX = FMath::FloorToInt(ColumnPositions[FirstColumn]) / TileSize;
+			int32 EndColumn = FirstColumn;
+			while (EndColumn < NumColumns && FMath::FloorToInt(ColumnPositions[EndColumn]) / TileSize == TileX)
+			{
+				EndColumn++;
+			}
+
+			for (int32 Row = FirstRow; Row < EndRow; Row++)
+			{
+				for (int32 Column = FirstColumn; Column < EndColumn; Column++)
+				{
+					OutHeights[Row * NumColumns + Column] = SampleBilinear(ColumnPositions[Column], RowPositions[Row]) * HeightScale;
+				}
+			}
+
+			FirstColumn = EndColumn;
+		}
+
+		FirstRow = EndRow;
+	}
+}
@@ -0,0 +1,63 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Reads heights from 16 bit RAW or binary PGM heightmap files a tile at a time
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+
+// Keeps the file open and reads square tiles of samples on demand, so only the parts of a large heightmap that are actually sampled
+// are ever read, and never more than MaxResidentTiles of them are kept in memory. The least recently used tile is dropped first.
+// RAW files are headerless 16 bit little endian, PGM files are binary (P5) with 8 or 16 bit big endian samples.
+// Not thread safe, each generating thread needs its own source.
+class PROCEDURALMESHES_API FHeightmapFileSource
+{
+public:
+	static const int32 TileSize = 64;
+
+	explicit FHeightmapFileSource(int32 InMaxResidentTiles = 16);
+
+	// RawWidth is only used for RAW files, 0 means the file is square
+	bool Open(const FString& Filename, int32 RawWidth = 0);
+	void Close();
+
+	bool IsOpen() const { return FileHandle.IsValid(); }
+	int32 GetWidth() const { return Width; }
+	int32 GetHeight() const { return Height; }
+
+	// Number of tiles read from disk since the file was opened
+	int32 GetNumTileReads() const { return NumTileReads; }
+
+	// Sample at a pixel, clamped to the edges of the file, scaled to 0-1
+	float GetSample(int32 X, int32 Y);
+
+	// Bilinear sample at a position in pixels
+	float SampleBilinear(float X, float Y);
+
+	// Samples NumRows x NumColumns evenly spaced points over a region of the file into OutHeights, row by row, scaled by HeightScale.
+	// The points are visited tile by tile, so even with a cache much smaller than a row of tiles each tile is read from disk at most twice.
+	void SampleGrid(float RegionX, float RegionY, float RegionWidth, float RegionHeight, int32 NumRows, int32 NumColumns, float HeightScale, TArray<float>& OutHeights);
+
+private:
+	struct FTile
+	{
+		int32 TileIndex;
+		TArray<uint16> Samples;
+	};
+
+	bool ReadPGMHeader();
+	const FTile& GetTile(int32 TileX, int32 TileY);
+
+	TUniquePtr<IFileHandle> FileHandle;
+	int64 DataOffset;
+	int32 Width;
+	int32 Height;
+	int32 BytesPerSample;
+	bool bBigEndian;
+	float MaxValue;
+
+	// Resident tiles, the most recently used one is last
+	TArray<FTile> Tiles;
+	int32 MaxResidentTiles;
+	int32 NumTileReads;
+	TArray<uint8> RowBuffer;
+};
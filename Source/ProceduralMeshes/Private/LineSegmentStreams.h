@@ -0,0 +1,104 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Line segments stored as one contiguous stream per component, for the loops that go over all of them at once
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ScratchArena.h"
+
+// Each component of a segment gets its own array, so a loop that reads the start points of every segment reads three packed float arrays
+// instead of striding over whole structs, and plain loops over them turn into SIMD code. Generation is whatever the owner counts
+// segments in, the fork generation of a branch or the recursion depth of a pyramid line, and is what lower LODs drop first.
+template<typename AllocatorType>
+struct TLineSegmentStreams
+{
+	TArray<float, AllocatorType> StartX;
+	TArray<float, AllocatorType> StartY;
+	TArray<float, AllocatorType> StartZ;
+	TArray<float, AllocatorType> EndX;
+	TArray<float, AllocatorType> EndY;
+	TArray<float, AllocatorType> EndZ;
+	TArray<float, AllocatorType> Width;
+	TArray<int32, AllocatorType> Generation;
+
+	int32 Num() const
+	{
+		return Width.Num();
+	}
+
+	int32 Add(const FVector& Start, const FVector& End, float InWidth, int32 InGeneration)
+	{
+		StartX.Add(Start.X);
+		StartY.Add(Start.Y);
+		StartZ.Add(Start.Z);
+		EndX.Add(End.X);
+		EndY.Add(End.Y);
+		EndZ.Add(End.Z);
+		Generation.Add(InGeneration);
+		return Width.Add(InWidth);
+	}
+
+	FVector GetStart(int32 Index) const
+	{
+		return FVector(StartX[Index], StartY[Index], StartZ[Index]);
+	}
+
+	FVector GetEnd(int32 Index) const
+	{
+		return FVector(EndX[Index], EndY[Index], EndZ[Index]);
+	}
+
+	int32 GetMaxGeneration() const
+	{
+		int32 MaxGeneration = 0;
+		for (int32 Index = 0; Index < Generation.Num(); Index++)
+		{
+			MaxGeneration = FMath::Max(MaxGeneration, Generation[Index]);
+		}
+		return MaxGeneration;
+	}
+
+	// Appends the segments of Other that are no deeper than MaxGeneration, in order
+	template<typename OtherAllocatorType>
+	void Append(const TLineSegmentStreams<OtherAllocatorType>& Other, int32 MaxGeneration = MAX_int32)
+	{
+		Reserve(Num() + Other.Num());
+		for (int32 Index = 0; Index < Other.Num(); Index++)
+		{
+			if (Other.Generation[Index] <= MaxGeneration)
+			{
+				Add(Other.GetStart(Index), Other.GetEnd(Index), Other.Width[Index], Other.Generation[Index]);
+			}
+		}
+	}
+
+	void Reserve(int32 Number)
+	{
+		StartX.Reserve(Number);
+		StartY.Reserve(Number);
+		StartZ.Reserve(Number);
+		EndX.Reserve(Number);
+		EndY.Reserve(Number);
+		EndZ.Reserve(Number);
+		Width.Reserve(Number);
+		Generation.Reserve(Number);
+	}
+
+	void Reset(int32 Slack = 0)
+	{
+		StartX.Reset(Slack);
+		StartY.Reset(Slack);
+		StartZ.Reset(Slack);
+		EndX.Reset(Slack);
+		EndY.Reset(Slack);
+		EndZ.Reset(Slack);
+		Width.Reset(Slack);
+		Generation.Reset(Slack);
+	}
+};
+
+// Kept on an actor between generations
+typedef TLineSegmentStreams<FDefaultAllocator> FLineSegmentStreams;
+
+// Only needed while a generation stage runs, like the segments of one LOD
+typedef TLineSegmentStreams<FScratchAllocator> FScratchLineSegmentStreams;
@@ -0,0 +1,416 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Scalar field and marching cubes polygoniser used by the isosurface actor
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "MarchingCubes.h"
+#include "ProceduralMeshThreading.h"
+
+namespace MarchingCubes
+{
+	// Corner 0 is the cell origin, 0-3 go around the bottom of the cell and 4-7 around the top
+	static const int32 CornerOffsets[8][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 } };
+
+	static const int32 EdgeCorners[12][2] = { { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 }, { 4, 5 }, { 5, 6 }, { 6, 7 }, { 7, 4 }, { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 } };
+
+	// The corners of each face, counter clockwise when looking at the face from outside the cell
+	static const int32 FaceCorners[6][4] = { { 0, 3, 2, 1 }, { 4, 5, 6, 7 }, { 0, 1, 5, 4 }, { 2, 3, 7, 6 }, { 0, 4, 7, 3 }, { 1, 2, 6, 5 } };
+
+	// Instead of typing in the usual 256 case table we work it out when the module loads.
+	// On every face of the cell, the surface crosses from the edge where we enter an inside corner to the edge where we leave it again.
+	// Faces with two inside corners opposite each other always keep those corners apart, and since neighbouring cells see the same face
+	// the same way the surface stays watertight between them. Chaining the crossings gives closed loops that we triangulate as fans.
+	struct FCaseTable
+	{
+		// Edge indexes of up to 5 triangles per case
+		int8 Triangles[256][15];
+		int32 NumIndexes[256];
+
+		// The corner with the lowest coordinates and the axis each edge runs along
+		int32 EdgeOrigin[12][3];
+		int32 EdgeAxis[12];
+
+		FCaseTable()
+		{
+			int32 EdgeFaces[12];
+			for (int32 Edge = 0; Edge < 12; Edge++)
+			{
+				const int32* CornerA = CornerOffsets[EdgeCorners[Edge][0]];
+				const int32* CornerB = CornerOffsets[EdgeCorners[Edge][1]];
+				for (int32 Axis = 0; Axis < 3; Axis++)
+				{
+					EdgeOrigin[Edge][Axis] = FMath::Min(CornerA[Axis], CornerB[Axis]);
+					if (CornerA[Axis] != CornerB[Axis])
+					{
+						EdgeAxis[Edge] = Axis;
+					}
+				}
+
+				EdgeFaces[Edge] = 0;
+				for (int32 Face = 0; Face < 6; Face++)
+				{
+					if (FaceHasCorner(Face, EdgeCorners[Edge][0]) && FaceHasCorner(Face, EdgeCorners[Edge][1]))
+					{
+						EdgeFaces[Edge] |= 1 << Face;
+					}
+				}
+			}
+
+			for (int32 Case = 0; Case < 256; Case++)
+			{
+				// -------------------------------------------------------
+				// Link each crossed edge to the next one along the surface
+				int32 NextEdge[12];
+				for (int32 Edge = 0; Edge < 12; Edge++)
+				{
+					NextEdge[Edge] = INDEX_NONE;
+				}
+
+				for (int32 Face = 0; Face < 6; Face++)
+				{
+					int32 CrossedEdges[4];
+					bool bLeavesInside[4];
+					int32 NumCrossed = 0;
+					for (int32 Side = 0; Side < 4; Side++)
+					{
+						int32 CornerA = FaceCorners[Face][Side];
+						int32 CornerB = FaceCorners[Face][(Side + 1) % 4];
+						bool bInsideA = (Case & (1 << CornerA)) != 0;
+						bool bInsideB = (Case & (1 << CornerB)) != 0;
+						if (bInsideA != bInsideB)
+						{
+							CrossedEdges[NumCrossed] = FindEdge(CornerA, CornerB);
+							bLeavesInside[NumCrossed] = bInsideA;
+							NumCrossed++;
+						}
+					}
+
+					for (int32 Crossing = 0; Crossing < NumCrossed; Crossing++)
+					{
+						if (bLeavesInside[Crossing])
+						{
+							continue;
+						}
+
+						for (int32 Step = 1; Step <= NumCrossed; Step++)
+						{
+							int32 Other = (Crossing + Step) % NumCrossed;
+							if (bLeavesInside[Other])
+							{
+								// Linked in this direction the triangles face out of the surface
+								NextEdge[CrossedEdges[Other]] = CrossedEdges[Crossing];
+								break;
+							}
+						}
+					}
+				}
+
+				// -------------------------------------------------------
+				// Follow the links around each loop and triangulate it
+				bool bVisited[12] = { false };
+				NumIndexes[Case] = 0;
+
+				for (int32 StartEdge = 0; StartEdge < 12; StartEdge++)
+				{
+					if (NextEdge[StartEdge] == INDEX_NONE || bVisited[StartEdge])
+					{
+						continue;
+					}
+
+					int32 Loop[12];
+					int32 LoopLength = 0;
+					int32 Edge = StartEdge;
+					do
+					{
+						bVisited[Edge] = true;
+						Loop[LoopLength++] = Edge;
+						Edge = NextEdge[Edge];
+					} while (Edge != StartEdge);
+
+					// Start the fan where the fewest of its diagonals lie flat on a cell face, those would overlap the neighbouring cell
+					int32 BestStart = 0;
+					int32 BestCount = MAX_int32;
+					for (int32 Start = 0; Start < LoopLength; Start++)
+					{
+						int32 Count = 0;
+						for (int32 Diagonal = 2; Diagonal < LoopLength - 1; Diagonal++)
+						{
+							if (EdgeFaces[Loop[Start]] & EdgeFaces[Loop[(Start + Diagonal) % LoopLength]])
+							{
+								Count++;
+							}
+						}
+						if (Count < BestCount)
+						{
+							BestStart = Start;
+							BestCount = Count;
+						}
+					}
+
+					for (int32 Fan = 1; Fan < LoopLength - 1; Fan++)
+					{
+						Triangles[Case][NumIndexes[Case]++] = (int8)Loop[BestStart];
+						Triangles[Case][NumIndexes[Case]++] = (int8)Loop[(BestStart + Fan) % LoopLength];
+						Triangles[Case][NumIndexes[Case]++] = (int8)Loop[(BestStart + Fan + 1) % LoopLength];
+					}
+				}
+			}
+		}
+
+		static bool FaceHasCorner(int32 Face, int32 Corner)
+		{
+			return FaceCorners[Face][0] == Corner || FaceCorners[Face][1] == Corner || FaceCorners[Face][2] == Corner || FaceCorners[Face][3] == Corner;
+		}
+
+		static int32 FindEdge(int32 CornerA, int32 CornerB)
+		{
+			for (int32 Edge = 0; Edge < 12; Edge++)
+			{
+				if ((EdgeCorners[Edge][0] == CornerA && EdgeCorners[Edge][1] == CornerB) || (EdgeCorners[Edge][0] == CornerB && EdgeCorners[Edge][1] == CornerA))
+				{
+					return Edge;
+				}
+			}
+			return INDEX_NONE;
+		}
+	};
+
+	// Built once when the module loads, so the worker threads only ever read it
+	static const FCaseTable CaseTable;
+}
+
+// -------------------------------------------------------
+// Scalar field
+
+void FScalarField3D::Init(int32 InSizeX, int32 InSizeY, int32 InSizeZ)
+{
+	SizeX = FMath::Max(InSizeX, 1);
+	SizeY = FMath::Max(InSizeY, 1);
+	SizeZ = FMath::Max(InSizeZ, 1);
+	Values.Init(0.0f, (SizeX + 1) * (SizeY + 1) * (SizeZ + 1));
+}
+
+void FScalarField3D::FillWithValueNoise(FRandomStream& RngStream, float NoiseScale, int32 Octaves, float SurfaceHeight, float GroundBias)
+{
+	// -------------------------------------------------------
+	// Start with solid ground below the surface height, fading out to air above it
+	for (int32 Z = 0; Z <= SizeZ; Z++)
+	{
+		float GroundValue = GroundBias * (SurfaceHeight - (float)Z / (float)SizeZ);
+		for (int32 Y = 0; Y <= SizeY; Y++)
+		{
+			for (int32 X = 0; X <= SizeX; X++)
+			{
+				Values[GetIndex(X, Y, Z)] = GroundValue;
+			}
+		}
+	}
+
+	// -------------------------------------------------------
+	// Each octave is a lattice of random values, with half the spacing and half the strength of the previous one
+	float Spacing = FMath::Max(NoiseScale, 1.0f);
+	float Amplitude = 1.0f;
+	TArray<float> Lattice;
+
+	for (int32 Octave = 0; Octave < Octaves; Octave++)
+	{
+		int32 LatticeX = FMath::FloorToInt(SizeX / Spacing) + 2;
+		int32 LatticeY = FMath::FloorToInt(SizeY / Spacing) + 2;
+		int32 LatticeZ = FMath::FloorToInt(SizeZ / Spacing) + 2;
+		Lattice.SetNumUninitialized(LatticeX * LatticeY * LatticeZ);
+		for (int32 LatticeIndex = 0; LatticeIndex < Lattice.Num(); LatticeIndex++)
+		{
+			Lattice[LatticeIndex] = RngStream.FRandRange(-1.0f, 1.0f);
+		}
+
+		for (int32 Z = 0; Z <= SizeZ; Z++)
+		{
+			float FZ = Z / Spacing;
+			int32 IZ = FMath::Min(FMath::FloorToInt(FZ), LatticeZ - 2);
+			float TZ = FMath::SmoothStep(0.0f, 1.0f, FZ - IZ);
+
+			for (int32 Y = 0; Y <= SizeY; Y++)
+			{
+				float FY = Y / Spacing;
+				int32 IY = FMath::Min(FMath::FloorToInt(FY), LatticeY - 2);
+				float TY = FMath::SmoothStep(0.0f, 1.0f, FY - IY);
+
+				for (int32 X = 0; X <= SizeX; X++)
+				{
+					float FX = X / Spacing;
+					int32 IX = FMath::Min(FMath::FloorToInt(FX), LatticeX - 2);
+					float TX = FMath::SmoothStep(0.0f, 1.0f, FX - IX);
+
+					// Trilinear blend of the 8 surrounding lattice values
+					const float* L = &Lattice[IX + LatticeX * (IY + LatticeY * IZ)];
+					const int32 StepY = LatticeX;
+					const int32 StepZ = LatticeX * LatticeY;
+					float Bottom = FMath::Lerp(FMath::Lerp(L[0], L[1], TX), FMath::Lerp(L[StepY], L[StepY + 1], TX), TY);
+					float Top = FMath::Lerp(FMath::Lerp(L[StepZ], L[StepZ + 1], TX), FMath::Lerp(L[StepZ + StepY], L[StepZ + StepY + 1], TX), TY);
+					Values[GetIndex(X, Y, Z)] += Amplitude * FMath::Lerp(Bottom, Top, TZ);
+				}
+			}
+		}
+
+		Spacing = FMath::Max(Spacing * 0.5f, 1.0f);
+		Amplitude *= 0.5f;
+	}
+}
+
+FVector FScalarField3D::GetGradient(int32 X, int32 Y, int32 Z) const
+{
+	int32 X0 = FMath::Max(X - 1, 0), X1 = FMath::Min(X + 1, SizeX);
+	int32 Y0 = FMath::Max(Y - 1, 0), Y1 = FMath::Min(Y + 1, SizeY);
+	int32 Z0 = FMath::Max(Z - 1, 0), Z1 = FMath::Min(Z + 1, SizeZ);
+	return FVector(
+		(Get(X1, Y, Z) - Get(X0, Y, Z)) / (float)(X1 - X0),
+		(Get(X, Y1, Z) - Get(X, Y0, Z)) / (float)(Y1 - Y0),
+		(Get(X, Y, Z1) - Get(X, Y, Z0)) / (float)(Z1 - Z0));
+}
+
+// -------------------------------------------------------
+// Polygoniser
+
+void FMarchingCubes::PolygoniseChunk(const FScalarField3D& Field, const FIntVector& ChunkMin, const FIntVector& ChunkMax, const FVector& Origin, float CellSize, float IsoLevel, FProceduralMeshData& MeshData, TArray<int32>& EdgeCache)
+{
+	using namespace MarchingCubes;
+
+	// One cache slot per grid point and axis, holding the vertex on the edge that starts at that point
+	const int32 PointsX = ChunkMax.X - ChunkMin.X + 1;
+	const int32 PointsY = ChunkMax.Y - ChunkMin.Y + 1;
+	const int32 PointsZ = ChunkMax.Z - ChunkMin.Z + 1;
+	EdgeCache.Init(INDEX_NONE, PointsX * PointsY * PointsZ * 3);
+	MeshData.Reset();
+
+	for (int32 Z = ChunkMin.Z; Z < ChunkMax.Z; Z++)
+	{
+		for (int32 Y = ChunkMin.Y; Y < ChunkMax.Y; Y++)
+		{
+			for (int32 X = ChunkMin.X; X < ChunkMax.X; X++)
+			{
+				// -------------------------------------------------------
+				// Each inside corner sets one bit of the case index
+				float CornerValues[8];
+				int32 Case = 0;
+				for (int32 Corner = 0; Corner < 8; Corner++)
+				{
+					CornerValues[Corner] = Field.Get(X + CornerOffsets[Corner][0], Y + CornerOffsets[Corner][1], Z + CornerOffsets[Corner][2]);
+					if (CornerValues[Corner] > IsoLevel)
+					{
+						Case |= 1 << Corner;
+					}
+				}
+
+				// Nothing to draw for cells that are entirely inside or outside
+				if (Case == 0 || Case == 255)
+				{
+					continue;
+				}
+
+				for (int32 Index = 0; Index < CaseTable.NumIndexes[Case]; Index++)
+				{
+					const int32 Edge = CaseTable.Triangles[Case][Index];
+					const int32* EdgeOrigin = CaseTable.EdgeOrigin[Edge];
+					const int32 CacheIndex = ((X - ChunkMin.X + EdgeOrigin[0]) + PointsX * ((Y - ChunkMin.Y + EdgeOrigin[1]) + PointsY * (Z - ChunkMin.Z + EdgeOrigin[2]))) * 3 + CaseTable.EdgeAxis[Edge];
+
+					int32& VertexIndex = EdgeCache[CacheIndex];
+					if (VertexIndex == INDEX_NONE)
+					{
+						// -------------------------------------------------------
+						// First time we see this edge, place a vertex where the field crosses the iso level
+						const int32 CornerA = EdgeCorners[Edge][0];
+						const int32 CornerB = EdgeCorners[Edge][1];
+						const FIntVector PointA(X + CornerOffsets[CornerA][0], Y + CornerOffsets[CornerA][1], Z + CornerOffsets[CornerA][2]);
+						const FIntVector PointB(X + CornerOffsets[CornerB][0], Y + CornerOffsets[CornerB][1], Z + CornerOffsets[CornerB][2]);
+
+						const float ValueDelta = CornerValues[CornerB] - CornerValues[CornerA];
+						const float Alpha = FMath::Abs(ValueDelta) > SMALL_NUMBER ? FMath::Clamp((IsoLevel - CornerValues[CornerA]) / ValueDelta, 0.0f, 1.0f) : 0.5f;
+						const FVector Position = FMath::Lerp(FVector(PointA.X, PointA.Y, PointA.Z), FVector(PointB.X, PointB.Y, PointB.Z), Alpha);
+
+						// The field grows towards the inside, so the normal points down the gradient
+						FVector Normal = -FMath::Lerp(Field.GetGradient(PointA.X, PointA.Y, PointA.Z), Field.GetGradient(PointB.X, PointB.Y, PointB.Z), Alpha).GetSafeNormal();
+						FVector Tangent = FVector::CrossProduct(Normal, FVector::UpVector);
+						Tangent = Tangent.IsNearlyZero() ? FVector::ForwardVector : Tangent.GetSafeNormal();
+
+						VertexIndex = MeshData.Vertices.Add(Origin + Position * CellSize);
+						MeshData.Normals.Add(Normal);
+						MeshData.Tangents.Add(FProcMeshTangent(Tangent, false));
+						// Planar mapping from above, the texture repeats every 16 cells
+						MeshData.UVs.Add(FVector2D(Position.X, Position.Y) / 16.0f);
+					}
+
+					MeshData.Triangles.Add(VertexIndex);
+				}
+			}
+		}
+	}
+}
+
+void FMarchingCubes::RunBenchmark(const TArray<FString>& Args)
+{
+	// Usage: ProceduralMeshes.BenchmarkMarchingCubes [ChunkSize] [ChunksPerAxis]
+	const int32 ChunkSize = Args.Num() > 0 ? FMath::Max(2, FCString::Atoi(*Args[0])) : 16;
+	const int32 ChunksPerAxis = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 4;
+	const int32 NumChunks = ChunksPerAxis * ChunksPerAxis * ChunksPerAxis;
+
+	FRandomStream RngStream(1238);
+	FScalarField3D Field;
+	Field.Init(ChunkSize * ChunksPerAxis, ChunkSize * ChunksPerAxis, ChunkSize * ChunksPerAxis);
+	Field.FillWithValueNoise(RngStream, ChunkSize, 3, 0.5f, 2.0f);
+
+	UE_LOG(LogProceduralMeshes, Log, TEXT("Marching cubes benchmark, %d chunks of %d^3 cells"), NumChunks, ChunkSize);
+
+	// Both passes write into the same chunk buffers and give every chunk its own edge cache, so neither pays for allocations the other doesn't
+	TArray<FProceduralMeshData> ChunkMeshData;
+	ChunkMeshData.AddDefaulted(NumChunks);
+	TArray<TArray<int32>> EdgeCaches;
+	EdgeCaches.AddDefaulted(NumChunks);
+
+	auto BuildChunk = [&](int32 ChunkIndex)
+	{
+		FIntVector ChunkMin(ChunkIndex % ChunksPerAxis, (ChunkIndex / ChunksPerAxis) % ChunksPerAxis, ChunkIndex / (ChunksPerAxis * ChunksPerAxis));
+		ChunkMin = ChunkMin * ChunkSize;
+		FIntVector ChunkMax = ChunkMin + FIntVector(ChunkSize, ChunkSize, ChunkSize);
+		PolygoniseChunk(Field, ChunkMin, ChunkMax, FVector::ZeroVector, 1.0f, 0.0f, ChunkMeshData[ChunkIndex], EdgeCaches[ChunkIndex]);
+	};
+
+	auto RunPass = [&](bool bParallel) -> double
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		if (bParallel)
+		{
+			FProceduralMeshThreading::ParallelFor(NumChunks, BuildChunk);
+		}
+		else
+		{
+			for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ChunkIndex++)
+			{
+				BuildChunk(ChunkIndex);
+			}
+		}
+		return FMath::Max(FPlatformTime::Seconds() - StartTime, 1e-9);
+	};
+
+	// Untimed runs of both grow the buffers to size and wake up the worker threads
+	RunPass(false);
+	RunPass(true);
+
+	for (int32 Pass = 0; Pass < 2; Pass++)
+	{
+		const bool bParallel = Pass == 1;
+		const double Seconds = RunPass(bParallel);
+
+		int32 NumTriangles = 0;
+		for (const FProceduralMeshData& MeshData : ChunkMeshData)
+		{
+			NumTriangles += MeshData.Triangles.Num() / 3;
+		}
+
+		UE_LOG(LogProceduralMeshes, Log, TEXT("%s: %.1f chunks/s, %d triangles in %.2f ms"),
+			bParallel ? TEXT("ParallelFor    ") : TEXT("Single threaded"), NumChunks / Seconds, NumTriangles, Seconds * 1000.0);
+	}
+}
+
+static FAutoConsoleCommand BenchmarkMarchingCubesCommand(
+	TEXT("ProceduralMeshes.BenchmarkMarchingCubes"),
+	TEXT("Measures chunks/sec for the marching cubes polygoniser. Optional arguments: cells per chunk side, chunks per axis."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&FMarchingCubes::RunBenchmark));
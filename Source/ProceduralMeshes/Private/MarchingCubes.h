@@ -0,0 +1,43 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Scalar field and marching cubes polygoniser used by the isosurface actor
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshData.h"
+
+// A scalar value at every corner of a grid of SizeX * SizeY * SizeZ cells. Positive values are inside the surface.
+struct PROCEDURALMESHES_API FScalarField3D
+{
+	int32 SizeX;
+	int32 SizeY;
+	int32 SizeZ;
+	TArray<float> Values;
+
+	FScalarField3D()
+		: SizeX(0), SizeY(0), SizeZ(0)
+	{
+	}
+
+	void Init(int32 InSizeX, int32 InSizeY, int32 InSizeZ);
+
+	// Layered value noise built from FRandomStream, plus a vertical falloff so there is ground below SurfaceHeight (0-1) and air above it.
+	// The noise lets the surface fold over itself, so unlike a heightfield we get overhangs and caves.
+	void FillWithValueNoise(FRandomStream& RngStream, float NoiseScale, int32 Octaves, float SurfaceHeight, float GroundBias);
+
+	FORCEINLINE int32 GetIndex(int32 X, int32 Y, int32 Z) const { return X + (SizeX + 1) * (Y + (SizeY + 1) * Z); }
+	FORCEINLINE float Get(int32 X, int32 Y, int32 Z) const { return Values[GetIndex(X, Y, Z)]; }
+
+	// Central difference, one sided along the edges of the field
+	FVector GetGradient(int32 X, int32 Y, int32 Z) const;
+};
+
+struct PROCEDURALMESHES_API FMarchingCubes
+{
+	// Polygonises the cells from ChunkMin up to (but not including) ChunkMax into MeshData.
+	// Vertices on cell edges are shared through EdgeCache, which is only scratch memory and can be reused between calls.
+	static void PolygoniseChunk(const FScalarField3D& Field, const FIntVector& ChunkMin, const FIntVector& ChunkMax, const FVector& Origin, float CellSize, float IsoLevel, FProceduralMeshData& MeshData, TArray<int32>& EdgeCache);
+
+	// Logs chunks/sec for a noise field, single threaded and with ParallelFor
+	static void RunBenchmark(const TArray<FString>& Args);
+};
@@ -0,0 +1,218 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Example isosurface of a 3d noise field, polygonised with marching cubes
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "MarchingCubesActor.h"
+#include "ProceduralMeshThreading.h"
+#include "VertexCacheOptimizer.h"
+#include "ProceduralMeshStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Marching cubes"), STAT_GenerateMarchingCubes, STATGROUP_ProceduralMeshes);
+
+AMarchingCubesActor::AMarchingCubesActor()
+{
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootScene"));
+	ProcMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("ProceduralMesh"));
+	ProcMesh->AttachTo(RootComponent);
+	// Make sure the PMC doesnt save any mesh data with the map
+	ProcMesh->SetFlags(EObjectFlags::RF_Transient);
+}
+
+#if WITH_EDITOR
+void AMarchingCubesActor::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+	GenerateMesh();
+}
+#endif // WITH_EDITOR
+
+void AMarchingCubesActor::BeginPlay()
+{
+	Super::BeginPlay();
+	GenerateMesh();
+
+	// Fix for PCM location/rotation/scale since the whole component is Transient
+	ProcMesh->SetWorldLocation(this->GetActorLocation());
+	ProcMesh->SetWorldRotation(this->GetActorRotation());
+	ProcMesh->SetWorldScale3D(this->GetActorScale3D());
+}
+
+void AMarchingCubesActor::GenerateMesh()
+{
+	FProceduralMeshGenerationScope GenerationScope(this, GET_STATID(STAT_GenerateMarchingCubes));
+
+	// -------------------------------------------------------
+	// Setup the random number generator and fill the field with noise
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshStructure);
+		RngStream = FRandomStream::FRandomStream(RandomSeed);
+		Field.Init(SizeX, SizeY, SizeZ);
+		Field.FillWithValueNoise(RngStream, NoiseScale, NoiseOctaves, FMath::Clamp(SurfaceHeightPercentage, 0.0f, 100.0f) / 100.0f, GroundBias);
+	}
+
+	// -------------------------------------------------------
+	// Every chunk needs to be built the first time
+	ChunkLayoutSize = FMath::Max(1, ChunkSize);
+	NumChunks = FIntVector(FMath::DivideAndRoundUp(Field.SizeX, ChunkLayoutSize), FMath::DivideAndRoundUp(Field.SizeY, ChunkLayoutSize), FMath::DivideAndRoundUp(Field.SizeZ, ChunkLayoutSize));
+	DirtyChunks.Init(true, NumChunks.X * NumChunks.Y * NumChunks.Z);
+	ChunkTriangleCounts.Init(0, DirtyChunks.Num());
+
+	ProcMesh->ClearAllMeshSections();
+	RebuildDirtyChunks();
+}
+
+void AMarchingCubesActor::AddSphereToField(FVector Center, float Radius, float Strength)
+{
+	if (Field.Values.Num() == 0 || Radius <= 0)
+	{
+		return;
+	}
+
+	// -------------------------------------------------------
+	// Change every grid point inside the sphere
+	FVector FieldCenter = (Center - GetFieldOrigin()) / CellSize;
+	float FieldRadius = Radius / CellSize;
+	FIntVector MinPoint(
+		FMath::Max(FMath::FloorToInt(FieldCenter.X - FieldRadius), 0),
+		FMath::Max(FMath::FloorToInt(FieldCenter.Y - FieldRadius), 0),
+		FMath::Max(FMath::FloorToInt(FieldCenter.Z - FieldRadius), 0));
+	FIntVector MaxPoint(
+		FMath::Min(FMath::CeilToInt(FieldCenter.X + FieldRadius), Field.SizeX),
+		FMath::Min(FMath::CeilToInt(FieldCenter.Y + FieldRadius), Field.SizeY),
+		FMath::Min(FMath::CeilToInt(FieldCenter.Z + FieldRadius), Field.SizeZ));
+
+	if (MinPoint.X > MaxPoint.X || MinPoint.Y > MaxPoint.Y || MinPoint.Z > MaxPoint.Z)
+	{
+		return;
+	}
+
+	for (int32 Z = MinPoint.Z; Z <= MaxPoint.Z; Z++)
+	{
+		for (int32 Y = MinPoint.Y; Y <= MaxPoint.Y; Y++)
+		{
+			for (int32 X = MinPoint.X; X <= MaxPoint.X; X++)
+			{
+				float Distance = FVector::Dist(FVector(X, Y, Z), FieldCenter);
+				if (Distance < FieldRadius)
+				{
+					Field.Values[Field.GetIndex(X, Y, Z)] += Strength * (1.0f - Distance / FieldRadius);
+				}
+			}
+		}
+	}
+
+	MarkChunksDirty(MinPoint, MaxPoint);
+	RebuildDirtyChunks();
+}
+
+void AMarchingCubesActor::MarkChunksDirty(const FIntVector& MinPoint, const FIntVector& MaxPoint)
+{
+	// A grid point is a corner of the cells on both sides of it, and the normals also read one point further out
+	FIntVector MinChunk(
+		FMath::Max(MinPoint.X - 2, 0) / ChunkLayoutSize,
+		FMath::Max(MinPoint.Y - 2, 0) / ChunkLayoutSize,
+		FMath::Max(MinPoint.Z - 2, 0) / ChunkLayoutSize);
+	FIntVector MaxChunk(
+		FMath::Min((MaxPoint.X + 1) / ChunkLayoutSize, NumChunks.X - 1),
+		FMath::Min((MaxPoint.Y + 1) / ChunkLayoutSize, NumChunks.Y - 1),
+		FMath::Min((MaxPoint.Z + 1) / ChunkLayoutSize, NumChunks.Z - 1));
+
+	for (int32 Z = MinChunk.Z; Z <= MaxChunk.Z; Z++)
+	{
+		for (int32 Y = MinChunk.Y; Y <= MaxChunk.Y; Y++)
+		{
+			for (int32 X = MinChunk.X; X <= MaxChunk.X; X++)
+			{
+				DirtyChunks[X + NumChunks.X * (Y + NumChunks.Y * Z)] = true;
+			}
+		}
+	}
+}
+
+void AMarchingCubesActor::RebuildDirtyChunks()
+{
+	TArray<int32> ChunksToBuild;
+	for (int32 ChunkIndex = 0; ChunkIndex < DirtyChunks.Num(); ChunkIndex++)
+	{
+		if (DirtyChunks[ChunkIndex])
+		{
+			ChunksToBuild.Add(ChunkIndex);
+		}
+	}
+
+	// -------------------------------------------------------
+	// Chunks only read the field and write their own mesh data, so they can all be polygonised at the same time
+	TArray<FProceduralMeshData> ChunkMeshData;
+	TArray<FVertexCacheStats> ChunkCacheStats;
+	ChunkMeshData.AddDefaulted(ChunksToBuild.Num());
+	ChunkCacheStats.AddDefaulted(ChunksToBuild.Num());
+	const FVector FieldOrigin = GetFieldOrigin();
+
+	FProceduralMeshThreading::ParallelFor(ChunksToBuild.Num(), [this, &ChunksToBuild, &ChunkMeshData, &ChunkCacheStats, &FieldOrigin](int32 BuildIndex)
+	{
+		int32 ChunkIndex = ChunksToBuild[BuildIndex];
+		FIntVector ChunkMin(ChunkIndex % NumChunks.X, (ChunkIndex / NumChunks.X) % NumChunks.Y, ChunkIndex / (NumChunks.X * NumChunks.Y));
+		ChunkMin = ChunkMin * ChunkLayoutSize;
+		FIntVector ChunkMax(FMath::Min(ChunkMin.X + ChunkLayoutSize, Field.SizeX), FMath::Min(ChunkMin.Y + ChunkLayoutSize, Field.SizeY), FMath::Min(ChunkMin.Z + ChunkLayoutSize, Field.SizeZ));
+
+		// The class counter is opened again so the chunks built on other threads still count as this generator's
+		SCOPE_CYCLE_COUNTER(STAT_GenerateMarchingCubes);
+		{
+			SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshVertexFill);
+			TArray<int32> EdgeCache;
+			FMarchingCubes::PolygoniseChunk(Field, ChunkMin, ChunkMax, FieldOrigin, CellSize, 0.0f, ChunkMeshData[BuildIndex], EdgeCache);
+			ChunkTriangleCounts[ChunkIndex] = ChunkMeshData[BuildIndex].Triangles.Num() / 3;
+		}
+
+		// The edge cache already shares vertices, this just draws them in a cache friendly order
+		if (bOptimizeVertexCache)
+		{
+			SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshOptimization);
+			ChunkCacheStats[BuildIndex] = FVertexCacheOptimizer::Optimize(ChunkMeshData[BuildIndex]);
+		}
+	});
+
+	// The component can only be updated from the game thread
+	SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshUpload);
+	int32 BuiltTriangleCount = 0;
+	float MissesBefore = 0.0f;
+	float MissesAfter = 0.0f;
+	for (int32 BuildIndex = 0; BuildIndex < ChunksToBuild.Num(); BuildIndex++)
+	{
+		int32 ChunkIndex = ChunksToBuild[BuildIndex];
+		const FProceduralMeshData& MeshData = ChunkMeshData[BuildIndex];
+		BuiltTriangleCount += ChunkTriangleCounts[ChunkIndex];
+		MissesBefore += ChunkCacheStats[BuildIndex].ACMRBefore * ChunkTriangleCounts[ChunkIndex];
+		MissesAfter += ChunkCacheStats[BuildIndex].ACMRAfter * ChunkTriangleCounts[ChunkIndex];
+		if (MeshData.Triangles.Num() == 0)
+		{
+			ProcMesh->ClearMeshSection(ChunkIndex);
+		}
+		else
+		{
+			FProceduralMeshStats::CountUpload(MeshData);
+			ProcMesh->CreateMeshSection(ChunkIndex, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, false);
+			ProcMesh->SetMaterial(ChunkIndex, Material);
+		}
+		DirtyChunks[ChunkIndex] = false;
+	}
+
+	GeneratedTriangleCount = 0;
+	for (int32 TriangleCount : ChunkTriangleCounts)
+	{
+		GeneratedTriangleCount += TriangleCount;
+	}
+
+	if (bOptimizeVertexCache && BuiltTriangleCount > 0)
+	{
+		ACMRBefore = MissesBefore / BuiltTriangleCount;
+		ACMRAfter = MissesAfter / BuiltTriangleCount;
+		UE_LOG(LogProceduralMeshes, Verbose, TEXT("%s: vertex cache ACMR %.3f -> %.3f over %d rebuilt chunks"), *GetName(), ACMRBefore, ACMRAfter, ChunksToBuild.Num());
+	}
+}
+
+FVector AMarchingCubesActor::GetFieldOrigin() const
+{
+	// Center the field on the actor in X and Y, with the bottom of it at the actor location
+	return FVector(Field.SizeX * CellSize * -0.5f, Field.SizeY * CellSize * -0.5f, 0.0f);
+}
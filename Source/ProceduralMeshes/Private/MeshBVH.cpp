@@ -0,0 +1,581 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Bounding volume hierarchy over generated triangles for raycasts and overlap queries
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "MeshBVH.h"
+#include "ProceduralMeshThreading.h"
+
+namespace MeshBVH
+{
+	const int32 NumBins = 16;
+
+	// Nodes with this many triangles or fewer can become leaves, bigger ones are always split
+	const int32 MaxLeafTriangles = 8;
+
+	// Cost of visiting a node relative to testing a triangle
+	const float TraversalCost = 1.0f;
+
+	// Levels split on the calling thread before the subtrees are handed out, which gives up to 2^ParallelDepth subtrees
+	const int32 ParallelDepth = 5;
+
+	// Not worth a task of its own below this
+	const int32 MinParallelTriangles = 1024;
+
+	const int32 TrianglesPerTask = 2048;
+
+	float HalfSurfaceArea(const FVector& Min, const FVector& Max)
+	{
+		const FVector Size = Max - Min;
+		return Size.X * Size.Y + Size.Y * Size.Z + Size.Z * Size.X;
+	}
+
+	// Slab test, OutEntry is where the ray enters the box (0 if it starts inside)
+	bool IntersectBox(const FVector& Min, const FVector& Max, const FVector& Start, const FVector& InverseDirection, float MaxDistance, float& OutEntry)
+	{
+		const FVector T1 = (Min - Start) * InverseDirection;
+		const FVector T2 = (Max - Start) * InverseDirection;
+		const float Entry = FMath::Max(FMath::Max(FMath::Min(T1.X, T2.X), FMath::Min(T1.Y, T2.Y)), FMath::Max(FMath::Min(T1.Z, T2.Z), 0.0f));
+		const float Exit = FMath::Min(FMath::Min(FMath::Max(T1.X, T2.X), FMath::Max(T1.Y, T2.Y)), FMath::Min(FMath::Max(T1.Z, T2.Z), MaxDistance));
+		OutEntry = Entry;
+		return Entry <= Exit;
+	}
+
+	// Runs Function over [0, Num) in blocks of TrianglesPerTask
+	template<typename FunctionType>
+	void ParallelForBlocks(int32 Num, const FunctionType& Function)
+	{
+		const int32 NumTasks = FMath::DivideAndRoundUp(Num, TrianglesPerTask);
+		FProceduralMeshThreading::ParallelFor(NumTasks, [&Function, Num](int32 TaskIndex)
+		{
+			const int32 End = FMath::Min((TaskIndex + 1) * TrianglesPerTask, Num);
+			for (int32 Index = TaskIndex * TrianglesPerTask; Index < End; Index++)
+			{
+				Function(Index);
+			}
+		}, NumTasks < 2);
+	}
+}
+
+FMeshBVH::FMeshBVH()
+{
+}
+
+void FMeshBVH::Reset()
+{
+	Vertices.Empty();
+	Triangles.Empty();
+	Nodes.Empty();
+	TriangleOrder.Empty();
+}
+
+void FMeshBVH::Build(const FProceduralMeshData& MeshData)
+{
+	Reset();
+
+	const int32 NumTriangles = MeshData.Triangles.Num() / 3;
+	for (int32 VertexIndex : MeshData.Triangles)
+	{
+		if (VertexIndex < 0 || VertexIndex >= MeshData.Vertices.Num())
+		{
+			return;
+		}
+	}
+
+	if (NumTriangles == 0)
+	{
+		return;
+	}
+
+	Vertices = MeshData.Vertices;
+	Triangles = MeshData.Triangles;
+	Triangles.SetNum(NumTriangles * 3);
+
+	// -------------------------------------------------------
+	// Bounds and centers of every triangle, these are all the build looks at
+	TriangleMins.SetNumUninitialized(NumTriangles);
+	TriangleMaxs.SetNumUninitialized(NumTriangles);
+	TriangleCenters.SetNumUninitialized(NumTriangles);
+	TriangleOrder.SetNumUninitialized(NumTriangles);
+	MeshBVH::ParallelForBlocks(NumTriangles, [this](int32 TriangleIndex)
+	{
+		UpdateTriangleBounds(TriangleIndex);
+		TriangleOrder[TriangleIndex] = TriangleIndex;
+	});
+
+	// -------------------------------------------------------
+	// Split the top of the tree here, then build the subtrees below it at the same time. Each one has its own part of TriangleOrder.
+	TArray<FBuildRange> PendingRanges;
+	Nodes.AddUninitialized(1);
+	FBuildRange Root = { 0, 0, NumTriangles, 0 };
+	BuildSubtree(Nodes, Root, &PendingRanges);
+
+	TArray<TArray<FNode>> SubtreeNodes;
+	SubtreeNodes.SetNum(PendingRanges.Num());
+	FProceduralMeshThreading::ParallelFor(PendingRanges.Num(), [this, &PendingRanges, &SubtreeNodes](int32 SubtreeIndex)
+	{
+		FBuildRange Range = PendingRanges[SubtreeIndex];
+		Range.NodeIndex = 0;
+		SubtreeNodes[SubtreeIndex].AddUninitialized(1);
+		BuildSubtree(SubtreeNodes[SubtreeIndex], Range, nullptr);
+	});
+
+	// -------------------------------------------------------
+	// Move the subtrees into the main array. Their roots go where the top of the tree left room for them, the rest is appended.
+	for (int32 SubtreeIndex = 0; SubtreeIndex < PendingRanges.Num(); SubtreeIndex++)
+	{
+		const TArray<FNode>& Subtree = SubtreeNodes[SubtreeIndex];
+		const int32 FirstNode = Nodes.Num() - 1;
+		for (int32 NodeIndex = 0; NodeIndex < Subtree.Num(); NodeIndex++)
+		{
+			FNode Node = Subtree[NodeIndex];
+			if (Node.NumTriangles == 0)
+			{
+				Node.Index += FirstNode;
+			}
+
+			if (NodeIndex == 0)
+			{
+				Nodes[PendingRanges[SubtreeIndex].NodeIndex] = Node;
+			}
+			else
+			{
+				Nodes.Add(Node);
+			}
+		}
+	}
+
+	TriangleMins.Empty();
+	TriangleMaxs.Empty();
+	TriangleCenters.Empty();
+}
+
+void FMeshBVH::BuildSubtree(TArray<FNode>& OutNodes, const FBuildRange& Range, TArray<FBuildRange>* OutPending)
+{
+	// Uses our own stack, very uneven splits could otherwise run out of call stack on large meshes
+	TArray<FBuildRange> Stack;
+	Stack.Add(Range);
+
+	while (Stack.Num() > 0)
+	{
+		const FBuildRange Current = Stack.Pop(false);
+		if (OutPending && Current.Depth >= MeshBVH::ParallelDepth && Current.End - Current.Begin >= MeshBVH::MinParallelTriangles)
+		{
+			OutPending->Add(Current);
+			continue;
+		}
+
+		FNode& Node = OutNodes[Current.NodeIndex];
+		UpdateNodeBounds(Node, Current.Begin, Current.End);
+		Node.Index = Current.Begin;
+		Node.NumTriangles = Current.End - Current.Begin;
+
+		int32 Middle;
+		if (!FindSplit(Node, Current.Begin, Current.End, Middle))
+		{
+			continue;
+		}
+
+		const int32 FirstChild = OutNodes.AddUninitialized(2);
+		OutNodes[Current.NodeIndex].Index = FirstChild;
+		OutNodes[Current.NodeIndex].NumTriangles = 0;
+
+		FBuildRange Left = { FirstChild, Current.Begin, Middle, Current.Depth + 1 };
+		FBuildRange Right = { FirstChild + 1, Middle, Current.End, Current.Depth + 1 };
+		Stack.Add(Right);
+		Stack.Add(Left);
+	}
+}
+
+bool FMeshBVH::FindSplit(const FNode& Node, int32 Begin, int32 End, int32& OutMiddle)
+{
+	const int32 NumTriangles = End - Begin;
+	if (NumTriangles <= 1)
+	{
+		return false;
+	}
+
+	// -------------------------------------------------------
+	// Split along the axis the triangle centers are most spread out on
+	FVector CenterMin = TriangleCenters[TriangleOrder[Begin]];
+	FVector CenterMax = CenterMin;
+	for (int32 Position = Begin + 1; Position < End; Position++)
+	{
+		CenterMin = CenterMin.ComponentMin(TriangleCenters[TriangleOrder[Position]]);
+		CenterMax = CenterMax.ComponentMax(TriangleCenters[TriangleOrder[Position]]);
+	}
+
+	const FVector CenterExtent = CenterMax - CenterMin;
+	const int32 Axis = CenterExtent.X >= CenterExtent.Y ? (CenterExtent.X >= CenterExtent.Z ? 0 : 2) : (CenterExtent.Y >= CenterExtent.Z ? 1 : 2);
+	if (CenterExtent[Axis] <= KINDA_SMALL_NUMBER)
+	{
+		// All the centers are in the same place, there is nothing to gain from splitting other than keeping the leaves small
+		OutMiddle = (Begin + End) / 2;
+		return NumTriangles > MeshBVH::MaxLeafTriangles;
+	}
+
+	// -------------------------------------------------------
+	// Drop the triangles into bins by their center
+	struct FBin
+	{
+		FVector Min;
+		FVector Max;
+		int32 Count;
+	};
+
+	FBin Bins[MeshBVH::NumBins];
+	for (FBin& Bin : Bins)
+	{
+		Bin.Min = FVector(MAX_flt, MAX_flt, MAX_flt);
+		Bin.Max = FVector(-MAX_flt, -MAX_flt, -MAX_flt);
+		Bin.Count = 0;
+	}
+
+	const float BinScale = MeshBVH::NumBins / CenterExtent[Axis];
+	auto GetBin = [&](int32 TriangleIndex)
+	{
+		return FMath::Min((int32)((TriangleCenters[TriangleIndex][Axis] - CenterMin[Axis]) * BinScale), MeshBVH::NumBins - 1);
+	};
+
+	for (int32 Position = Begin; Position < End; Position++)
+	{
+		const int32 TriangleIndex = TriangleOrder[Position];
+		FBin& Bin = Bins[GetBin(TriangleIndex)];
+		Bin.Min = Bin.Min.ComponentMin(TriangleMins[TriangleIndex]);
+		Bin.Max = Bin.Max.ComponentMax(TriangleMaxs[TriangleIndex]);
+		Bin.Count++;
+	}
+
+	// -------------------------------------------------------
+	// Sweep from the right to get the cost of everything after each split, then from the left to find the cheapest one
+	float RightAreas[MeshBVH::NumBins];
+	int32 RightCounts[MeshBVH::NumBins];
+	FVector SweepMin = FVector(MAX_flt, MAX_flt, MAX_flt);
+	FVector SweepMax = FVector(-MAX_flt, -MAX_flt, -MAX_flt);
+	int32 SweepCount = 0;
+	for (int32 BinIndex = MeshBVH::NumBins - 1; BinIndex > 0; BinIndex--)
+	{
+		SweepMin = SweepMin.ComponentMin(Bins[BinIndex].Min);
+		SweepMax = SweepMax.ComponentMax(Bins[BinIndex].Max);
+		SweepCount += Bins[BinIndex].Count;
+		RightAreas[BinIndex] = SweepCount > 0 ? MeshBVH::HalfSurfaceArea(SweepMin, SweepMax) : 0.0f;
+		RightCounts[BinIndex] = SweepCount;
+	}
+
+	SweepMin = FVector(MAX_flt, MAX_flt, MAX_flt);
+	SweepMax = FVector(-MAX_flt, -MAX_flt, -MAX_flt);
+	SweepCount = 0;
+	float BestCost = MAX_flt;
+	int32 BestBin = INDEX_NONE;
+	for (int32 BinIndex = 0; BinIndex < MeshBVH::NumBins - 1; BinIndex++)
+	{
+		SweepMin = SweepMin.ComponentMin(Bins[BinIndex].Min);
+		SweepMax = SweepMax.ComponentMax(Bins[BinIndex].Max);
+		SweepCount += Bins[BinIndex].Count;
+		if (SweepCount == 0 || RightCounts[BinIndex + 1] == 0)
+		{
+			continue;
+		}
+
+		const float Cost = MeshBVH::HalfSurfaceArea(SweepMin, SweepMax) * SweepCount + RightAreas[BinIndex + 1] * RightCounts[BinIndex + 1];
+		if (Cost < BestCost)
+		{
+			BestCost = Cost;
+			BestBin = BinIndex;
+		}
+	}
+
+	// Keep it as a leaf if testing all its triangles is cheaper than visiting two children
+	const float NodeArea = FMath::Max(MeshBVH::HalfSurfaceArea(Node.Min, Node.Max), SMALL_NUMBER);
+	const float SplitCost = MeshBVH::TraversalCost + BestCost / NodeArea;
+	if (BestBin == INDEX_NONE || (SplitCost >= NumTriangles && NumTriangles <= MeshBVH::MaxLeafTriangles))
+	{
+		return false;
+	}
+
+	// -------------------------------------------------------
+	// Move the triangles on the left of the split to the front of the range
+	int32 Left = Begin;
+	int32 Right = End - 1;
+	while (Left <= Right)
+	{
+		if (GetBin(TriangleOrder[Left]) <= BestBin)
+		{
+			Left++;
+		}
+		else
+		{
+			Swap(TriangleOrder[Left], TriangleOrder[Right]);
+			Right--;
+		}
+	}
+
+	OutMiddle = Left;
+	return true;
+}
+
+void FMeshBVH::UpdateNodeBounds(FNode& Node, int32 Begin, int32 End) const
+{
+	Node.Min = TriangleMins[TriangleOrder[Begin]];
+	Node.Max = TriangleMaxs[TriangleOrder[Begin]];
+	for (int32 Position = Begin + 1; Position < End; Position++)
+	{
+		Node.Min = Node.Min.ComponentMin(TriangleMins[TriangleOrder[Position]]);
+		Node.Max = Node.Max.ComponentMax(TriangleMaxs[TriangleOrder[Position]]);
+	}
+}
+
+void FMeshBVH::UpdateTriangleBounds(int32 TriangleIndex)
+{
+	const FVector& A = Vertices[Triangles[TriangleIndex * 3]];
+	const FVector& B = Vertices[Triangles[TriangleIndex * 3 + 1]];
+	const FVector& C = Vertices[Triangles[TriangleIndex * 3 + 2]];
+	TriangleMins[TriangleIndex] = A.ComponentMin(B).ComponentMin(C);
+	TriangleMaxs[TriangleIndex] = A.ComponentMax(B).ComponentMax(C);
+	TriangleCenters[TriangleIndex] = (TriangleMins[TriangleIndex] + TriangleMaxs[TriangleIndex]) * 0.5f;
+}
+
+void FMeshBVH::Refit(const TArray<FVector>& NewVertices)
+{
+	if (!IsBuilt() || NewVertices.Num() != Vertices.Num())
+	{
+		return;
+	}
+
+	Vertices = NewVertices;
+
+	// -------------------------------------------------------
+	// Leaves only depend on their own triangles, so they can all be done at once
+	MeshBVH::ParallelForBlocks(Nodes.Num(), [this](int32 NodeIndex)
+	{
+		FNode& Node = Nodes[NodeIndex];
+		if (Node.NumTriangles == 0)
+		{
+			return;
+		}
+
+		Node.Min = FVector(MAX_flt, MAX_flt, MAX_flt);
+		Node.Max = FVector(-MAX_flt, -MAX_flt, -MAX_flt);
+		for (int32 Position = Node.Index; Position < Node.Index + Node.NumTriangles; Position++)
+		{
+			const int32 TriangleIndex = TriangleOrder[Position];
+			for (int32 Corner = 0; Corner < 3; Corner++)
+			{
+				const FVector& Vertex = Vertices[Triangles[TriangleIndex * 3 + Corner]];
+				Node.Min = Node.Min.ComponentMin(Vertex);
+				Node.Max = Node.Max.ComponentMax(Vertex);
+			}
+		}
+	});
+
+	// Children always come after their parent, so going backwards every child is done before its parent
+	for (int32 NodeIndex = Nodes.Num() - 1; NodeIndex >= 0; NodeIndex--)
+	{
+		FNode& Node = Nodes[NodeIndex];
+		if (Node.NumTriangles == 0)
+		{
+			const FNode& Left = Nodes[Node.Index];
+			const FNode& Right = Nodes[Node.Index + 1];
+			Node.Min = Left.Min.ComponentMin(Right.Min);
+			Node.Max = Left.Max.ComponentMax(Right.Max);
+		}
+	}
+}
+
+bool FMeshBVH::Raycast(const FVector& Start, const FVector& End, FMeshBVHHit& OutHit) const
+{
+	FVector Direction = End - Start;
+	float BestDistance = Direction.Size();
+	if (!IsBuilt() || BestDistance <= SMALL_NUMBER)
+	{
+		return false;
+	}
+
+	Direction /= BestDistance;
+	const FVector InverseDirection = FVector(1.0f / Direction.X, 1.0f / Direction.Y, 1.0f / Direction.Z);
+	int32 HitTriangle = INDEX_NONE;
+
+	// -------------------------------------------------------
+	// Visit the nearer child first, and skip anything that starts further away than the closest hit so far
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(0);
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+		float Entry;
+		if (!MeshBVH::IntersectBox(Node.Min, Node.Max, Start, InverseDirection, BestDistance, Entry))
+		{
+			continue;
+		}
+
+		if (Node.NumTriangles > 0)
+		{
+			for (int32 Position = Node.Index; Position < Node.Index + Node.NumTriangles; Position++)
+			{
+				float Distance;
+				if (IntersectTriangle(TriangleOrder[Position], Start, Direction, BestDistance, Distance))
+				{
+					BestDistance = Distance;
+					HitTriangle = TriangleOrder[Position];
+				}
+			}
+			continue;
+		}
+
+		float LeftEntry, RightEntry;
+		const bool bHitLeft = MeshBVH::IntersectBox(Nodes[Node.Index].Min, Nodes[Node.Index].Max, Start, InverseDirection, BestDistance, LeftEntry);
+		const bool bHitRight = MeshBVH::IntersectBox(Nodes[Node.Index + 1].Min, Nodes[Node.Index + 1].Max, Start, InverseDirection, BestDistance, RightEntry);
+		if (bHitLeft && bHitRight)
+		{
+			const bool bLeftFirst = LeftEntry <= RightEntry;
+			Stack.Add(bLeftFirst ? Node.Index + 1 : Node.Index);
+			Stack.Add(bLeftFirst ? Node.Index : Node.Index + 1);
+		}
+		else if (bHitLeft || bHitRight)
+		{
+			Stack.Add(bHitLeft ? Node.Index : Node.Index + 1);
+		}
+	}
+
+	if (HitTriangle == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// Front faces wind clockwise, so this points out of the front
+	const FVector& A = Vertices[Triangles[HitTriangle * 3]];
+	const FVector& B = Vertices[Triangles[HitTriangle * 3 + 1]];
+	const FVector& C = Vertices[Triangles[HitTriangle * 3 + 2]];
+	OutHit.Distance = BestDistance;
+	OutHit.Location = Start + Direction * BestDistance;
+	OutHit.Normal = FVector::CrossProduct(C - A, B - A).GetSafeNormal();
+	OutHit.TriangleIndex = HitTriangle;
+	return true;
+}
+
+bool FMeshBVH::IntersectTriangle(int32 TriangleIndex, const FVector& Start, const FVector& Direction, float MaxDistance, float& OutDistance) const
+{
+	// Moller-Trumbore, hits either side
+	const FVector& A = Vertices[Triangles[TriangleIndex * 3]];
+	const FVector Edge1 = Vertices[Triangles[TriangleIndex * 3 + 1]] - A;
+	const FVector Edge2 = Vertices[Triangles[TriangleIndex * 3 + 2]] - A;
+	const FVector P = FVector::CrossProduct(Direction, Edge2);
+	const float Determinant = FVector::DotProduct(Edge1, P);
+	if (FMath::Abs(Determinant) < SMALL_NUMBER)
+	{
+		return false;
+	}
+
+	const float InverseDeterminant = 1.0f / Determinant;
+	const FVector T = Start - A;
+	const float U = FVector::DotProduct(T, P) * InverseDeterminant;
+	if (U < 0.0f || U > 1.0f)
+	{
+		return false;
+	}
+
+	const FVector Q = FVector::CrossProduct(T, Edge1);
+	const float V = FVector::DotProduct(Direction, Q) * InverseDeterminant;
+	if (V < 0.0f || U + V > 1.0f)
+	{
+		return false;
+	}
+
+	const float Distance = FVector::DotProduct(Edge2, Q) * InverseDeterminant;
+	if (Distance < 0.0f || Distance > MaxDistance)
+	{
+		return false;
+	}
+
+	OutDistance = Distance;
+	return true;
+}
+
+int32 FMeshBVH::OverlapBox(const FBox& Box, TArray<int32>& OutTriangleIndices) const
+{
+	if (!IsBuilt() || !Box.IsValid)
+	{
+		return 0;
+	}
+
+	const FVector BoxCenter = Box.GetCenter();
+	const FVector BoxExtent = Box.GetExtent();
+	const int32 NumFoundBefore = OutTriangleIndices.Num();
+
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(0);
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+		if (Node.Min.X > Box.Max.X || Node.Min.Y > Box.Max.Y || Node.Min.Z > Box.Max.Z
+			|| Node.Max.X < Box.Min.X || Node.Max.Y < Box.Min.Y || Node.Max.Z < Box.Min.Z)
+		{
+			continue;
+		}
+
+		if (Node.NumTriangles > 0)
+		{
+			for (int32 Position = Node.Index; Position < Node.Index + Node.NumTriangles; Position++)
+			{
+				if (TriangleOverlapsBox(TriangleOrder[Position], BoxCenter, BoxExtent))
+				{
+					OutTriangleIndices.Add(TriangleOrder[Position]);
+				}
+			}
+		}
+		else
+		{
+			Stack.Add(Node.Index + 1);
+			Stack.Add(Node.Index);
+		}
+	}
+
+	return OutTriangleIndices.Num() - NumFoundBefore;
+}
+
+bool FMeshBVH::TriangleOverlapsBox(int32 TriangleIndex, const FVector& BoxCenter, const FVector& BoxExtent) const
+{
+	// Separating axis test (Akenine-Moller): the box axes, the triangle normal and the cross products of their edges
+	const FVector Corners[3] =
+	{
+		Vertices[Triangles[TriangleIndex * 3]] - BoxCenter,
+		Vertices[Triangles[TriangleIndex * 3 + 1]] - BoxCenter,
+		Vertices[Triangles[TriangleIndex * 3 + 2]] - BoxCenter
+	};
+	const FVector Edges[3] = { Corners[1] - Corners[0], Corners[2] - Corners[1], Corners[0] - Corners[2] };
+	const FVector BoxAxes[3] = { FVector(1, 0, 0), FVector(0, 1, 0), FVector(0, 0, 1) };
+
+	auto IsSeparatedBy = [&](const FVector& Axis)
+	{
+		const float P0 = FVector::DotProduct(Corners[0], Axis);
+		const float P1 = FVector::DotProduct(Corners[1], Axis);
+		const float P2 = FVector::DotProduct(Corners[2], Axis);
+		const float Radius = BoxExtent.X * FMath::Abs(Axis.X) + BoxExtent.Y * FMath::Abs(Axis.Y) + BoxExtent.Z * FMath::Abs(Axis.Z);
+		return FMath::Min3(P0, P1, P2) > Radius || FMath::Max3(P0, P1, P2) < -Radius;
+	};
+
+	for (const FVector& BoxAxis : BoxAxes)
+	{
+		if (IsSeparatedBy(BoxAxis))
+		{
+			return false;
+		}
+	}
+
+	if (IsSeparatedBy(FVector::CrossProduct(Edges[0], Edges[1])))
+	{
+		return false;
+	}
+
+	for (const FVector& BoxAxis : BoxAxes)
+	{
+		for (const FVector& Edge : Edges)
+		{
+			if (IsSeparatedBy(FVector::CrossProduct(BoxAxis, Edge)))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,95 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Bounding volume hierarchy over generated triangles for raycasts and overlap queries
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshData.h"
+
+struct PROCEDURALMESHES_API FMeshBVHHit
+{
+	// Distance from the start of the ray
+	float Distance;
+	FVector Location;
+
+	// Points out of the front face of the triangle
+	FVector Normal;
+	int32 TriangleIndex;
+
+	FMeshBVHHit()
+		: Distance(0.0f), Location(FVector::ZeroVector), Normal(FVector::ZeroVector), TriangleIndex(INDEX_NONE)
+	{
+	}
+};
+
+// Keeps its own copy of the positions and triangles, so it can be queried after the mesh data is gone and from any thread once built.
+// Nodes are split with the surface area heuristic evaluated over a fixed number of bins, and stored in one flat array where the two
+// children of a node are always next to each other and after their parent.
+class PROCEDURALMESHES_API FMeshBVH
+{
+public:
+	FMeshBVH();
+
+	// Builds the tree from scratch. The top few levels are split on the calling thread, then the subtrees below them are built in parallel.
+	void Build(const FProceduralMeshData& MeshData);
+
+	// Moves the vertices without changing the tree, much cheaper than a rebuild when the triangles are the same and only the positions
+	// changed. The tree gets slower to query the more the mesh moves away from the shape it was built for.
+	void Refit(const TArray<FVector>& NewVertices);
+
+	void Reset();
+
+	bool IsBuilt() const { return Nodes.Num() > 0; }
+	int32 GetNumTriangles() const { return Triangles.Num() / 3; }
+	int32 GetNumVertices() const { return Vertices.Num(); }
+	int32 GetNumNodes() const { return Nodes.Num(); }
+
+	// Finds the first triangle hit by the line from Start to End, from either side
+	bool Raycast(const FVector& Start, const FVector& End, FMeshBVHHit& OutHit) const;
+
+	// Adds the index of every triangle touching the box to OutTriangleIndices and returns how many were added
+	int32 OverlapBox(const FBox& Box, TArray<int32>& OutTriangleIndices) const;
+
+private:
+	struct FNode
+	{
+		FVector Min;
+		FVector Max;
+
+		// Interior nodes: index of the first of the two children. Leaves: first entry in TriangleOrder.
+		int32 Index;
+
+		// 0 for interior nodes
+		int32 NumTriangles;
+	};
+
+	// A range of TriangleOrder that still has to be turned into a subtree, rooted at the node NodeIndex
+	struct FBuildRange
+	{
+		int32 NodeIndex;
+		int32 Begin;
+		int32 End;
+		int32 Depth;
+	};
+
+	// Builds the subtree for Range into OutNodes. If OutPending is given, ranges below the top levels are left for later and added to it.
+	void BuildSubtree(TArray<FNode>& OutNodes, const FBuildRange& Range, TArray<FBuildRange>* OutPending);
+	bool FindSplit(const FNode& Node, int32 Begin, int32 End, int32& OutMiddle);
+	void UpdateNodeBounds(FNode& Node, int32 Begin, int32 End) const;
+	void UpdateTriangleBounds(int32 TriangleIndex);
+
+	bool IntersectTriangle(int32 TriangleIndex, const FVector& Start, const FVector& Direction, float MaxDistance, float& OutDistance) const;
+	bool TriangleOverlapsBox(int32 TriangleIndex, const FVector& BoxCenter, const FVector& BoxExtent) const;
+
+	TArray<FVector> Vertices;
+	TArray<int32> Triangles;
+	TArray<FNode> Nodes;
+
+	// Triangle indices in the order the leaves refer to them
+	TArray<int32> TriangleOrder;
+
+	// Only needed while building
+	TArray<FVector> TriangleMins;
+	TArray<FVector> TriangleMaxs;
+	TArray<FVector> TriangleCenters;
+};
@@ -0,0 +1,507 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Quadric error mesh simplification for generated mesh data
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "MeshDecimation.h"
+
+namespace MeshDecimation
+{
+	// Weighted sum of squared distances to a set of planes, stored as the upper half of a symmetric 4x4 matrix.
+	// The weights are summed up alongside, dividing by them gives the mean squared distance.
+	struct FQuadric
+	{
+		double Values[10];
+		double Weight;
+
+		FQuadric()
+			: Weight(0.0)
+		{
+			FMemory::Memzero(Values);
+		}
+
+		FQuadric(const FVector& Normal, float Distance, float InWeight)
+			: Weight(InWeight)
+		{
+			const double A = Normal.X, B = Normal.Y, C = Normal.Z, D = Distance;
+			Values[0] = A * A * Weight; Values[1] = A * B * Weight; Values[2] = A * C * Weight; Values[3] = A * D * Weight;
+			Values[4] = B * B * Weight; Values[5] = B * C * Weight; Values[6] = B * D * Weight;
+			Values[7] = C * C * Weight; Values[8] = C * D * Weight;
+			Values[9] = D * D * Weight;
+		}
+
+		FQuadric& operator+=(const FQuadric& Other)
+		{
+			for (int32 Index = 0; Index < 10; Index++)
+			{
+				Values[Index] += Other.Values[Index];
+			}
+			Weight += Other.Weight;
+			return *this;
+		}
+
+		float Evaluate(const FVector& Point) const
+		{
+			const double X = Point.X, Y = Point.Y, Z = Point.Z;
+			return (float)(Values[0] * X * X + 2.0 * Values[1] * X * Y + 2.0 * Values[2] * X * Z + 2.0 * Values[3] * X
+				+ Values[4] * Y * Y + 2.0 * Values[5] * Y * Z + 2.0 * Values[6] * Y
+				+ Values[7] * Z * Z + 2.0 * Values[8] * Z
+				+ Values[9]);
+		}
+
+		// How far the point is from the planes on average, squared, in the same units as the positions
+		float EvaluateMeanSquaredDistance(const FVector& Point) const
+		{
+			return Weight > SMALL_NUMBER ? (float)(Evaluate(Point) / Weight) : 0.0f;
+		}
+	};
+
+	// Moving From onto To, and what it costs. The versions tell us if either vertex changed after this was queued.
+	struct FCollapse
+	{
+		float Cost;
+		int32 From;
+		int32 To;
+		int32 FromVersion;
+		int32 ToVersion;
+	};
+
+	struct FCollapseOrder
+	{
+		bool operator()(const FCollapse& A, const FCollapse& B) const
+		{
+			return A.Cost < B.Cost;
+		}
+	};
+
+	// Small enough to never outweigh a real error
+	static const float TieBreakScale = 1e-6f;
+
+	FORCEINLINE uint64 GetEdgeKey(int32 A, int32 B)
+	{
+		return A < B ? ((uint64)A << 32) | (uint32)B : ((uint64)B << 32) | (uint32)A;
+	}
+
+	class FSimplifier
+	{
+	public:
+		FSimplifier(const FProceduralMeshData& InMeshData)
+			: MeshData(InMeshData)
+			, NumLiveTriangles(0)
+		{
+		}
+
+		void Run(float MaxError, int32 TargetTriangleCount)
+		{
+			Weld();
+			BuildQuadrics();
+			LockBoundaries();
+
+			if (MaxError <= 0 && TargetTriangleCount <= 0)
+			{
+				return;
+			}
+
+			for (const auto& Edge : EdgeUseCounts)
+			{
+				QueueCollapse((int32)(Edge.Key >> 32), (int32)(Edge.Key & 0xffffffff));
+			}
+
+			// -------------------------------------------------------
+			// Always do the cheapest collapse that is left, until it costs too much or we hit the triangle budget
+			const float MaxCost = MaxError > 0 ? MaxError * MaxError : MAX_flt;
+			while (Queue.Num() > 0 && NumLiveTriangles > TargetTriangleCount)
+			{
+				FCollapse Collapse;
+				Queue.HeapPop(Collapse, FCollapseOrder(), false);
+				if (Collapse.Cost > MaxCost)
+				{
+					break;
+				}
+
+				if (bVertexRemoved[Collapse.From] || bVertexRemoved[Collapse.To] || Versions[Collapse.From] != Collapse.FromVersion || Versions[Collapse.To] != Collapse.ToVersion)
+				{
+					continue;
+				}
+
+				if (CanCollapse(Collapse.From, Collapse.To))
+				{
+					DoCollapse(Collapse.From, Collapse.To);
+				}
+			}
+		}
+
+		void Write(FProceduralMeshData& OutMeshData) const
+		{
+			// -------------------------------------------------------
+			// Compact the vertices that are still in use, keeping the attributes of the input vertex each one came from
+			const bool bHasUVs = MeshData.UVs.Num() == MeshData.Vertices.Num();
+			const bool bHasTangents = MeshData.Tangents.Num() == MeshData.Vertices.Num();
+			const bool bHasColors = MeshData.VertexColors.Num() == MeshData.Vertices.Num();
+
+			TArray<int32> OutputIndexes;
+			OutputIndexes.Init(INDEX_NONE, Positions.Num());
+			OutMeshData.Reset();
+			OutMeshData.Triangles.Reserve(NumLiveTriangles * 3);
+
+			for (int32 TriangleIndex = 0; TriangleIndex < bTriangleRemoved.Num(); TriangleIndex++)
+			{
+				if (bTriangleRemoved[TriangleIndex])
+				{
+					continue;
+				}
+
+				const int32* Corners = &Triangles[TriangleIndex * 3];
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					int32& OutputIndex = OutputIndexes[Corners[Corner]];
+					if (OutputIndex == INDEX_NONE)
+					{
+						const int32 SourceIndex = SourceVertices[Corners[Corner]];
+						OutputIndex = OutMeshData.Vertices.Add(Positions[Corners[Corner]]);
+						OutMeshData.Normals.Add(FVector::ZeroVector);
+						if (bHasUVs)
+						{
+							OutMeshData.UVs.Add(MeshData.UVs[SourceIndex]);
+						}
+						if (bHasTangents)
+						{
+							OutMeshData.Tangents.Add(MeshData.Tangents[SourceIndex]);
+						}
+						if (bHasColors)
+						{
+							OutMeshData.VertexColors.Add(MeshData.VertexColors[SourceIndex]);
+						}
+					}
+					OutMeshData.Triangles.Add(OutputIndex);
+				}
+
+				// Area weighted face normals, summed up per vertex
+				const FVector FaceNormal = GetFaceNormal(Positions[Corners[0]], Positions[Corners[1]], Positions[Corners[2]]);
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					OutMeshData.Normals[OutputIndexes[Corners[Corner]]] += FaceNormal;
+				}
+			}
+
+			// The welded vertices are smooth now
+			for (FVector& Normal : OutMeshData.Normals)
+			{
+				Normal = Normal.GetSafeNormal();
+			}
+		}
+
+		int32 GetNumLiveTriangles() const { return NumLiveTriangles; }
+
+	private:
+		// Front faces are wound clockwise, see MeshBVH
+		static FVector GetFaceNormal(const FVector& A, const FVector& B, const FVector& C)
+		{
+			return FVector::CrossProduct(C - A, B - A);
+		}
+
+		void Weld()
+		{
+			// -------------------------------------------------------
+			// Our generators write separate vertices for every quad, so the mesh has no connectivity until we merge equal positions
+			TMap<FVector, int32> PositionToVertex;
+			TArray<int32> Remap;
+			Remap.AddUninitialized(MeshData.Vertices.Num());
+
+			for (int32 VertexIndex = 0; VertexIndex < MeshData.Vertices.Num(); VertexIndex++)
+			{
+				const FVector& Position = MeshData.Vertices[VertexIndex];
+				if (const int32* Existing = PositionToVertex.Find(Position))
+				{
+					Remap[VertexIndex] = *Existing;
+				}
+				else
+				{
+					Remap[VertexIndex] = Positions.Add(Position);
+					SourceVertices.Add(VertexIndex);
+					PositionToVertex.Add(Position, Remap[VertexIndex]);
+				}
+			}
+
+			VertexTriangles.SetNum(Positions.Num());
+			bVertexRemoved.Init(false, Positions.Num());
+			bVertexLocked.Init(false, Positions.Num());
+			Versions.Init(0, Positions.Num());
+			Quadrics.SetNum(Positions.Num());
+
+			for (int32 Index = 0; Index + 2 < MeshData.Triangles.Num(); Index += 3)
+			{
+				const int32 A = Remap[MeshData.Triangles[Index]];
+				const int32 B = Remap[MeshData.Triangles[Index + 1]];
+				const int32 C = Remap[MeshData.Triangles[Index + 2]];
+				if (A == B || B == C || C == A)
+				{
+					continue;
+				}
+
+				const int32 TriangleIndex = bTriangleRemoved.Add(false);
+				Triangles.Add(A);
+				Triangles.Add(B);
+				Triangles.Add(C);
+				VertexTriangles[A].Add(TriangleIndex);
+				VertexTriangles[B].Add(TriangleIndex);
+				VertexTriangles[C].Add(TriangleIndex);
+
+				EdgeUseCounts.FindOrAdd(GetEdgeKey(A, B))++;
+				EdgeUseCounts.FindOrAdd(GetEdgeKey(B, C))++;
+				EdgeUseCounts.FindOrAdd(GetEdgeKey(C, A))++;
+			}
+
+			NumLiveTriangles = bTriangleRemoved.Num();
+		}
+
+		void BuildQuadrics()
+		{
+			// Each vertex starts out with the planes of the triangles around it, weighted by area
+			for (int32 TriangleIndex = 0; TriangleIndex < bTriangleRemoved.Num(); TriangleIndex++)
+			{
+				const int32* Corners = &Triangles[TriangleIndex * 3];
+				const FVector FaceNormal = GetFaceNormal(Positions[Corners[0]], Positions[Corners[1]], Positions[Corners[2]]);
+				const float Area = FaceNormal.Size() * 0.5f;
+				if (Area <= SMALL_NUMBER)
+				{
+					continue;
+				}
+
+				const FVector PlaneNormal = FaceNormal / (Area * 2.0f);
+				const FQuadric Plane(PlaneNormal, -FVector::DotProduct(PlaneNormal, Positions[Corners[0]]), Area);
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					Quadrics[Corners[Corner]] += Plane;
+				}
+			}
+		}
+
+		void LockBoundaries()
+		{
+			// Edges with only one triangle are on the outline of the mesh, and edges with more than two can't be collapsed safely
+			for (const auto& Edge : EdgeUseCounts)
+			{
+				if (Edge.Value != 2)
+				{
+					bVertexLocked[(int32)(Edge.Key >> 32)] = true;
+					bVertexLocked[(int32)(Edge.Key & 0xffffffff)] = true;
+				}
+			}
+		}
+
+		void QueueCollapse(int32 A, int32 B)
+		{
+			// Pick whichever direction moves the surface the least, locked vertices can only be collapsed onto.
+			// The cost is a squared distance rather than an area weighted sum, so it can be held against MaxError no matter how big the triangles are.
+			FQuadric Combined = Quadrics[A];
+			Combined += Quadrics[B];
+			const float CostAToB = bVertexLocked[A] ? MAX_flt : Combined.EvaluateMeanSquaredDistance(Positions[B]);
+			const float CostBToA = bVertexLocked[B] ? MAX_flt : Combined.EvaluateMeanSquaredDistance(Positions[A]);
+			if (CostAToB == MAX_flt && CostBToA == MAX_flt)
+			{
+				return;
+			}
+
+			// Flat areas have no error at all, so break ties with the edge length to keep the triangles even instead of fanning out from one vertex
+			FCollapse Collapse;
+			Collapse.Cost = FMath::Max(FMath::Min(CostAToB, CostBToA), 0.0f) + FVector::DistSquared(Positions[A], Positions[B]) * TieBreakScale;
+			Collapse.From = CostAToB <= CostBToA ? A : B;
+			Collapse.To = CostAToB <= CostBToA ? B : A;
+			Collapse.FromVersion = Versions[Collapse.From];
+			Collapse.ToVersion = Versions[Collapse.To];
+			Queue.HeapPush(Collapse, FCollapseOrder());
+		}
+
+		// Sorted, so two sets of neighbours can be compared in one pass
+		void GatherNeighbours(int32 Vertex, TArray<int32, TInlineAllocator<32>>& OutNeighbours) const
+		{
+			OutNeighbours.Reset();
+			for (int32 TriangleIndex : VertexTriangles[Vertex])
+			{
+				if (bTriangleRemoved[TriangleIndex])
+				{
+					continue;
+				}
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					const int32 Other = Triangles[TriangleIndex * 3 + Corner];
+					if (Other != Vertex)
+					{
+						OutNeighbours.Add(Other);
+					}
+				}
+			}
+
+			OutNeighbours.Sort();
+			int32 NumUnique = 0;
+			for (int32 Index = 0; Index < OutNeighbours.Num(); Index++)
+			{
+				if (NumUnique == 0 || OutNeighbours[NumUnique - 1] != OutNeighbours[Index])
+				{
+					OutNeighbours[NumUnique++] = OutNeighbours[Index];
+				}
+			}
+			OutNeighbours.SetNum(NumUnique, false);
+		}
+
+		bool CanCollapse(int32 From, int32 To) const
+		{
+			// -------------------------------------------------------
+			// The vertices the two have in common must be exactly the ones across the triangles on the edge,
+			// otherwise the collapse would pinch the surface and make it non-manifold
+			TArray<int32, TInlineAllocator<32>> FromNeighbours;
+			TArray<int32, TInlineAllocator<32>> ToNeighbours;
+			GatherNeighbours(From, FromNeighbours);
+			GatherNeighbours(To, ToNeighbours);
+
+			int32 NumShared = 0;
+			for (int32 FromIndex = 0, ToIndex = 0; FromIndex < FromNeighbours.Num() && ToIndex < ToNeighbours.Num();)
+			{
+				if (FromNeighbours[FromIndex] < ToNeighbours[ToIndex])
+				{
+					FromIndex++;
+				}
+				else if (ToNeighbours[ToIndex] < FromNeighbours[FromIndex])
+				{
+					ToIndex++;
+				}
+				else
+				{
+					NumShared++;
+					FromIndex++;
+					ToIndex++;
+				}
+			}
+
+			int32 NumEdgeTriangles = 0;
+			for (int32 TriangleIndex : VertexTriangles[From])
+			{
+				if (!bTriangleRemoved[TriangleIndex] && TriangleHasVertex(TriangleIndex, To))
+				{
+					NumEdgeTriangles++;
+				}
+			}
+
+			if (NumShared != NumEdgeTriangles)
+			{
+				return false;
+			}
+
+			// -------------------------------------------------------
+			// None of the triangles that stay may flip over or collapse to a line
+			for (int32 TriangleIndex : VertexTriangles[From])
+			{
+				if (bTriangleRemoved[TriangleIndex] || TriangleHasVertex(TriangleIndex, To))
+				{
+					continue;
+				}
+
+				FVector Corners[3];
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					Corners[Corner] = Positions[Triangles[TriangleIndex * 3 + Corner]];
+				}
+				const FVector OldNormal = GetFaceNormal(Corners[0], Corners[1], Corners[2]);
+
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					if (Triangles[TriangleIndex * 3 + Corner] == From)
+					{
+						Corners[Corner] = Positions[To];
+					}
+				}
+				const FVector NewNormal = GetFaceNormal(Corners[0], Corners[1], Corners[2]);
+
+				if (NewNormal.SizeSquared() <= SMALL_NUMBER || FVector::DotProduct(OldNormal.GetSafeNormal(), NewNormal.GetSafeNormal()) < 0.0f)
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		void DoCollapse(int32 From, int32 To)
+		{
+			Quadrics[To] += Quadrics[From];
+			bVertexRemoved[From] = true;
+
+			// -------------------------------------------------------
+			// Triangles on the edge disappear, the rest of the triangles around From now use To instead
+			for (int32 TriangleIndex : VertexTriangles[From])
+			{
+				if (bTriangleRemoved[TriangleIndex])
+				{
+					continue;
+				}
+
+				if (TriangleHasVertex(TriangleIndex, To))
+				{
+					bTriangleRemoved[TriangleIndex] = true;
+					NumLiveTriangles--;
+					continue;
+				}
+
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					if (Triangles[TriangleIndex * 3 + Corner] == From)
+					{
+						Triangles[TriangleIndex * 3 + Corner] = To;
+					}
+				}
+				VertexTriangles[To].Add(TriangleIndex);
+			}
+			VertexTriangles[From].Empty();
+			VertexTriangles[To].RemoveAll([this](int32 TriangleIndex) { return bTriangleRemoved[TriangleIndex]; });
+
+			// -------------------------------------------------------
+			// Every edge around To has a new cost now
+			Versions[To]++;
+			TArray<int32, TInlineAllocator<32>> Neighbours;
+			GatherNeighbours(To, Neighbours);
+			for (int32 Neighbour : Neighbours)
+			{
+				QueueCollapse(To, Neighbour);
+			}
+		}
+
+		FORCEINLINE bool TriangleHasVertex(int32 TriangleIndex, int32 Vertex) const
+		{
+			return Triangles[TriangleIndex * 3] == Vertex || Triangles[TriangleIndex * 3 + 1] == Vertex || Triangles[TriangleIndex * 3 + 2] == Vertex;
+		}
+
+		const FProceduralMeshData& MeshData;
+
+		// Welded vertices, and the input vertex each one was first seen as
+		TArray<FVector> Positions;
+		TArray<int32> SourceVertices;
+		TArray<FQuadric> Quadrics;
+		TArray<bool> bVertexRemoved;
+		TArray<bool> bVertexLocked;
+		TArray<int32> Versions;
+		TArray<TArray<int32>> VertexTriangles;
+
+		TArray<int32> Triangles;
+		TArray<bool> bTriangleRemoved;
+		int32 NumLiveTriangles;
+
+		TMap<uint64, int32> EdgeUseCounts;
+		TArray<FCollapse> Queue;
+	};
+}
+
+FMeshDecimationStats FMeshDecimation::Simplify(const FProceduralMeshData& InMeshData, FProceduralMeshData& OutMeshData, float MaxError, int32 TargetTriangleCount/* = 0*/)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	FMeshDecimationStats Stats;
+	Stats.InputTriangleCount = InMeshData.Triangles.Num() / 3;
+
+	MeshDecimation::FSimplifier Simplifier(InMeshData);
+	Simplifier.Run(MaxError, TargetTriangleCount);
+	Simplifier.Write(OutMeshData);
+
+	Stats.OutputTriangleCount = Simplifier.GetNumLiveTriangles();
+	Stats.Seconds = FPlatformTime::Seconds() - StartTime;
+	return Stats;
+}
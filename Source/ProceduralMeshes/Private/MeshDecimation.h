@@ -0,0 +1,28 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Quadric error mesh simplification for generated mesh data
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshData.h"
+
+struct PROCEDURALMESHES_API FMeshDecimationStats
+{
+	int32 InputTriangleCount;
+	int32 OutputTriangleCount;
+	double Seconds;
+
+	FMeshDecimationStats()
+		: InputTriangleCount(0), OutputTriangleCount(0), Seconds(0.0)
+	{
+	}
+};
+
+struct PROCEDURALMESHES_API FMeshDecimation
+{
+	// Collapses edges in order of least quadric error until the next collapse would move the surface further than MaxError,
+	// or the mesh is down to TargetTriangleCount. A MaxError or TargetTriangleCount of 0 means that limit is not used.
+	// Vertices at the same position are welded first and keep the attributes of the first one. Vertices on open edges
+	// never move, so the outline of the mesh stays exactly the same and neighbouring chunks still line up.
+	static FMeshDecimationStats Simplify(const FProceduralMeshData& InMeshData, FProceduralMeshData& OutMeshData, float MaxError, int32 TargetTriangleCount = 0);
+};
@@ -0,0 +1,99 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Collision made of simple shapes for the procedural examples
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralCollisionComponent.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "Async.h"
+
+UProceduralCollisionComponent::UProceduralCollisionComponent(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+	, CollisionBodySetup(nullptr)
+	, LocalBounds(0)
+	, LatestBuildId(0)
+{
+	SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+	bHiddenInGame = true;
+}
+
+void UProceduralCollisionComponent::BuildCollisionAsync(TFunction<void(FKAggregateGeom&)> BuildShapes)
+{
+	const int32 BuildId = ++LatestBuildId;
+	TWeakObjectPtr<UProceduralCollisionComponent> WeakThis(this);
+
+	AsyncTask(ENamedThreads::AnyThread, [WeakThis, BuildId, BuildShapes]()
+	{
+		TSharedRef<FKAggregateGeom, ESPMode::ThreadSafe> Shapes = MakeShareable(new FKAggregateGeom());
+		BuildShapes(*Shapes);
+
+		// Components can only be touched on the game thread, and this one may be gone by now
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, BuildId, Shapes]()
+		{
+			UProceduralCollisionComponent* Component = WeakThis.Get();
+			if (Component && Component->LatestBuildId == BuildId)
+			{
+				Component->SetShapes(*Shapes);
+			}
+		});
+	});
+}
+
+void UProceduralCollisionComponent::ClearCollision()
+{
+	LatestBuildId++;
+	if (GetNumShapes() > 0)
+	{
+		SetShapes(FKAggregateGeom());
+	}
+}
+
+int32 UProceduralCollisionComponent::GetNumShapes() const
+{
+	return CollisionBodySetup ? CollisionBodySetup->AggGeom.GetElementCount() : 0;
+}
+
+void UProceduralCollisionComponent::AddCapsule(FKAggregateGeom& Shapes, const FVector& Start, const FVector& End, float Radius)
+{
+	// Capsules run along their Z axis, and Length doesn't include the rounded ends
+	const FVector Direction = End - Start;
+	FKSphylElem Capsule;
+	Capsule.Center = (Start + End) * 0.5f;
+	Capsule.Orientation = FRotationMatrix::MakeFromZ(Direction).ToQuat();
+	Capsule.Radius = Radius;
+	Capsule.Length = Direction.Size();
+	Shapes.SphylElems.Add(Capsule);
+}
+
+void UProceduralCollisionComponent::SetShapes(const FKAggregateGeom& Shapes)
+{
+	if (CollisionBodySetup == nullptr)
+	{
+		CollisionBodySetup = NewObject<UBodySetup>(this, NAME_None, RF_Transient);
+		CollisionBodySetup->BodySetupGuid = FGuid::NewGuid();
+		CollisionBodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
+		CollisionBodySetup->bGenerateMirroredCollision = false;
+	}
+
+	// Only convex elements are cooked, and the ones we make are only a handful of points each
+	CollisionBodySetup->AggGeom = Shapes;
+	CollisionBodySetup->InvalidatePhysicsData();
+	CollisionBodySetup->CreatePhysicsMeshes();
+
+	LocalBounds = Shapes.GetElementCount() > 0 ? Shapes.CalcAABB(FTransform::Identity) : FBox(0);
+	UpdateBounds();
+	RecreatePhysicsState();
+}
+
+UBodySetup* UProceduralCollisionComponent::GetBodySetup()
+{
+	return CollisionBodySetup;
+}
+
+FBoxSphereBounds UProceduralCollisionComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	if (!LocalBounds.IsValid)
+	{
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.0f);
+	}
+	return FBoxSphereBounds(LocalBounds).TransformBy(LocalToWorld);
+}
@@ -0,0 +1,443 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Generates meshes from a parameter file without opening a map, and writes timing, memory and size statistics to CSV
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshBatchCommandlet.h"
+#include "ProceduralMeshThreading.h"
+#include "ProceduralMeshBenchmarks.h"
+#include "ProceduralMeshDeterminism.h"
+#include "ProceduralMeshHarness.h"
+#include "ScratchArena.h"
+
+namespace ProceduralMeshBatch
+{
+	const int32 DefaultNumRuns = 5;
+
+	struct FSweepParameter
+	{
+		FString Name;
+		TArray<FString> Values;
+	};
+
+	// One section of the parameter file
+	struct FSweep
+	{
+		FString Name;
+		FString ClassName;
+		int32 NumRuns;
+		TArray<FSweepParameter> Parameters;
+
+		FSweep()
+			: NumRuns(INDEX_NONE)
+		{
+		}
+
+		int32 GetNumCombinations() const
+		{
+			int32 NumCombinations = 1;
+			for (const FSweepParameter& Parameter : Parameters)
+			{
+				NumCombinations *= Parameter.Values.Num();
+			}
+			return NumCombinations;
+		}
+
+		// The value of every parameter in combination number CombinationIndex, the last parameter changes fastest like in nested loops
+		void GetCombination(int32 CombinationIndex, TArray<FString>& OutValues) const
+		{
+			OutValues.SetNum(Parameters.Num());
+			for (int32 ParameterIndex = Parameters.Num() - 1; ParameterIndex >= 0; ParameterIndex--)
+			{
+				const TArray<FString>& Values = Parameters[ParameterIndex].Values;
+				OutValues[ParameterIndex] = Values[CombinationIndex % Values.Num()];
+				CombinationIndex /= Values.Num();
+			}
+		}
+	};
+
+	FString TrimBoth(FString Text)
+	{
+		Text.Trim();
+		Text.TrimTrailing();
+		return Text;
+	}
+
+	bool LoadSweeps(const FString& Filename, TArray<FSweep>& OutSweeps)
+	{
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadFileToStringArray(Lines, *Filename))
+		{
+			UE_LOG(LogProceduralMeshes, Error, TEXT("Could not read the parameter file %s"), *Filename);
+			return false;
+		}
+
+		for (int32 LineIndex = 0; LineIndex < Lines.Num(); LineIndex++)
+		{
+			const FString Line = TrimBoth(Lines[LineIndex]);
+			if (Line.IsEmpty() || Line.StartsWith(TEXT(";")) || Line.StartsWith(TEXT("#")))
+			{
+				continue;
+			}
+
+			if (Line.StartsWith(TEXT("[")) && Line.EndsWith(TEXT("]")))
+			{
+				FSweep& Sweep = OutSweeps[OutSweeps.AddDefaulted()];
+				Sweep.Name = TrimBoth(Line.Mid(1, Line.Len() - 2));
+				continue;
+			}
+
+			FString Key;
+			FString Value;
+			if (OutSweeps.Num() == 0 || !Line.Split(TEXT("="), &Key, &Value))
+			{
+				UE_LOG(LogProceduralMeshes, Error, TEXT("%s(%d): expected [Section] or Key=Value"), *Filename, LineIndex + 1);
+				return false;
+			}
+			Key = TrimBoth(Key);
+			Value = TrimBoth(Value);
+
+			FSweep& Sweep = OutSweeps.Last();
+			if (Key == TEXT("Class"))
+			{
+				Sweep.ClassName = Value;
+			}
+			else if (Key == TEXT("Repeat"))
+			{
+				Sweep.NumRuns = FMath::Max(1, FCString::Atoi(*Value));
+			}
+			else
+			{
+				FSweepParameter& Parameter = Sweep.Parameters[Sweep.Parameters.AddDefaulted()];
+				Parameter.Name = Key;
+				Value.ParseIntoArray(Parameter.Values, TEXT("|"), false);
+				for (FString& EachValue : Parameter.Values)
+				{
+					EachValue = TrimBoth(EachValue);
+				}
+				if (Parameter.Values.Num() == 0)
+				{
+					Parameter.Values.Add(FString());
+				}
+			}
+		}
+		return true;
+	}
+
+	// Accepts the class name with or without its A prefix
+	UClass* FindGeneratorClass(const FString& ClassName)
+	{
+		UClass* Class = FindObject<UClass>(ANY_PACKAGE, *ClassName);
+		if (!Class && ClassName.StartsWith(TEXT("A")))
+		{
+			Class = FindObject<UClass>(ANY_PACKAGE, *ClassName.Mid(1));
+		}
+		return Class && Class->IsChildOf(AProceduralMeshActor::StaticClass()) && !Class->HasAnyClassFlags(CLASS_Abstract) ? Class : nullptr;
+	}
+
+	bool SetProperty(AActor* Actor, const FString& Name, const FString& Value)
+	{
+		UProperty* Property = FindField<UProperty>(Actor->GetClass(), *Name);
+		if (!Property)
+		{
+			UE_LOG(LogProceduralMeshes, Error, TEXT("%s has no property called %s"), *Actor->GetClass()->GetName(), *Name);
+			return false;
+		}
+
+		if (!Property->ImportText(*Value, Property->ContainerPtrToValuePtr<void>(Actor), PPF_None, Actor))
+		{
+			UE_LOG(LogProceduralMeshes, Error, TEXT("Could not set %s.%s to %s"), *Actor->GetClass()->GetName(), *Name, *Value);
+			return false;
+		}
+		return true;
+	}
+
+	struct FMeshStats
+	{
+		int32 NumSections;
+		int32 NumVertices;
+		int32 NumTriangles;
+		SIZE_T NumBytes;
+
+		FMeshStats()
+			: NumSections(0)
+			, NumVertices(0)
+			, NumTriangles(0)
+			, NumBytes(0)
+		{
+		}
+	};
+
+	FMeshStats GetMeshStats(UProceduralMeshComponent* ProcMesh)
+	{
+		FMeshStats Stats;
+		FProceduralMeshHarness::ForEachVisibleSection(ProcMesh, [&Stats](int32, const FProcMeshSection& Section)
+		{
+			Stats.NumSections++;
+			Stats.NumVertices += Section.ProcVertexBuffer.Num();
+			Stats.NumTriangles += Section.ProcIndexBuffer.Num() / 3;
+			Stats.NumBytes += Section.ProcVertexBuffer.GetAllocatedSize() + Section.ProcIndexBuffer.GetAllocatedSize();
+		});
+		return Stats;
+	}
+
+	void WriteText(FArchive& Writer, const FString& Text)
+	{
+		FTCHARToUTF8 Converted(*Text);
+		Writer.Serialize((void*)Converted.Get(), Converted.Length());
+	}
+
+	// One OBJ object per visible section. Positions are written as they are, in Unreal's left handed Z up space.
+	bool WriteObj(UProceduralMeshComponent* ProcMesh, const FString& Filename)
+	{
+		TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Filename));
+		if (!Writer.IsValid())
+		{
+			UE_LOG(LogProceduralMeshes, Error, TEXT("Could not write %s"), *Filename);
+			return false;
+		}
+
+		WriteText(*Writer, FString::Printf(TEXT("# %s\n"), *ProcMesh->GetOwner()->GetClass()->GetName()));
+
+		// OBJ indices start at 1 and keep counting across objects
+		int32 FirstVertex = 1;
+		FProceduralMeshHarness::ForEachVisibleSection(ProcMesh, [&Writer, &FirstVertex](int32 SectionIndex, const FProcMeshSection& Section)
+		{
+			// A section at a time, so the text never gets much bigger than the section itself
+			FString Text = FString::Printf(TEXT("o Section%d\n"), SectionIndex);
+			for (const FProcMeshVertex& Vertex : Section.ProcVertexBuffer)
+			{
+				Text += FString::Printf(TEXT("v %f %f %f\n"), Vertex.Position.X, Vertex.Position.Y, Vertex.Position.Z);
+			}
+			for (const FProcMeshVertex& Vertex : Section.ProcVertexBuffer)
+			{
+				Text += FString::Printf(TEXT("vn %f %f %f\n"), Vertex.Normal.X, Vertex.Normal.Y, Vertex.Normal.Z);
+			}
+			for (const FProcMeshVertex& Vertex : Section.ProcVertexBuffer)
+			{
+				// Unreal's UV origin is the upper left corner, OBJ's the lower left
+				Text += FString::Printf(TEXT("vt %f %f\n"), Vertex.UV0.X, 1.0f - Vertex.UV0.Y);
+			}
+			for (int32 Index = 0; Index + 2 < Section.ProcIndexBuffer.Num(); Index += 3)
+			{
+				const int32 A = FirstVertex + (int32)Section.ProcIndexBuffer[Index];
+				const int32 B = FirstVertex + (int32)Section.ProcIndexBuffer[Index + 1];
+				const int32 C = FirstVertex + (int32)Section.ProcIndexBuffer[Index + 2];
+				Text += FString::Printf(TEXT("f %d/%d/%d %d/%d/%d %d/%d/%d\n"), A, A, A, B, B, B, C, C, C);
+			}
+			WriteText(*Writer, Text);
+			FirstVertex += Section.ProcVertexBuffer.Num();
+		});
+
+		return Writer->Close();
+	}
+
+	FString EscapeCsv(const FString& Text)
+	{
+		if (!Text.Contains(TEXT(",")) && !Text.Contains(TEXT("\"")))
+		{
+			return Text;
+		}
+		return FString::Printf(TEXT("\"%s\""), *Text.Replace(TEXT("\""), TEXT("\"\"")));
+	}
+}
+
+UProceduralMeshBatchCommandlet::UProceduralMeshBatchCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Generates procedural meshes over a parameter sweep and writes timing, memory and size statistics to CSV");
+	HelpUsage = TEXT("-run=ProceduralMeshBatch -Params=<File> [-Output=<Csv>] [-Threads=0,1,4] [-Repeat=<N>] [-DumpMeshes[=<Directory>]]")
+		TEXT(" or -run=ProceduralMeshBatch -Benchmarks [-Extreme] [-WriteBaseline] [-AllowMissingBaseline] [-Baseline=<File>] [-Tolerance=<Percent>]")
+		TEXT(" or -run=ProceduralMeshBatch -Determinism [-WriteGolden] [-Golden=<File>]");
+}
+
+int32 UProceduralMeshBatchCommandlet::Main(const FString& Params)
+{
+	using namespace ProceduralMeshBatch;
+
+	// The benchmark suite takes the place of a sweep, and fails the run when a case regressed
+	if (FParse::Param(*Params, TEXT("Benchmarks")))
+	{
+		FProceduralMeshBenchmarks::FSettings Settings;
+		Settings.Parse(*Params);
+		return FProceduralMeshBenchmarks::Run(Settings) ? 0 : 1;
+	}
+
+	// So does the determinism check, which fails the run when a mesh changed
+	if (FParse::Param(*Params, TEXT("Determinism")))
+	{
+		FProceduralMeshDeterminism::FSettings Settings;
+		Settings.Parse(*Params);
+		return FProceduralMeshDeterminism::Run(Settings) ? 0 : 1;
+	}
+
+	// -------------------------------------------------------
+	// Command line
+	FString ParamsFile;
+	if (!FParse::Value(*Params, TEXT("Params="), ParamsFile))
+	{
+		UE_LOG(LogProceduralMeshes, Error, TEXT("No parameter file given. Usage: %s"), *HelpUsage);
+		return 1;
+	}
+
+	FString OutputFile = FPaths::GameSavedDir() / TEXT("ProceduralMeshes") / TEXT("Batch.csv");
+	FParse::Value(*Params, TEXT("Output="), OutputFile);
+
+	int32 DefaultRuns = DefaultNumRuns;
+	FParse::Value(*Params, TEXT("Repeat="), DefaultRuns);
+	DefaultRuns = FMath::Max(1, DefaultRuns);
+
+	// The list is comma separated, so it is read without stopping at the first comma
+	FString ThreadsList = TEXT("0");
+	FParse::Value(*Params, TEXT("Threads="), ThreadsList, false);
+	TArray<FString> ThreadsStrings;
+	ThreadsList.ParseIntoArray(ThreadsStrings, TEXT(","), true);
+	TArray<int32> ThreadCounts;
+	for (const FString& ThreadsString : ThreadsStrings)
+	{
+		ThreadCounts.Add(FMath::Max(0, FCString::Atoi(*ThreadsString)));
+	}
+	if (ThreadCounts.Num() == 0)
+	{
+		ThreadCounts.Add(0);
+	}
+
+	FString DumpDirectory;
+	if (!FParse::Value(*Params, TEXT("DumpMeshes="), DumpDirectory) && FParse::Param(*Params, TEXT("DumpMeshes")))
+	{
+		DumpDirectory = FPaths::GameSavedDir() / TEXT("ProceduralMeshes") / TEXT("Meshes");
+	}
+	if (!DumpDirectory.IsEmpty())
+	{
+		IFileManager::Get().MakeDirectory(*DumpDirectory, true);
+	}
+
+	TArray<FSweep> Sweeps;
+	if (!LoadSweeps(ParamsFile, Sweeps))
+	{
+		return 1;
+	}
+
+	FProceduralMeshHarness Harness;
+	const int32 PreviousMaxThreads = FProceduralMeshThreading::GetMaxThreads();
+	int32 NumErrors = 0;
+
+	FString Csv = TEXT("Sweep,Combination,Class,Parameters,Threads,Runs,MinMs,MeanMs,MaxMs,Sections,Vertices,Triangles,MeshBytes,")
+		TEXT("ScratchHeapAllocationsPerRun,ScratchArenaBytes,UsedPhysicalBytes,PeakUsedPhysicalBytes,MeshFile\n");
+
+	for (const FSweep& Sweep : Sweeps)
+	{
+		UClass* Class = FindGeneratorClass(Sweep.ClassName);
+		if (!Class)
+		{
+			UE_LOG(LogProceduralMeshes, Error, TEXT("[%s] %s is not one of the mesh generators"), *Sweep.Name, *Sweep.ClassName);
+			NumErrors++;
+			continue;
+		}
+
+		const int32 NumRuns = Sweep.NumRuns != INDEX_NONE ? Sweep.NumRuns : DefaultRuns;
+		const int32 NumCombinations = Sweep.GetNumCombinations();
+		UE_LOG(LogProceduralMeshes, Display, TEXT("[%s] %d combinations of %s, %d runs each"), *Sweep.Name, NumCombinations, *Class->GetName(), NumRuns);
+
+		TArray<FString> Values;
+		for (int32 CombinationIndex = 0; CombinationIndex < NumCombinations; CombinationIndex++)
+		{
+			Sweep.GetCombination(CombinationIndex, Values);
+
+			// -------------------------------------------------------
+			// The properties are set before the actor is constructed, so construction doesn't build a mesh with the defaults first
+			FString Description;
+			bool bPropertiesSet = true;
+			AProceduralMeshActor* Actor = Harness.Spawn<AProceduralMeshActor>(Class, [&](AProceduralMeshActor& NewActor)
+			{
+				for (int32 ParameterIndex = 0; ParameterIndex < Values.Num(); ParameterIndex++)
+				{
+					const FString& Name = Sweep.Parameters[ParameterIndex].Name;
+					bPropertiesSet &= SetProperty(&NewActor, Name, Values[ParameterIndex]);
+					Description += FString::Printf(TEXT("%s%s=%s"), Description.IsEmpty() ? TEXT("") : TEXT(" "), *Name, *Values[ParameterIndex]);
+				}
+			});
+
+			UProceduralMeshComponent* ProcMesh = Actor->FindComponentByClass<UProceduralMeshComponent>();
+			if (!bPropertiesSet || !ProcMesh)
+			{
+				NumErrors++;
+				Actor->Destroy();
+				continue;
+			}
+
+			// The first generation isn't timed, it fills the caches and scratch arenas the timed ones reuse
+			FProceduralMeshHarness::Generate(Actor);
+
+			for (int32 ThreadsIndex = 0; ThreadsIndex < ThreadCounts.Num(); ThreadsIndex++)
+			{
+				const int32 MaxThreads = ThreadCounts[ThreadsIndex];
+				FProceduralMeshThreading::SetMaxThreads(MaxThreads);
+
+				// -------------------------------------------------------
+				// Timed runs, each one a full regeneration
+				double MinSeconds = MAX_dbl;
+				double MaxSeconds = 0.0;
+				double TotalSeconds = 0.0;
+				const int32 StartHeapAllocations = FScratchArena::GetNumHeapAllocations();
+				for (int32 Run = 0; Run < NumRuns; Run++)
+				{
+					const double StartTime = FPlatformTime::Seconds();
+					Actor->GenerateMesh();
+					const double Seconds = FPlatformTime::Seconds() - StartTime;
+					MinSeconds = FMath::Min(MinSeconds, Seconds);
+					MaxSeconds = FMath::Max(MaxSeconds, Seconds);
+					TotalSeconds += Seconds;
+
+					// Lets collision that was built in the background land before the next run starts another one
+					FTaskGraphInterface::Get().ProcessThreadUntilIdle(ENamedThreads::GameThread);
+				}
+				const int32 NumHeapAllocations = FScratchArena::GetNumHeapAllocations() - StartHeapAllocations;
+
+				const FMeshStats MeshStats = GetMeshStats(ProcMesh);
+				const FPlatformMemoryStats MemoryStats = FPlatformMemory::GetStats();
+
+				// The thread count doesn't change the mesh, so it is only written once
+				FString MeshFile;
+				if (!DumpDirectory.IsEmpty() && ThreadsIndex == 0)
+				{
+					MeshFile = DumpDirectory / FString::Printf(TEXT("%s_%d.obj"), *Sweep.Name, CombinationIndex);
+					if (!WriteObj(ProcMesh, MeshFile))
+					{
+						MeshFile.Empty();
+						NumErrors++;
+					}
+				}
+
+				UE_LOG(LogProceduralMeshes, Display, TEXT("[%s] %d/%d %s, %d threads: %.3f ms mean, %d vertices, %d triangles"), *Sweep.Name,
+					CombinationIndex + 1, NumCombinations, *Description, MaxThreads, TotalSeconds * 1000.0 / NumRuns, MeshStats.NumVertices, MeshStats.NumTriangles);
+
+				Csv += FString::Printf(TEXT("%s,%d,%s,%s,%d,%d,%.3f,%.3f,%.3f,%d,%d,%d,%llu,%.1f,%llu,%llu,%llu,%s\n"),
+					*EscapeCsv(Sweep.Name), CombinationIndex, *Class->GetName(), *EscapeCsv(Description), MaxThreads, NumRuns,
+					MinSeconds * 1000.0, TotalSeconds * 1000.0 / NumRuns, MaxSeconds * 1000.0,
+					MeshStats.NumSections, MeshStats.NumVertices, MeshStats.NumTriangles, (uint64)MeshStats.NumBytes,
+					(double)NumHeapAllocations / NumRuns, (uint64)FScratchArena::Get().GetReservedBytes(),
+					(uint64)MemoryStats.UsedPhysical, (uint64)MemoryStats.PeakUsedPhysical, *EscapeCsv(MeshFile));
+			}
+
+			Actor->Destroy();
+		}
+	}
+
+	FProceduralMeshThreading::SetMaxThreads(PreviousMaxThreads);
+
+	// -------------------------------------------------------
+	// Written even when some sweeps failed, so the ones that worked aren't lost
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(OutputFile), true);
+	if (!FFileHelper::SaveStringToFile(Csv, *OutputFile))
+	{
+		UE_LOG(LogProceduralMeshes, Error, TEXT("Could not write %s"), *OutputFile);
+		return 1;
+	}
+	UE_LOG(LogProceduralMeshes, Display, TEXT("Wrote %s"), *OutputFile);
+
+	return NumErrors > 0 ? 1 : 0;
+}
@@ -0,0 +1,416 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Times every generator against a saved baseline, so a change that makes generation slower or allocate more is caught
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshBenchmarks.h"
+#include "ProceduralMeshHarness.h"
+#include "ScratchArena.h"
+#include "SimpleCubeActor.h"
+#include "SimpleCylinderActor.h"
+#include "CylinderStripActor.h"
+#include "SierpinskiLineActor.h"
+#include "BranchingLinesActor.h"
+#include "HeightFieldNoiseActor.h"
+#include "HeightFieldAnimatedActor.h"
+#include "VoxelGridActor.h"
+#include "MarchingCubesActor.h"
+
+namespace ProceduralMeshBenchmarks
+{
+	// Each case runs for at least this long and at least MinRuns times, after one run to warm up
+	const double MinSeconds = 0.25;
+	const int32 MinRuns = 3;
+	const int32 MaxRuns = 1000;
+
+	// Allocations made by other threads while a case runs end up in its count, so a case may make this many more than the baseline
+	const double AllocationSlack = 1.0;
+
+	struct FCase
+	{
+		FString Name;
+
+		// What the elements counted by Run are
+		const TCHAR* Unit;
+
+		// One run, returns how many elements it generated
+		TFunction<int32()> Run;
+	};
+
+	struct FResult
+	{
+		double NsPerElement;
+		double AllocationsPerRun;
+		int32 NumRuns;
+		int32 NumElements;
+	};
+
+	struct FBaselineEntry
+	{
+		double NsPerElement;
+		double AllocationsPerRun;
+	};
+
+	// Counted by the engine allocator, across all threads, in builds with stats
+	bool CanCountAllocations()
+	{
+		return STATS != 0;
+	}
+
+	uint64 GetNumAllocations()
+	{
+#if STATS
+		return (uint64)FMalloc::TotalMallocCalls + (uint64)FMalloc::TotalReallocCalls;
+#else
+		return 0;
+#endif
+	}
+
+	FResult Measure(const FCase& Case)
+	{
+		FResult Result;
+		Result.NumElements = Case.Run();
+
+		int32 NumRuns = 0;
+		int64 NumElements = 0;
+		const uint64 StartAllocations = GetNumAllocations();
+		const double StartTime = FPlatformTime::Seconds();
+		double Seconds = 0.0;
+		while (NumRuns < MaxRuns && (NumRuns < MinRuns || Seconds < MinSeconds))
+		{
+			NumElements += Case.Run();
+			NumRuns++;
+			Seconds = FPlatformTime::Seconds() - StartTime;
+		}
+
+		Result.NumRuns = NumRuns;
+		Result.NsPerElement = Seconds * 1e9 / FMath::Max<int64>(NumElements, 1);
+		Result.AllocationsPerRun = (double)(GetNumAllocations() - StartAllocations) / NumRuns;
+		return Result;
+	}
+
+	// A whole GenerateMesh, measured in the vertices that end up in the component
+	template<typename ActorType, typename FunctionType>
+	void AddMacroCase(TArray<FCase>& Cases, FProceduralMeshHarness& Harness, const FString& Name, const FunctionType& Setup)
+	{
+		ActorType* Actor = Harness.SpawnGenerated<ActorType>(Setup);
+		FCase& Case = Cases[Cases.AddDefaulted()];
+		Case.Name = FString::Printf(TEXT("Macro %s %s"), *ActorType::StaticClass()->GetName(), *Name);
+		Case.Unit = TEXT("vertex");
+		Case.Run = [Actor]()
+		{
+			Actor->GenerateMesh();
+			return FProceduralMeshHarness::GetNumVisibleVertices(Actor);
+		};
+	}
+
+	bool LoadBaseline(const FString& Filename, TMap<FString, FBaselineEntry>& OutBaseline)
+	{
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadFileToStringArray(Lines, *Filename))
+		{
+			return false;
+		}
+
+		// Case,Unit,NsPerElement,AllocationsPerRun with a header line, case names never have commas in them
+		for (int32 LineIndex = 1; LineIndex < Lines.Num(); LineIndex++)
+		{
+			TArray<FString> Fields;
+			if (Lines[LineIndex].ParseIntoArray(Fields, TEXT(","), false) == 4)
+			{
+				FBaselineEntry& Entry = OutBaseline.Add(Fields[0]);
+				Entry.NsPerElement = FCString::Atod(*Fields[2]);
+				Entry.AllocationsPerRun = FCString::Atod(*Fields[3]);
+			}
+		}
+		return true;
+	}
+}
+
+FProceduralMeshBenchmarks::FSettings::FSettings()
+	: bExtreme(false)
+	, BaselineFile(FPaths::GameSavedDir() / TEXT("ProceduralMeshes") / TEXT("BenchmarkBaseline.csv"))
+	, bWriteBaseline(false)
+	, bAllowMissingBaseline(false)
+	, TolerancePercent(10.0f)
+{
+}
+
+void FProceduralMeshBenchmarks::FSettings::Parse(const TCHAR* Params)
+{
+	bExtreme = FParse::Param(Params, TEXT("Extreme"));
+	bWriteBaseline = FParse::Param(Params, TEXT("WriteBaseline"));
+	bAllowMissingBaseline = FParse::Param(Params, TEXT("AllowMissingBaseline"));
+	FParse::Value(Params, TEXT("Baseline="), BaselineFile);
+	FParse::Value(Params, TEXT("Tolerance="), TolerancePercent);
+	TolerancePercent = FMath::Max(0.0f, TolerancePercent);
+}
+
+bool FProceduralMeshBenchmarks::Run(const FSettings& Settings)
+{
+	using namespace ProceduralMeshBenchmarks;
+
+	FProceduralMeshHarness Harness;
+	TArray<FCase> Cases;
+
+	ASimpleCubeActor* Cube = Harness.SpawnGenerated<ASimpleCubeActor>([](ASimpleCubeActor&) {});
+	ASimpleCylinderActor* Cylinder = Harness.SpawnGenerated<ASimpleCylinderActor>([](ASimpleCylinderActor&) {});
+	AHeightFieldNoiseActor* NoiseGrid = Harness.SpawnGenerated<AHeightFieldNoiseActor>([](AHeightFieldNoiseActor&) {});
+	AHeightFieldAnimatedActor* AnimatedGrid = Harness.SpawnGenerated<AHeightFieldAnimatedActor>([](AHeightFieldAnimatedActor&) {});
+	ABranchingLinesActor* Branches = Harness.SpawnGenerated<ABranchingLinesActor>([](ABranchingLinesActor&) {});
+	ASierpinskiLineActor* Pyramid = Harness.SpawnGenerated<ASierpinskiLineActor>([](ASierpinskiLineActor&) {});
+
+	for (int32 ScaleIndex = 0; ScaleIndex < (Settings.bExtreme ? 2 : 1); ScaleIndex++)
+	{
+		const bool bExtreme = ScaleIndex == 1;
+
+		// -------------------------------------------------------
+		// Micro cases, one generation function each
+		const int32 NumCubes = bExtreme ? 100000 : 1000;
+		Cases.Add({ FString::Printf(TEXT("Micro GenerateCube %d cubes"), NumCubes), TEXT("vertex"), [Cube, NumCubes]()
+		{
+			FProceduralMeshData MeshData;
+			int32 NumVertices = 0;
+			for (int32 CubeIndex = 0; CubeIndex < NumCubes; CubeIndex++)
+			{
+				MeshData.Reset();
+				Cube->GenerateCube(MeshData, 100.0f, 100.0f, 100.0f);
+				NumVertices += MeshData.Vertices.Num();
+			}
+			return NumVertices;
+		} });
+
+		// Both grids are sized the same way their actors size them before calling GenerateGrid
+		const int32 GridSections = bExtreme ? 1000 : 100;
+		TArray<float> NoiseHeights;
+		FRandomStream RngStream(1238);
+		NoiseHeights.SetNumUninitialized((GridSections + 1) * (GridSections + 1));
+		for (float& HeightValue : NoiseHeights)
+		{
+			HeightValue = RngStream.FRandRange(0.0f, 20.0f);
+		}
+		Cases.Add({ FString::Printf(TEXT("Micro GenerateGrid noise %dx%d"), GridSections, GridSections), TEXT("vertex"), [NoiseGrid, GridSections, NoiseHeights]()
+		{
+			const int32 NumVertices = GridSections * GridSections * 4;
+			FProceduralMeshData MeshData;
+			MeshData.Vertices.AddUninitialized(NumVertices);
+			MeshData.Triangles.AddUninitialized(GridSections * GridSections * 2 * 3);
+			MeshData.Normals.AddUninitialized(NumVertices);
+			MeshData.UVs.AddUninitialized(NumVertices);
+			MeshData.Tangents.AddUninitialized(NumVertices);
+			NoiseGrid->GenerateGrid(MeshData, 1000.0f, 1000.0f, GridSections, GridSections, NoiseHeights);
+			return NumVertices;
+		} });
+
+		Cases.Add({ FString::Printf(TEXT("Micro GenerateGrid animated %dx%d"), GridSections, GridSections), TEXT("vertex"), [AnimatedGrid, GridSections, NoiseHeights]()
+		{
+			FScratchScope ScratchScope;
+			TArray<float, FScratchAllocator> AnimatedHeights;
+			AnimatedHeights.Append(NoiseHeights);
+
+			const int32 NumVertices = AnimatedHeights.Num();
+			FProceduralMeshData MeshData;
+			MeshData.Vertices.AddUninitialized(NumVertices);
+			MeshData.Triangles.AddUninitialized(GridSections * GridSections * 2 * 3);
+			MeshData.Normals.AddUninitialized(NumVertices);
+			MeshData.UVs.AddUninitialized(NumVertices);
+			MeshData.Tangents.AddUninitialized(NumVertices);
+			AnimatedGrid->GenerateGrid(MeshData, 1000.0f, 1000.0f, GridSections, GridSections, AnimatedHeights);
+			return NumVertices;
+		} });
+
+		const int32 SegmentCount = bExtreme ? 256 : 10;
+		const int32 NumCylinders = bExtreme ? 100 : 1000;
+		for (int32 Flags = 0; Flags < 8; Flags++)
+		{
+			const bool bCapEnds = (Flags & 1) != 0;
+			const bool bDoubleSided = (Flags & 2) != 0;
+			const bool bSmoothNormals = (Flags & 4) != 0;
+			Cases.Add({ FString::Printf(TEXT("Micro GenerateCylinder segments=%d caps=%d doublesided=%d smooth=%d"), SegmentCount, bCapEnds, bDoubleSided, bSmoothNormals),
+				TEXT("vertex"), [Cylinder, SegmentCount, NumCylinders, bCapEnds, bDoubleSided, bSmoothNormals]()
+			{
+				FProceduralMeshData MeshData;
+				int32 NumVertices = 0;
+				for (int32 CylinderIndex = 0; CylinderIndex < NumCylinders; CylinderIndex++)
+				{
+					MeshData.Reset();
+					Cylinder->GenerateCylinder(MeshData, 100.0f, 10.0f, SegmentCount, bCapEnds, bDoubleSided, bSmoothNormals);
+					NumVertices += MeshData.Vertices.Num();
+				}
+				return NumVertices;
+			} });
+		}
+
+		const uint8 BranchIterations = bExtreme ? 14 : 6;
+		Cases.Add({ FString::Printf(TEXT("Micro CreateSegments %d iterations"), BranchIterations), TEXT("segment"), [Branches, BranchIterations]()
+		{
+			Branches->Iterations = BranchIterations;
+			Branches->GenerationRngStream = FRandomStream(Branches->RandomSeed);
+			Branches->CreateSegments();
+			return Branches->Segments.Num();
+		} });
+
+		// CreateLines adds the six lines of the first pyramid and leaves the rest to AddSection
+		const int32 PyramidIterations = bExtreme ? 8 : 5;
+		Cases.Add({ FString::Printf(TEXT("Micro AddSection %d iterations"), PyramidIterations), TEXT("line"), [Pyramid, PyramidIterations]()
+		{
+			Pyramid->Iterations = PyramidIterations;
+			Pyramid->CreateLines();
+			return Pyramid->Lines.Num();
+		} });
+
+		// -------------------------------------------------------
+		// Macro cases, the whole GenerateMesh of every generator
+		const FString ScaleName = bExtreme ? TEXT("extreme") : TEXT("realistic");
+		if (!bExtreme)
+		{
+			AddMacroCase<ASimpleCubeActor>(Cases, Harness, ScaleName, [](ASimpleCubeActor&) {});
+		}
+		AddMacroCase<ASimpleCylinderActor>(Cases, Harness, ScaleName, [bExtreme](ASimpleCylinderActor& Actor)
+		{
+			Actor.RadialSegmentCount = bExtreme ? 1024 : 10;
+		});
+		AddMacroCase<ACylinderStripActor>(Cases, Harness, ScaleName, [bExtreme](ACylinderStripActor& Actor)
+		{
+			FRandomStream PointStream(1238);
+			const int32 NumPoints = bExtreme ? 2000 : 20;
+			Actor.LinePoints.Reset();
+			Actor.LinePoints.Add(FVector::ZeroVector);
+			for (int32 PointIndex = 1; PointIndex < NumPoints; PointIndex++)
+			{
+				Actor.LinePoints.Add(Actor.LinePoints.Last() + PointStream.GetUnitVector() * 50.0f);
+			}
+		});
+		AddMacroCase<ASierpinskiLineActor>(Cases, Harness, ScaleName, [bExtreme](ASierpinskiLineActor& Actor)
+		{
+			Actor.Iterations = bExtreme ? 8 : 5;
+		});
+		AddMacroCase<ABranchingLinesActor>(Cases, Harness, ScaleName, [bExtreme](ABranchingLinesActor& Actor)
+		{
+			Actor.Iterations = bExtreme ? 12 : 5;
+		});
+		AddMacroCase<AHeightFieldNoiseActor>(Cases, Harness, ScaleName, [bExtreme](AHeightFieldNoiseActor& Actor)
+		{
+			Actor.LengthSections = Actor.WidthSections = bExtreme ? 1000 : 100;
+		});
+		AddMacroCase<AHeightFieldAnimatedActor>(Cases, Harness, ScaleName, [bExtreme](AHeightFieldAnimatedActor& Actor)
+		{
+			Actor.LengthSections = Actor.WidthSections = bExtreme ? 1000 : 100;
+		});
+		AddMacroCase<AVoxelGridActor>(Cases, Harness, ScaleName, [bExtreme](AVoxelGridActor& Actor)
+		{
+			Actor.SizeX = Actor.SizeY = Actor.SizeZ = bExtreme ? 128 : 32;
+		});
+		AddMacroCase<AMarchingCubesActor>(Cases, Harness, ScaleName, [bExtreme](AMarchingCubesActor& Actor)
+		{
+			Actor.SizeX = Actor.SizeY = bExtreme ? 256 : 64;
+			Actor.SizeZ = bExtreme ? 128 : 32;
+		});
+	}
+
+	// -------------------------------------------------------
+	// Run every case and compare it against the baseline
+	TMap<FString, FBaselineEntry> Baseline;
+	const bool bHasBaseline = !Settings.bWriteBaseline && LoadBaseline(Settings.BaselineFile, Baseline);
+	const double Tolerance = 1.0 + Settings.TolerancePercent / 100.0;
+
+	// A gate that can't compare anything must not pass, a missing or renamed baseline would otherwise let every regression through
+	const bool bRequireBaseline = !Settings.bWriteBaseline && !Settings.bAllowMissingBaseline;
+	if (bRequireBaseline && !bHasBaseline)
+	{
+		UE_LOG(LogProceduralMeshes, Error, TEXT("No benchmark baseline at %s, run with WriteBaseline to write one or AllowMissingBaseline to only report the results"), *Settings.BaselineFile);
+		return false;
+	}
+
+	UE_LOG(LogProceduralMeshes, Log, TEXT("Generator benchmarks, %d cases, %s"), Cases.Num(),
+		Settings.bWriteBaseline ? TEXT("writing a new baseline") : bHasBaseline ? *FString::Printf(TEXT("%.0f%% tolerance against %s"), Settings.TolerancePercent, *Settings.BaselineFile) : TEXT("no baseline"));
+	if (!CanCountAllocations())
+	{
+		UE_LOG(LogProceduralMeshes, Log, TEXT("Allocations are only counted in builds with stats, they are not compared in this one"));
+	}
+
+	FString BaselineCsv = TEXT("Case,Unit,NsPerElement,AllocationsPerRun\n");
+	int32 NumRegressions = 0;
+	int32 NumMissing = 0;
+	for (const FCase& Case : Cases)
+	{
+		const FResult Result = Measure(Case);
+		BaselineCsv += FString::Printf(TEXT("%s,%s,%.3f,%.2f\n"), *Case.Name, Case.Unit, Result.NsPerElement, Result.AllocationsPerRun);
+
+		FString Comparison;
+		bool bRegressed = false;
+		bool bMissing = false;
+		if (const FBaselineEntry* Entry = Baseline.Find(Case.Name))
+		{
+			const bool bSlower = Result.NsPerElement > Entry->NsPerElement * Tolerance;
+			const bool bMoreAllocations = CanCountAllocations() && Result.AllocationsPerRun > Entry->AllocationsPerRun * Tolerance + AllocationSlack;
+			bRegressed = bSlower || bMoreAllocations;
+			Comparison = FString::Printf(TEXT("%+.1f%% time, %+.1f allocations"), (Result.NsPerElement / FMath::Max(Entry->NsPerElement, 1e-9) - 1.0) * 100.0,
+				Result.AllocationsPerRun - Entry->AllocationsPerRun);
+		}
+		else if (bHasBaseline)
+		{
+			Comparison = TEXT("not in baseline");
+			bMissing = bRequireBaseline;
+		}
+
+		const FString Line = FString::Printf(TEXT("%-64s %10.2f ns/%-7s %10.1f allocations/run  %d %ss, %d runs  %s"),
+			*Case.Name, Result.NsPerElement, Case.Unit, Result.AllocationsPerRun, Result.NumElements, Case.Unit, Result.NumRuns, *Comparison);
+		if (bRegressed)
+		{
+			UE_LOG(LogProceduralMeshes, Error, TEXT("%s  REGRESSED"), *Line);
+			NumRegressions++;
+		}
+		else if (bMissing)
+		{
+			UE_LOG(LogProceduralMeshes, Error, TEXT("%s"), *Line);
+			NumMissing++;
+		}
+		else
+		{
+			UE_LOG(LogProceduralMeshes, Log, TEXT("%s"), *Line);
+		}
+	}
+
+	if (Settings.bWriteBaseline)
+	{
+		IFileManager::Get().MakeDirectory(*FPaths::GetPath(Settings.BaselineFile), true);
+		if (FFileHelper::SaveStringToFile(BaselineCsv, *Settings.BaselineFile))
+		{
+			UE_LOG(LogProceduralMeshes, Log, TEXT("Wrote baseline %s"), *Settings.BaselineFile);
+		}
+		else
+		{
+			UE_LOG(LogProceduralMeshes, Error, TEXT("Could not write baseline %s"), *Settings.BaselineFile);
+			return false;
+		}
+	}
+
+	if (NumRegressions > 0)
+	{
+		UE_LOG(LogProceduralMeshes, Error, TEXT("%d of %d generator benchmarks regressed by more than %.0f%%"), NumRegressions, Cases.Num(), Settings.TolerancePercent);
+	}
+	if (NumMissing > 0)
+	{
+		UE_LOG(LogProceduralMeshes, Error, TEXT("%d of %d generator benchmarks are not in %s, run with WriteBaseline to add them"), NumMissing, Cases.Num(), *Settings.BaselineFile);
+	}
+	return NumRegressions == 0 && NumMissing == 0;
+}
+
+void FProceduralMeshBenchmarks::RunBenchmark(const TArray<FString>& Args)
+{
+	// Usage: ProceduralMeshes.BenchmarkGenerators [Extreme] [WriteBaseline] [AllowMissingBaseline] [Baseline=<File>] [Tolerance=<Percent>]
+	FString Params;
+	for (const FString& Arg : Args)
+	{
+		Params += TEXT(" -") + Arg;
+	}
+
+	FSettings Settings;
+	Settings.Parse(*Params);
+	Run(Settings);
+}
+
+static FAutoConsoleCommand BenchmarkGeneratorsCommand(
+	TEXT("ProceduralMeshes.BenchmarkGenerators"),
+	TEXT("Times every generator in ns/vertex and allocations/run and compares them against a baseline. Optional arguments: Extreme, WriteBaseline, AllowMissingBaseline, Baseline=<File>, Tolerance=<Percent>."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&FProceduralMeshBenchmarks::RunBenchmark));
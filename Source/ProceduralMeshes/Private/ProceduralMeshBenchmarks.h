@@ -0,0 +1,41 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Times every generator against a saved baseline, so a change that makes generation slower or allocate more is caught
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+
+// Micro cases time one generation function on its own (GenerateCube, both GenerateGrid variants, every GenerateCylinder option,
+// CreateSegments and AddSection), macro cases time the whole GenerateMesh of every generator actor including the upload. Each case runs
+// at a realistic size, and at an extreme one when asked for, and reports nanoseconds per vertex (per segment or line for the cases that
+// don't make any vertices) and heap allocations per run. Baselines are specific to a machine and build configuration.
+class FProceduralMeshBenchmarks
+{
+public:
+	struct FSettings
+	{
+		// Also run every case at its extreme size
+		bool bExtreme;
+
+		// Results are compared against this file, or written to it with bWriteBaseline
+		FString BaselineFile;
+		bool bWriteBaseline;
+
+		// Runs without a baseline file, or with cases the baseline doesn't have, only report them rather than failing
+		bool bAllowMissingBaseline;
+
+		// How much slower, or how many more allocations, a case may get before it counts as a regression
+		float TolerancePercent;
+
+		FSettings();
+
+		// Reads Extreme, WriteBaseline, AllowMissingBaseline, Baseline=<File> and Tolerance=<Percent> from a command line or console arguments
+		void Parse(const TCHAR* Params);
+	};
+
+	// Returns false if any case regressed past the tolerance, or couldn't be compared because the baseline is missing it
+	static bool Run(const FSettings& Settings);
+
+	// Usage: ProceduralMeshes.BenchmarkGenerators [Extreme] [WriteBaseline] [AllowMissingBaseline] [Baseline=<File>] [Tolerance=<Percent>]
+	static void RunBenchmark(const TArray<FString>& Args);
+};
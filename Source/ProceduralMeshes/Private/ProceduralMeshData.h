@@ -29,4 +29,22 @@ struct PROCEDURALMESHES_API FProceduralMeshData
 
 	UPROPERTY()
 	TArray<FColor> VertexColors;
+
+	// Empties all the buffers but keeps their memory around for the next mesh
+	void Reset()
+	{
+		Vertices.Reset();
+		Triangles.Reset();
+		Normals.Reset();
+		UVs.Reset();
+		Tangents.Reset();
+		VertexColors.Reset();
+	}
+
+	// Heap memory held by all the buffers, including slack kept by Reset
+	SIZE_T GetAllocatedSize() const
+	{
+		return Vertices.GetAllocatedSize() + Triangles.GetAllocatedSize() + Normals.GetAllocatedSize() + UVs.GetAllocatedSize()
+			+ Tangents.GetAllocatedSize() + VertexColors.GetAllocatedSize();
+	}
 };
\ No newline at end of file
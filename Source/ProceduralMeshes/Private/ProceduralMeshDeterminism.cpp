@@ -0,0 +1,444 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Checks that every generator still makes the same mesh, against golden hashes and between serial and parallel generation
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshDeterminism.h"
+#include "ProceduralMeshThreading.h"
+#include "ProceduralMeshHarness.h"
+#include "IPluginManager.h"
+#include "SimpleCubeActor.h"
+#include "SimpleCylinderActor.h"
+#include "CylinderStripActor.h"
+#include "SierpinskiLineActor.h"
+#include "BranchingLinesActor.h"
+#include "HeightFieldNoiseActor.h"
+#include "HeightFieldAnimatedActor.h"
+#include "VoxelGridActor.h"
+#include "MarchingCubesActor.h"
+
+namespace ProceduralMeshDeterminism
+{
+	// Grid sizes floats are rounded to before hashing. A value that lands right on the edge of a grid cell can still flip between two
+	// cells, so these are kept well above float noise at the sizes the cases generate (a few thousand units at most).
+	const float PositionStep = 0.01f;
+	const float DirectionStep = 1.0f / 1024.0f;
+	const float UVStep = 1.0f / 4096.0f;
+
+	// Every case is generated with each of these ProceduralMeshes.MaxThreads values, the first one is the serial reference. 3 splits
+	// the loops unevenly, which catches results that depend on where a chunk boundary falls.
+	const int32 ThreadCounts[] = { 1, 3, 0 };
+
+	struct FMeshHash
+	{
+		int32 NumVertices;
+		int32 NumTriangles;
+		uint32 Positions;
+		uint32 Indices;
+		uint32 Attributes;
+
+		FMeshHash()
+			: NumVertices(0)
+			, NumTriangles(0)
+			, Positions(0)
+			, Indices(0)
+			, Attributes(0)
+		{
+		}
+
+		bool operator==(const FMeshHash& Other) const
+		{
+			return NumVertices == Other.NumVertices && NumTriangles == Other.NumTriangles
+				&& Positions == Other.Positions && Indices == Other.Indices && Attributes == Other.Attributes;
+		}
+
+		bool operator!=(const FMeshHash& Other) const
+		{
+			return !(*this == Other);
+		}
+
+		FString ToString() const
+		{
+			return FString::Printf(TEXT("%d vertices, %d triangles, positions %08x, indices %08x, attributes %08x"),
+				NumVertices, NumTriangles, Positions, Indices, Attributes);
+		}
+
+		// The parts that differ, for the log
+		FString Describe(const FMeshHash& Other) const
+		{
+			TArray<FString> Parts;
+			if (NumVertices != Other.NumVertices || NumTriangles != Other.NumTriangles)
+			{
+				Parts.Add(FString::Printf(TEXT("size %d/%d instead of %d/%d"), NumVertices, NumTriangles, Other.NumVertices, Other.NumTriangles));
+			}
+			if (Positions != Other.Positions)
+			{
+				Parts.Add(TEXT("positions"));
+			}
+			if (Indices != Other.Indices)
+			{
+				Parts.Add(TEXT("indices"));
+			}
+			if (Attributes != Other.Attributes)
+			{
+				Parts.Add(TEXT("attributes"));
+			}
+			return FString::Join(Parts, TEXT(", "));
+		}
+	};
+
+	int32 Quantize(float Value, float Step)
+	{
+		return FMath::RoundToInt(Value / Step);
+	}
+
+	uint32 HashVector(const FVector& Vector, float Step, uint32 Crc)
+	{
+		const int32 Quantized[3] = { Quantize(Vector.X, Step), Quantize(Vector.Y, Step), Quantize(Vector.Z, Step) };
+		return FCrc::MemCrc32(Quantized, sizeof(Quantized), Crc);
+	}
+
+	FMeshHash HashMesh(UProceduralMeshComponent* ProcMesh)
+	{
+		FMeshHash Hash;
+		FProceduralMeshHarness::ForEachVisibleSection(ProcMesh, [&Hash](int32 SectionIndex, const FProcMeshSection& Section)
+		{
+			// The section number goes into every hash, so moving triangles from one section to another is a change too
+			Hash.Positions = FCrc::MemCrc32(&SectionIndex, sizeof(SectionIndex), Hash.Positions);
+			Hash.Indices = FCrc::MemCrc32(&SectionIndex, sizeof(SectionIndex), Hash.Indices);
+			Hash.Attributes = FCrc::MemCrc32(&SectionIndex, sizeof(SectionIndex), Hash.Attributes);
+
+			for (const FProcMeshVertex& Vertex : Section.ProcVertexBuffer)
+			{
+				Hash.Positions = HashVector(Vertex.Position, PositionStep, Hash.Positions);
+
+				Hash.Attributes = HashVector(Vertex.Normal, DirectionStep, Hash.Attributes);
+				Hash.Attributes = HashVector(Vertex.Tangent.TangentX, DirectionStep, Hash.Attributes);
+				const int32 UVAndFlip[3] = { Quantize(Vertex.UV0.X, UVStep), Quantize(Vertex.UV0.Y, UVStep), Vertex.Tangent.bFlipTangentY ? 1 : 0 };
+				Hash.Attributes = FCrc::MemCrc32(UVAndFlip, sizeof(UVAndFlip), Hash.Attributes);
+				const uint32 Color = Vertex.Color.DWColor();
+				Hash.Attributes = FCrc::MemCrc32(&Color, sizeof(Color), Hash.Attributes);
+			}
+
+			Hash.Indices = FCrc::MemCrc32(Section.ProcIndexBuffer.GetData(), Section.ProcIndexBuffer.Num() * Section.ProcIndexBuffer.GetTypeSize(), Hash.Indices);
+			Hash.NumVertices += Section.ProcVertexBuffer.Num();
+			Hash.NumTriangles += Section.ProcIndexBuffer.Num() / 3;
+		});
+		return Hash;
+	}
+
+	struct FCase
+	{
+		FString Name;
+		AProceduralMeshActor* Actor;
+		UProceduralMeshComponent* ProcMesh;
+	};
+
+	template<typename ActorType, typename FunctionType>
+	void AddCase(TArray<FCase>& Cases, FProceduralMeshHarness& Harness, const FString& Name, const FunctionType& Setup)
+	{
+		FCase& Case = Cases[Cases.AddDefaulted()];
+		Case.Name = FString::Printf(TEXT("%s %s"), *ActorType::StaticClass()->GetName(), *Name);
+		Case.Actor = Harness.Spawn<ActorType>(Setup);
+		Case.ProcMesh = Case.Actor->FindComponentByClass<UProceduralMeshComponent>();
+	}
+
+	// The parameter matrix. Changing anything in here changes the case names or hashes, so the golden file has to be written again.
+	void AddCases(TArray<FCase>& Cases, FProceduralMeshHarness& Harness)
+	{
+		const int32 Seeds[] = { 1238, 42, 90210 };
+
+		AddCase<ASimpleCubeActor>(Cases, Harness, TEXT("default"), [](ASimpleCubeActor&) {});
+		AddCase<ASimpleCubeActor>(Cases, Harness, TEXT("50x200x10"), [](ASimpleCubeActor& Actor)
+		{
+			Actor.Depth = 50.0f;
+			Actor.Width = 200.0f;
+			Actor.Height = 10.0f;
+		});
+
+		for (int32 Flags = 0; Flags < 8; Flags++)
+		{
+			const bool bCapEnds = (Flags & 1) != 0;
+			const bool bDoubleSided = (Flags & 2) != 0;
+			const bool bSmoothNormals = (Flags & 4) != 0;
+			AddCase<ASimpleCylinderActor>(Cases, Harness, FString::Printf(TEXT("segments=13 caps=%d doublesided=%d smooth=%d"), bCapEnds, bDoubleSided, bSmoothNormals),
+				[bCapEnds, bDoubleSided, bSmoothNormals](ASimpleCylinderActor& Actor)
+			{
+				Actor.RadialSegmentCount = 13;
+				Actor.bCapEnds = bCapEnds;
+				Actor.bDoubleSided = bDoubleSided;
+				Actor.bSmoothNormals = bSmoothNormals;
+			});
+		}
+
+		for (int32 Flags = 0; Flags < 4; Flags++)
+		{
+			const bool bContinuousTube = (Flags & 1) != 0;
+			const bool bSplineInterpolation = (Flags & 2) != 0;
+			AddCase<ACylinderStripActor>(Cases, Harness, FString::Printf(TEXT("seed=%d continuous=%d spline=%d"), Seeds[0], bContinuousTube, bSplineInterpolation),
+				[&Seeds, bContinuousTube, bSplineInterpolation](ACylinderStripActor& Actor)
+			{
+				FRandomStream PointStream(Seeds[0]);
+				Actor.LinePoints.Reset();
+				Actor.LinePoints.Add(FVector::ZeroVector);
+				for (int32 PointIndex = 1; PointIndex < 40; PointIndex++)
+				{
+					Actor.LinePoints.Add(Actor.LinePoints.Last() + PointStream.GetUnitVector() * 50.0f);
+				}
+				Actor.bContinuousTube = bContinuousTube;
+				Actor.bSplineInterpolation = bSplineInterpolation;
+			});
+		}
+
+		const int32 PyramidIterations[] = { 3, 5 };
+		for (const int32 Iterations : PyramidIterations)
+		{
+			AddCase<ASierpinskiLineActor>(Cases, Harness, FString::Printf(TEXT("iterations=%d smooth=%d"), Iterations, Iterations > 3), [Iterations](ASierpinskiLineActor& Actor)
+			{
+				Actor.Iterations = Iterations;
+				Actor.bSmoothNormals = Iterations > 3;
+			});
+		}
+
+		for (const int32 Seed : Seeds)
+		{
+			AddCase<ABranchingLinesActor>(Cases, Harness, FString::Printf(TEXT("seed=%d iterations=7"), Seed), [Seed](ABranchingLinesActor& Actor)
+			{
+				Actor.RandomSeed = Seed;
+				Actor.Iterations = 7;
+			});
+		}
+		AddCase<ABranchingLinesActor>(Cases, Harness, FString::Printf(TEXT("seed=%d iterations=7 welded"), Seeds[0]), [&Seeds](ABranchingLinesActor& Actor)
+		{
+			Actor.RandomSeed = Seeds[0];
+			Actor.Iterations = 7;
+			Actor.bWeldVertices = true;
+		});
+
+		for (const int32 Seed : Seeds)
+		{
+			AddCase<AHeightFieldNoiseActor>(Cases, Harness, FString::Printf(TEXT("seed=%d 64x64"), Seed), [Seed](AHeightFieldNoiseActor& Actor)
+			{
+				Actor.RandomSeed = Seed;
+				Actor.LengthSections = Actor.WidthSections = 64;
+			});
+		}
+		AddCase<AHeightFieldNoiseActor>(Cases, Harness, FString::Printf(TEXT("seed=%d 64x64 decimated optimized"), Seeds[0]), [&Seeds](AHeightFieldNoiseActor& Actor)
+		{
+			Actor.RandomSeed = Seeds[0];
+			Actor.LengthSections = Actor.WidthSections = 64;
+			Actor.bDecimate = true;
+			Actor.bOptimizeVertexCache = true;
+		});
+
+		// Not animated, the animated heights depend on the time the case happens to run at. The heights are waves rather than noise,
+		// so the wave scale is varied instead of the seed.
+		const float WaveScales[] = { 0.5f, 1.0f, 2.5f };
+		for (const float WaveScale : WaveScales)
+		{
+			AddCase<AHeightFieldAnimatedActor>(Cases, Harness, FString::Printf(TEXT("scale=%.1f 64x64"), WaveScale), [WaveScale](AHeightFieldAnimatedActor& Actor)
+			{
+				Actor.ScaleFactor = WaveScale;
+				Actor.LengthSections = Actor.WidthSections = 64;
+				Actor.AnimateMesh = false;
+			});
+		}
+
+		for (const int32 Seed : Seeds)
+		{
+			AddCase<AVoxelGridActor>(Cases, Harness, FString::Printf(TEXT("seed=%d 40x40x40"), Seed), [Seed](AVoxelGridActor& Actor)
+			{
+				Actor.RandomSeed = Seed;
+				Actor.SizeX = Actor.SizeY = Actor.SizeZ = 40;
+				Actor.FillPercentage = 60.0f;
+			});
+		}
+
+		for (const int32 Seed : Seeds)
+		{
+			AddCase<AMarchingCubesActor>(Cases, Harness, FString::Printf(TEXT("seed=%d 48x48x24"), Seed), [Seed](AMarchingCubesActor& Actor)
+			{
+				Actor.RandomSeed = Seed;
+				Actor.SizeX = Actor.SizeY = 48;
+				Actor.SizeZ = 24;
+			});
+		}
+	}
+
+	bool LoadGolden(const FString& Filename, TMap<FString, FMeshHash>& OutGolden)
+	{
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadFileToStringArray(Lines, *Filename))
+		{
+			return false;
+		}
+
+		// Case,Vertices,Triangles,Positions,Indices,Attributes with a header line, case names never have commas in them
+		for (int32 LineIndex = 1; LineIndex < Lines.Num(); LineIndex++)
+		{
+			TArray<FString> Fields;
+			if (Lines[LineIndex].ParseIntoArray(Fields, TEXT(","), false) == 6)
+			{
+				FMeshHash& Hash = OutGolden.Add(Fields[0]);
+				Hash.NumVertices = FCString::Atoi(*Fields[1]);
+				Hash.NumTriangles = FCString::Atoi(*Fields[2]);
+				Hash.Positions = (uint32)FCString::Strtoui64(*Fields[3], nullptr, 16);
+				Hash.Indices = (uint32)FCString::Strtoui64(*Fields[4], nullptr, 16);
+				Hash.Attributes = (uint32)FCString::Strtoui64(*Fields[5], nullptr, 16);
+			}
+		}
+		return true;
+	}
+}
+
+FProceduralMeshDeterminism::FSettings::FSettings()
+	: bWriteGolden(false)
+{
+	// Kept with the plugin rather than the project, so the golden hashes are checked in next to the code they belong to
+	TSharedPtr<IPlugin> Plugin = IPluginManager::Get().FindPlugin(TEXT("ProceduralMeshes"));
+	const FString BaseDir = Plugin.IsValid() ? Plugin->GetBaseDir() : FPaths::GameSavedDir() / TEXT("ProceduralMeshes");
+	GoldenFile = BaseDir / TEXT("Resources") / TEXT("DeterminismGolden.csv");
+}
+
+void FProceduralMeshDeterminism::FSettings::Parse(const TCHAR* Params)
+{
+	bWriteGolden = FParse::Param(Params, TEXT("WriteGolden"));
+	FParse::Value(Params, TEXT("Golden="), GoldenFile);
+}
+
+bool FProceduralMeshDeterminism::Run(const FSettings& Settings)
+{
+	using namespace ProceduralMeshDeterminism;
+
+	FProceduralMeshHarness Harness;
+	const int32 PreviousMaxThreads = FProceduralMeshThreading::GetMaxThreads();
+
+	TArray<FCase> Cases;
+	AddCases(Cases, Harness);
+
+	// Without golden hashes the check can't tell if anything changed, so that fails the run too. The thread counts are still compared.
+	TMap<FString, FMeshHash> Golden;
+	int32 NumFailures = 0;
+	if (Settings.bWriteGolden)
+	{
+		UE_LOG(LogProceduralMeshes, Log, TEXT("Determinism check, %d cases, writing new golden hashes"), Cases.Num());
+	}
+	else if (LoadGolden(Settings.GoldenFile, Golden))
+	{
+		UE_LOG(LogProceduralMeshes, Log, TEXT("Determinism check, %d cases against %s"), Cases.Num(), *Settings.GoldenFile);
+	}
+	else
+	{
+		UE_LOG(LogProceduralMeshes, Error, TEXT("Determinism check, %d cases, could not read golden hashes %s. Run with WriteGolden to create them."), Cases.Num(), *Settings.GoldenFile);
+		NumFailures++;
+	}
+
+	// -------------------------------------------------------
+	// Every case with every thread count, against the serial run and then against the golden hash
+	FString GoldenCsv = TEXT("Case,Vertices,Triangles,Positions,Indices,Attributes\n");
+	for (const FCase& Case : Cases)
+	{
+		if (!Case.ProcMesh)
+		{
+			UE_LOG(LogProceduralMeshes, Error, TEXT("%s has no procedural mesh component"), *Case.Name);
+			NumFailures++;
+			continue;
+		}
+
+		FMeshHash SerialHash;
+		FString Failure;
+		for (int32 ThreadsIndex = 0; ThreadsIndex < ARRAY_COUNT(ThreadCounts); ThreadsIndex++)
+		{
+			FProceduralMeshThreading::SetMaxThreads(ThreadCounts[ThreadsIndex]);
+			FProceduralMeshHarness::Generate(Case.Actor);
+
+			const FMeshHash Hash = HashMesh(Case.ProcMesh);
+			if (ThreadsIndex == 0)
+			{
+				SerialHash = Hash;
+			}
+			else if (Hash != SerialHash && Failure.IsEmpty())
+			{
+				Failure = FString::Printf(TEXT("MaxThreads=%d differs from serial in %s"), ThreadCounts[ThreadsIndex], *Hash.Describe(SerialHash));
+			}
+		}
+
+		GoldenCsv += FString::Printf(TEXT("%s,%d,%d,%08x,%08x,%08x\n"), *Case.Name, SerialHash.NumVertices, SerialHash.NumTriangles,
+			SerialHash.Positions, SerialHash.Indices, SerialHash.Attributes);
+
+		// A case the golden file doesn't know about hasn't been checked against anything, so it fails until the file is written again
+		const FMeshHash* GoldenHash = Golden.Find(Case.Name);
+		if (!Settings.bWriteGolden && Failure.IsEmpty())
+		{
+			if (!GoldenHash)
+			{
+				Failure = TEXT("not in golden file");
+			}
+			else if (*GoldenHash != SerialHash)
+			{
+				Failure = FString::Printf(TEXT("differs from golden in %s"), *SerialHash.Describe(*GoldenHash));
+			}
+		}
+
+		if (!Failure.IsEmpty())
+		{
+			UE_LOG(LogProceduralMeshes, Error, TEXT("%-64s %s  FAILED: %s"), *Case.Name, *SerialHash.ToString(), *Failure);
+			NumFailures++;
+		}
+		else
+		{
+			UE_LOG(LogProceduralMeshes, Log, TEXT("%-64s %s"), *Case.Name, *SerialHash.ToString());
+		}
+	}
+
+	FProceduralMeshThreading::SetMaxThreads(PreviousMaxThreads);
+
+	if (Settings.bWriteGolden)
+	{
+		IFileManager::Get().MakeDirectory(*FPaths::GetPath(Settings.GoldenFile), true);
+		if (FFileHelper::SaveStringToFile(GoldenCsv, *Settings.GoldenFile))
+		{
+			UE_LOG(LogProceduralMeshes, Log, TEXT("Wrote golden hashes %s"), *Settings.GoldenFile);
+		}
+		else
+		{
+			UE_LOG(LogProceduralMeshes, Error, TEXT("Could not write golden hashes %s"), *Settings.GoldenFile);
+			return false;
+		}
+	}
+
+	if (NumFailures > 0)
+	{
+		UE_LOG(LogProceduralMeshes, Error, TEXT("%d determinism failures over %d cases"), NumFailures, Cases.Num());
+
+		// Saved next to the other results rather than over the golden file, so an intended change is reviewed before it is copied over
+		if (!Settings.bWriteGolden)
+		{
+			const FString ActualFile = FPaths::GameSavedDir() / TEXT("ProceduralMeshes") / TEXT("DeterminismActual.csv");
+			IFileManager::Get().MakeDirectory(*FPaths::GetPath(ActualFile), true);
+			if (FFileHelper::SaveStringToFile(GoldenCsv, *ActualFile))
+			{
+				UE_LOG(LogProceduralMeshes, Log, TEXT("Wrote the hashes of this run to %s, copy it over %s if the changes are intended"), *ActualFile, *Settings.GoldenFile);
+			}
+		}
+	}
+	return NumFailures == 0;
+}
+
+void FProceduralMeshDeterminism::RunCheck(const TArray<FString>& Args)
+{
+	// Usage: ProceduralMeshes.CheckDeterminism [WriteGolden] [Golden=<File>]
+	FString Params;
+	for (const FString& Arg : Args)
+	{
+		Params += TEXT(" -") + Arg;
+	}
+
+	FSettings Settings;
+	Settings.Parse(*Params);
+	Run(Settings);
+}
+
+static FAutoConsoleCommand CheckDeterminismCommand(
+	TEXT("ProceduralMeshes.CheckDeterminism"),
+	TEXT("Generates every generator over a fixed parameter matrix serially and in parallel, and compares the mesh hashes with each other and the golden file. Optional arguments: WriteGolden, Golden=<File>."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&FProceduralMeshDeterminism::RunCheck));
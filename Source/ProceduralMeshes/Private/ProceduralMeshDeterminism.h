@@ -0,0 +1,32 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Checks that every generator still makes the same mesh, against golden hashes and between serial and parallel generation
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+
+// Every generator is built over a fixed set of parameters and seeds, and each mesh is reduced to three hashes: positions, indices and
+// the other vertex attributes. Floats are rounded to a grid before they are hashed, fine enough that any visible change moves them but
+// coarse enough that the last bits a different compiler or instruction order produces don't. Each case is generated on one thread,
+// on a few and on every task graph thread, and all of them have to give the same hashes as each other and as the golden file.
+class FProceduralMeshDeterminism
+{
+public:
+	struct FSettings
+	{
+		// Hashes are compared against this file, or written to it with bWriteGolden
+		FString GoldenFile;
+		bool bWriteGolden;
+
+		FSettings();
+
+		// Reads WriteGolden and Golden=<File> from a command line or console arguments
+		void Parse(const TCHAR* Params);
+	};
+
+	// Returns false if any case changed, came out differently depending on the thread count, or has no golden hash to compare with
+	static bool Run(const FSettings& Settings);
+
+	// Usage: ProceduralMeshes.CheckDeterminism [WriteGolden] [Golden=<File>]
+	static void RunCheck(const TArray<FString>& Args);
+};
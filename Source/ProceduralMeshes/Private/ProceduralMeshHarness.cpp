@@ -0,0 +1,31 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Spawns generators into a world of their own and reads back the mesh they uploaded
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshHarness.h"
+
+FProceduralMeshHarness::FProceduralMeshHarness()
+	: World(UWorld::CreateWorld(EWorldType::Game, false))
+{
+}
+
+FProceduralMeshHarness::~FProceduralMeshHarness()
+{
+	World->DestroyWorld(false);
+}
+
+void FProceduralMeshHarness::Generate(AProceduralMeshActor* Actor)
+{
+	Actor->GenerateMesh();
+	FTaskGraphInterface::Get().ProcessThreadUntilIdle(ENamedThreads::GameThread);
+}
+
+int32 FProceduralMeshHarness::GetNumVisibleVertices(const AActor* Actor)
+{
+	int32 NumVertices = 0;
+	ForEachVisibleSection(Actor->FindComponentByClass<UProceduralMeshComponent>(), [&NumVertices](int32, const FProcMeshSection& Section)
+	{
+		NumVertices += Section.ProcVertexBuffer.Num();
+	});
+	return NumVertices;
+}
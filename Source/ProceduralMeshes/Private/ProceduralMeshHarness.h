@@ -0,0 +1,65 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Spawns generators into a world of their own and reads back the mesh they uploaded
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshComponent.h"
+#include "ProceduralMeshActor.h"
+
+// Shared by the benchmarks, the determinism check and the batch commandlet. The world is created with the harness and destroyed with it,
+// and is never played, so nothing else generates or ticks while the generators in it are measured.
+class FProceduralMeshHarness
+{
+public:
+	FProceduralMeshHarness();
+	~FProceduralMeshHarness();
+
+	// The properties are set before the actor is constructed, so construction builds with them rather than with the defaults
+	template<typename ActorType, typename FunctionType>
+	ActorType* Spawn(UClass* Class, const FunctionType& Setup)
+	{
+		ActorType* Actor = World->SpawnActorDeferred<ActorType>(Class, FTransform::Identity);
+		Setup(*Actor);
+		Actor->FinishSpawning(FTransform::Identity);
+		return Actor;
+	}
+
+	template<typename ActorType, typename FunctionType>
+	ActorType* Spawn(const FunctionType& Setup)
+	{
+		return Spawn<ActorType>(ActorType::StaticClass(), Setup);
+	}
+
+	// Construction may start a background build in the editor, the GenerateMesh straight after it waits for that build to finish
+	template<typename ActorType, typename FunctionType>
+	ActorType* SpawnGenerated(const FunctionType& Setup)
+	{
+		ActorType* Actor = Spawn<ActorType>(Setup);
+		Actor->GenerateMesh();
+		return Actor;
+	}
+
+	// GenerateMesh, and then lets anything that finishes in the background (like collision) land before the next generation
+	static void Generate(AProceduralMeshActor* Actor);
+
+	// Calls Visit(SectionIndex, Section) for every visible section. Hidden sections are lower LODs that may or may not have been
+	// generated yet, so they never count.
+	template<typename FunctionType>
+	static void ForEachVisibleSection(UProceduralMeshComponent* ProcMesh, const FunctionType& Visit)
+	{
+		for (int32 SectionIndex = 0; ProcMesh && SectionIndex < ProcMesh->GetNumSections(); SectionIndex++)
+		{
+			const FProcMeshSection* Section = ProcMesh->GetProcMeshSection(SectionIndex);
+			if (Section && Section->bSectionVisible)
+			{
+				Visit(SectionIndex, *Section);
+			}
+		}
+	}
+
+	static int32 GetNumVisibleVertices(const AActor* Actor);
+
+private:
+	UWorld* World;
+};
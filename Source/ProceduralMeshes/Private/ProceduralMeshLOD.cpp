@@ -0,0 +1,104 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Keeps track of a chain of discrete LODs, each stored in its own mesh section
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshLOD.h"
+
+void FProceduralMeshLODChain::Reset(int32 InNumLODs)
+{
+	NumLODs = FMath::Max(1, InNumLODs);
+	CurrentLOD = INDEX_NONE;
+	GeneratedLODs.Init(false, NumLODs);
+}
+
+bool FProceduralMeshLODChain::IsGenerated(int32 LODIndex) const
+{
+	return GeneratedLODs.IsValidIndex(LODIndex) && GeneratedLODs[LODIndex];
+}
+
+void FProceduralMeshLODChain::MarkGenerated(int32 LODIndex)
+{
+	if (GeneratedLODs.IsValidIndex(LODIndex))
+	{
+		GeneratedLODs[LODIndex] = true;
+	}
+}
+
+int32 FProceduralMeshLODChain::GetDesiredLOD(const UPrimitiveComponent* Component, const TArray<float>& InScreenSizes) const
+{
+	float ScreenSize = 0.0f;
+	if (NumLODs <= 1 || !ComputeScreenSize(Component, ScreenSize))
+	{
+		return CurrentLOD;
+	}
+
+	// InScreenSizes[0] is the threshold for switching from LOD0 to LOD1, and so on
+	int32 DesiredLOD = 0;
+	for (int32 i = 0; i < InScreenSizes.Num() && DesiredLOD < NumLODs - 1; i++)
+	{
+		if (ScreenSize >= InScreenSizes[i])
+		{
+			break;
+		}
+		DesiredLOD++;
+	}
+
+	return DesiredLOD;
+}
+
+void FProceduralMeshLODChain::ShowLOD(UProceduralMeshComponent* ProcMesh, int32 LODIndex)
+{
+	for (int32 i = 0; i < NumLODs; i++)
+	{
+		// Sections that haven't been generated yet don't exist in the PMC
+		if (IsGenerated(i))
+		{
+			ProcMesh->SetMeshSectionVisible(i, i == LODIndex);
+		}
+	}
+
+	CurrentLOD = LODIndex;
+}
+
+int32 FProceduralMeshLODChain::GetRadialSegmentCountForLOD(int32 InRadialSegmentCount, int32 LODIndex)
+{
+	return FMath::Max(FMath::Min(InRadialSegmentCount, 3), InRadialSegmentCount >> LODIndex);
+}
+
+bool FProceduralMeshLODChain::ComputeScreenSize(const UPrimitiveComponent* Component, float& OutScreenSize)
+{
+	const UWorld* World = Component ? Component->GetWorld() : nullptr;
+	if (World == nullptr || World->ViewLocationsRenderedLastFrame.Num() == 0)
+	{
+		return false;
+	}
+
+	// We only care about the closest view
+	const FBoxSphereBounds& Bounds = Component->Bounds;
+	float ClosestDistanceSquared = MAX_FLT;
+	for (const FVector& ViewLocation : World->ViewLocationsRenderedLastFrame)
+	{
+		ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, FVector::DistSquared(ViewLocation, Bounds.Origin));
+	}
+
+	// Editor viewports don't have a camera manager, assume the default 90 degree FOV there
+	float FOVAngle = 90.0f;
+	APlayerController* PlayerController = World->GetFirstPlayerController();
+	if (PlayerController && PlayerController->PlayerCameraManager)
+	{
+		FOVAngle = PlayerController->PlayerCameraManager->GetFOVAngle();
+	}
+
+	const float HalfFOVTan = FMath::Tan(FMath::DegreesToRadians(FOVAngle * 0.5f));
+	const float Distance = FMath::Max(1.0f, FMath::Sqrt(ClosestDistanceSquared));
+	OutScreenSize = Bounds.SphereRadius / (Distance * FMath::Max(HalfFOVTan, KINDA_SMALL_NUMBER));
+	return true;
+}
+
+void FProceduralMeshLODChain::GetDefaultScreenSizes(TArray<float>& OutScreenSizes)
+{
+	OutScreenSizes.Empty();
+	OutScreenSizes.Add(0.5f);
+	OutScreenSizes.Add(0.25f);
+	OutScreenSizes.Add(0.125f);
+}
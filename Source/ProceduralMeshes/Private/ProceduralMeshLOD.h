@@ -0,0 +1,60 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Keeps track of a chain of discrete LODs, each stored in its own mesh section
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshComponent.h"
+
+struct PROCEDURALMESHES_API FProceduralMeshLODChain
+{
+	FProceduralMeshLODChain()
+		: NumLODs(1)
+		, CurrentLOD(INDEX_NONE)
+	{
+	}
+
+	// Forget all generated LODs, must be called whenever the mesh is rebuilt from scratch
+	void Reset(int32 InNumLODs);
+
+	bool IsGenerated(int32 LODIndex) const;
+	void MarkGenerated(int32 LODIndex);
+
+	// Returns the LOD we want to display right now, or CurrentLOD if we can't tell (no views rendered yet)
+	int32 GetDesiredLOD(const UPrimitiveComponent* Component, const TArray<float>& InScreenSizes) const;
+
+	// Makes the section for the given LOD the only visible one
+	void ShowLOD(UProceduralMeshComponent* ProcMesh, int32 LODIndex);
+
+	// Shows the LOD for the current screen size, calling GenerateLOD(LODIndex) first if it hasn't been generated yet
+	template <typename GenerateLODType>
+	void Update(UProceduralMeshComponent* ProcMesh, const TArray<float>& InScreenSizes, GenerateLODType GenerateLOD)
+	{
+		const int32 DesiredLOD = GetDesiredLOD(ProcMesh, InScreenSizes);
+		if (DesiredLOD != CurrentLOD && DesiredLOD != INDEX_NONE)
+		{
+			// Lower LODs are only generated the first time we need them
+			if (!IsGenerated(DesiredLOD))
+			{
+				GenerateLOD(DesiredLOD);
+			}
+			ShowLOD(ProcMesh, DesiredLOD);
+		}
+	}
+
+	// Each LOD halves the radial segment count of the one before it, but we never go below a triangle
+	static int32 GetRadialSegmentCountForLOD(int32 InRadialSegmentCount, int32 LODIndex);
+
+	// Same definition the engine uses for static mesh LODs: bounding sphere radius relative to half the screen.
+	// Returns false if nothing has been rendered yet.
+	static bool ComputeScreenSize(const UPrimitiveComponent* Component, float& OutScreenSize);
+
+	// Sensible defaults for actors that don't specify their own thresholds
+	static void GetDefaultScreenSizes(TArray<float>& OutScreenSizes);
+
+	int32 NumLODs;
+	int32 CurrentLOD;
+
+private:
+	TArray<bool> GeneratedLODs;
+};
@@ -0,0 +1,400 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Merges many simple cube and cylinder actors into a single procedural mesh, with one section per material
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshMergeActor.h"
+#include "SimpleCubeActor.h"
+#include "SimpleCylinderActor.h"
+#include "ProceduralMeshThreading.h"
+#include "EngineUtils.h"
+
+AProceduralMeshMergeActor::AProceduralMeshMergeActor()
+{
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootScene"));
+	ProcMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("ProceduralMesh"));
+	ProcMesh->AttachTo(RootComponent);
+	// Make sure the PMC doesnt save any mesh data with the map
+	ProcMesh->SetFlags(EObjectFlags::RF_Transient);
+}
+
+#if WITH_EDITOR
+void AProceduralMeshMergeActor::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+
+	// Keep the merged mesh up to date while the source actors are being edited
+	if (!OnObjectPropertyChangedHandle.IsValid())
+	{
+		OnObjectPropertyChangedHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddUObject(this, &AProceduralMeshMergeActor::OnObjectPropertyChanged);
+	}
+	if (!OnActorMovedHandle.IsValid() && GEngine)
+	{
+		OnActorMovedHandle = GEngine->OnActorMoved().AddUObject(this, &AProceduralMeshMergeActor::OnActorMoved);
+	}
+
+	MergeAll();
+}
+
+void AProceduralMeshMergeActor::OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEvent)
+{
+	if (AActor* ChangedActor = Cast<AActor>(Object))
+	{
+		if (ChangedActor != this && CanMerge(ChangedActor))
+		{
+			RemergeActor(ChangedActor);
+		}
+	}
+}
+
+void AProceduralMeshMergeActor::OnActorMoved(AActor* Actor)
+{
+	if (Actor == this)
+	{
+		// Everything is stored relative to us, so all the chunks need to be transformed again
+		MergeAll();
+	}
+	else if (CanMerge(Actor))
+	{
+		RemergeActor(Actor);
+	}
+}
+#endif // WITH_EDITOR
+
+void AProceduralMeshMergeActor::BeginPlay()
+{
+	Super::BeginPlay();
+	MergeAll();
+
+	// Fix for PCM location/rotation/scale since the whole component is Transient
+	ProcMesh->SetWorldLocation(this->GetActorLocation());
+	ProcMesh->SetWorldRotation(this->GetActorRotation());
+	ProcMesh->SetWorldScale3D(this->GetActorScale3D());
+}
+
+void AProceduralMeshMergeActor::BeginDestroy()
+{
+#if WITH_EDITOR
+	FCoreUObjectDelegates::OnObjectPropertyChanged.Remove(OnObjectPropertyChangedHandle);
+	OnObjectPropertyChangedHandle.Reset();
+	if (GEngine)
+	{
+		GEngine->OnActorMoved().Remove(OnActorMovedHandle);
+	}
+	OnActorMovedHandle.Reset();
+#endif // WITH_EDITOR
+
+	Super::BeginDestroy();
+}
+
+void AProceduralMeshMergeActor::Destroyed()
+{
+	// Don't leave the source actors hidden once there is no merged mesh standing in for them
+	ShowHiddenSourceActors();
+	Super::Destroyed();
+}
+
+bool AProceduralMeshMergeActor::CanMerge(const AActor* Actor)
+{
+	return Actor && !Actor->IsPendingKill() && (Actor->IsA(ASimpleCubeActor::StaticClass()) || Actor->IsA(ASimpleCylinderActor::StaticClass()));
+}
+
+void AProceduralMeshMergeActor::MergeAll()
+{
+	// -------------------------------------------------------
+	// Gather the source actors, each one becomes a chunk
+	TArray<AActor*> ActorsToMerge;
+	if (bMergeAllInLevel)
+	{
+		if (UWorld* World = GetWorld())
+		{
+			for (TActorIterator<AActor> It(World); It; ++It)
+			{
+				if (CanMerge(*It))
+				{
+					ActorsToMerge.Add(*It);
+				}
+			}
+		}
+	}
+	else
+	{
+		for (AActor* EachActor : SourceActors)
+		{
+			if (CanMerge(EachActor))
+			{
+				ActorsToMerge.AddUnique(EachActor);
+			}
+		}
+	}
+
+	// Actors that were removed from SourceActors, or merged while bHideSourceActors was on, are shown again before hiding the current ones
+	ShowHiddenSourceActors();
+	Chunks.Empty(ActorsToMerge.Num());
+	Chunks.AddDefaulted(ActorsToMerge.Num());
+	for (int32 ChunkIndex = 0; ChunkIndex < ActorsToMerge.Num(); ChunkIndex++)
+	{
+		Chunks[ChunkIndex].SourceActor = ActorsToMerge[ChunkIndex];
+		if (bHideSourceActors)
+		{
+			ActorsToMerge[ChunkIndex]->GetRootComponent()->SetVisibility(false, true);
+			HiddenSourceActors.Add(ActorsToMerge[ChunkIndex]);
+		}
+	}
+
+	// -------------------------------------------------------
+	// The chunks don't share any data, so they can all be generated at the same time
+	FProceduralMeshThreading::ParallelFor(Chunks.Num(), [this](int32 ChunkIndex)
+	{
+		BuildChunk(Chunks[ChunkIndex]);
+	});
+
+	if (bCompactChunkData && Chunks.Num() > 0)
+	{
+		int32 NumVertices = 0;
+		int32 BytesBefore = 0;
+		int32 BytesAfter = 0;
+		double EncodeSeconds = 0.0;
+		for (const FProceduralMeshMergeChunk& EachChunk : Chunks)
+		{
+			NumVertices += EachChunk.GetNumVertices();
+			BytesBefore += EachChunk.CompactStats.BytesPerVertexBefore * EachChunk.GetNumVertices();
+			BytesAfter += EachChunk.CompactStats.BytesPerVertexAfter * EachChunk.GetNumVertices();
+			EncodeSeconds += EachChunk.CompactStats.Seconds;
+		}
+
+		UE_LOG(LogProceduralMeshes, Log, TEXT("%s: stored %d vertices in %d chunks at %.1f bytes per vertex instead of %.1f, %.2f ms"),
+			*GetName(), NumVertices, Chunks.Num(), (float)BytesAfter / FMath::Max(NumVertices, 1), (float)BytesBefore / FMath::Max(NumVertices, 1), EncodeSeconds * 1000.0);
+	}
+
+	// -------------------------------------------------------
+	// Group the chunks by material, in the order they were found
+	SectionMaterials.Empty();
+	for (const FProceduralMeshMergeChunk& EachChunk : Chunks)
+	{
+		FindOrAddSection(EachChunk.Material);
+	}
+
+	MergedSections.Empty(SectionMaterials.Num());
+	MergedSections.AddDefaulted(SectionMaterials.Num());
+	FProceduralMeshThreading::ParallelFor(SectionMaterials.Num(), [this](int32 SectionIndex)
+	{
+		MergeSection(SectionIndex);
+	});
+
+	// The component can only be updated from the game thread
+	ProcMesh->ClearAllMeshSections();
+	for (int32 SectionIndex = 0; SectionIndex < SectionMaterials.Num(); SectionIndex++)
+	{
+		UploadSection(SectionIndex);
+	}
+	UpdateChunkMemory();
+}
+
+void AProceduralMeshMergeActor::RemergeActor(AActor* SourceActor)
+{
+	FProceduralMeshMergeChunk* Chunk = Chunks.FindByPredicate([SourceActor](const FProceduralMeshMergeChunk& EachChunk) { return EachChunk.SourceActor.Get() == SourceActor; });
+	if (!Chunk)
+	{
+		// Only actors that were part of the last full merge are picked up individually
+		return;
+	}
+
+	int32 OldSectionIndex = SectionMaterials.Find(Chunk->Material);
+	BuildChunk(*Chunk);
+	int32 NewSectionIndex = FindOrAddSection(Chunk->Material);
+	MergedSections.SetNum(SectionMaterials.Num());
+
+	// Only the sections the chunk moved out of and into need to be rebuilt
+	MergeSection(NewSectionIndex);
+	UploadSection(NewSectionIndex);
+	if (OldSectionIndex != INDEX_NONE && OldSectionIndex != NewSectionIndex)
+	{
+		MergeSection(OldSectionIndex);
+		UploadSection(OldSectionIndex);
+	}
+	UpdateChunkMemory();
+}
+
+void AProceduralMeshMergeActor::BuildChunk(FProceduralMeshMergeChunk& Chunk) const
+{
+	Chunk.MeshData.Reset();
+	Chunk.CompactMeshData.Reset();
+	Chunk.CompactStats = FCompactMeshStats();
+	Chunk.Material = nullptr;
+
+	AActor* SourceActor = Chunk.SourceActor.Get();
+	if (const ASimpleCubeActor* Cube = Cast<ASimpleCubeActor>(SourceActor))
+	{
+		Cube->BuildMeshData(Chunk.MeshData);
+		Chunk.Material = Cube->Material;
+	}
+	else if (const ASimpleCylinderActor* Cylinder = Cast<ASimpleCylinderActor>(SourceActor))
+	{
+		Cylinder->BuildMeshData(Chunk.MeshData);
+		Chunk.Material = Cylinder->Material;
+	}
+	else
+	{
+		return;
+	}
+
+	// -------------------------------------------------------
+	// Bake the source actor transform into the chunk, relative to ourselves
+	// Normals are scaled by the inverse scale so they stay perpendicular to non-uniformly scaled faces.
+	// A mirroring scale turns every triangle inside out, so the winding is reversed to keep them facing the same way as the normals.
+	FTransform RelativeTransform = SourceActor->GetActorTransform().GetRelativeTransform(GetActorTransform());
+	FVector InverseScale = RelativeTransform.GetSafeScaleReciprocal(RelativeTransform.GetScale3D());
+	FQuat Rotation = RelativeTransform.GetRotation();
+
+	FProceduralMeshData& MeshData = Chunk.MeshData;
+	for (int32 VertexIndex = 0; VertexIndex < MeshData.Vertices.Num(); VertexIndex++)
+	{
+		MeshData.Vertices[VertexIndex] = RelativeTransform.TransformPosition(MeshData.Vertices[VertexIndex]);
+	}
+	for (int32 VertexIndex = 0; VertexIndex < MeshData.Normals.Num(); VertexIndex++)
+	{
+		MeshData.Normals[VertexIndex] = Rotation.RotateVector(MeshData.Normals[VertexIndex] * InverseScale).GetSafeNormal();
+	}
+	for (int32 VertexIndex = 0; VertexIndex < MeshData.Tangents.Num(); VertexIndex++)
+	{
+		FProcMeshTangent& Tangent = MeshData.Tangents[VertexIndex];
+		Tangent.TangentX = RelativeTransform.TransformVectorNoScale(Tangent.TangentX);
+	}
+	if (RelativeTransform.GetDeterminant() < 0.0f)
+	{
+		for (int32 TriangleIndex = 0; TriangleIndex + 2 < MeshData.Triangles.Num(); TriangleIndex += 3)
+		{
+			Swap(MeshData.Triangles[TriangleIndex + 1], MeshData.Triangles[TriangleIndex + 2]);
+		}
+	}
+
+	// Positions are quantized after the transform, so the bounds they are spread over are the ones of the transformed chunk
+	if (bCompactChunkData)
+	{
+		Chunk.CompactStats = Chunk.CompactMeshData.Encode(MeshData, bQuantizeChunkPositions);
+		MeshData.Vertices.Empty();
+		MeshData.Triangles.Empty();
+		MeshData.Normals.Empty();
+		MeshData.UVs.Empty();
+		MeshData.Tangents.Empty();
+		MeshData.VertexColors.Empty();
+	}
+}
+
+int32 AProceduralMeshMergeActor::FindOrAddSection(UMaterialInterface* InMaterial)
+{
+	int32 SectionIndex = SectionMaterials.Find(InMaterial);
+	if (SectionIndex == INDEX_NONE)
+	{
+		SectionIndex = SectionMaterials.Add(InMaterial);
+	}
+	return SectionIndex;
+}
+
+void AProceduralMeshMergeActor::MergeSection(int32 SectionIndex)
+{
+	UMaterialInterface* SectionMaterial = SectionMaterials[SectionIndex];
+
+	// -------------------------------------------------------
+	// Calculate and pre-allocate buffers
+	int32 TotalNumberOfVertices = 0;
+	int32 TotalNumberOfTriangles = 0;
+	for (const FProceduralMeshMergeChunk& EachChunk : Chunks)
+	{
+		if (EachChunk.Material == SectionMaterial)
+		{
+			TotalNumberOfVertices += EachChunk.GetNumVertices();
+			TotalNumberOfTriangles += EachChunk.GetTriangles().Num();
+		}
+	}
+
+	// None of the source actors use vertex colors, so the merged sections don't have any either
+	FProceduralMeshData& MeshData = MergedSections[SectionIndex];
+	MeshData.Reset();
+	MeshData.Vertices.AddUninitialized(TotalNumberOfVertices);
+	MeshData.Triangles.AddUninitialized(TotalNumberOfTriangles);
+	MeshData.Normals.AddUninitialized(TotalNumberOfVertices);
+	MeshData.UVs.AddUninitialized(TotalNumberOfVertices);
+	MeshData.Tangents.AddUninitialized(TotalNumberOfVertices);
+
+	// -------------------------------------------------------
+	// Append every chunk, offsetting its vertex indexes by the vertices that came before it
+	int32 VertexOffset = 0;
+	int32 TriangleOffset = 0;
+	for (const FProceduralMeshMergeChunk& EachChunk : Chunks)
+	{
+		if (EachChunk.Material != SectionMaterial)
+		{
+			continue;
+		}
+
+		const FProceduralMeshData& ChunkData = EachChunk.MeshData;
+		int32 NumChunkVertices = EachChunk.GetNumVertices();
+		if (EachChunk.CompactMeshData.GetNumVertices() > 0)
+		{
+			// Compact chunks are unpacked straight into the merged buffers
+			EachChunk.CompactMeshData.DecodeVertices(MeshData, VertexOffset);
+		}
+		else
+		{
+			FMemory::Memcpy(MeshData.Vertices.GetData() + VertexOffset, ChunkData.Vertices.GetData(), NumChunkVertices * sizeof(FVector));
+			FMemory::Memcpy(MeshData.Normals.GetData() + VertexOffset, ChunkData.Normals.GetData(), NumChunkVertices * sizeof(FVector));
+			FMemory::Memcpy(MeshData.UVs.GetData() + VertexOffset, ChunkData.UVs.GetData(), NumChunkVertices * sizeof(FVector2D));
+			FMemory::Memcpy(MeshData.Tangents.GetData() + VertexOffset, ChunkData.Tangents.GetData(), NumChunkVertices * sizeof(FProcMeshTangent));
+		}
+
+		const TArray<int32>& ChunkTriangles = EachChunk.GetTriangles();
+		int32* Triangles = MeshData.Triangles.GetData() + TriangleOffset;
+		for (int32 TriangleIndex = 0; TriangleIndex < ChunkTriangles.Num(); TriangleIndex++)
+		{
+			Triangles[TriangleIndex] = ChunkTriangles[TriangleIndex] + VertexOffset;
+		}
+
+		VertexOffset += NumChunkVertices;
+		TriangleOffset += ChunkTriangles.Num();
+	}
+}
+
+void AProceduralMeshMergeActor::UploadSection(int32 SectionIndex)
+{
+	const FProceduralMeshData& MeshData = MergedSections[SectionIndex];
+	if (MeshData.Vertices.Num() == 0)
+	{
+		// Keep the section index so the others don't shift, it just has nothing in it any more
+		ProcMesh->ClearMeshSection(SectionIndex);
+		return;
+	}
+
+	FProceduralMeshStats::CountUpload(MeshData);
+	ProcMesh->CreateMeshSection(SectionIndex, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, false);
+	ProcMesh->SetMaterial(SectionIndex, SectionMaterials[SectionIndex]);
+}
+
+void AProceduralMeshMergeActor::ShowHiddenSourceActors()
+{
+	for (AActor* HiddenActor : HiddenSourceActors)
+	{
+		if (HiddenActor && !HiddenActor->IsPendingKill() && HiddenActor->GetRootComponent())
+		{
+			HiddenActor->GetRootComponent()->SetVisibility(true, true);
+		}
+	}
+	HiddenSourceActors.Empty();
+}
+
+void AProceduralMeshMergeActor::UpdateChunkMemory()
+{
+	SIZE_T TotalBytes = 0;
+	for (const FProceduralMeshMergeChunk& EachChunk : Chunks)
+	{
+		TotalBytes += EachChunk.MeshData.GetAllocatedSize() + EachChunk.CompactMeshData.GetAllocatedSize();
+	}
+	ChunkMemoryBytes = (int32)FMath::Min<SIZE_T>(TotalBytes, MAX_int32);
+
+	// The merged sections stay around after the upload as well
+	for (const FProceduralMeshData& Section : MergedSections)
+	{
+		TotalBytes += Section.GetAllocatedSize();
+	}
+	MeshDataMemory.Set(TotalBytes);
+}
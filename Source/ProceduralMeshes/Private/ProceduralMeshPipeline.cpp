@@ -0,0 +1,259 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Splits mesh generation into stages that run on the task graph and only re-run when something they depend on changed
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshPipeline.h"
+#include "ScratchArena.h"
+#include "ProceduralMeshThreading.h"
+#include "ProceduralMeshStats.h"
+
+FProceduralMeshPipeline::FProceduralMeshPipeline()
+	: Owner(nullptr)
+	, LastRunSeconds(0.0)
+	, bCancelled(false)
+{
+}
+
+FProceduralMeshPipeline::~FProceduralMeshPipeline()
+{
+	// The stages point at the owner, which is going away
+	CancelAndWait();
+}
+
+int32 FProceduralMeshPipeline::AddStage(const TCHAR* Name, TStatId PhaseStatId, TFunction<void()> Work, const TArray<int32>& Dependencies, bool bGameThread)
+{
+	// The tasks of a run point straight at the stages
+	check(!IsRunning());
+	for (int32 Dependency : Dependencies)
+	{
+		check(Dependency >= 0 && Dependency < Stages.Num());
+	}
+
+	FStage Stage;
+	Stage.Name = Name;
+	Stage.PhaseStatId = PhaseStatId;
+	Stage.Work = Work;
+	Stage.Dependencies = Dependencies;
+	Stage.bGameThread = bGameThread;
+	Stage.bDirty = true;
+	Stage.Seconds = 0.0;
+	return Stages.Add(Stage);
+}
+
+void FProceduralMeshPipeline::Invalidate(int32 StageIndex)
+{
+	CancelAndWait();
+
+	// Stages only depend on stages added before them, so one pass forward reaches everything downstream
+	Stages[StageIndex].bDirty = true;
+	for (int32 Index = StageIndex + 1; Index < Stages.Num(); Index++)
+	{
+		for (int32 Dependency : Stages[Index].Dependencies)
+		{
+			if (Stages[Dependency].bDirty)
+			{
+				Stages[Index].bDirty = true;
+				break;
+			}
+		}
+	}
+}
+
+void FProceduralMeshPipeline::InvalidateAll()
+{
+	CancelAndWait();
+	for (FStage& Stage : Stages)
+	{
+		Stage.bDirty = true;
+	}
+}
+
+void FProceduralMeshPipeline::AddPropertyTrigger(FName PropertyName, int32 StageIndex)
+{
+	check(StageIndex >= 0 && StageIndex < Stages.Num());
+	PropertyTriggers.AddUnique(PropertyName, StageIndex);
+}
+
+void FProceduralMeshPipeline::IgnoreProperty(FName PropertyName)
+{
+	IgnoredProperties.Add(PropertyName);
+}
+
+void FProceduralMeshPipeline::InvalidateForProperty(FName PropertyName)
+{
+	if (IgnoredProperties.Contains(PropertyName))
+	{
+		return;
+	}
+
+	TArray<int32> TriggeredStages;
+	PropertyTriggers.MultiFind(PropertyName, TriggeredStages);
+	if (TriggeredStages.Num() == 0)
+	{
+		InvalidateAll();
+		return;
+	}
+
+	for (int32 StageIndex : TriggeredStages)
+	{
+		Invalidate(StageIndex);
+	}
+}
+
+int32 FProceduralMeshPipeline::Run()
+{
+	const int32 NumStagesRun = RunAsync();
+	Wait();
+	return NumStagesRun;
+}
+
+int32 FProceduralMeshPipeline::RunAsync()
+{
+	check(IsInGameThread());
+	Wait();
+	bCancelled = false;
+	const double StartTime = FPlatformTime::Seconds();
+
+	// With generation limited to one thread the dirty stages run right here, in the order they were added
+	if (FProceduralMeshThreading::IsSingleThreaded())
+	{
+		int32 NumStagesRun = 0;
+		for (FStage& Stage : Stages)
+		{
+			if (Stage.bDirty)
+			{
+				RunStage(Stage);
+				NumStagesRun++;
+			}
+		}
+		CountRun(NumStagesRun);
+		if (NumStagesRun > 0)
+		{
+			FinishRun(StartTime);
+		}
+		return NumStagesRun;
+	}
+
+	// -------------------------------------------------------
+	// Dispatch every dirty stage right away, the task graph holds each one back until the stages it depends on are done.
+	// Clean dependencies have nothing to wait for, their results are already there.
+	TArray<FGraphEventRef> StageEvents;
+	StageEvents.SetNum(Stages.Num());
+	FGraphEventArray AllEvents;
+
+	for (int32 StageIndex = 0; StageIndex < Stages.Num(); StageIndex++)
+	{
+		FStage& Stage = Stages[StageIndex];
+		if (!Stage.bDirty)
+		{
+			continue;
+		}
+
+		FGraphEventArray Prerequisites;
+		for (int32 Dependency : Stage.Dependencies)
+		{
+			if (StageEvents[Dependency].GetReference())
+			{
+				Prerequisites.Add(StageEvents[Dependency]);
+			}
+		}
+
+		// A stage that is skipped or stopped by Cancel stays dirty, and so does everything after it since none of that ran either
+		FStage* StagePtr = &Stage;
+		StageEvents[StageIndex] = FFunctionGraphTask::CreateAndDispatchWhenReady([this, StagePtr]()
+		{
+			if (!bCancelled)
+			{
+				RunStage(*StagePtr);
+			}
+		}, TStatId(), &Prerequisites, Stage.bGameThread ? ENamedThreads::GameThread : ENamedThreads::AnyThread);
+		AllEvents.Add(StageEvents[StageIndex]);
+	}
+
+	CountRun(AllEvents.Num());
+	if (AllEvents.Num() == 0)
+	{
+		LastRunSeconds = FPlatformTime::Seconds() - StartTime;
+		return 0;
+	}
+
+	// The run is timed by a task that waits for all the stages. It runs on the game thread like the upload stages at the end of the run,
+	// since that is where the generation records live.
+	CompletionEvent = FFunctionGraphTask::CreateAndDispatchWhenReady([this, StartTime]()
+	{
+		FinishRun(StartTime);
+	}, TStatId(), &AllEvents, ENamedThreads::GameThread);
+	return AllEvents.Num();
+}
+
+void FProceduralMeshPipeline::FinishRun(double StartTime)
+{
+	LastRunSeconds = FPlatformTime::Seconds() - StartTime;
+
+	// A cancelled run didn't produce a mesh, and the owner may be on its way out
+	if (Owner && !bCancelled)
+	{
+		FProceduralMeshStats::RecordGeneration(Owner, LastRunSeconds);
+	}
+}
+
+void FProceduralMeshPipeline::RunStage(FStage& Stage)
+{
+	const double StageStartTime = FPlatformTime::Seconds();
+	{
+		FScopeCycleCounter OwnerCycleCounter(OwnerStatId);
+		FScopeCycleCounter PhaseCycleCounter(Stage.PhaseStatId);
+
+		// The temporary arrays of a stage are rewound along with the scope once it is done
+		FScratchScope ScratchScope;
+		Stage.Work();
+	}
+	Stage.Seconds = FPlatformTime::Seconds() - StageStartTime;
+	if (!bCancelled)
+	{
+		Stage.bDirty = false;
+	}
+}
+
+void FProceduralMeshPipeline::CountRun(int32 NumStagesRun)
+{
+	// A run that had nothing to do at all isn't a regeneration, so it isn't counted as a skipped one either
+	const int32 NumStagesSkipped = Stages.Num() - NumStagesRun;
+	INC_DWORD_STAT_BY(STAT_ProceduralMeshStagesRun, NumStagesRun);
+	INC_DWORD_STAT_BY(STAT_ProceduralMeshStagesSkipped, NumStagesSkipped);
+	if (NumStagesRun > 0 && NumStagesSkipped > 0)
+	{
+		INC_DWORD_STAT(STAT_ProceduralMeshRegenerationsSkipped);
+	}
+}
+
+void FProceduralMeshPipeline::Cancel()
+{
+	if (IsRunning() && !bCancelled)
+	{
+		bCancelled = true;
+		INC_DWORD_STAT(STAT_ProceduralMeshRegenerationsCancelled);
+	}
+}
+
+void FProceduralMeshPipeline::Wait()
+{
+	if (CompletionEvent.GetReference())
+	{
+		// Waiting on the game thread also runs the game thread stages as they become ready
+		check(IsInGameThread());
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(CompletionEvent, ENamedThreads::GameThread);
+		CompletionEvent = nullptr;
+	}
+}
+
+void FProceduralMeshPipeline::CancelAndWait()
+{
+	Cancel();
+	Wait();
+}
+
+bool FProceduralMeshPipeline::IsRunning() const
+{
+	return CompletionEvent.GetReference() && !CompletionEvent->IsComplete();
+}
@@ -0,0 +1,106 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Splits mesh generation into stages that run on the task graph and only re-run when something they depend on changed
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "TaskGraphInterfaces.h"
+
+// A stage reads what the stages it depends on wrote (usually members of the actor that owns the pipeline) and writes its own results.
+// Stages must be added after the stages they depend on, so the order they are added in is always an order they can run in.
+// Run dispatches every dirty stage to the task graph at once, with the stages it depends on as prerequisites, so stages that don't
+// depend on each other run at the same time. Stages that touch components are marked bGameThread and still run in the same order.
+// RunAsync does the same without waiting, and a run that is still going can be cancelled, which leaves the stages it didn't finish dirty.
+// With ProceduralMeshes.MaxThreads set to 1 both of them run the dirty stages one after another on the game thread instead.
+// The stages read the actor's properties while they run, so the owner has to cancel and wait before any of them change.
+class PROCEDURALMESHES_API FProceduralMeshPipeline
+{
+public:
+	FProceduralMeshPipeline();
+	~FProceduralMeshPipeline();
+
+	// Returns the index of the new stage, which starts out dirty. The stage is timed under PhaseStatId, one of the phase counters.
+	int32 AddStage(const TCHAR* Name, TStatId PhaseStatId, TFunction<void()> Work, const TArray<int32>& Dependencies, bool bGameThread = false);
+
+	// The actor that owns the pipeline and its class counter. Every stage is timed under the class counter as well so the phases still
+	// show per class on the task graph threads, and every run that finishes is recorded for ProceduralMeshes.DumpSlowestActors.
+	void SetOwner(const AActor* InOwner, TStatId InOwnerStatId)
+	{
+		Owner = InOwner;
+		OwnerStatId = InOwnerStatId;
+	}
+
+	// Marks the stage dirty, along with everything that depends on it. A run that is still going is cancelled first, since it would
+	// otherwise finish with results from before the change.
+	void Invalidate(int32 StageIndex);
+	void InvalidateAll();
+
+	// Editing PropertyName invalidates StageIndex, usually the first stage that reads it. A property can invalidate several stages.
+	void AddPropertyTrigger(FName PropertyName, int32 StageIndex);
+
+	// Properties that don't change the generated mesh at all, like LOD screen sizes that are only read when switching LODs
+	void IgnoreProperty(FName PropertyName);
+
+	// Invalidates the stages mapped to PropertyName. Properties without a mapping invalidate everything, so a new property is never missed.
+	void InvalidateForProperty(FName PropertyName);
+
+	// Runs every dirty stage and waits for them to finish, must be called from the game thread. Returns the number of stages that ran.
+	// The stages that didn't run are counted in STAT_ProceduralMeshStagesSkipped.
+	int32 Run();
+
+	// Starts every dirty stage and returns straight away, must be called from the game thread. The game thread stages run whenever the
+	// game thread processes its tasks. Waits for the previous run first if it is still going. Returns the number of stages started.
+	int32 RunAsync();
+
+	// Stages of the current run that haven't started yet are skipped. Long stages can poll IsCancelled and return early.
+	void Cancel();
+	bool IsCancelled() const { return bCancelled; }
+
+	// Waits for the current run to finish, or to wind down after Cancel, running its game thread stages on the way
+	void Wait();
+	void CancelAndWait();
+	bool IsRunning() const;
+
+	bool IsDirty(int32 StageIndex) const { return Stages[StageIndex].bDirty; }
+	bool IsEmpty() const { return Stages.Num() == 0; }
+	int32 GetNumStages() const { return Stages.Num(); }
+	const TCHAR* GetStageName(int32 StageIndex) const { return Stages[StageIndex].Name; }
+
+	// How long the stage took the last time it ran
+	double GetStageSeconds(int32 StageIndex) const { return Stages[StageIndex].Seconds; }
+
+	// Wall clock time of the last run that finished, including waiting for the task graph
+	double GetLastRunSeconds() const { return LastRunSeconds; }
+
+private:
+	struct FStage
+	{
+		const TCHAR* Name;
+		TStatId PhaseStatId;
+		TFunction<void()> Work;
+		TArray<int32> Dependencies;
+		bool bGameThread;
+		bool bDirty;
+		double Seconds;
+	};
+
+	// Runs the stage's work inside a scratch scope, and marks it clean unless the run was cancelled meanwhile
+	void RunStage(FStage& Stage);
+
+	// Adds the run to the stage counters of "stat ProceduralMeshes"
+	void CountRun(int32 NumStagesRun);
+
+	// Times the run once its last stage is done, on the game thread
+	void FinishRun(double StartTime);
+
+	TArray<FStage> Stages;
+	TMultiMap<FName, int32> PropertyTriggers;
+	TSet<FName> IgnoredProperties;
+	const AActor* Owner;
+	TStatId OwnerStatId;
+	double LastRunSeconds;
+
+	// Completes once every stage of the current run has finished or been skipped
+	FGraphEventRef CompletionEvent;
+	FThreadSafeBool bCancelled;
+};
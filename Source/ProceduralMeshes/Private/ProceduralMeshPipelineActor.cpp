@@ -0,0 +1,175 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Base of the examples that generate through FProceduralMeshPipeline
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshPipelineActor.h"
+#include "ScratchArena.h"
+
+AProceduralMeshPipelineActor::AProceduralMeshPipelineActor()
+	: PreviewStage(INDEX_NONE)
+	, PreviewLOD(0)
+{
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootScene"));
+	ProcMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("ProceduralMesh"));
+	ProcMesh->AttachTo(RootComponent);
+	// Make sure the PMC doesnt save any mesh data with the map
+	ProcMesh->SetFlags(EObjectFlags::RF_Transient);
+
+	Collision = CreateDefaultSubobject<UProceduralCollisionComponent>(TEXT("Collision"));
+	Collision->AttachTo(RootComponent);
+	Collision->SetFlags(EObjectFlags::RF_Transient);
+
+	// Ticking is only used to switch LODs, so subclasses turn it on once they have more than one
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	// Builds the full mesh after a drag that never sent its final change. Blueprint defaults are edited on the template, which has no mesh.
+	EditorInteraction.SetOnSettled([this]()
+	{
+		if (!IsTemplate())
+		{
+			RunPipeline(true);
+		}
+	});
+}
+
+#if WITH_EDITOR
+void AProceduralMeshPipelineActor::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+
+	// Only the stages invalidated by the properties that changed since the last run do any work. The work happens in the background,
+	// and the next change cancels it if it hasn't finished by then.
+	RunPipeline(true);
+}
+
+void AProceduralMeshPipelineActor::PreEditChange(UProperty* PropertyAboutToChange)
+{
+	// The stages read the properties while they run
+	Pipeline.CancelAndWait();
+	Super::PreEditChange(PropertyAboutToChange);
+}
+
+void AProceduralMeshPipelineActor::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	// Runs before Super, which re-runs the construction script and with it the pipeline
+	SetupPipeline();
+	EditorInteraction.NotifyPropertyChanged(PropertyChangedEvent.ChangeType);
+	Pipeline.InvalidateForProperty(PropertyChangedEvent.MemberProperty ? PropertyChangedEvent.MemberProperty->GetFName() : NAME_None);
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+}
+
+void AProceduralMeshPipelineActor::PreEditUndo()
+{
+	Pipeline.CancelAndWait();
+	Super::PreEditUndo();
+}
+
+void AProceduralMeshPipelineActor::PostEditUndo()
+{
+	// Undo can change any number of properties at once
+	SetupPipeline();
+	Pipeline.InvalidateAll();
+	Super::PostEditUndo();
+}
+#endif // WITH_EDITOR
+
+void AProceduralMeshPipelineActor::BeginPlay()
+{
+	Super::BeginPlay();
+	GenerateMesh();
+
+	// Fix for PCM and collision location/rotation/scale since both components are Transient
+	ProcMesh->SetWorldLocation(this->GetActorLocation());
+	ProcMesh->SetWorldRotation(this->GetActorRotation());
+	ProcMesh->SetWorldScale3D(this->GetActorScale3D());
+	Collision->SetWorldLocation(this->GetActorLocation());
+	Collision->SetWorldRotation(this->GetActorRotation());
+	Collision->SetWorldScale3D(this->GetActorScale3D());
+}
+
+void AProceduralMeshPipelineActor::BeginDestroy()
+{
+	// The stages write to members of the subclass, which are destroyed before the pipeline is
+	Pipeline.CancelAndWait();
+	Super::BeginDestroy();
+}
+
+void AProceduralMeshPipelineActor::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	// Lower LODs are built from what the pipeline is still writing
+	if (Pipeline.IsRunning())
+	{
+		return;
+	}
+
+	// Lower LODs are generated here rather than in a stage, so they need a scratch scope of their own
+	FScratchScope ScratchScope;
+	UpdateLOD();
+}
+
+bool AProceduralMeshPipelineActor::ShouldTickIfViewportsOnly() const
+{
+	// Lets us preview LOD switching in the editor viewports, ticking is only turned on when there are LODs to switch
+	return true;
+}
+
+void AProceduralMeshPipelineActor::GenerateMesh()
+{
+	SetupPipeline();
+	Pipeline.InvalidateAll();
+	RunPipeline(false);
+}
+
+void AProceduralMeshPipelineActor::SetupPipeline()
+{
+	if (Pipeline.IsEmpty())
+	{
+		SetupStages();
+	}
+}
+
+void AProceduralMeshPipelineActor::RunPipeline(bool bAsync)
+{
+	if (!CanRunPipeline())
+	{
+		return;
+	}
+
+	SetupPipeline();
+
+	// Dragging a slider builds a preview at a lower LOD, letting go of it builds the full mesh again
+	const int32 NewPreviewLOD = EditorInteraction.IsInteracting() ? GetEditorPreviewLOD() : 0;
+	if (NewPreviewLOD != PreviewLOD)
+	{
+		if (PreviewStage != INDEX_NONE)
+		{
+			Pipeline.Invalidate(PreviewStage);
+		}
+		else
+		{
+			Pipeline.CancelAndWait();
+		}
+		PreviewLOD = NewPreviewLOD;
+	}
+	PrepareRun();
+
+	// The component is transient, so it can come back empty (after loading the level for example) without any property changing.
+	// A run that is still going will fill it.
+	if (ProcMesh->GetNumSections() == 0 && !Pipeline.IsRunning())
+	{
+		Pipeline.InvalidateAll();
+	}
+
+	if (bAsync)
+	{
+		const int32 NumStagesStarted = Pipeline.RunAsync();
+		UE_LOG(LogProceduralMeshes, Verbose, TEXT("%s: started %d of %d generation stages%s"), *GetName(), NumStagesStarted, Pipeline.GetNumStages(), PreviewLOD > 0 ? TEXT(" for a preview") : TEXT(""));
+		return;
+	}
+
+	const int32 NumStagesRun = Pipeline.Run();
+	UE_LOG(LogProceduralMeshes, Verbose, TEXT("%s: ran %d of %d generation stages, %.2f ms"), *GetName(), NumStagesRun, Pipeline.GetNumStages(), Pipeline.GetLastRunSeconds() * 1000.0);
+}
@@ -0,0 +1,116 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Shows where generation time and memory go, per generator class and phase, and which actors took longest to generate
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshStats.h"
+#include "ProceduralMeshHarness.h"
+
+namespace ProceduralMeshStats
+{
+	const int32 DefaultNumSlowestActors = 10;
+
+	struct FGenerationRecord
+	{
+		TWeakObjectPtr<const AActor> Actor;
+		double LastSeconds;
+		double MaxSeconds;
+		int32 NumGenerations;
+		int32 NumVertices;
+	};
+
+	// Only touched from the game thread, which is where GenerateMesh is called and pipeline runs finish
+	TMap<const AActor*, FGenerationRecord> Records;
+
+	// Actors that were destroyed since they were recorded, or whose address now belongs to a different actor
+	void RemoveStaleRecords()
+	{
+		for (auto It = Records.CreateIterator(); It; ++It)
+		{
+			if (It.Value().Actor.Get() != It.Key())
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+}
+
+FProceduralMeshGenerationScope::FProceduralMeshGenerationScope(const AActor* InActor, TStatId ClassStatId)
+	: CycleCounter(ClassStatId)
+	, Actor(InActor)
+	, StartTime(FPlatformTime::Seconds())
+{
+}
+
+FProceduralMeshGenerationScope::~FProceduralMeshGenerationScope()
+{
+	FProceduralMeshStats::RecordGeneration(Actor, FPlatformTime::Seconds() - StartTime);
+}
+
+void FProceduralMeshMemoryStat::Set(SIZE_T NewBytes)
+{
+	DEC_MEMORY_STAT_BY(STAT_ProceduralMeshDataMemory, Bytes);
+	INC_MEMORY_STAT_BY(STAT_ProceduralMeshDataMemory, NewBytes);
+	Bytes = NewBytes;
+}
+
+void FProceduralMeshStats::CountUpload(const FProceduralMeshData& MeshData)
+{
+	INC_DWORD_STAT_BY(STAT_ProceduralMeshBytesUploaded, MeshData.GetAllocatedSize());
+}
+
+void FProceduralMeshStats::RecordGeneration(const AActor* Actor, double Seconds)
+{
+	using namespace ProceduralMeshStats;
+
+	check(IsInGameThread());
+	FGenerationRecord* Record = Records.Find(Actor);
+	if (!Record || Record->Actor.Get() != Actor)
+	{
+		Record = &Records.Add(Actor);
+		Record->Actor = Actor;
+		Record->MaxSeconds = 0.0;
+		Record->NumGenerations = 0;
+	}
+
+	Record->LastSeconds = Seconds;
+	Record->MaxSeconds = FMath::Max(Record->MaxSeconds, Seconds);
+	Record->NumGenerations++;
+	Record->NumVertices = FProceduralMeshHarness::GetNumVisibleVertices(Actor);
+}
+
+void FProceduralMeshStats::DumpSlowestActors(const TArray<FString>& Args, UWorld* World)
+{
+	using namespace ProceduralMeshStats;
+
+	// Usage: ProceduralMeshes.DumpSlowestActors [Count]
+	const int32 NumToDump = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : DefaultNumSlowestActors;
+
+	RemoveStaleRecords();
+	TArray<const FGenerationRecord*> WorldRecords;
+	for (const TPair<const AActor*, FGenerationRecord>& Pair : Records)
+	{
+		if (Pair.Key->GetWorld() == World)
+		{
+			WorldRecords.Add(&Pair.Value);
+		}
+	}
+	WorldRecords.Sort([](const FGenerationRecord& A, const FGenerationRecord& B)
+	{
+		return A.LastSeconds > B.LastSeconds;
+	});
+
+	UE_LOG(LogProceduralMeshes, Display, TEXT("Slowest %d of %d generated actors in %s, by their last generation:"), FMath::Min(NumToDump, WorldRecords.Num()), WorldRecords.Num(),
+		World ? *World->GetName() : TEXT("no world"));
+	for (int32 RecordIndex = 0; RecordIndex < FMath::Min(NumToDump, WorldRecords.Num()); RecordIndex++)
+	{
+		const FGenerationRecord& Record = *WorldRecords[RecordIndex];
+		const AActor* Actor = Record.Actor.Get();
+		UE_LOG(LogProceduralMeshes, Display, TEXT("%3d. %-32s %-32s %9.3f ms last, %9.3f ms slowest, %d generations, %d vertices"), RecordIndex + 1,
+			*Actor->GetClass()->GetName(), *Actor->GetName(), Record.LastSeconds * 1000.0, Record.MaxSeconds * 1000.0, Record.NumGenerations, Record.NumVertices);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs DumpSlowestActorsCommand(
+	TEXT("ProceduralMeshes.DumpSlowestActors"),
+	TEXT("Lists the generated actors in the world whose last generation took longest. Optional argument: how many to list (10 by default)."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&FProceduralMeshStats::DumpSlowestActors));
@@ -0,0 +1,67 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Shows where generation time and memory go, per generator class and phase, and which actors took longest to generate
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshData.h"
+
+// Opened at the top of GenerateMesh by the actors that don't generate through FProceduralMeshPipeline, which times and records its
+// runs itself. Times the generation under the generator class's own cycle counter, so the phase counters opened inside it
+// (STAT_ProceduralMeshStructure and the rest) show up per class in "stat ProceduralMeshes", and remembers how long it took for
+// ProceduralMeshes.DumpSlowestActors.
+class FProceduralMeshGenerationScope
+{
+public:
+	FProceduralMeshGenerationScope(const AActor* InActor, TStatId ClassStatId);
+	~FProceduralMeshGenerationScope();
+
+private:
+	FScopeCycleCounter CycleCounter;
+	const AActor* Actor;
+	double StartTime;
+};
+
+// Mesh data an actor keeps around between generations, counted in STAT_ProceduralMeshDataMemory for as long as the actor lives.
+// A copy starts out at zero, so duplicating an actor doesn't count its mesh data twice.
+class FProceduralMeshMemoryStat
+{
+public:
+	FProceduralMeshMemoryStat()
+		: Bytes(0)
+	{
+	}
+
+	FProceduralMeshMemoryStat(const FProceduralMeshMemoryStat&)
+		: Bytes(0)
+	{
+	}
+
+	~FProceduralMeshMemoryStat()
+	{
+		Set(0);
+	}
+
+	FProceduralMeshMemoryStat& operator=(const FProceduralMeshMemoryStat&)
+	{
+		return *this;
+	}
+
+	void Set(SIZE_T NewBytes);
+
+private:
+	SIZE_T Bytes;
+};
+
+class FProceduralMeshStats
+{
+public:
+	// Adds a section that is about to be uploaded to the component to STAT_ProceduralMeshBytesUploaded
+	static void CountUpload(const FProceduralMeshData& MeshData);
+
+	// Remembers how long the actor's last generation took for DumpSlowestActors, must be called from the game thread
+	static void RecordGeneration(const AActor* Actor, double Seconds);
+
+	// Usage: ProceduralMeshes.DumpSlowestActors [Count]
+	static void DumpSlowestActors(const TArray<FString>& Args, UWorld* World);
+};
@@ -0,0 +1,20 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Limits how many threads mesh generation keeps busy, for profiling and for machines that do other work next to it
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshThreading.h"
+
+static TAutoConsoleVariable<int32> CVarMaxThreads(
+	TEXT("ProceduralMeshes.MaxThreads"),
+	0,
+	TEXT("How many threads generation may keep busy at once. 0 uses every task graph thread, 1 generates everything on the calling thread."));
+
+int32 FProceduralMeshThreading::GetMaxThreads()
+{
+	return FMath::Max(0, CVarMaxThreads.GetValueOnAnyThread());
+}
+
+void FProceduralMeshThreading::SetMaxThreads(int32 MaxThreads)
+{
+	CVarMaxThreads.AsVariable()->Set(FMath::Max(0, MaxThreads));
+}
@@ -0,0 +1,46 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Limits how many threads mesh generation keeps busy, for profiling and for machines that do other work next to it
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ParallelFor.h"
+
+// Generation splits its loops with FProceduralMeshThreading::ParallelFor instead of calling ParallelFor directly, so the number of
+// threads it uses can be set with ProceduralMeshes.MaxThreads. 0 uses every task graph thread, 1 runs all of generation on the calling
+// thread (pipeline stages included), and anything above that splits each loop into at most that many tasks.
+class PROCEDURALMESHES_API FProceduralMeshThreading
+{
+public:
+	static int32 GetMaxThreads();
+	static void SetMaxThreads(int32 MaxThreads);
+
+	static bool IsSingleThreaded()
+	{
+		return GetMaxThreads() == 1;
+	}
+
+	// Calls Body(Index) for every index in [0, Num), same as ParallelFor
+	template<typename FunctionType>
+	static void ParallelFor(int32 Num, const FunctionType& Body, bool bForceSingleThread = false)
+	{
+		const int32 MaxThreads = GetMaxThreads();
+		if (MaxThreads == 0)
+		{
+			::ParallelFor(Num, Body, bForceSingleThread);
+			return;
+		}
+
+		// Each task takes one contiguous run of indices, so there are never more than MaxThreads of them to be busy at once
+		const int32 NumTasks = FMath::Min(Num, MaxThreads);
+		::ParallelFor(NumTasks, [&Body, Num, NumTasks](int32 TaskIndex)
+		{
+			const int32 Begin = (int32)((int64)Num * TaskIndex / NumTasks);
+			const int32 End = (int32)((int64)Num * (TaskIndex + 1) / NumTasks);
+			for (int32 Index = Begin; Index < End; Index++)
+			{
+				Body(Index);
+			}
+		}, bForceSingleThread || NumTasks < 2);
+	}
+};
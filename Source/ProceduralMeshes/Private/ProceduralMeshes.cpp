@@ -4,6 +4,22 @@
 
 #define LOCTEXT_NAMESPACE "FProceduralMeshesModule"
 
+DEFINE_LOG_CATEGORY(LogProceduralMeshes);
+
+DEFINE_STAT(STAT_ProceduralMeshRegenerationsSkipped);
+DEFINE_STAT(STAT_ProceduralMeshRegenerationsCancelled);
+DEFINE_STAT(STAT_ProceduralMeshStagesRun);
+DEFINE_STAT(STAT_ProceduralMeshStagesSkipped);
+DEFINE_STAT(STAT_ProceduralMeshTubeSegmentsReused);
+DEFINE_STAT(STAT_ProceduralMeshScratchHeapAllocations);
+DEFINE_STAT(STAT_ProceduralMeshStructure);
+DEFINE_STAT(STAT_ProceduralMeshVertexFill);
+DEFINE_STAT(STAT_ProceduralMeshOptimization);
+DEFINE_STAT(STAT_ProceduralMeshUpload);
+DEFINE_STAT(STAT_ProceduralMeshCollision);
+DEFINE_STAT(STAT_ProceduralMeshDataMemory);
+DEFINE_STAT(STAT_ProceduralMeshBytesUploaded);
+
 void FProceduralMeshesModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
@@ -0,0 +1,359 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Per thread linear allocator for the temporary arrays of a generation, rewound as a whole when the generation is done
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ScratchArena.h"
+#include "TubeSegmentCache.h"
+#include "VertexWelding.h"
+
+namespace ScratchArena
+{
+	const uint32 Alignment = 16;
+
+	// Big enough that a typical generation fits in one or two blocks
+	const SIZE_T BlockSize = 1024 * 1024;
+
+	// Blocks past this are freed when the outermost scope closes, so one huge generation doesn't hold on to its memory for good
+	const SIZE_T MaxRetainedBytes = 64 * 1024 * 1024;
+
+	const uint32 TlsSlot = FPlatformTLS::AllocTlsSlot();
+	FThreadSafeCounter NumHeapAllocations;
+
+	SIZE_T AlignSize(SIZE_T Size)
+	{
+		return Align(Size, (SIZE_T)Alignment);
+	}
+}
+
+static TAutoConsoleVariable<int32> CVarScratchArena(
+	TEXT("ProceduralMeshes.ScratchArena"),
+	1,
+	TEXT("Set to 0 to put the temporary arrays of a generation on the heap instead of the per thread scratch arena."));
+
+// -------------------------------------------------------
+// FScratchArena
+
+FScratchArena::FScratchArena()
+	: CurrentBlock(0)
+	, Offset(0)
+	, LastAllocation(nullptr)
+	, ScopeDepth(0)
+	, ThreadId(FPlatformTLS::GetCurrentThreadId())
+{
+}
+
+FScratchArena& FScratchArena::Get()
+{
+	FScratchArena* Arena = (FScratchArena*)FPlatformTLS::GetTlsValue(ScratchArena::TlsSlot);
+	if (!Arena)
+	{
+		Arena = new FScratchArena();
+		FPlatformTLS::SetTlsValue(ScratchArena::TlsSlot, Arena);
+	}
+	return *Arena;
+}
+
+FScratchArena* FScratchArena::GetIfInScope()
+{
+	if (CVarScratchArena.GetValueOnAnyThread() == 0)
+	{
+		return nullptr;
+	}
+
+	// No need to create an arena for a thread that never opened a scope
+	FScratchArena* Arena = (FScratchArena*)FPlatformTLS::GetTlsValue(ScratchArena::TlsSlot);
+	return Arena && Arena->ScopeDepth > 0 ? Arena : nullptr;
+}
+
+void* FScratchArena::Allocate(SIZE_T Size)
+{
+	check(ThreadId == FPlatformTLS::GetCurrentThreadId());
+	const SIZE_T AlignedSize = ScratchArena::AlignSize(Size);
+
+	// Blocks that are too small for this are skipped, their space comes back when the scope closes
+	while (CurrentBlock < Blocks.Num() && Offset + AlignedSize > Blocks[CurrentBlock].Size)
+	{
+		CurrentBlock++;
+		Offset = 0;
+	}
+
+	if (CurrentBlock == Blocks.Num())
+	{
+		FBlock Block;
+		Block.Size = FMath::Max(ScratchArena::BlockSize, AlignedSize);
+		Block.Memory = (uint8*)FMemory::Malloc(Block.Size, ScratchArena::Alignment);
+		Blocks.Add(Block);
+		AddHeapAllocation();
+	}
+
+	LastAllocation = Blocks[CurrentBlock].Memory + Offset;
+	Offset += AlignedSize;
+	return LastAllocation;
+}
+
+bool FScratchArena::ResizeInPlace(void* Ptr, SIZE_T NewSize)
+{
+	if (!Ptr || Ptr != LastAllocation)
+	{
+		return false;
+	}
+
+	const SIZE_T Start = LastAllocation - Blocks[CurrentBlock].Memory;
+	const SIZE_T AlignedSize = ScratchArena::AlignSize(NewSize);
+	if (Start + AlignedSize > Blocks[CurrentBlock].Size)
+	{
+		return false;
+	}
+
+	Offset = Start + AlignedSize;
+	return true;
+}
+
+void FScratchArena::Free(void* Ptr)
+{
+	if (Ptr && Ptr == LastAllocation)
+	{
+		Offset = LastAllocation - Blocks[CurrentBlock].Memory;
+		LastAllocation = nullptr;
+	}
+}
+
+bool FScratchArena::IsInnermostScope(int32 InScopeDepth) const
+{
+	return InScopeDepth > 0 && InScopeDepth == ScopeDepth && ThreadId == FPlatformTLS::GetCurrentThreadId();
+}
+
+SIZE_T FScratchArena::GetReservedBytes() const
+{
+	SIZE_T ReservedBytes = 0;
+	for (const FBlock& Block : Blocks)
+	{
+		ReservedBytes += Block.Size;
+	}
+	return ReservedBytes;
+}
+
+int32 FScratchArena::GetNumHeapAllocations()
+{
+	return ScratchArena::NumHeapAllocations.GetValue();
+}
+
+void FScratchArena::AddHeapAllocation()
+{
+	ScratchArena::NumHeapAllocations.Increment();
+	INC_DWORD_STAT(STAT_ProceduralMeshScratchHeapAllocations);
+}
+
+// -------------------------------------------------------
+// FScratchScope
+
+FScratchScope::FScratchScope()
+	: Arena(FScratchArena::Get())
+	, MarkBlock(Arena.CurrentBlock)
+	, MarkOffset(Arena.Offset)
+{
+	Arena.ScopeDepth++;
+}
+
+FScratchScope::~FScratchScope()
+{
+	check(Arena.ScopeDepth > 0);
+	Arena.ScopeDepth--;
+	Arena.CurrentBlock = MarkBlock;
+	Arena.Offset = MarkOffset;
+	Arena.LastAllocation = nullptr;
+
+	// Nothing is allocated outside a scope, so all of the blocks are free again once the outermost one closes
+	if (Arena.ScopeDepth == 0)
+	{
+		SIZE_T ReservedBytes = Arena.GetReservedBytes();
+		while (ReservedBytes > ScratchArena::MaxRetainedBytes && Arena.Blocks.Num() > 0)
+		{
+			ReservedBytes -= Arena.Blocks.Last().Size;
+			FMemory::Free(Arena.Blocks.Last().Memory);
+			Arena.Blocks.Pop(false);
+		}
+	}
+}
+
+// -------------------------------------------------------
+// FScratchAllocator
+
+FScratchAllocator::ForAnyElementType::ForAnyElementType()
+	: Data(nullptr)
+	, Arena(FScratchArena::GetIfInScope())
+	, ScopeDepth(Arena ? Arena->GetScopeDepth() : 0)
+	, bArenaAllocation(false)
+	, AllocatedBytes(0)
+{
+}
+
+FScratchAllocator::ForAnyElementType::~ForAnyElementType()
+{
+	FreeAllocation();
+}
+
+void FScratchAllocator::ForAnyElementType::MoveToEmpty(ForAnyElementType& Other)
+{
+	check(this != &Other);
+	FreeAllocation();
+
+	// Arena memory can only be handed to an array that goes away before the scope it came from closes.
+	// Anything else gets a copy on the heap.
+	const bool bOutlivesMemory = Other.bArenaAllocation && (Arena != Other.Arena || ScopeDepth < Other.ScopeDepth);
+	if (bOutlivesMemory)
+	{
+		Data = (FScriptContainerElement*)FMemory::Malloc(Other.AllocatedBytes);
+		FMemory::Memcpy(Data, Other.Data, Other.AllocatedBytes);
+		AllocatedBytes = Other.AllocatedBytes;
+		FScratchArena::AddHeapAllocation();
+		Other.FreeAllocation();
+		return;
+	}
+
+	Data = Other.Data;
+	bArenaAllocation = Other.bArenaAllocation;
+	AllocatedBytes = Other.AllocatedBytes;
+	Other.Data = nullptr;
+	Other.bArenaAllocation = false;
+	Other.AllocatedBytes = 0;
+}
+
+void FScratchAllocator::ForAnyElementType::ResizeAllocation(SizeType PreviousNumElements, SizeType NumElements, SIZE_T NumBytesPerElement)
+{
+	const SIZE_T NewSize = NumElements * NumBytesPerElement;
+	if (NewSize == 0)
+	{
+		FreeAllocation();
+		return;
+	}
+
+	// -------------------------------------------------------
+	// Arena memory while the array is still on its own thread, in the scope it was created in
+	const SIZE_T PreviousSize = PreviousNumElements * NumBytesPerElement;
+	if (Arena && Arena->IsInnermostScope(ScopeDepth) && (!Data || bArenaAllocation))
+	{
+		if (!Data || !Arena->ResizeInPlace(Data, NewSize))
+		{
+			// The old memory is left where it is until the scope closes
+			void* NewData = Arena->Allocate(NewSize);
+			if (Data)
+			{
+				FMemory::Memcpy(NewData, Data, PreviousSize);
+			}
+			Data = (FScriptContainerElement*)NewData;
+		}
+		bArenaAllocation = true;
+		AllocatedBytes = NewSize;
+		return;
+	}
+
+	// -------------------------------------------------------
+	// Heap memory for everything else
+	if (bArenaAllocation)
+	{
+		void* NewData = FMemory::Malloc(NewSize);
+		FMemory::Memcpy(NewData, Data, PreviousSize);
+		Data = (FScriptContainerElement*)NewData;
+		bArenaAllocation = false;
+	}
+	else
+	{
+		Data = (FScriptContainerElement*)FMemory::Realloc(Data, NewSize);
+	}
+	AllocatedBytes = NewSize;
+	FScratchArena::AddHeapAllocation();
+}
+
+void FScratchAllocator::ForAnyElementType::FreeAllocation()
+{
+	if (Data)
+	{
+		if (!bArenaAllocation)
+		{
+			FMemory::Free(Data);
+		}
+		else if (Arena->IsInnermostScope(ScopeDepth))
+		{
+			Arena->Free(Data);
+		}
+	}
+
+	Data = nullptr;
+	bArenaAllocation = false;
+	AllocatedBytes = 0;
+}
+
+// -------------------------------------------------------
+// Benchmark
+
+void FScratchArena::RunBenchmark(const TArray<FString>& Args)
+{
+	// Usage: ProceduralMeshes.BenchmarkScratchArena [Iterations]
+	const int32 Iterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 50;
+	const int32 GridSections = 128;
+	const int32 SubdivisionIterations = 8;
+
+	UE_LOG(LogProceduralMeshes, Log, TEXT("Scratch arena benchmark, %d generations"), Iterations);
+
+	// One generation of the kind of temporary data the actors build: a heightfield's heights, a line subdivided one generation at a time,
+	// the tube segments of one LOD and welding them
+	auto Generate = [&](int32 Iteration)
+	{
+		FScratchScope ScratchScope;
+
+		TArray<float, FScratchAllocator> HeightValues;
+		HeightValues.AddUninitialized((GridSections + 1) * (GridSections + 1));
+		for (int32 Index = 0; Index < HeightValues.Num(); Index++)
+		{
+			HeightValues[Index] = FMath::Sin((Index + Iteration) * 0.01f) * 100.0f;
+		}
+
+		FRandomStream RngStream(1238);
+		FScratchLineSegmentStreams Generation;
+		Generation.Add(FVector::ZeroVector, FVector(0.0f, 0.0f, 1000.0f), 10.0f, 0);
+		for (int32 SubdivisionIteration = 0; SubdivisionIteration < SubdivisionIterations; SubdivisionIteration++)
+		{
+			FScratchLineSegmentStreams NextGeneration;
+			for (int32 SegmentIndex = 0; SegmentIndex < Generation.Num(); SegmentIndex++)
+			{
+				const FVector Midpoint = (Generation.GetStart(SegmentIndex) + Generation.GetEnd(SegmentIndex)) / 2 + RngStream.GetUnitVector() * 10.0f;
+				NextGeneration.Add(Generation.GetStart(SegmentIndex), Midpoint, Generation.Width[SegmentIndex], 0);
+				NextGeneration.Add(Midpoint, Generation.GetEnd(SegmentIndex), Generation.Width[SegmentIndex], 0);
+			}
+			Generation = MoveTemp(NextGeneration);
+		}
+
+		FProceduralMeshData MeshData;
+		FTubeSegmentCache::Extrude(MeshData, Generation, 8, false);
+		FVertexWelder::Weld(MeshData);
+	};
+
+	IConsoleVariable* ScratchArenaVariable = CVarScratchArena.AsVariable();
+	const int32 PreviousValue = CVarScratchArena.GetValueOnGameThread();
+
+	for (int32 Pass = 0; Pass < 2; Pass++)
+	{
+		const bool bUseArena = Pass == 1;
+		ScratchArenaVariable->Set(bUseArena ? 1 : 0);
+
+		const int32 StartAllocations = GetNumHeapAllocations();
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			Generate(Iteration);
+		}
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+		const int32 NumAllocations = GetNumHeapAllocations() - StartAllocations;
+
+		UE_LOG(LogProceduralMeshes, Log, TEXT("%s: %.2f ms per generation, %.1f heap allocations per generation from scratch arrays"),
+			bUseArena ? TEXT("Scratch arena") : TEXT("Heap         "), Seconds * 1000.0 / Iterations, (double)NumAllocations / Iterations);
+	}
+
+	ScratchArenaVariable->Set(PreviousValue);
+}
+
+static FAutoConsoleCommand BenchmarkScratchArenaCommand(
+	TEXT("ProceduralMeshes.BenchmarkScratchArena"),
+	TEXT("Compares generation time and heap allocations of temporary arrays with and without the scratch arena. Optional argument: number of generations."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&FScratchArena::RunBenchmark));
@@ -0,0 +1,166 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Per thread linear allocator for the temporary arrays of a generation, rewound as a whole when the generation is done
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+
+// Each thread gets its own arena, a list of big blocks that allocations are carved out of one after another. Nothing is freed on its own,
+// the arena is rewound to where it was when an FScratchScope opened once that scope closes, so the next generation on the same thread
+// reuses the same blocks and the heap isn't touched at all once they are large enough. Growing the last allocation happens in place.
+// Only arrays created inside a scope use the arena, and only while they are on the thread and in the scope they were created in.
+// Anything else (no scope open, growing inside a nested scope, resizing from another thread) quietly falls back to the heap.
+class PROCEDURALMESHES_API FScratchArena
+{
+public:
+	// The arena of the calling thread, created the first time it is needed. Threads keep theirs for as long as they run.
+	static FScratchArena& Get();
+
+	// The arena of the calling thread if it has a scope open and the arena isn't switched off, otherwise null
+	static FScratchArena* GetIfInScope();
+
+	// Allocations are 16 byte aligned
+	void* Allocate(SIZE_T Size);
+
+	// Grows or shrinks the most recent allocation without moving it. Fails for any other allocation or when the block is full.
+	bool ResizeInPlace(void* Ptr, SIZE_T NewSize);
+
+	// Gives the memory back straight away if it was the most recent allocation, otherwise it is only reclaimed when the scope closes
+	void Free(void* Ptr);
+
+	// True on the thread that owns the arena while ScopeDepth is the innermost open scope
+	bool IsInnermostScope(int32 InScopeDepth) const;
+	int32 GetScopeDepth() const { return ScopeDepth; }
+
+	// Memory held in blocks, used or not
+	SIZE_T GetReservedBytes() const;
+
+	// Heap allocations made by scratch arrays and arena blocks, across all threads
+	static int32 GetNumHeapAllocations();
+	static void AddHeapAllocation();
+
+	// Usage: ProceduralMeshes.BenchmarkScratchArena [Iterations]
+	static void RunBenchmark(const TArray<FString>& Args);
+
+private:
+	friend class FScratchScope;
+
+	FScratchArena();
+
+	struct FBlock
+	{
+		uint8* Memory;
+		SIZE_T Size;
+	};
+
+	TArray<FBlock> Blocks;
+	int32 CurrentBlock;
+	SIZE_T Offset;
+	uint8* LastAllocation;
+	int32 ScopeDepth;
+	uint32 ThreadId;
+};
+
+// Rewinds the calling thread's arena to where it was when the scope opened. Scratch arrays must be declared after the scope they use.
+class PROCEDURALMESHES_API FScratchScope
+{
+public:
+	FScratchScope();
+	~FScratchScope();
+
+private:
+	FScratchScope(const FScratchScope&);
+	FScratchScope& operator=(const FScratchScope&);
+
+	FScratchArena& Arena;
+	int32 MarkBlock;
+	SIZE_T MarkOffset;
+};
+
+// Allocator policy for temporary arrays: TArray<float, FScratchAllocator>. The arrays can be read and written from any thread (a
+// ParallelFor filling one, for example), but anything that changes their size should stay on the thread that created them.
+class PROCEDURALMESHES_API FScratchAllocator
+{
+public:
+	typedef int32 SizeType;
+
+	enum { NeedsElementType = false };
+	enum { RequireRangeCheck = true };
+
+	class PROCEDURALMESHES_API ForAnyElementType
+	{
+	public:
+		ForAnyElementType();
+		~ForAnyElementType();
+
+		void MoveToEmpty(ForAnyElementType& Other);
+
+		FORCEINLINE FScriptContainerElement* GetAllocation() const
+		{
+			return Data;
+		}
+
+		void ResizeAllocation(SizeType PreviousNumElements, SizeType NumElements, SIZE_T NumBytesPerElement);
+
+		FORCEINLINE SizeType CalculateSlackReserve(SizeType NumElements, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackReserve(NumElements, NumBytesPerElement, false);
+		}
+
+		FORCEINLINE SizeType CalculateSlackShrink(SizeType NumElements, SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackShrink(NumElements, NumAllocatedElements, NumBytesPerElement, false);
+		}
+
+		FORCEINLINE SizeType CalculateSlackGrow(SizeType NumElements, SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackGrow(NumElements, NumAllocatedElements, NumBytesPerElement, false);
+		}
+
+		FORCEINLINE SIZE_T GetAllocatedSize(SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return NumAllocatedElements * NumBytesPerElement;
+		}
+
+		FORCEINLINE bool HasAllocation()
+		{
+			return !!Data;
+		}
+
+	private:
+		ForAnyElementType(const ForAnyElementType&);
+		ForAnyElementType& operator=(const ForAnyElementType&);
+
+		void FreeAllocation();
+
+		FScriptContainerElement* Data;
+
+		// The arena of the scope the array was created in, null if it was created outside one
+		FScratchArena* Arena;
+		int32 ScopeDepth;
+
+		// Whether Data came from the arena rather than the heap
+		bool bArenaAllocation;
+		SIZE_T AllocatedBytes;
+	};
+
+	template<typename ElementType>
+	class ForElementType : public ForAnyElementType
+	{
+	public:
+		ForElementType()
+		{
+		}
+
+		FORCEINLINE ElementType* GetAllocation() const
+		{
+			return (ElementType*)ForAnyElementType::GetAllocation();
+		}
+	};
+};
+
+template <>
+struct TAllocatorTraits<FScratchAllocator> : TAllocatorTraitsBase<FScratchAllocator>
+{
+	enum { SupportsMove = true };
+};
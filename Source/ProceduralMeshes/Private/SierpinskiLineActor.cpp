@@ -3,40 +3,116 @@
 
 #include "ProceduralMeshesPrivatePCH.h"
 #include "SierpinskiLineActor.h"
+#include "VertexWelding.h"
+
+DECLARE_CYCLE_STAT(TEXT("Sierpinski lines"), STAT_GenerateSierpinskiLines, STATGROUP_ProceduralMeshes);
 
 ASierpinskiLineActor::ASierpinskiLineActor()
+	: LinesStage(INDEX_NONE)
+	, GeometryStage(INDEX_NONE)
+	, OptimizationStage(INDEX_NONE)
+	, UploadStage(INDEX_NONE)
+	, MaterialStage(INDEX_NONE)
+	, CollisionStage(INDEX_NONE)
 {
-	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootScene"));
-	ProcMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("ProceduralMesh"));
-	ProcMesh->AttachTo(RootComponent);
-	// Make sure the PMC doesnt save any mesh data with the map
-	ProcMesh->SetFlags(EObjectFlags::RF_Transient);
+	FProceduralMeshLODChain::GetDefaultScreenSizes(LODScreenSizes);
 }
 
-#if WITH_EDITOR  
-void ASierpinskiLineActor::OnConstruction(const FTransform& Transform)
+void ASierpinskiLineActor::UpdateLOD()
 {
-	Super::OnConstruction(Transform);
-	PreCacheCrossSection();
-	GenerateMesh();
+	LODChain.Update(ProcMesh, LODScreenSizes, [this](int32 LODIndex) { GenerateLOD(LODIndex); });
 }
-#endif // WITH_EDITOR
 
-void ASierpinskiLineActor::BeginPlay()
+void ASierpinskiLineActor::SetupStages()
 {
-	Super::BeginPlay();
-	PreCacheCrossSection();
-	GenerateMesh();
-
-	// Fix for PCM location/rotation/scale since the whole component is Transient
-	ProcMesh->SetWorldLocation(this->GetActorLocation());
-	ProcMesh->SetWorldRotation(this->GetActorRotation());
-	ProcMesh->SetWorldScale3D(this->GetActorScale3D());
+	Pipeline.SetOwner(this, GET_STATID(STAT_GenerateSierpinskiLines));
+
+	LinesStage = Pipeline.AddStage(TEXT("Lines"), GET_STATID(STAT_ProceduralMeshStructure), [this]()
+	{
+		CreateLines();
+	}, TArray<int32>());
+
+	// -------------------------------------------------------
+	// All LODs are built from the same lines, but only LOD0 is built up front. Lines that are the same as last time are copied from the
+	// previous mesh instead of being extruded again.
+	GeometryStage = Pipeline.AddStage(TEXT("Geometry"), GET_STATID(STAT_ProceduralMeshVertexFill), [this]()
+	{
+		// The editor preview while dragging a slider is one of the lower LODs
+		const int32 GeometryLOD = GetPreviewLOD();
+		FScratchLineSegmentStreams LODSegments;
+		GetLODSegments(GeometryLOD, LODSegments);
+		LOD0Tubes.Build(LODSegments, FProceduralMeshLODChain::GetRadialSegmentCountForLOD(RadialSegmentCount, GeometryLOD), bSmoothNormals);
+	}, { LinesStage });
+
+	// Welds a copy, so turning welding off again doesn't need the geometry to be rebuilt
+	OptimizationStage = Pipeline.AddStage(TEXT("Optimization"), GET_STATID(STAT_ProceduralMeshOptimization), [this]()
+	{
+		LOD0WeldedMeshData.Reset();
+		if (bWeldVertices)
+		{
+			LOD0WeldedMeshData = LOD0Tubes.GetMeshData();
+			FVertexWelder::Weld(LOD0WeldedMeshData);
+		}
+	}, { GeometryStage });
+
+	UploadStage = Pipeline.AddStage(TEXT("Upload"), GET_STATID(STAT_ProceduralMeshUpload), [this]()
+	{
+		// The reflected copy is only made when someone wants to look at it, on the game thread like every other property
+		DebugLines.Reset();
+		if (bShowLinesInDetails)
+		{
+			DebugLines.Reserve(Lines.Num());
+			for (int32 LineIndex = 0; LineIndex < Lines.Num(); LineIndex++)
+			{
+				DebugLines.Add(FPyramidLine(Lines.GetStart(LineIndex), Lines.GetEnd(LineIndex), Lines.Width[LineIndex], Lines.Generation[LineIndex]));
+			}
+		}
+
+		ProcMesh->ClearAllMeshSections();
+		LODChain.Reset(NumLODs);
+		SetActorTickEnabled(NumLODs > 1);
+		UploadLOD(0, bWeldVertices ? LOD0WeldedMeshData : LOD0Tubes.GetMeshData());
+		LODChain.ShowLOD(ProcMesh, 0);
+		MeshDataMemory.Set(LOD0Tubes.GetMeshData().GetAllocatedSize() + LOD0WeldedMeshData.GetAllocatedSize());
+	}, { OptimizationStage }, true);
+
+	MaterialStage = Pipeline.AddStage(TEXT("Material"), GET_STATID(STAT_ProceduralMeshUpload), [this]()
+	{
+		for (int32 LODIndex = 0; LODIndex < NumLODs; LODIndex++)
+		{
+			ProcMesh->SetMaterial(LODIndex, Material);
+		}
+	}, { UploadStage }, true);
+
+	CollisionStage = Pipeline.AddStage(TEXT("Collision"), GET_STATID(STAT_ProceduralMeshCollision), [this]()
+	{
+		GenerateCollision();
+	}, { LinesStage }, true);
+
+	// The preview is built from the same lines
+	PreviewStage = GeometryStage;
+
+	// -------------------------------------------------------
+	// The properties that only affect part of the work. Everything else shapes the lines, which all the stages are built from.
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ASierpinskiLineActor, Material), MaterialStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ASierpinskiLineActor, RadialSegmentCount), GeometryStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ASierpinskiLineActor, bSmoothNormals), GeometryStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ASierpinskiLineActor, bWeldVertices), OptimizationStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ASierpinskiLineActor, NumLODs), UploadStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ASierpinskiLineActor, bShowLinesInDetails), UploadStage);
+
+	// Complex collision is cooked as part of the upload
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ASierpinskiLineActor, CollisionMode), UploadStage);
+	Pipeline.AddPropertyTrigger(GET_MEMBER_NAME_CHECKED(ASierpinskiLineActor, CollisionMode), CollisionStage);
+
+	// Only read when switching LODs
+	Pipeline.IgnoreProperty(GET_MEMBER_NAME_CHECKED(ASierpinskiLineActor, LODScreenSizes));
+	Pipeline.IgnoreProperty(GET_MEMBER_NAME_CHECKED(ASierpinskiLineActor, EditorPreviewLOD));
 }
 
-void ASierpinskiLineActor::GenerateMesh()
+void ASierpinskiLineActor::CreateLines()
 {
-	Lines.Empty();
+	Lines.Reset();
 
 	// -------------------------------------------------------
 	// Start by setting the four points that define a pyramid
@@ -49,71 +125,48 @@ void ASierpinskiLineActor::GenerateMesh()
 	FVector TopPoint = FVector(CenterPosX, 0, ThirdBasePointDistance);
 
 	// Then create all the lines between those 4 points
-	Lines.Add(FPyramidLine(BottomLeftPoint, BottomRightPoint, LineThickness));
-	Lines.Add(FPyramidLine(BottomRightPoint, TopPoint, LineThickness));
-	Lines.Add(FPyramidLine(TopPoint, BottomLeftPoint, LineThickness));
+	Lines.Add(BottomLeftPoint, BottomRightPoint, LineThickness, 0);
+	Lines.Add(BottomRightPoint, TopPoint, LineThickness, 0);
+	Lines.Add(TopPoint, BottomLeftPoint, LineThickness, 0);
 
-	Lines.Add(FPyramidLine(BottomLeftPoint, BottomMiddlePoint, LineThickness));
-	Lines.Add(FPyramidLine(BottomMiddlePoint, BottomRightPoint, LineThickness));
-	Lines.Add(FPyramidLine(BottomMiddlePoint, TopPoint, LineThickness));
+	Lines.Add(BottomLeftPoint, BottomMiddlePoint, LineThickness, 0);
+	Lines.Add(BottomMiddlePoint, BottomRightPoint, LineThickness, 0);
+	Lines.Add(BottomMiddlePoint, TopPoint, LineThickness, 0);
 
 	// -------------------------------------------------------
 	// Create the rest of the lines through recursion
 	AddSection(BottomLeftPoint, TopPoint, BottomRightPoint, BottomMiddlePoint, 1);
+}
 
-	// -------------------------------------------------------
-	// Calculate and pre-allocate buffers
-	int32 TotalNumberOfVerticesPerSection = RadialSegmentCount * 4; // 4 verts per face 
-	int32 TotalNumberOfTrianglesPerSection = TotalNumberOfVerticesPerSection + 2 * RadialSegmentCount;
-
-	FProceduralMeshData MeshData = FProceduralMeshData();
-	MeshData.Vertices.AddUninitialized(TotalNumberOfVerticesPerSection * Lines.Num());
-	MeshData.Triangles.AddUninitialized(TotalNumberOfTrianglesPerSection * Lines.Num());
-	MeshData.Normals.AddUninitialized(TotalNumberOfVerticesPerSection * Lines.Num());
-	MeshData.UVs.AddUninitialized(TotalNumberOfVerticesPerSection * Lines.Num());
-	MeshData.Tangents.AddUninitialized(TotalNumberOfVerticesPerSection * Lines.Num());
-
-	// -------------------------------------------------------
-	// Now lets loop through all the defined lines of the pyramid and create a cylinder for each
-	int32 CurrentIndexStart = 0;
+void ASierpinskiLineActor::GenerateLOD(int32 LODIndex)
+{
+	FScratchLineSegmentStreams LODSegments;
+	GetLODSegments(LODIndex, LODSegments);
 
-	for (int32 i = 0; i < Lines.Num(); i++)
+	FProceduralMeshData MeshData;
+	FTubeSegmentCache::Extrude(MeshData, LODSegments, FProceduralMeshLODChain::GetRadialSegmentCountForLOD(RadialSegmentCount, LODIndex), bSmoothNormals);
+	if (bWeldVertices)
 	{
-		CurrentIndexStart = i * TotalNumberOfVerticesPerSection;
-		GenerateCylinder(MeshData, Lines[i].Start, Lines[i].End, Lines[i].Width, RadialSegmentCount, CurrentIndexStart, bSmoothNormals);
+		FVertexWelder::Weld(MeshData);
 	}
-	
-	ProcMesh->ClearAllMeshSections();
-	ProcMesh->CreateMeshSection(0, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, false);
-	ProcMesh->SetMaterial(0, Material);
+	UploadLOD(LODIndex, MeshData);
+	ProcMesh->SetMaterial(LODIndex, Material);
 }
 
-FVector ASierpinskiLineActor::RotatePointAroundPivot(FVector InPoint, FVector InPivot, FVector InAngles)
+void ASierpinskiLineActor::GetLODSegments(int32 LODIndex, FScratchLineSegmentStreams& OutSegments) const
 {
-	FVector direction = InPoint - InPivot; // get point direction relative to pivot
-	direction = FQuat::MakeFromEuler(InAngles) * direction; // rotate it
-	return direction + InPivot; // calculate rotated point
+	// Each LOD drops the lines of the deepest iteration, but we always keep the outer pyramid
+	int32 LODMaxDepth = FMath::Max(0, Iterations - LODIndex);
+
+	OutSegments.Reset();
+	OutSegments.Append(Lines, LODMaxDepth);
 }
 
-void ASierpinskiLineActor::PreCacheCrossSection()
+void ASierpinskiLineActor::UploadLOD(int32 LODIndex, const FProceduralMeshData& MeshData)
 {
-	if (LastCachedCrossSectionCount == RadialSegmentCount)
-	{
-		return;
-	}
-
-	// Generate a cross-section for use in cylinder generation
-	const float AngleBetweenQuads = (2.0f / (float)(RadialSegmentCount)) * PI;
-	CachedCrossSectionPoints.Empty();
-
-	// Pre-calculate cross section points of a circle, two more than needed
-	for (int32 PointIndex = 0; PointIndex < (RadialSegmentCount + 2); PointIndex++)
-	{
-		float Angle = (float)PointIndex * AngleBetweenQuads;
-		CachedCrossSectionPoints.Add(FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0));
-	}
-
-	LastCachedCrossSectionCount = RadialSegmentCount;
+	FProceduralMeshStats::CountUpload(MeshData);
+	ProcMesh->CreateMeshSection(LODIndex, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, LODIndex == 0 && CollisionMode == EProceduralCollisionMode::Complex);
+	LODChain.MarkGenerated(LODIndex);
 }
 
 void ASierpinskiLineActor::AddSection(FVector InBottomLeftPoint, FVector InTopPoint, FVector InBottomRightPoint, FVector InBottomMiddlePoint, int32 InDepth)
@@ -143,24 +196,24 @@ void ASierpinskiLineActor::AddSection(FVector InBottomLeftPoint, FVector InTopPo
 	float NewThickness = LineThickness * FMath::Pow(ThicknessMultiplierPerGeneration, InDepth);
 
 	// First side
-	Lines.Add(FPyramidLine(Side1LeftPoint, Side1RightPoint, NewThickness));
-	Lines.Add(FPyramidLine(Side1RightPoint, Side1BottomPoint, NewThickness));
-	Lines.Add(FPyramidLine(Side1BottomPoint, Side1LeftPoint, NewThickness));
+	Lines.Add(Side1LeftPoint, Side1RightPoint, NewThickness, InDepth);
+	Lines.Add(Side1RightPoint, Side1BottomPoint, NewThickness, InDepth);
+	Lines.Add(Side1BottomPoint, Side1LeftPoint, NewThickness, InDepth);
 
 	// Second side
-	Lines.Add(FPyramidLine(BottomLeftPoint, Side1LeftPoint, NewThickness));
-	Lines.Add(FPyramidLine(BottomLeftPoint, MiddlePointUp, NewThickness));
-	Lines.Add(FPyramidLine(Side1LeftPoint, MiddlePointUp, NewThickness));
+	Lines.Add(BottomLeftPoint, Side1LeftPoint, NewThickness, InDepth);
+	Lines.Add(BottomLeftPoint, MiddlePointUp, NewThickness, InDepth);
+	Lines.Add(Side1LeftPoint, MiddlePointUp, NewThickness, InDepth);
 
 	// Third side
-	Lines.Add(FPyramidLine(BottomRightPoint, Side1RightPoint, NewThickness));
-	Lines.Add(FPyramidLine(BottomRightPoint, MiddlePointUp, NewThickness));
-	Lines.Add(FPyramidLine(Side1RightPoint, MiddlePointUp, NewThickness));
+	Lines.Add(BottomRightPoint, Side1RightPoint, NewThickness, InDepth);
+	Lines.Add(BottomRightPoint, MiddlePointUp, NewThickness, InDepth);
+	Lines.Add(Side1RightPoint, MiddlePointUp, NewThickness, InDepth);
 
 	// Fourth side (bottom)
-	Lines.Add(FPyramidLine(Side1BottomPoint, BottomLeftPoint, NewThickness));
-	Lines.Add(FPyramidLine(Side1BottomPoint, BottomRightPoint, NewThickness));
-	Lines.Add(FPyramidLine(BottomLeftPoint, BottomRightPoint, NewThickness));
+	Lines.Add(Side1BottomPoint, BottomLeftPoint, NewThickness, InDepth);
+	Lines.Add(Side1BottomPoint, BottomRightPoint, NewThickness, InDepth);
+	Lines.Add(BottomLeftPoint, BottomRightPoint, NewThickness, InDepth);
 
 	AddSection(InBottomLeftPoint, Side1LeftPoint, Side1BottomPoint, BottomLeftPoint, InDepth + 1); // Lower left pyramid
 	AddSection(Side1LeftPoint, InTopPoint, Side1RightPoint, MiddlePointUp, InDepth + 1); // Top pyramid
@@ -168,105 +221,21 @@ void ASierpinskiLineActor::AddSection(FVector InBottomLeftPoint, FVector InTopPo
 	AddSection(BottomLeftPoint, MiddlePointUp, BottomRightPoint, InBottomMiddlePoint, InDepth + 1); // Lower middle pyramid
 }
 
-void ASierpinskiLineActor::GenerateCylinder(FProceduralMeshData& MeshData, FVector StartPoint, FVector EndPoint, float InWidth, int32 InCrossSectionCount, int32 InVertexIndexStart, bool bInSmoothNormals/* = true*/)
+void ASierpinskiLineActor::GenerateCollision()
 {
-	// Basic setup
-	int32 VertexIndex = InVertexIndexStart;
-	int32 NumVerts = InCrossSectionCount * 4; // 4 verts per face
-
-	// Make a cylinder section
-	const float AngleBetweenQuads = (2.0f / (float)(InCrossSectionCount)) * PI;
-	const float UMapPerQuad = 1.0f / (float)InCrossSectionCount;
-
-	FVector StartOffset = StartPoint - FVector(0, 0, 0);
-	FVector Offset = EndPoint - StartPoint;
-
-	// Find angle between vectors
-	FVector LineDirection = (StartPoint - EndPoint);
-	LineDirection.Normalize();
-	FVector RotationAngle = LineDirection.Rotation().Add(90.f, 0.f, 0.f).Euler();
+	if (CollisionMode != EProceduralCollisionMode::Simple)
+	{
+		Collision->ClearCollision();
+		return;
+	}
 
-	// Start by building up vertices that make up the cylinder sides
-	for (int32 QuadIndex = 0; QuadIndex < InCrossSectionCount; QuadIndex++)
+	// The worker thread gets its own copy of the lines and builds the capsules from those
+	FLineSegmentStreams CollisionLines = Lines;
+	Collision->BuildCollisionAsync([CollisionLines](FKAggregateGeom& Shapes)
 	{
-		float Angle = (float)QuadIndex * AngleBetweenQuads;
-		float NextAngle = (float)(QuadIndex + 1) * AngleBetweenQuads;
-
-		// Set up the vertices
-		FVector p0 = (CachedCrossSectionPoints[QuadIndex] * InWidth) + StartOffset;
-		p0 = RotatePointAroundPivot(p0, StartPoint, RotationAngle);
-		FVector p1 = CachedCrossSectionPoints[QuadIndex + 1] * InWidth + StartOffset;
-		p1 = RotatePointAroundPivot(p1, StartPoint, RotationAngle);
-		FVector p2 = p1 + Offset;
-		FVector p3 = p0 + Offset;
-
-		// Set up the quad triangles
-		int32 VertIndex1 = VertexIndex++;
-		int32 VertIndex2 = VertexIndex++;
-		int32 VertIndex3 = VertexIndex++;
-		int32 VertIndex4 = VertexIndex++;
-
-		MeshData.Vertices[VertIndex1] = p0;
-		MeshData.Vertices[VertIndex2] = p1;
-		MeshData.Vertices[VertIndex3] = p2;
-		MeshData.Vertices[VertIndex4] = p3;
-
-		// Now create two triangles from those four vertices
-		// The order of these (clockwise/counter-clockwise) dictates which way the normal will face. 
-		MeshData.Triangles.Add(VertIndex4);
-		MeshData.Triangles.Add(VertIndex3);
-		MeshData.Triangles.Add(VertIndex1);
-
-		MeshData.Triangles.Add(VertIndex3);
-		MeshData.Triangles.Add(VertIndex2);
-		MeshData.Triangles.Add(VertIndex1);
-
-		// UVs.  Note that Unreal UV origin (0,0) is top left
-		MeshData.UVs[VertIndex1] = FVector2D(1.0f - (UMapPerQuad * QuadIndex), 1.0f);
-		MeshData.UVs[VertIndex2] = FVector2D(1.0f - (UMapPerQuad * (QuadIndex + 1)), 1.0f);
-		MeshData.UVs[VertIndex3] = FVector2D(1.0f - (UMapPerQuad * (QuadIndex + 1)), 0.0f);
-		MeshData.UVs[VertIndex4] = FVector2D(1.0f - (UMapPerQuad * QuadIndex), 0.0f);
-
-		// Normals
-		FVector NormalCurrent = FVector::CrossProduct(MeshData.Vertices[VertIndex1] - MeshData.Vertices[VertIndex3], MeshData.Vertices[VertIndex2] - MeshData.Vertices[VertIndex3]).GetSafeNormal();
-
-		if (bInSmoothNormals)
-		{
-			// To smooth normals we give the vertices different values than the polygon they belong to.
-			// GPUs know how to interpolate between those.
-			// I do this here as an average between normals of two adjacent polygons
-			float NextNextAngle = (float)(QuadIndex + 2) * AngleBetweenQuads;
-			FVector p4 = (CachedCrossSectionPoints[QuadIndex + 2] * InWidth) + StartOffset;
-			p4 = RotatePointAroundPivot(p4, StartPoint, RotationAngle);
-
-			// p1 to p4 to p2
-			FVector NormalNext = FVector::CrossProduct(p1 - p2, p4 - p2).GetSafeNormal();
-			FVector AverageNormalRight = (NormalCurrent + NormalNext) / 2;
-			AverageNormalRight = AverageNormalRight.GetSafeNormal();
-
-			float PreviousAngle = (float)(QuadIndex - 1) * AngleBetweenQuads;
-			FVector pMinus1 = FVector(FMath::Cos(PreviousAngle) * InWidth, FMath::Sin(PreviousAngle) * InWidth, 0.f) + StartOffset;
-			pMinus1 = RotatePointAroundPivot(pMinus1, StartPoint, RotationAngle);
-
-			// p0 to p3 to pMinus1
-			FVector NormalPrevious = FVector::CrossProduct(p0 - pMinus1, p3 - pMinus1).GetSafeNormal();
-			FVector AverageNormalLeft = (NormalCurrent + NormalPrevious) / 2;
-			AverageNormalLeft = AverageNormalLeft.GetSafeNormal();
-
-			MeshData.Normals[VertIndex1] = AverageNormalLeft;
-			MeshData.Normals[VertIndex2] = AverageNormalRight;
-			MeshData.Normals[VertIndex3] = AverageNormalRight;
-			MeshData.Normals[VertIndex4] = AverageNormalLeft;
-		}
-		else
+		for (int32 LineIndex = 0; LineIndex < CollisionLines.Num(); LineIndex++)
 		{
-			// If not smoothing we just set the vertex normal to the same normal as the polygon they belong to
-			MeshData.Normals[VertIndex1] = MeshData.Normals[VertIndex2] = MeshData.Normals[VertIndex3] = MeshData.Normals[VertIndex4] = NormalCurrent;
+			UProceduralCollisionComponent::AddCapsule(Shapes, CollisionLines.GetStart(LineIndex), CollisionLines.GetEnd(LineIndex), CollisionLines.Width[LineIndex]);
 		}
-
-		// Tangents (perpendicular to the surface)
-		FVector SurfaceTangent = p0 - p1;
-		SurfaceTangent = SurfaceTangent.GetSafeNormal();
-		MeshData.Tangents[VertIndex1] = MeshData.Tangents[VertIndex2] = MeshData.Tangents[VertIndex3] = MeshData.Tangents[VertIndex4] = FProcMeshTangent(SurfaceTangent, true);
-	}
+	});
 }
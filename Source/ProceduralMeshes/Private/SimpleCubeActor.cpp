@@ -3,6 +3,9 @@
 
 #include "ProceduralMeshesPrivatePCH.h"
 #include "SimpleCubeActor.h"
+#include "ProceduralMeshStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Simple cube"), STAT_GenerateSimpleCube, STATGROUP_ProceduralMeshes);
 
 ASimpleCubeActor::ASimpleCubeActor()
 {
@@ -11,6 +14,10 @@ ASimpleCubeActor::ASimpleCubeActor()
 	ProcMesh->AttachTo(RootComponent);
 	// Make sure the PMC doesnt save any mesh data with the map
 	ProcMesh->SetFlags(EObjectFlags::RF_Transient);
+
+	Collision = CreateDefaultSubobject<UProceduralCollisionComponent>(TEXT("Collision"));
+	Collision->AttachTo(RootComponent);
+	Collision->SetFlags(EObjectFlags::RF_Transient);
 }
 
 #if WITH_EDITOR  
@@ -26,22 +33,40 @@ void ASimpleCubeActor::BeginPlay()
 	Super::BeginPlay();
 	GenerateMesh();
 
-	// Fix for PCM location/rotation/scale since the whole component is Transient
+	// Fix for PCM and collision location/rotation/scale since both components are Transient
 	ProcMesh->SetWorldLocation(this->GetActorLocation());
 	ProcMesh->SetWorldRotation(this->GetActorRotation());
 	ProcMesh->SetWorldScale3D(this->GetActorScale3D());
+	Collision->SetWorldLocation(this->GetActorLocation());
+	Collision->SetWorldRotation(this->GetActorRotation());
+	Collision->SetWorldScale3D(this->GetActorScale3D());
 }
 
 void ASimpleCubeActor::GenerateMesh()
 {
+	FProceduralMeshGenerationScope GenerationScope(this, GET_STATID(STAT_GenerateSimpleCube));
 	FProceduralMeshData MeshData = FProceduralMeshData();
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshVertexFill);
+		BuildMeshData(MeshData);
+	}
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshUpload);
+		FProceduralMeshStats::CountUpload(MeshData);
+		ProcMesh->ClearAllMeshSections();
+		ProcMesh->CreateMeshSection(0, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, CollisionMode == EProceduralCollisionMode::Complex);
+		ProcMesh->SetMaterial(0, Material);
+	}
+	SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshCollision);
+	GenerateCollision();
+}
+
+void ASimpleCubeActor::BuildMeshData(FProceduralMeshData& MeshData) const
+{
 	GenerateCube(MeshData, Depth, Width, Height);
-	ProcMesh->ClearAllMeshSections();
-	ProcMesh->CreateMeshSection(0, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, false);
-	ProcMesh->SetMaterial(0, Material);
 }
 
-void ASimpleCubeActor::GenerateCube(FProceduralMeshData& MeshData, float Depth, float Width, float Height)
+void ASimpleCubeActor::GenerateCube(FProceduralMeshData& MeshData, float Depth, float Width, float Height) const
 {
 	// NOTE: Unreal uses an upper-left origin UV
 	// NOTE: This sample uses a simple UV mapping scheme where each face is the same
@@ -105,15 +130,15 @@ void ASimpleCubeActor::GenerateCube(FProceduralMeshData& MeshData, float Depth,
 	VertexOffset = BuildQuad(MeshData, p1, p0, p4, p5, VertexOffset, Normal, Tangent);
 }
 
-int32 ASimpleCubeActor::BuildQuad(FProceduralMeshData& MeshData, FVector BottomLeft, FVector BottomRight, FVector TopRight, FVector TopLeft, int32 VertexOffset, FVector Normal, FProcMeshTangent Tangent)
+int32 ASimpleCubeActor::BuildQuad(FProceduralMeshData& MeshData, FVector BottomLeft, FVector BottomRight, FVector TopRight, FVector TopLeft, int32 VertexOffset, FVector Normal, FProcMeshTangent Tangent, FVector2D UVScale/* = FVector2D(1.0f, 1.0f)*/)
 {
 	MeshData.Vertices[VertexOffset + 0] = BottomLeft;
 	MeshData.Vertices[VertexOffset + 1] = BottomRight;
 	MeshData.Vertices[VertexOffset + 2] = TopRight;
 	MeshData.Vertices[VertexOffset + 3] = TopLeft;
-	MeshData.UVs[VertexOffset + 0] = FVector2D(0.0f, 1.0f);
-	MeshData.UVs[VertexOffset + 1] = FVector2D(1.0f, 1.0f);
-	MeshData.UVs[VertexOffset + 2] = FVector2D(1.0f, 0.0f);
+	MeshData.UVs[VertexOffset + 0] = FVector2D(0.0f, UVScale.Y);
+	MeshData.UVs[VertexOffset + 1] = FVector2D(UVScale.X, UVScale.Y);
+	MeshData.UVs[VertexOffset + 2] = FVector2D(UVScale.X, 0.0f);
 	MeshData.UVs[VertexOffset + 3] = FVector2D(0.0f, 0.0f);
 	MeshData.Triangles.Add(VertexOffset + 0);
 	MeshData.Triangles.Add(VertexOffset + 1);
@@ -125,4 +150,20 @@ int32 ASimpleCubeActor::BuildQuad(FProceduralMeshData& MeshData, FVector BottomL
 	MeshData.Normals[VertexOffset + 0] = MeshData.Normals[VertexOffset + 1] = MeshData.Normals[VertexOffset + 2] = MeshData.Normals[VertexOffset + 3] = Normal;
 	MeshData.Tangents[VertexOffset + 0] = MeshData.Tangents[VertexOffset + 1] = MeshData.Tangents[VertexOffset + 2] = MeshData.Tangents[VertexOffset + 3] = Tangent;
 	return VertexOffset + 4;
-}
\ No newline at end of file
+}
+
+void ASimpleCubeActor::GenerateCollision()
+{
+	if (CollisionMode != EProceduralCollisionMode::Simple)
+	{
+		Collision->ClearCollision();
+		return;
+	}
+
+	// The cube is centered on the actor, so one box covers it exactly
+	const FVector Size = FVector(Depth, Width, Height);
+	Collision->BuildCollisionAsync([Size](FKAggregateGeom& Shapes)
+	{
+		Shapes.BoxElems.Add(FKBoxElem(Size.X, Size.Y, Size.Z));
+	});
+}
@@ -0,0 +1,172 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Extrudes a cylinder around each segment of a line, copying the ones that didn't change since the last build
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "TubeSegmentCache.h"
+#include "CrossSectionCache.h"
+#include "CylinderKernels.h"
+
+namespace TubeSegmentCache
+{
+	// Fewer than three radial segments can't go around anything. FCrossSectionRing has a minimum of its own, so the count is clamped
+	// before anything is sized from it, to keep the buffers and the ring the kernels walk the same size.
+	int32 ClampRadialSegmentCount(int32 RadialSegmentCount)
+	{
+		return FMath::Max(RadialSegmentCount, 3);
+	}
+
+	int32 GetVerticesPerSegment(int32 RadialSegmentCount)
+	{
+		return RadialSegmentCount * 4; // 4 verts per face
+	}
+
+	int32 GetIndicesPerSegment(int32 RadialSegmentCount)
+	{
+		return RadialSegmentCount * 2 * 3; // 2x3 vertex indexes per face
+	}
+
+	void AllocateMeshData(FProceduralMeshData& MeshData, int32 NumSegments, int32 RadialSegmentCount)
+	{
+		const int32 NumVertices = GetVerticesPerSegment(RadialSegmentCount) * NumSegments;
+		MeshData.Reset();
+		MeshData.Vertices.AddUninitialized(NumVertices);
+		MeshData.Triangles.AddUninitialized(GetIndicesPerSegment(RadialSegmentCount) * NumSegments);
+		MeshData.Normals.AddUninitialized(NumVertices);
+		MeshData.UVs.AddUninitialized(NumVertices);
+		MeshData.Tangents.AddUninitialized(NumVertices);
+	}
+
+	FTubeSegment GetSegment(const FScratchLineSegmentStreams& Segments, int32 Index)
+	{
+		return FTubeSegment(Segments.GetStart(Index), Segments.GetEnd(Index), Segments.Width[Index]);
+	}
+
+	// The tube rotations of every segment, one quaternion component per array
+	struct FTubeRotations
+	{
+		TArray<float, FScratchAllocator> X;
+		TArray<float, FScratchAllocator> Y;
+		TArray<float, FScratchAllocator> Z;
+		TArray<float, FScratchAllocator> W;
+
+		explicit FTubeRotations(const FScratchLineSegmentStreams& Segments)
+		{
+			const int32 NumSegments = Segments.Num();
+			X.SetNumUninitialized(NumSegments);
+			Y.SetNumUninitialized(NumSegments);
+			Z.SetNumUninitialized(NumSegments);
+			W.SetNumUninitialized(NumSegments);
+			FCylinderKernels::GetTubeRotations(NumSegments, Segments.StartX.GetData(), Segments.StartY.GetData(), Segments.StartZ.GetData(),
+				Segments.EndX.GetData(), Segments.EndY.GetData(), Segments.EndZ.GetData(), X.GetData(), Y.GetData(), Z.GetData(), W.GetData());
+		}
+
+		FQuat Get(int32 Index) const
+		{
+			return FQuat(X[Index], Y[Index], Z[Index], W[Index]);
+		}
+	};
+
+	void CopySegment(FProceduralMeshData& MeshData, int32 SegmentIndex, const FProceduralMeshData& PreviousMeshData, int32 PreviousSegmentIndex, int32 RadialSegmentCount)
+	{
+		const int32 VerticesPerSegment = GetVerticesPerSegment(RadialSegmentCount);
+		const int32 IndicesPerSegment = GetIndicesPerSegment(RadialSegmentCount);
+		const int32 VertexStart = SegmentIndex * VerticesPerSegment;
+		const int32 PreviousVertexStart = PreviousSegmentIndex * VerticesPerSegment;
+
+		FMemory::Memcpy(MeshData.Vertices.GetData() + VertexStart, PreviousMeshData.Vertices.GetData() + PreviousVertexStart, VerticesPerSegment * sizeof(FVector));
+		FMemory::Memcpy(MeshData.Normals.GetData() + VertexStart, PreviousMeshData.Normals.GetData() + PreviousVertexStart, VerticesPerSegment * sizeof(FVector));
+		FMemory::Memcpy(MeshData.UVs.GetData() + VertexStart, PreviousMeshData.UVs.GetData() + PreviousVertexStart, VerticesPerSegment * sizeof(FVector2D));
+		FMemory::Memcpy(MeshData.Tangents.GetData() + VertexStart, PreviousMeshData.Tangents.GetData() + PreviousVertexStart, VerticesPerSegment * sizeof(FProcMeshTangent));
+
+		// The triangles point at the segment's own vertices, which have moved along with it
+		const int32 VertexOffset = VertexStart - PreviousVertexStart;
+		const int32* SourceIndices = PreviousMeshData.Triangles.GetData() + PreviousSegmentIndex * IndicesPerSegment;
+		int32* DestinationIndices = MeshData.Triangles.GetData() + SegmentIndex * IndicesPerSegment;
+		for (int32 Index = 0; Index < IndicesPerSegment; Index++)
+		{
+			DestinationIndices[Index] = SourceIndices[Index] + VertexOffset;
+		}
+	}
+}
+
+FTubeSegmentCache::FTubeSegmentCache()
+	: RadialSegmentCount(0), bSmoothNormals(false)
+{
+}
+
+int32 FTubeSegmentCache::Build(const FScratchLineSegmentStreams& NewSegments, int32 InRadialSegmentCount, bool bNewSmoothNormals)
+{
+	const int32 NewRadialSegmentCount = TubeSegmentCache::ClampRadialSegmentCount(InRadialSegmentCount);
+
+	// A different cross section changes every segment
+	if (NewRadialSegmentCount != RadialSegmentCount || bNewSmoothNormals != bSmoothNormals)
+	{
+		Reset();
+	}
+
+	TMap<FTubeSegment, int32> PreviousSegmentIndices;
+	PreviousSegmentIndices.Reserve(Segments.Num());
+	for (int32 SegmentIndex = 0; SegmentIndex < Segments.Num(); SegmentIndex++)
+	{
+		PreviousSegmentIndices.Add(Segments[SegmentIndex], SegmentIndex);
+	}
+
+	FCrossSectionRingRef CrossSection = FCrossSectionCache::Get(NewRadialSegmentCount);
+	FCylinderKernels::FTubeKernel GenerateCylinder = FCylinderKernels::SelectTubeKernel(bNewSmoothNormals, NewRadialSegmentCount);
+	const int32 VerticesPerSegment = TubeSegmentCache::GetVerticesPerSegment(NewRadialSegmentCount);
+
+	const TubeSegmentCache::FTubeRotations Rotations(NewSegments);
+
+	FProceduralMeshData NewMeshData;
+	TubeSegmentCache::AllocateMeshData(NewMeshData, NewSegments.Num(), NewRadialSegmentCount);
+
+	TArray<FTubeSegment> BuiltSegments;
+	BuiltSegments.Reserve(NewSegments.Num());
+	int32 NumReused = 0;
+	for (int32 SegmentIndex = 0; SegmentIndex < NewSegments.Num(); SegmentIndex++)
+	{
+		const FTubeSegment Segment = TubeSegmentCache::GetSegment(NewSegments, SegmentIndex);
+		BuiltSegments.Add(Segment);
+		const int32* PreviousSegmentIndex = PreviousSegmentIndices.Find(Segment);
+		if (PreviousSegmentIndex)
+		{
+			TubeSegmentCache::CopySegment(NewMeshData, SegmentIndex, MeshData, *PreviousSegmentIndex, NewRadialSegmentCount);
+			NumReused++;
+		}
+		else
+		{
+			GenerateCylinder(NewMeshData, *CrossSection, Segment.Start, Segment.End, Segment.Width, Rotations.Get(SegmentIndex), SegmentIndex * VerticesPerSegment);
+		}
+	}
+
+	Segments = MoveTemp(BuiltSegments);
+	MeshData = MoveTemp(NewMeshData);
+	RadialSegmentCount = NewRadialSegmentCount;
+	bSmoothNormals = bNewSmoothNormals;
+
+	INC_DWORD_STAT_BY(STAT_ProceduralMeshTubeSegmentsReused, NumReused);
+	return NumReused;
+}
+
+void FTubeSegmentCache::Extrude(FProceduralMeshData& MeshData, const FScratchLineSegmentStreams& Segments, int32 InRadialSegmentCount, bool bSmoothNormals)
+{
+	const int32 RadialSegmentCount = TubeSegmentCache::ClampRadialSegmentCount(InRadialSegmentCount);
+	const TubeSegmentCache::FTubeRotations Rotations(Segments);
+	FCrossSectionRingRef CrossSection = FCrossSectionCache::Get(RadialSegmentCount);
+	FCylinderKernels::FTubeKernel GenerateCylinder = FCylinderKernels::SelectTubeKernel(bSmoothNormals, RadialSegmentCount);
+	const int32 VerticesPerSegment = TubeSegmentCache::GetVerticesPerSegment(RadialSegmentCount);
+
+	TubeSegmentCache::AllocateMeshData(MeshData, Segments.Num(), RadialSegmentCount);
+	for (int32 SegmentIndex = 0; SegmentIndex < Segments.Num(); SegmentIndex++)
+	{
+		GenerateCylinder(MeshData, *CrossSection, Segments.GetStart(SegmentIndex), Segments.GetEnd(SegmentIndex), Segments.Width[SegmentIndex], Rotations.Get(SegmentIndex), SegmentIndex * VerticesPerSegment);
+	}
+}
+
+void FTubeSegmentCache::Reset()
+{
+	Segments.Reset();
+	MeshData.Reset();
+	RadialSegmentCount = 0;
+	bSmoothNormals = false;
+}
@@ -0,0 +1,62 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Extrudes a cylinder around each segment of a line, copying the ones that didn't change since the last build
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshData.h"
+#include "LineSegmentStreams.h"
+
+struct PROCEDURALMESHES_API FTubeSegment
+{
+	FVector Start;
+	FVector End;
+	float Width;
+
+	FTubeSegment()
+		: Start(FVector::ZeroVector), End(FVector::ZeroVector), Width(1.0f)
+	{
+	}
+
+	FTubeSegment(const FVector& InStart, const FVector& InEnd, float InWidth)
+		: Start(InStart), End(InEnd), Width(InWidth)
+	{
+	}
+
+	bool operator==(const FTubeSegment& Other) const
+	{
+		return Start == Other.Start && End == Other.End && Width == Other.Width;
+	}
+
+	friend uint32 GetTypeHash(const FTubeSegment& Segment)
+	{
+		return HashCombine(HashCombine(GetTypeHash(Segment.Start), GetTypeHash(Segment.End)), GetTypeHash(Segment.Width));
+	}
+};
+
+// Every segment is extruded by the tube kernel into its own block of vertices and triangles, so a segment that is exactly the same as one
+// from the last build (same points, same width, same cross section) can be copied over with its triangles offset instead of extruded again.
+// Segments only match exactly when they were generated from the same inputs, which is what happens to the unaffected parts of a line when
+// a single point or a property that only some segments use is edited.
+class PROCEDURALMESHES_API FTubeSegmentCache
+{
+public:
+	FTubeSegmentCache();
+
+	// Replaces the mesh with one cylinder per segment, in order. Returns the number of segments that were copied from the previous mesh.
+	// The rotations of all the segments are worked out in one go before any of them are extruded.
+	int32 Build(const FScratchLineSegmentStreams& Segments, int32 RadialSegmentCount, bool bSmoothNormals);
+
+	// Builds the segments into MeshData without keeping anything around, for meshes that are only built once like lower LODs
+	static void Extrude(FProceduralMeshData& MeshData, const FScratchLineSegmentStreams& Segments, int32 RadialSegmentCount, bool bSmoothNormals);
+
+	const FProceduralMeshData& GetMeshData() const { return MeshData; }
+
+	void Reset();
+
+private:
+	TArray<FTubeSegment> Segments;
+	FProceduralMeshData MeshData;
+	int32 RadialSegmentCount;
+	bool bSmoothNormals;
+};
@@ -0,0 +1,344 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Reorders generated index and vertex buffers for the post-transform vertex cache
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "VertexCacheOptimizer.h"
+
+namespace VertexCacheOptimizer
+{
+	// Moves every element to the position given by NewIndices, arrays that aren't per vertex are left alone
+	template<typename ElementType>
+	void RemapVertexArray(TArray<ElementType>& Elements, const TArray<int32>& NewIndices)
+	{
+		if (Elements.Num() != NewIndices.Num())
+		{
+			return;
+		}
+
+		TArray<ElementType> Remapped;
+		Remapped.SetNumUninitialized(Elements.Num());
+		for (int32 Index = 0; Index < Elements.Num(); Index++)
+		{
+			Remapped[NewIndices[Index]] = Elements[Index];
+		}
+		Elements = MoveTemp(Remapped);
+	}
+
+	class FTipsify
+	{
+	public:
+		FTipsify(const TArray<int32>& InTriangles, int32 InNumVertices, int32 InCacheSize)
+			: Triangles(InTriangles)
+			, NumVertices(InNumVertices)
+			, CacheSize(InCacheSize)
+		{
+			// -------------------------------------------------------
+			// List the triangles using each vertex, packed into one array
+			LiveTriangleCounts.SetNumZeroed(NumVertices);
+			for (int32 VertexIndex : Triangles)
+			{
+				LiveTriangleCounts[VertexIndex]++;
+			}
+
+			AdjacencyOffsets.SetNumUninitialized(NumVertices + 1);
+			AdjacencyOffsets[0] = 0;
+			for (int32 VertexIndex = 0; VertexIndex < NumVertices; VertexIndex++)
+			{
+				AdjacencyOffsets[VertexIndex + 1] = AdjacencyOffsets[VertexIndex] + LiveTriangleCounts[VertexIndex];
+			}
+
+			TArray<int32> FillCounts;
+			FillCounts.SetNumZeroed(NumVertices);
+			AdjacentTriangles.SetNumUninitialized(Triangles.Num());
+			for (int32 Corner = 0; Corner < Triangles.Num(); Corner++)
+			{
+				const int32 VertexIndex = Triangles[Corner];
+				AdjacentTriangles[AdjacencyOffsets[VertexIndex] + FillCounts[VertexIndex]++] = Corner / 3;
+			}
+		}
+
+		// Fills OutOrder with the triangle indices in the order they should be drawn, and OutClusterStarts with the positions in it
+		// where the cache had gone cold, which are the only places the order can be cut without costing extra cache misses
+		void Run(TArray<int32>& OutOrder, TArray<int32>& OutClusterStarts)
+		{
+			const int32 NumTriangles = Triangles.Num() / 3;
+			OutOrder.Reset(NumTriangles);
+			OutClusterStarts.Reset();
+			OutClusterStarts.Add(0);
+
+			TArray<bool> bEmitted;
+			bEmitted.Init(false, NumTriangles);
+			CacheTimes.SetNumZeroed(NumVertices);
+			Time = CacheSize + 1;
+			NextUnprocessedVertex = 0;
+
+			TArray<int32> Candidates;
+			int32 FanningVertex = Triangles[0];
+
+			while (FanningVertex != INDEX_NONE)
+			{
+				// -------------------------------------------------------
+				// Draw every triangle around the fanning vertex that hasn't been drawn yet
+				Candidates.Reset();
+				for (int32 Adjacency = AdjacencyOffsets[FanningVertex]; Adjacency < AdjacencyOffsets[FanningVertex + 1]; Adjacency++)
+				{
+					const int32 TriangleIndex = AdjacentTriangles[Adjacency];
+					if (bEmitted[TriangleIndex])
+					{
+						continue;
+					}
+
+					for (int32 Corner = 0; Corner < 3; Corner++)
+					{
+						const int32 VertexIndex = Triangles[TriangleIndex * 3 + Corner];
+						DeadEndStack.Add(VertexIndex);
+						Candidates.Add(VertexIndex);
+						LiveTriangleCounts[VertexIndex]--;
+						if (!IsInCache(VertexIndex))
+						{
+							CacheTimes[VertexIndex] = Time++;
+						}
+					}
+
+					bEmitted[TriangleIndex] = true;
+					OutOrder.Add(TriangleIndex);
+				}
+
+				// -------------------------------------------------------
+				// Continue from the vertex that will still be in the cache when all its triangles are drawn, and has been in it the longest
+				FanningVertex = INDEX_NONE;
+				int32 BestPriority = -1;
+				for (int32 VertexIndex : Candidates)
+				{
+					if (LiveTriangleCounts[VertexIndex] > 0)
+					{
+						const int32 Age = Time - CacheTimes[VertexIndex];
+						const int32 Priority = Age + 2 * LiveTriangleCounts[VertexIndex] <= CacheSize ? Age : 0;
+						if (Priority > BestPriority)
+						{
+							BestPriority = Priority;
+							FanningVertex = VertexIndex;
+						}
+					}
+				}
+
+				if (FanningVertex == INDEX_NONE)
+				{
+					FanningVertex = SkipDeadEnd();
+					if (FanningVertex != INDEX_NONE && !IsInCache(FanningVertex) && OutOrder.Num() > OutClusterStarts.Last())
+					{
+						OutClusterStarts.Add(OutOrder.Num());
+					}
+				}
+			}
+		}
+
+	private:
+		bool IsInCache(int32 VertexIndex) const
+		{
+			return Time - CacheTimes[VertexIndex] <= CacheSize;
+		}
+
+		// Nothing good left around the last fan, try the most recently used vertices first and then just the next one with triangles left
+		int32 SkipDeadEnd()
+		{
+			while (DeadEndStack.Num() > 0)
+			{
+				const int32 VertexIndex = DeadEndStack.Pop(false);
+				if (LiveTriangleCounts[VertexIndex] > 0)
+				{
+					return VertexIndex;
+				}
+			}
+
+			while (NextUnprocessedVertex < NumVertices)
+			{
+				if (LiveTriangleCounts[NextUnprocessedVertex] > 0)
+				{
+					return NextUnprocessedVertex;
+				}
+				NextUnprocessedVertex++;
+			}
+
+			return INDEX_NONE;
+		}
+
+		const TArray<int32>& Triangles;
+		const int32 NumVertices;
+		const int32 CacheSize;
+
+		TArray<int32> AdjacencyOffsets;
+		TArray<int32> AdjacentTriangles;
+		TArray<int32> LiveTriangleCounts;
+		TArray<int32> CacheTimes;
+		TArray<int32> DeadEndStack;
+		int32 Time;
+		int32 NextUnprocessedVertex;
+	};
+
+	// Draws the clusters facing away from the middle of the mesh first, they are the most likely to cover the others.
+	// Only the order of the clusters changes, so the cache behaviour inside each of them stays the same.
+	void SortClustersForOverdraw(const FProceduralMeshData& MeshData, TArray<int32>& Order, const TArray<int32>& ClusterStarts)
+	{
+		const int32 NumClusters = ClusterStarts.Num();
+		if (NumClusters < 2)
+		{
+			return;
+		}
+
+		FVector MeshCenter = FVector::ZeroVector;
+		for (const FVector& Vertex : MeshData.Vertices)
+		{
+			MeshCenter += Vertex;
+		}
+		MeshCenter /= MeshData.Vertices.Num();
+
+		TArray<float> ClusterScores;
+		TArray<int32> ClusterOrder;
+		ClusterScores.SetNumUninitialized(NumClusters);
+		ClusterOrder.SetNumUninitialized(NumClusters);
+
+		for (int32 Cluster = 0; Cluster < NumClusters; Cluster++)
+		{
+			const int32 ClusterEnd = Cluster + 1 < NumClusters ? ClusterStarts[Cluster + 1] : Order.Num();
+			FVector AreaWeightedNormal = FVector::ZeroVector;
+			FVector AreaWeightedCenter = FVector::ZeroVector;
+			float TotalArea = 0.0f;
+
+			for (int32 Position = ClusterStarts[Cluster]; Position < ClusterEnd; Position++)
+			{
+				const int32 TriangleIndex = Order[Position];
+				const FVector& A = MeshData.Vertices[MeshData.Triangles[TriangleIndex * 3]];
+				const FVector& B = MeshData.Vertices[MeshData.Triangles[TriangleIndex * 3 + 1]];
+				const FVector& C = MeshData.Vertices[MeshData.Triangles[TriangleIndex * 3 + 2]];
+
+				// Front faces wind clockwise, so this points out of the front. Its length is twice the area.
+				const FVector Normal = FVector::CrossProduct(C - A, B - A);
+				const float Area = Normal.Size();
+				AreaWeightedNormal += Normal;
+				AreaWeightedCenter += (A + B + C) * (Area / 3.0f);
+				TotalArea += Area;
+			}
+
+			ClusterScores[Cluster] = TotalArea > 0.0f ? FVector::DotProduct(AreaWeightedCenter / TotalArea - MeshCenter, AreaWeightedNormal.GetSafeNormal()) : 0.0f;
+			ClusterOrder[Cluster] = Cluster;
+		}
+
+		ClusterOrder.StableSort([&ClusterScores](int32 A, int32 B) { return ClusterScores[A] > ClusterScores[B]; });
+
+		TArray<int32> SortedOrder;
+		SortedOrder.Reserve(Order.Num());
+		for (int32 Cluster : ClusterOrder)
+		{
+			const int32 ClusterEnd = Cluster + 1 < NumClusters ? ClusterStarts[Cluster + 1] : Order.Num();
+			for (int32 Position = ClusterStarts[Cluster]; Position < ClusterEnd; Position++)
+			{
+				SortedOrder.Add(Order[Position]);
+			}
+		}
+		Order = MoveTemp(SortedOrder);
+	}
+}
+
+float FVertexCacheOptimizer::ComputeACMR(const TArray<int32>& Triangles, int32 NumVertices, int32 CacheSize/* = DefaultCacheSize*/)
+{
+	const int32 NumTriangles = Triangles.Num() / 3;
+	if (NumTriangles == 0)
+	{
+		return 0.0f;
+	}
+
+	// A vertex is in the cache if fewer than CacheSize other vertices have been added since it was
+	TArray<int32> CacheTimes;
+	CacheTimes.Init(-CacheSize - 1, NumVertices);
+	int32 NumMisses = 0;
+	for (int32 VertexIndex : Triangles)
+	{
+		if (NumMisses - CacheTimes[VertexIndex] > CacheSize)
+		{
+			CacheTimes[VertexIndex] = NumMisses++;
+		}
+	}
+
+	return (float)NumMisses / NumTriangles;
+}
+
+FVertexCacheStats FVertexCacheOptimizer::Optimize(FProceduralMeshData& MeshData, int32 CacheSize/* = DefaultCacheSize*/)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	FVertexCacheStats Stats;
+	const int32 NumVertices = MeshData.Vertices.Num();
+	const int32 NumTriangles = MeshData.Triangles.Num() / 3;
+	if (NumTriangles == 0 || MeshData.Triangles.Num() % 3 != 0)
+	{
+		return Stats;
+	}
+
+	for (int32 VertexIndex : MeshData.Triangles)
+	{
+		if (VertexIndex < 0 || VertexIndex >= NumVertices)
+		{
+			return Stats;
+		}
+	}
+
+	Stats.ACMRBefore = Stats.ACMRAfter = ComputeACMR(MeshData.Triangles, NumVertices, CacheSize);
+
+	// -------------------------------------------------------
+	// Work out the new triangle order
+	TArray<int32> Order;
+	TArray<int32> ClusterStarts;
+	VertexCacheOptimizer::FTipsify Tipsify(MeshData.Triangles, NumVertices, CacheSize);
+	Tipsify.Run(Order, ClusterStarts);
+	VertexCacheOptimizer::SortClustersForOverdraw(MeshData, Order, ClusterStarts);
+
+	TArray<int32> NewTriangles;
+	NewTriangles.SetNumUninitialized(MeshData.Triangles.Num());
+	for (int32 Position = 0; Position < NumTriangles; Position++)
+	{
+		for (int32 Corner = 0; Corner < 3; Corner++)
+		{
+			NewTriangles[Position * 3 + Corner] = MeshData.Triangles[Order[Position] * 3 + Corner];
+		}
+	}
+
+	// Some generators already draw in a good order, keep it if we can't beat it
+	const float NewACMR = ComputeACMR(NewTriangles, NumVertices, CacheSize);
+	if (NewACMR < Stats.ACMRBefore)
+	{
+		MeshData.Triangles = MoveTemp(NewTriangles);
+		Stats.ACMRAfter = NewACMR;
+	}
+
+	// -------------------------------------------------------
+	// Number the vertices in the order they are first used, unused ones go at the end
+	TArray<int32> NewIndices;
+	NewIndices.Init(INDEX_NONE, NumVertices);
+	int32 NextIndex = 0;
+	for (int32& VertexIndex : MeshData.Triangles)
+	{
+		if (NewIndices[VertexIndex] == INDEX_NONE)
+		{
+			NewIndices[VertexIndex] = NextIndex++;
+		}
+		VertexIndex = NewIndices[VertexIndex];
+	}
+
+	for (int32& NewIndex : NewIndices)
+	{
+		if (NewIndex == INDEX_NONE)
+		{
+			NewIndex = NextIndex++;
+		}
+	}
+
+	VertexCacheOptimizer::RemapVertexArray(MeshData.Vertices, NewIndices);
+	VertexCacheOptimizer::RemapVertexArray(MeshData.Normals, NewIndices);
+	VertexCacheOptimizer::RemapVertexArray(MeshData.UVs, NewIndices);
+	VertexCacheOptimizer::RemapVertexArray(MeshData.Tangents, NewIndices);
+	VertexCacheOptimizer::RemapVertexArray(MeshData.VertexColors, NewIndices);
+
+	Stats.Seconds = FPlatformTime::Seconds() - StartTime;
+	return Stats;
+}
@@ -0,0 +1,35 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Reorders generated index and vertex buffers for the post-transform vertex cache
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshData.h"
+
+struct PROCEDURALMESHES_API FVertexCacheStats
+{
+	// Average cache miss ratio, vertices transformed per triangle. 0.5 is the best possible, 3 means nothing is reused.
+	float ACMRBefore;
+	float ACMRAfter;
+	double Seconds;
+
+	FVertexCacheStats()
+		: ACMRBefore(0.0f), ACMRAfter(0.0f), Seconds(0.0)
+	{
+	}
+};
+
+struct PROCEDURALMESHES_API FVertexCacheOptimizer
+{
+	// Size of the FIFO cache we optimize for, small enough that it is also a good order for bigger caches
+	static const int32 DefaultCacheSize = 16;
+
+	// Reorders the triangles with Tipsify (Sander et al. 2007) so triangles sharing vertices are drawn close together. The triangles are
+	// drawn in clusters that each start with a cold cache, and the clusters facing outward from the center of the mesh are moved to the front
+	// so they hide more of what is drawn after them. Then the vertices are renumbered in the order they are first used, so they are also
+	// fetched in order. Runs in linear time, the mesh is only changed if the new order has a lower ACMR.
+	static FVertexCacheStats Optimize(FProceduralMeshData& MeshData, int32 CacheSize = DefaultCacheSize);
+
+	// Simulates a FIFO cache of CacheSize vertices and returns the number of misses per triangle
+	static float ComputeACMR(const TArray<int32>& Triangles, int32 NumVertices, int32 CacheSize = DefaultCacheSize);
+};
@@ -0,0 +1,276 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Merges duplicate vertices in generated mesh data
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "VertexWelding.h"
+#include "ScratchArena.h"
+#include "ProceduralMeshThreading.h"
+
+namespace VertexWelding
+{
+	// Enough work per task to be worth handing to another thread
+	const int32 VerticesPerTask = 2048;
+
+	uint32 HashCell(const FIntVector& Cell)
+	{
+		// Generated vertices tend to sit on a regular grid, so mix the bits well or whole rows end up in the same few buckets
+		uint32 Hash = ((uint32)Cell.X * 73856093u) ^ ((uint32)Cell.Y * 19349663u) ^ ((uint32)Cell.Z * 83492791u);
+		Hash ^= Hash >> 16;
+		Hash *= 0x85ebca6bu;
+		Hash ^= Hash >> 13;
+		Hash *= 0xc2b2ae35u;
+		Hash ^= Hash >> 16;
+		return Hash;
+	}
+
+	// Runs Function over [0, Num) in blocks of VerticesPerTask
+	template<typename FunctionType>
+	void ParallelForBlocks(int32 Num, const FunctionType& Function)
+	{
+		const int32 NumTasks = FMath::DivideAndRoundUp(Num, VerticesPerTask);
+		FProceduralMeshThreading::ParallelFor(NumTasks, [&Function, Num](int32 TaskIndex)
+		{
+			const int32 End = FMath::Min((TaskIndex + 1) * VerticesPerTask, Num);
+			for (int32 Index = TaskIndex * VerticesPerTask; Index < End; Index++)
+			{
+				Function(Index);
+			}
+		}, NumTasks < 2);
+	}
+
+	// Moves the vertices we keep to their new index. New indices are never higher than the old ones, so this can be done in place.
+	template<typename ElementType>
+	void CompactVertexArray(TArray<ElementType>& Elements, const TArray<int32, FScratchAllocator>& Representatives, const TArray<int32, FScratchAllocator>& NewIndices, int32 NumNewVertices)
+	{
+		if (Elements.Num() != NewIndices.Num())
+		{
+			return;
+		}
+
+		for (int32 Index = 0; Index < Elements.Num(); Index++)
+		{
+			if (Representatives[Index] == Index)
+			{
+				Elements[NewIndices[Index]] = Elements[Index];
+			}
+		}
+		Elements.SetNum(NumNewVertices, false);
+	}
+
+	class FWelder
+	{
+	public:
+		FWelder(const FProceduralMeshData& InMeshData, const FVertexWeldSettings& InSettings)
+			: MeshData(InMeshData)
+			, Settings(InSettings)
+			, NumVertices(InMeshData.Vertices.Num())
+			, bCompareNormals(InMeshData.Normals.Num() == NumVertices)
+			, bCompareUVs(InMeshData.UVs.Num() == NumVertices)
+			, bCompareTangents(InMeshData.Tangents.Num() == NumVertices)
+			, bCompareColors(InMeshData.VertexColors.Num() == NumVertices)
+		{
+			const float CellSize = FMath::Max(Settings.PositionTolerance * 4.0f, KINDA_SMALL_NUMBER);
+			InverseCellSize = 1.0f / CellSize;
+			PositionToleranceInCells = Settings.PositionTolerance * InverseCellSize;
+			PositionToleranceSquared = FMath::Square(Settings.PositionTolerance);
+		}
+
+		// Fills OutRepresentatives with the lowest index vertex each vertex should be merged into, which is itself if there is none
+		void FindRepresentatives(TArray<int32, FScratchAllocator>& OutRepresentatives)
+		{
+			// -------------------------------------------------------
+			// Work out which cell each vertex is in
+			Cells.SetNumUninitialized(NumVertices);
+			ParallelForBlocks(NumVertices, [this](int32 VertexIndex)
+			{
+				const FVector Scaled = GetPositionInCells(VertexIndex);
+				Cells[VertexIndex] = FIntVector(FMath::FloorToInt(Scaled.X), FMath::FloorToInt(Scaled.Y), FMath::FloorToInt(Scaled.Z));
+			});
+
+			// -------------------------------------------------------
+			// Sort the vertices into hash buckets, packed into one array. Each bucket lists its vertices in increasing order.
+			const int32 NumBuckets = FMath::RoundUpToPowerOfTwo(NumVertices * 2);
+			BucketMask = NumBuckets - 1;
+			BucketStarts.SetNumZeroed(NumBuckets + 1);
+			for (const FIntVector& Cell : Cells)
+			{
+				BucketStarts[(HashCell(Cell) & BucketMask) + 1]++;
+			}
+			for (int32 Bucket = 0; Bucket < NumBuckets; Bucket++)
+			{
+				BucketStarts[Bucket + 1] += BucketStarts[Bucket];
+			}
+
+			TArray<int32, FScratchAllocator> FillPositions(BucketStarts);
+			BucketVertices.SetNumUninitialized(NumVertices);
+			for (int32 VertexIndex = 0; VertexIndex < NumVertices; VertexIndex++)
+			{
+				BucketVertices[FillPositions[HashCell(Cells[VertexIndex]) & BucketMask]++] = VertexIndex;
+			}
+
+			// -------------------------------------------------------
+			// Every vertex looks for its match on its own, the hash is only read from here on
+			OutRepresentatives.SetNumUninitialized(NumVertices);
+			ParallelForBlocks(NumVertices, [this, &OutRepresentatives](int32 VertexIndex)
+			{
+				OutRepresentatives[VertexIndex] = FindFirstMatch(VertexIndex);
+			});
+
+			// A vertex can match one that was itself merged into an earlier vertex, follow those through so every vertex points at one we keep.
+			// Representatives always have a lower index, so they are already resolved when we get to them.
+			for (int32 VertexIndex = 0; VertexIndex < NumVertices; VertexIndex++)
+			{
+				OutRepresentatives[VertexIndex] = OutRepresentatives[OutRepresentatives[VertexIndex]];
+			}
+		}
+
+	private:
+		// Generated vertices are often on round numbers, offset the cells by half so those end up in the middle of a cell and
+		// we don't have to look in the neighbouring cells for them
+		FVector GetPositionInCells(int32 VertexIndex) const
+		{
+			return MeshData.Vertices[VertexIndex] * InverseCellSize + FVector(0.5f, 0.5f, 0.5f);
+		}
+
+		int32 FindFirstMatch(int32 VertexIndex) const
+		{
+			// -------------------------------------------------------
+			// Cells are four times the tolerance wide, so a match can only be in the current cell or in the neighbouring ones on the sides the vertex is close to
+			const FVector Scaled = GetPositionInCells(VertexIndex);
+			const FIntVector& Cell = Cells[VertexIndex];
+			int32 Steps[3] = { 0, 0, 0 };
+			const float Offsets[3] = { Scaled.X - Cell.X, Scaled.Y - Cell.Y, Scaled.Z - Cell.Z };
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				if (Offsets[Axis] <= PositionToleranceInCells)
+				{
+					Steps[Axis] = -1;
+				}
+				else if (Offsets[Axis] >= 1.0f - PositionToleranceInCells)
+				{
+					Steps[Axis] = 1;
+				}
+			}
+
+			int32 Best = VertexIndex;
+			for (int32 StepX = 0; StepX <= FMath::Abs(Steps[0]); StepX++)
+			{
+				for (int32 StepY = 0; StepY <= FMath::Abs(Steps[1]); StepY++)
+				{
+					for (int32 StepZ = 0; StepZ <= FMath::Abs(Steps[2]); StepZ++)
+					{
+						const FIntVector NeighbourCell(Cell.X + StepX * Steps[0], Cell.Y + StepY * Steps[1], Cell.Z + StepZ * Steps[2]);
+						const uint32 Bucket = HashCell(NeighbourCell) & BucketMask;
+
+						// Other cells can share the bucket, but the full comparison sorts those out
+						for (int32 Position = BucketStarts[Bucket]; Position < BucketStarts[Bucket + 1]; Position++)
+						{
+							const int32 OtherIndex = BucketVertices[Position];
+							if (OtherIndex >= Best)
+							{
+								break;
+							}
+							if (Matches(VertexIndex, OtherIndex))
+							{
+								Best = OtherIndex;
+								break;
+							}
+						}
+					}
+				}
+			}
+
+			return Best;
+		}
+
+		bool Matches(int32 A, int32 B) const
+		{
+			if (FVector::DistSquared(MeshData.Vertices[A], MeshData.Vertices[B]) > PositionToleranceSquared)
+			{
+				return false;
+			}
+			if (bCompareNormals && !MeshData.Normals[A].Equals(MeshData.Normals[B], Settings.NormalTolerance))
+			{
+				return false;
+			}
+			if (bCompareUVs && !MeshData.UVs[A].Equals(MeshData.UVs[B], Settings.UVTolerance))
+			{
+				return false;
+			}
+			if (bCompareTangents && (MeshData.Tangents[A].bFlipTangentY != MeshData.Tangents[B].bFlipTangentY
+				|| !MeshData.Tangents[A].TangentX.Equals(MeshData.Tangents[B].TangentX, Settings.NormalTolerance)))
+			{
+				return false;
+			}
+			if (bCompareColors && MeshData.VertexColors[A] != MeshData.VertexColors[B])
+			{
+				return false;
+			}
+			return true;
+		}
+
+		const FProceduralMeshData& MeshData;
+		const FVertexWeldSettings& Settings;
+		const int32 NumVertices;
+		const bool bCompareNormals;
+		const bool bCompareUVs;
+		const bool bCompareTangents;
+		const bool bCompareColors;
+
+		float InverseCellSize;
+		float PositionToleranceInCells;
+		float PositionToleranceSquared;
+
+		// Only needed while welding, so they go in the scratch arena when the caller has a scope open
+		TArray<FIntVector, FScratchAllocator> Cells;
+		TArray<int32, FScratchAllocator> BucketStarts;
+		TArray<int32, FScratchAllocator> BucketVertices;
+		uint32 BucketMask;
+	};
+}
+
+FVertexWeldStats FVertexWelder::Weld(FProceduralMeshData& MeshData, const FVertexWeldSettings& Settings/* = FVertexWeldSettings()*/)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	FVertexWeldStats Stats;
+	const int32 NumVertices = MeshData.Vertices.Num();
+	Stats.InputVertexCount = Stats.OutputVertexCount = NumVertices;
+	if (NumVertices < 2)
+	{
+		return Stats;
+	}
+
+	TArray<int32, FScratchAllocator> Representatives;
+	VertexWelding::FWelder Welder(MeshData, Settings);
+	Welder.FindRepresentatives(Representatives);
+
+	// -------------------------------------------------------
+	// Number the vertices we keep in their original order
+	TArray<int32, FScratchAllocator> NewIndices;
+	NewIndices.SetNumUninitialized(NumVertices);
+	int32 NumNewVertices = 0;
+	for (int32 VertexIndex = 0; VertexIndex < NumVertices; VertexIndex++)
+	{
+		const int32 Representative = Representatives[VertexIndex];
+		NewIndices[VertexIndex] = Representative == VertexIndex ? NumNewVertices++ : NewIndices[Representative];
+	}
+
+	if (NumNewVertices < NumVertices)
+	{
+		VertexWelding::ParallelForBlocks(MeshData.Triangles.Num(), [&MeshData, &NewIndices](int32 Index)
+		{
+			MeshData.Triangles[Index] = NewIndices[MeshData.Triangles[Index]];
+		});
+
+		VertexWelding::CompactVertexArray(MeshData.Vertices, Representatives, NewIndices, NumNewVertices);
+		VertexWelding::CompactVertexArray(MeshData.Normals, Representatives, NewIndices, NumNewVertices);
+		VertexWelding::CompactVertexArray(MeshData.UVs, Representatives, NewIndices, NumNewVertices);
+		VertexWelding::CompactVertexArray(MeshData.Tangents, Representatives, NewIndices, NumNewVertices);
+		VertexWelding::CompactVertexArray(MeshData.VertexColors, Representatives, NewIndices, NumNewVertices);
+	}
+
+	Stats.OutputVertexCount = NumNewVertices;
+	Stats.Seconds = FPlatformTime::Seconds() - StartTime;
+	return Stats;
+}
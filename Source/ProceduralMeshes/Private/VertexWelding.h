@@ -0,0 +1,45 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Merges duplicate vertices in generated mesh data
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshData.h"
+
+struct PROCEDURALMESHES_API FVertexWeldSettings
+{
+	// Largest distance between two vertices that are merged
+	float PositionTolerance;
+
+	// Largest difference in each component of the normals and tangents
+	float NormalTolerance;
+
+	// Largest difference in each component of the UVs
+	float UVTolerance;
+
+	FVertexWeldSettings()
+		: PositionTolerance(0.01f), NormalTolerance(0.001f), UVTolerance(0.0001f)
+	{
+	}
+};
+
+struct PROCEDURALMESHES_API FVertexWeldStats
+{
+	int32 InputVertexCount;
+	int32 OutputVertexCount;
+	double Seconds;
+
+	FVertexWeldStats()
+		: InputVertexCount(0), OutputVertexCount(0), Seconds(0.0)
+	{
+	}
+};
+
+struct PROCEDURALMESHES_API FVertexWelder
+{
+	// Merges vertices whose position, normal, tangent and UV are all within the tolerances and whose colors are the same, then remaps the
+	// triangles to the vertices that are left. Each vertex is merged into the first vertex it matches, so the order of the remaining vertices
+	// and their attributes are unchanged. Vertices are found through a spatial hash with cells four times the position tolerance, which makes
+	// this linear in the number of vertices, and the lookups are done in parallel.
+	static FVertexWeldStats Weld(FProceduralMeshData& MeshData, const FVertexWeldSettings& Settings = FVertexWeldSettings());
+};
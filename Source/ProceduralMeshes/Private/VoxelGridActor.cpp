@@ -0,0 +1,368 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Example voxel volume built from greedy meshed cube faces
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "VoxelGridActor.h"
+#include "SimpleCubeActor.h"
+#include "ProceduralMeshThreading.h"
+#include "ProceduralMeshStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Voxel grid"), STAT_GenerateVoxelGrid, STATGROUP_ProceduralMeshes);
+
+namespace
+{
+	// A rectangle of merged voxel faces, with its corners in the same order BuildQuad wants them
+	struct FVoxelQuad
+	{
+		FVector BottomLeft;
+		FVector BottomRight;
+		FVector TopRight;
+		FVector TopLeft;
+		FVector Normal;
+		FVector Tangent;
+		FVector2D UVScale;
+	};
+}
+
+AVoxelGridActor::AVoxelGridActor()
+{
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootScene"));
+	ProcMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("ProceduralMesh"));
+	ProcMesh->AttachTo(RootComponent);
+	// Make sure the PMC doesnt save any mesh data with the map
+	ProcMesh->SetFlags(EObjectFlags::RF_Transient);
+}
+
+#if WITH_EDITOR
+void AVoxelGridActor::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+	GenerateMesh();
+}
+#endif // WITH_EDITOR
+
+void AVoxelGridActor::BeginPlay()
+{
+	Super::BeginPlay();
+	GenerateMesh();
+
+	// Fix for PCM location/rotation/scale since the whole component is Transient
+	ProcMesh->SetWorldLocation(this->GetActorLocation());
+	ProcMesh->SetWorldRotation(this->GetActorRotation());
+	ProcMesh->SetWorldScale3D(this->GetActorScale3D());
+}
+
+bool AVoxelGridActor::GetVoxel(int32 X, int32 Y, int32 Z) const
+{
+	return Voxels.Num() == SizeX * SizeY * SizeZ && IsFilled(X, Y, Z);
+}
+
+void AVoxelGridActor::SetVoxel(int32 X, int32 Y, int32 Z, bool bFilled)
+{
+	if (Voxels.Num() != SizeX * SizeY * SizeZ || X < 0 || Y < 0 || Z < 0 || X >= SizeX || Y >= SizeY || Z >= SizeZ)
+	{
+		return;
+	}
+
+	uint8& Voxel = Voxels[GetVoxelIndex(X, Y, Z)];
+	if ((Voxel != 0) == bFilled)
+	{
+		return;
+	}
+	Voxel = bFilled ? 1 : 0;
+
+	// The faces of a voxel on the edge of a chunk belong to the neighbouring chunk as well
+	MarkChunkDirty(X, Y, Z);
+	MarkChunkDirty(X - 1, Y, Z);
+	MarkChunkDirty(X + 1, Y, Z);
+	MarkChunkDirty(X, Y - 1, Z);
+	MarkChunkDirty(X, Y + 1, Z);
+	MarkChunkDirty(X, Y, Z - 1);
+	MarkChunkDirty(X, Y, Z + 1);
+	RebuildDirtyChunks();
+}
+
+void AVoxelGridActor::GenerateMesh()
+{
+	FProceduralMeshGenerationScope GenerationScope(this, GET_STATID(STAT_GenerateVoxelGrid));
+
+	// -------------------------------------------------------
+	// Setup the random number generator and fill the voxels
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshStructure);
+		RngStream = FRandomStream::FRandomStream(RandomSeed);
+		FillVoxels();
+	}
+
+	// -------------------------------------------------------
+	// Every chunk needs to be built the first time
+	ChunkLayoutSize = FMath::Max(1, ChunkSize);
+	NumChunksX = FMath::DivideAndRoundUp(SizeX, ChunkLayoutSize);
+	NumChunksY = FMath::DivideAndRoundUp(SizeY, ChunkLayoutSize);
+	NumChunksZ = FMath::DivideAndRoundUp(SizeZ, ChunkLayoutSize);
+	int32 NumChunks = NumChunksX * NumChunksY * NumChunksZ;
+
+	DirtyChunks.Init(true, NumChunks);
+	ChunkVisibleQuadCounts.Init(0, NumChunks);
+	ChunkGeneratedQuadCounts.Init(0, NumChunks);
+
+	ProcMesh->ClearAllMeshSections();
+	RebuildDirtyChunks();
+
+	UE_LOG(LogProceduralMeshes, Log, TEXT("%s: %d quads (%d vertices), %d visible faces, %d for a cube per voxel (%d vertices)"),
+		*GetName(), GeneratedQuadCount, GeneratedQuadCount * 4, VisibleQuadCount, NaiveQuadCount, NaiveQuadCount * 4);
+}
+
+void AVoxelGridActor::FillVoxels()
+{
+	float FillChance = FMath::Clamp(FillPercentage, 0.0f, 100.0f) / 100.0f;
+
+	Voxels.Empty(SizeX * SizeY * SizeZ);
+	Voxels.AddUninitialized(SizeX * SizeY * SizeZ);
+	for (int32 VoxelIndex = 0; VoxelIndex < Voxels.Num(); VoxelIndex++)
+	{
+		Voxels[VoxelIndex] = RngStream.FRand() < FillChance ? 1 : 0;
+	}
+}
+
+void AVoxelGridActor::MarkChunkDirty(int32 X, int32 Y, int32 Z)
+{
+	if (X < 0 || Y < 0 || Z < 0 || X >= SizeX || Y >= SizeY || Z >= SizeZ)
+	{
+		return;
+	}
+
+	int32 ChunkX = X / ChunkLayoutSize;
+	int32 ChunkY = Y / ChunkLayoutSize;
+	int32 ChunkZ = Z / ChunkLayoutSize;
+	DirtyChunks[ChunkX + NumChunksX * (ChunkY + NumChunksY * ChunkZ)] = true;
+}
+
+void AVoxelGridActor::RebuildDirtyChunks()
+{
+	TArray<int32> ChunksToBuild;
+	for (int32 ChunkIndex = 0; ChunkIndex < DirtyChunks.Num(); ChunkIndex++)
+	{
+		if (DirtyChunks[ChunkIndex])
+		{
+			ChunksToBuild.Add(ChunkIndex);
+		}
+	}
+
+	// -------------------------------------------------------
+	// Chunks only read the voxels and write their own mesh data, so they can all be meshed at the same time
+	TArray<FProceduralMeshData> ChunkMeshData;
+	ChunkMeshData.AddDefaulted(ChunksToBuild.Num());
+
+	FProceduralMeshThreading::ParallelFor(ChunksToBuild.Num(), [this, &ChunksToBuild, &ChunkMeshData](int32 BuildIndex)
+	{
+		// Chunks meshed on the other threads wouldn't count towards the voxel grid otherwise
+		SCOPE_CYCLE_COUNTER(STAT_GenerateVoxelGrid);
+		SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshVertexFill);
+		int32 ChunkIndex = ChunksToBuild[BuildIndex];
+		GenerateChunk(ChunkIndex, ChunkMeshData[BuildIndex], ChunkVisibleQuadCounts[ChunkIndex]);
+		ChunkGeneratedQuadCounts[ChunkIndex] = ChunkMeshData[BuildIndex].Vertices.Num() / 4;
+	});
+
+	// The component can only be updated from the game thread
+	SCOPE_CYCLE_COUNTER(STAT_ProceduralMeshUpload);
+	for (int32 BuildIndex = 0; BuildIndex < ChunksToBuild.Num(); BuildIndex++)
+	{
+		int32 ChunkIndex = ChunksToBuild[BuildIndex];
+		const FProceduralMeshData& MeshData = ChunkMeshData[BuildIndex];
+		if (MeshData.Vertices.Num() == 0)
+		{
+			ProcMesh->ClearMeshSection(ChunkIndex);
+		}
+		else
+		{
+			FProceduralMeshStats::CountUpload(MeshData);
+			ProcMesh->CreateMeshSection(ChunkIndex, MeshData.Vertices, MeshData.Triangles, MeshData.Normals, MeshData.UVs, MeshData.VertexColors, MeshData.Tangents, false);
+			ProcMesh->SetMaterial(ChunkIndex, Material);
+		}
+		DirtyChunks[ChunkIndex] = false;
+	}
+
+	UpdateStatistics();
+}
+
+void AVoxelGridActor::GenerateChunk(int32 ChunkIndex, FProceduralMeshData& MeshData, int32& OutVisibleQuadCount) const
+{
+	// -------------------------------------------------------
+	// Find the voxels this chunk covers, the last chunk on each axis may be smaller than the rest
+	int32 ChunkCoords[3] = { ChunkIndex % NumChunksX, (ChunkIndex / NumChunksX) % NumChunksY, ChunkIndex / (NumChunksX * NumChunksY) };
+	int32 GridSize[3] = { SizeX, SizeY, SizeZ };
+	int32 ChunkMin[3];
+	int32 ChunkMax[3];
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		ChunkMin[Axis] = ChunkCoords[Axis] * ChunkLayoutSize;
+		ChunkMax[Axis] = FMath::Min(ChunkMin[Axis] + ChunkLayoutSize, GridSize[Axis]);
+	}
+
+	// Center the whole grid on the actor, the same way the cube is
+	FVector GridOrigin = FVector(SizeX, SizeY, SizeZ) * VoxelSize * -0.5f;
+
+	TArray<FVoxelQuad> Quads;
+	TArray<uint8> FaceMask;
+	OutVisibleQuadCount = 0;
+
+	// -------------------------------------------------------
+	// Sweep a plane through the chunk along each axis, in both directions.
+	// For each slice we mark the voxel faces that have an empty voxel in front of them, and then merge those into as few rectangles as we can.
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		// U and V are the other two axes, in the order that makes U x V point along Axis
+		int32 AxisU = (Axis + 1) % 3;
+		int32 AxisV = (Axis + 2) % 3;
+		int32 SizeU = ChunkMax[AxisU] - ChunkMin[AxisU];
+		int32 SizeV = ChunkMax[AxisV] - ChunkMin[AxisV];
+		FaceMask.SetNumUninitialized(SizeU * SizeV);
+
+		FVector UnitU = FVector::ZeroVector;
+		FVector UnitV = FVector::ZeroVector;
+		UnitU[AxisU] = 1.0f;
+		UnitV[AxisV] = 1.0f;
+
+		for (int32 Direction = -1; Direction <= 1; Direction += 2)
+		{
+			FVector Normal = FVector::ZeroVector;
+			Normal[Axis] = (float)Direction;
+
+			for (int32 Slice = ChunkMin[Axis]; Slice < ChunkMax[Axis]; Slice++)
+			{
+				// -------------------------------------------------------
+				// Find the visible faces in this slice
+				int32 NumFaces = 0;
+				int32 Voxel[3];
+				int32 Neighbour[3];
+				Voxel[Axis] = Slice;
+				Neighbour[Axis] = Slice + Direction;
+
+				for (int32 V = 0; V < SizeV; V++)
+				{
+					Voxel[AxisV] = Neighbour[AxisV] = ChunkMin[AxisV] + V;
+					for (int32 U = 0; U < SizeU; U++)
+					{
+						Voxel[AxisU] = Neighbour[AxisU] = ChunkMin[AxisU] + U;
+						bool bVisibleFace = IsFilled(Voxel[0], Voxel[1], Voxel[2]) && !IsFilled(Neighbour[0], Neighbour[1], Neighbour[2]);
+						FaceMask[U + V * SizeU] = bVisibleFace ? 1 : 0;
+						NumFaces += bVisibleFace ? 1 : 0;
+					}
+				}
+
+				OutVisibleQuadCount += NumFaces;
+				if (NumFaces == 0)
+				{
+					continue;
+				}
+
+				// -------------------------------------------------------
+				// Grow each remaining face as far as we can along U, then along V while the whole row matches
+				for (int32 V = 0; V < SizeV; V++)
+				{
+					for (int32 U = 0; U < SizeU; U++)
+					{
+						if (!FaceMask[U + V * SizeU])
+						{
+							continue;
+						}
+
+						int32 QuadWidth = 1;
+						while (U + QuadWidth < SizeU && FaceMask[U + QuadWidth + V * SizeU])
+						{
+							QuadWidth++;
+						}
+
+						int32 QuadHeight = 1;
+						bool bRowMatches = true;
+						while (V + QuadHeight < SizeV && bRowMatches)
+						{
+							for (int32 RowU = U; RowU < U + QuadWidth; RowU++)
+							{
+								if (!FaceMask[RowU + (V + QuadHeight) * SizeU])
+								{
+									bRowMatches = false;
+									break;
+								}
+							}
+							if (bRowMatches)
+							{
+								QuadHeight++;
+							}
+						}
+
+						// These faces are now covered
+						for (int32 RowV = V; RowV < V + QuadHeight; RowV++)
+						{
+							FMemory::Memzero(&FaceMask[U + RowV * SizeU], QuadWidth);
+						}
+
+						// The face sits on the far side of the voxel when it points along the axis
+						FVector Corner = FVector::ZeroVector;
+						Corner[Axis] = (float)(Slice + (Direction > 0 ? 1 : 0));
+						Corner[AxisU] = (float)(ChunkMin[AxisU] + U);
+						Corner[AxisV] = (float)(ChunkMin[AxisV] + V);
+
+						FVector EdgeU = UnitU * (float)QuadWidth;
+						FVector EdgeV = UnitV * (float)QuadHeight;
+
+						// Pick the edge order so the quad faces along the normal
+						FVoxelQuad& Quad = Quads[Quads.AddUninitialized()];
+						Quad.Normal = Normal;
+						Quad.BottomLeft = GridOrigin + Corner * VoxelSize;
+						Quad.TopRight = GridOrigin + (Corner + EdgeU + EdgeV) * VoxelSize;
+						if (Direction > 0)
+						{
+							Quad.BottomRight = GridOrigin + (Corner + EdgeV) * VoxelSize;
+							Quad.TopLeft = GridOrigin + (Corner + EdgeU) * VoxelSize;
+							Quad.Tangent = UnitV;
+							Quad.UVScale = FVector2D(QuadHeight, QuadWidth);
+						}
+						else
+						{
+							Quad.BottomRight = GridOrigin + (Corner + EdgeU) * VoxelSize;
+							Quad.TopLeft = GridOrigin + (Corner + EdgeV) * VoxelSize;
+							Quad.Tangent = UnitU;
+							Quad.UVScale = FVector2D(QuadWidth, QuadHeight);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// -------------------------------------------------------
+	// Now that we know how many quads there are we can pre-allocate the buffers and fill them
+	int32 VertexCount = Quads.Num() * 4;
+	MeshData.Reset();
+	MeshData.Vertices.AddUninitialized(VertexCount);
+	MeshData.UVs.AddUninitialized(VertexCount);
+	MeshData.Normals.AddUninitialized(VertexCount);
+	MeshData.Tangents.AddUninitialized(VertexCount);
+	MeshData.Triangles.Reserve(Quads.Num() * 6);
+
+	int32 VertexOffset = 0;
+	for (const FVoxelQuad& Quad : Quads)
+	{
+		VertexOffset = ASimpleCubeActor::BuildQuad(MeshData, Quad.BottomLeft, Quad.BottomRight, Quad.TopRight, Quad.TopLeft, VertexOffset, Quad.Normal, FProcMeshTangent(Quad.Tangent, false), Quad.UVScale);
+	}
+}
+
+void AVoxelGridActor::UpdateStatistics()
+{
+	int32 FilledVoxelCount = 0;
+	for (uint8 Voxel : Voxels)
+	{
+		FilledVoxelCount += Voxel;
+	}
+
+	NaiveQuadCount = FilledVoxelCount * 6;
+	VisibleQuadCount = 0;
+	GeneratedQuadCount = 0;
+	for (int32 ChunkIndex = 0; ChunkIndex < ChunkGeneratedQuadCounts.Num(); ChunkIndex++)
+	{
+		VisibleQuadCount += ChunkVisibleQuadCounts[ChunkIndex];
+		GeneratedQuadCount += ChunkGeneratedQuadCounts[ChunkIndex];
+	}
+}
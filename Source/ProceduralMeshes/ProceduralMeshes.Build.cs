@@ -19,6 +19,7 @@ public class ProceduralMeshes : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"Projects",
 // 				"Slate",
 // 				"SlateCore",
 				// ... add private dependencies that you statically link with here ...	
@@ -4,27 +4,31 @@
 #pragma once
 
 #include "ProceduralMeshesPrivatePCH.h"
-#include "GameFramework/Actor.h"
-#include "ProceduralMeshComponent.h"
+#include "ProceduralMeshPipelineActor.h"
 #include "ProceduralMeshData.h"
+#include "ProceduralMeshLOD.h"
+#include "ProceduralMeshStats.h"
+#include "TubeSegmentCache.h"
+#include "LineSegmentStreams.h"
 #include "BranchingLinesActor.generated.h"
 
-// A simple struct to keep some data together
+// A simple struct to keep some data together. Generation keeps the segments in FLineSegmentStreams, this is only the view of them that
+// shows up in the details panel.
 USTRUCT()
 struct FBranchSegment
 {
 	GENERATED_BODY()
 
-	UPROPERTY()
+	UPROPERTY(VisibleAnywhere)
 	FVector Start;
 
-	UPROPERTY()
+	UPROPERTY(VisibleAnywhere)
 	FVector End;
 
-	UPROPERTY()
+	UPROPERTY(VisibleAnywhere)
 	float Width;
 
-	UPROPERTY()
+	UPROPERTY(VisibleAnywhere)
 	int8 ForkGeneration;
 
 	FBranchSegment()
@@ -61,7 +65,7 @@ struct FBranchSegment
 };
 
 UCLASS()
-class PROCEDURALMESHES_API ABranchingLinesActor : public AActor
+class PROCEDURALMESHES_API ABranchingLinesActor : public AProceduralMeshPipelineActor
 {
 	GENERATED_BODY()
 
@@ -77,7 +81,7 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
 	uint8 Iterations = 5;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "3"))
 	int32 RadialSegmentCount = 10;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
@@ -120,36 +124,74 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
 	UMaterialInterface* Material;
 
-	virtual void BeginPlay() override;
+	// Simple builds a capsule around every segment in the background, Complex cooks the whole LOD0 mesh
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Collision")
+	EProceduralCollisionMode CollisionMode = EProceduralCollisionMode::None;
+
+	// Each LOD halves RadialSegmentCount and drops the thinnest fork generation. Lower LODs are generated the first time they are needed.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|LOD", meta = (ClampMin = "1", ClampMax = "4"))
+	int32 NumLODs = 1;
+
+	// Screen size below which LOD1, LOD2 etc. are used
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|LOD")
+	TArray<float> LODScreenSizes;
+
+	// Merge the vertices that neighbouring quads write on top of each other before uploading, they only differ when bSmoothNormals is off
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Optimization")
+	bool bWeldVertices = false;
 
-#if WITH_EDITOR
-	virtual void OnConstruction(const FTransform& Transform) override;
-#endif   // WITH_EDITOR
+	// While a slider is dragged in the editor the mesh is built at this LOD, and at full resolution once it is let go. 0 keeps full resolution.
+	UPROPERTY(EditAnywhere, Category = "Procedural Parameters|Editor", meta = (ClampMin = "0", ClampMax = "3"))
+	int32 EditorPreviewLOD = 2;
+
+	// The segments are kept in packed streams the editor can't show, this copies them into DebugSegments after every generation
+	UPROPERTY(EditAnywhere, Category = "Procedural Parameters|Editor")
+	bool bShowSegmentsInDetails = false;
+
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Procedural Parameters|Editor")
+	TArray<FBranchSegment> DebugSegments;
 
 protected:
-	UPROPERTY(Transient, DuplicateTransient)
-	UProceduralMeshComponent* ProcMesh;
+	virtual void SetupStages() override;
+	virtual int32 GetEditorPreviewLOD() const override { return EditorPreviewLOD; }
+	virtual void UpdateLOD() override;
 
 private:
-	void GenerateMesh();
+	friend class FProceduralMeshBenchmarks;
+
+	void GenerateCollision();
+	void GenerateLOD(int32 LODIndex);
+	void GetLODSegments(int32 LODIndex, FScratchLineSegmentStreams& OutSegments) const;
+	void UploadLOD(int32 LODIndex, const FProceduralMeshData& MeshData);
 	void CreateSegments();
 
-	UPROPERTY(Transient)
-	TArray<FBranchSegment> Segments;
+	// Start, end, width and fork generation of every segment, one stream each
+	FLineSegmentStreams Segments;
 
 	void AddSection(FVector InBottomLeftPoint, FVector InTopPoint, FVector InBottomRightPoint, FVector InBottomMiddlePoint, int32 InDepth);
-	void GenerateCylinder(FProceduralMeshData& MeshData, FVector StartPoint, FVector EndPoint, float InWidth, int32 InCrossSectionCount, int32 InVertexIndexStart, bool bInSmoothNormals = true);
-
-	FVector RotatePointAroundPivot(FVector InPoint, FVector InPivot, FVector InAngles);
-	void PreCacheCrossSection();
-
-	int32 LastCachedCrossSectionCount;
-	UPROPERTY(Transient)
-	TArray<FVector> CachedCrossSectionPoints;
 
 	UPROPERTY(Transient)
 	TArray<FVector> OffsetDirections;
 
 	UPROPERTY(Transient)
 	FRandomStream RngStream = FRandomStream::FRandomStream();
+
+	// The stages that may run on worker threads use this, and the upload copies it to RngStream on the game thread
+	FRandomStream GenerationRngStream;
+
+	FProceduralMeshLODChain LODChain;
+
+	// Segments -> geometry -> optimization -> upload -> material, with collision built from the segments alongside the geometry
+	int32 SegmentsStage;
+	int32 GeometryStage;
+	int32 OptimizationStage;
+	int32 UploadStage;
+	int32 MaterialStage;
+	int32 CollisionStage;
+
+	// Kept between runs so the upload and material stages can run again without generating the mesh again, and so the geometry stage
+	// can copy the segments that didn't change
+	FTubeSegmentCache LOD0Tubes;
+	FProceduralMeshData LOD0WeldedMeshData;
+	FProceduralMeshMemoryStat MeshDataMemory;
 };
@@ -4,13 +4,16 @@
 #pragma once
 
 #include "ProceduralMeshesPrivatePCH.h"
-#include "GameFramework/Actor.h"
-#include "ProceduralMeshComponent.h"
+#include "ProceduralMeshPipelineActor.h"
 #include "ProceduralMeshData.h"
+#include "ProceduralMeshLOD.h"
+#include "CrossSectionCache.h"
+#include "ProceduralMeshStats.h"
+#include "TubeSegmentCache.h"
 #include "CylinderStripActor.generated.h"
 
 UCLASS()
-class PROCEDURALMESHES_API ACylinderStripActor : public AActor
+class PROCEDURALMESHES_API ACylinderStripActor : public AProceduralMeshPipelineActor
 {
 	GENERATED_BODY()
 
@@ -23,34 +26,93 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
 	float Radius = 10;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "3"))
 	int32 RadialSegmentCount = 10;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
 	bool bSmoothNormals = true;
 
+	// Build one continuous tube with a single ring of vertices per point, instead of a separate cylinder between each pair of points
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
+	bool bContinuousTube = false;
+
+	// Pass a smooth centripetal Catmull-Rom spline through LinePoints instead of connecting them with straight lines
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Spline")
+	bool bSplineInterpolation = false;
+
+	// How far the tube center line may stray from the true curve. Tight bends get more rings than straight stretches.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Spline", meta = (ClampMin = "0.01", UIMin = "0.01"))
+	float SplineChordTolerance = 1.0f;
+
+	// Upper limit on the number of triangles in LOD0 when interpolating a spline, 0 means no limit.
+	// Every span between two line points keeps at least one segment, so the limit can't go below that and is exceeded with a warning.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Spline", meta = (ClampMin = "0", UIMin = "0"))
+	int32 MaxTriangleCount = 0;
+
+	// Number of triangles in the last generated LOD0
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Procedural Parameters|Spline")
+	int32 GeneratedTriangleCount = 0;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
 	UMaterialInterface* Material;
 
-	virtual void BeginPlay() override;
+	// Simple builds a capsule around every segment of the tube in the background, Complex cooks the whole LOD0 mesh
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Collision")
+	EProceduralCollisionMode CollisionMode = EProceduralCollisionMode::None;
 
-#if WITH_EDITOR
-	virtual void OnConstruction(const FTransform& Transform) override;
-#endif   // WITH_EDITOR
+	// Each LOD halves RadialSegmentCount. Lower LODs are generated the first time they are needed.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|LOD", meta = (ClampMin = "1", ClampMax = "4"))
+	int32 NumLODs = 1;
+
+	// Screen size below which LOD1, LOD2 etc. are used
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|LOD")
+	TArray<float> LODScreenSizes;
+
+	// Merge the vertices that neighbouring quads write on top of each other before uploading, they only differ when bSmoothNormals is off.
+	// The continuous tube already shares its vertices and isn't affected.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Optimization")
+	bool bWeldVertices = false;
+
+	// While a slider is dragged in the editor the mesh is built at this LOD, and at full resolution once it is let go. 0 keeps full resolution.
+	UPROPERTY(EditAnywhere, Category = "Procedural Parameters|Editor", meta = (ClampMin = "0", ClampMax = "3"))
+	int32 EditorPreviewLOD = 2;
 
 protected:
-	UPROPERTY(Transient, DuplicateTransient)
-	UProceduralMeshComponent* ProcMesh;
+	virtual void SetupStages() override;
+	virtual bool CanRunPipeline() const override;
+	virtual int32 GetEditorPreviewLOD() const override { return EditorPreviewLOD; }
+	virtual void UpdateLOD() override;
 
 private:
-	void GenerateMesh();
+	void GenerateCollision();
+	void GenerateLOD(int32 LODIndex);
+	void UploadLOD(int32 LODIndex, const FProceduralMeshData& MeshData);
+	const FProceduralMeshData& GetLOD0MeshData() const;
+	void GetTubeSegments(FScratchLineSegmentStreams& OutSegments) const;
 	
-	void GenerateCylinder(FProceduralMeshData& MeshData, FVector StartPoint, FVector EndPoint, float InWidth, int32 InCrossSectionCount, int32 InVertexIndexStart, bool bInSmoothNormals = true);
+	void GenerateContinuousTube(FProceduralMeshData& MeshData, const FCrossSectionRing& CrossSection, const TArray<FVector>& InPoints, float InWidth, bool bInSmoothNormals = true);
+
+	void ResampleSpline(TArray<FVector>& OutPoints, const TArray<FVector>& InControlPoints, float InChordTolerance, int32 InMaxSegments);
+	static FVector EvaluateCentripetalCatmullRom(const FVector& P0, const FVector& P1, const FVector& P2, const FVector& P3, float T);
+
+	// The points the tube is actually built along, either LinePoints or the resampled spline. Written by the points stage on a worker
+	// thread, so it isn't a UPROPERTY.
+	TArray<FVector> TubePoints;
+
+	FProceduralMeshLODChain LODChain;
 
-	FVector RotatePointAroundPivot(FVector InPoint, FVector InPivot, FVector InAngles);
-	void PreCacheCrossSection();
+	// Points -> geometry -> optimization -> upload -> material, with collision built from the points alongside the geometry
+	int32 PointsStage;
+	int32 GeometryStage;
+	int32 OptimizationStage;
+	int32 UploadStage;
+	int32 MaterialStage;
+	int32 CollisionStage;
 
-	int32 LastCachedCrossSectionCount;
-	UPROPERTY(Transient)
-	TArray<FVector> CachedCrossSectionPoints;
+	// Kept between runs so the later stages can run again on their own. Only one of the continuous tube or the separate cylinders is
+	// built, depending on bContinuousTube.
+	FTubeSegmentCache LOD0Tubes;
+	FProceduralMeshData LOD0ContinuousMeshData;
+	FProceduralMeshData LOD0WeldedMeshData;
+	FProceduralMeshMemoryStat MeshDataMemory;
 };
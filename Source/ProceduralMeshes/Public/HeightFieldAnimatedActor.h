@@ -4,13 +4,15 @@
 #pragma once
 
 #include "ProceduralMeshesPrivatePCH.h"
-#include "GameFramework/Actor.h"
+#include "ProceduralMeshActor.h"
 #include "ProceduralMeshComponent.h"
 #include "ProceduralMeshData.h"
+#include "MeshBVH.h"
+#include "ScratchArena.h"
 #include "HeightFieldAnimatedActor.generated.h"
 
 UCLASS()
-class PROCEDURALMESHES_API AHeightFieldAnimatedActor : public AActor
+class PROCEDURALMESHES_API AHeightFieldAnimatedActor : public AProceduralMeshActor
 {
 	GENERATED_BODY()
 
@@ -50,8 +52,24 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
 	float AnimationSpeedY = 4.5f;
 
+	// Keep a bounding volume hierarchy over the grid so RaycastMesh and CountTrianglesInBox can be used.
+	// Animation only moves the vertices up and down, so each frame refits the existing tree instead of building a new one.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Queries")
+	bool bBuildBVH = false;
+
+	// Finds the first point on the mesh along the line from Start to End, all in world space
+	UFUNCTION(BlueprintCallable, Category = "Procedural Parameters|Queries")
+	bool RaycastMesh(FVector Start, FVector End, FVector& HitLocation, FVector& HitNormal) const;
+
+	// Number of triangles touching a world space box. On a rotated actor the box is grown to stay axis aligned with the mesh.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Parameters|Queries")
+	int32 CountTrianglesInBox(FVector BoxCenter, FVector BoxExtent) const;
+
 	virtual void BeginPlay() override;
 
+	// Builds the grid for the current animation frame
+	virtual void GenerateMesh() override;
+
 	virtual void Tick(float DeltaSeconds) override;
 
 #if WITH_EDITOR
@@ -66,6 +84,10 @@ protected:
 	float CurrentAnimationFrameY = 0.0f;
 
 private:
-	void GenerateMesh();
-	void GenerateGrid(FProceduralMeshData& MeshData, float InLength, float InWidth, int32 InLengthSections, int32 InWidthSections, const TArray<float>& InHeightValues);
+	friend class FProceduralMeshBenchmarks;
+
+	void UpdateBVH(const FProceduralMeshData& MeshData);
+	void GenerateGrid(FProceduralMeshData& MeshData, float InLength, float InWidth, int32 InLengthSections, int32 InWidthSections, const TArray<float, FScratchAllocator>& InHeightValues);
+
+	FMeshBVH BVH;
 };
@@ -4,13 +4,14 @@
 #pragma once
 
 #include "ProceduralMeshesPrivatePCH.h"
-#include "GameFramework/Actor.h"
-#include "ProceduralMeshComponent.h"
+#include "ProceduralMeshPipelineActor.h"
 #include "ProceduralMeshData.h"
+#include "MeshBVH.h"
+#include "ProceduralMeshStats.h"
 #include "HeightFieldNoiseActor.generated.h"
 
 UCLASS()
-class PROCEDURALMESHES_API AHeightFieldNoiseActor : public AActor
+class PROCEDURALMESHES_API AHeightFieldNoiseActor : public AProceduralMeshPipelineActor
 {
 	GENERATED_BODY()
 
@@ -38,21 +39,118 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
 	UMaterialInterface* Material;
 
-	virtual void BeginPlay() override;
+	// Simple builds a coarse grid of CollisionGridSections x CollisionGridSections columns in the background, Complex cooks every triangle
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Collision")
+	EProceduralCollisionMode CollisionMode = EProceduralCollisionMode::None;
 
+	// Number of collision columns along each side of the grid, each one spans several quads
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Collision", meta = (ClampMin = "1", UIMin = "1"))
+	int32 CollisionGridSections = 16;
 
-#if WITH_EDITOR
-	virtual void OnConstruction(const FTransform& Transform) override;
-#endif   // WITH_EDITOR
+	// 16 bit RAW or binary PGM heightmap to read the heights from instead of random noise.
+	// Only the tiles under the sampled region are read, so the file can be much larger than memory allows.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Heightmap")
+	FFilePath HeightmapFile;
+
+	// Width of a RAW heightmap in pixels, 0 means the file is square. PGM files store their own size.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Heightmap", meta = (ClampMin = "0", UIMin = "0"))
+	int32 HeightmapRawWidth = 0;
+
+	// Part of the heightmap the grid covers in pixels, a size of 0 means up to the edge of the file.
+	// The grid has LengthSections x WidthSections quads no matter how large the region is, so a larger region is a lower LOD of the same file.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Heightmap", meta = (ClampMin = "0", UIMin = "0"))
+	FIntPoint HeightmapRegionStart = FIntPoint(0, 0);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Heightmap", meta = (ClampMin = "0", UIMin = "0"))
+	FIntPoint HeightmapRegionSize = FIntPoint(0, 0);
+
+	// Upper limit on the number of 64x64 tiles of the heightmap kept in memory while sampling it
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Heightmap", meta = (ClampMin = "4", UIMin = "4"))
+	int32 MaxResidentTiles = 16;
+
+	// Simplify the grid after generating it, so flat areas end up with fewer triangles than rough ones
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Decimation")
+	bool bDecimate = false;
+
+	// How far the simplified surface may move away from the generated grid, 0 means no limit
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Decimation", meta = (ClampMin = "0", UIMin = "0"))
+	float DecimationMaxError = 1.0f;
+
+	// Percentage of triangles to keep in each chunk, 0 means no limit
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Decimation", meta = (ClampMin = "0", ClampMax = "100"))
+	float DecimationTargetPercentage = 0.0f;
+
+	// The grid is split into chunks of this many quads along each side, which are simplified in parallel and become separate mesh sections.
+	// The edges between chunks are never simplified so the chunks still line up.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Decimation", meta = (ClampMin = "2", UIMin = "2"))
+	int32 DecimationChunkSections = 32;
+
+	// Number of triangles in the generated mesh, set when it is uploaded
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Procedural Parameters|Decimation")
+	int32 GeneratedTriangleCount = 0;
+
+	// Reorder triangles and vertices for the GPU vertex cache after generating, the cache miss ratio before and after is logged
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Optimization")
+	bool bOptimizeVertexCache = false;
+
+	// Keep a bounding volume hierarchy over the full grid so RaycastMesh and CountTrianglesInBox can be used.
+	// It is built before decimation, so queries always hit the surface as it was generated.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Queries")
+	bool bBuildBVH = false;
+
+	// While a slider is dragged in the editor LengthSections and WidthSections are halved this many times, and the full grid is built
+	// once it is let go. 0 keeps the full grid.
+	UPROPERTY(EditAnywhere, Category = "Procedural Parameters|Editor", meta = (ClampMin = "0", ClampMax = "4"))
+	int32 EditorPreviewLOD = 2;
+
+	// Finds the first point on the mesh along the line from Start to End, all in world space
+	UFUNCTION(BlueprintCallable, Category = "Procedural Parameters|Queries")
+	bool RaycastMesh(FVector Start, FVector End, FVector& HitLocation, FVector& HitNormal) const;
+
+	// Number of triangles touching a world space box. On a rotated actor the box is grown to stay axis aligned with the mesh.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Parameters|Queries")
+	int32 CountTrianglesInBox(FVector BoxCenter, FVector BoxExtent) const;
 
 protected:
-	UPROPERTY(Transient, DuplicateTransient)
-	UProceduralMeshComponent* ProcMesh;
+	virtual void SetupStages() override;
+	virtual bool CanRunPipeline() const override;
+	virtual int32 GetEditorPreviewLOD() const override { return EditorPreviewLOD; }
+	virtual void PrepareRun() override;
 
 private:
-	void GenerateMesh();
+	friend class FProceduralMeshBenchmarks;
+
+	void GenerateCollision(const TArray<float>& InHeightValues);
+	bool SampleHeightmap(int32 NumberOfRows, int32 NumberOfColumns, TArray<float>& OutHeightValues) const;
+	void DecimateInChunks(const FProceduralMeshData& MeshData);
 	void GenerateGrid(FProceduralMeshData& MeshData, float InLength, float InWidth, int32 InLengthSections, int32 InWidthSections, const TArray<float>& InHeightValues);
 
+	FMeshBVH BVH;
+
+	// Heights -> grid -> optimization -> upload -> material. The BVH is built from the grid alongside the optimization, and the
+	// collision from the heights alongside everything else.
+	int32 HeightsStage;
+	int32 GridStage;
+	int32 OptimizationStage;
+	int32 BVHStage;
+	int32 UploadStage;
+	int32 MaterialStage;
+	int32 CollisionStage;
+
+	// The grid size the pipeline builds, smaller than LengthSections and WidthSections for the editor preview. Only changed while the
+	// pipeline isn't running.
+	int32 GridLengthSections;
+	int32 GridWidthSections;
+
+	// What each stage produced, kept so later stages can run again on their own
+	TArray<float> HeightValues;
+	FProceduralMeshData GridMeshData;
+	TArray<FProceduralMeshData> SectionMeshData;
+	FProceduralMeshMemoryStat MeshDataMemory;
+
 	UPROPERTY(Transient)
 	FRandomStream RngStream = FRandomStream::FRandomStream();
+
+	// The stages that may run on worker threads use this, and the upload copies it to RngStream on the game thread
+	FRandomStream GenerationRngStream;
 };
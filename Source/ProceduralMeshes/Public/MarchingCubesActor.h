@@ -0,0 +1,105 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Example isosurface of a 3d noise field, polygonised with marching cubes
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshActor.h"
+#include "ProceduralMeshComponent.h"
+#include "ProceduralMeshData.h"
+#include "MarchingCubes.h"
+#include "MarchingCubesActor.generated.h"
+
+UCLASS()
+class PROCEDURALMESHES_API AMarchingCubesActor : public AProceduralMeshActor
+{
+	GENERATED_BODY()
+
+public:
+	AMarchingCubesActor();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "1", UIMin = "1"))
+	int32 SizeX = 64;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "1", UIMin = "1"))
+	int32 SizeY = 64;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "1", UIMin = "1"))
+	int32 SizeZ = 32;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "0.01", UIMin = "0.01"))
+	float CellSize = 25.0f;
+
+	// Each chunk is its own mesh section, and only chunks touched by an edit are rebuilt
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "1", UIMin = "4"))
+	int32 ChunkSize = 16;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
+	int32 RandomSeed = 1238;
+
+	// Distance between the random values of the first noise octave, in cells
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "1", UIMin = "1"))
+	float NoiseScale = 16.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "1", ClampMax = "8"))
+	int32 NoiseOctaves = 3;
+
+	// Height of the ground as a percentage of SizeZ
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "0", ClampMax = "100"))
+	float SurfaceHeightPercentage = 50.0f;
+
+	// How strongly the field is pulled towards ground below the surface height and air above it. Lower values give more caves and overhangs.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "0", UIMin = "0"))
+	float GroundBias = 2.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
+	UMaterialInterface* Material;
+
+	// Reorder the triangles and vertices of each chunk for the GPU vertex cache
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Optimization")
+	bool bOptimizeVertexCache = true;
+
+	// Number of triangles over all chunks
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Procedural Parameters|Statistics")
+	int32 GeneratedTriangleCount = 0;
+
+	// Average cache miss ratio of the chunks built last, before and after optimizing. 0.5 is ideal, 3 means no vertices are shared.
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Procedural Parameters|Statistics")
+	float ACMRBefore = 0.0f;
+
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Procedural Parameters|Statistics")
+	float ACMRAfter = 0.0f;
+
+	// Adds to the field inside a sphere (in actor space), fading out towards the edge. Use a negative strength to dig.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Parameters")
+	void AddSphereToField(FVector Center, float Radius, float Strength);
+
+	virtual void BeginPlay() override;
+
+	// Fills the field again and rebuilds every chunk
+	virtual void GenerateMesh() override;
+
+#if WITH_EDITOR
+	virtual void OnConstruction(const FTransform& Transform) override;
+#endif   // WITH_EDITOR
+
+protected:
+	UPROPERTY(Transient, DuplicateTransient)
+	UProceduralMeshComponent* ProcMesh;
+
+private:
+	void MarkChunksDirty(const FIntVector& MinPoint, const FIntVector& MaxPoint);
+	void RebuildDirtyChunks();
+	FVector GetFieldOrigin() const;
+
+	UPROPERTY(Transient)
+	FRandomStream RngStream = FRandomStream::FRandomStream();
+
+	FScalarField3D Field;
+
+	// ChunkSize as it was when the chunks were laid out, at least one even if Blueprint set it lower
+	int32 ChunkLayoutSize = 1;
+	FIntVector NumChunks;
+	TArray<bool> DirtyChunks;
+	TArray<int32> ChunkTriangleCounts;
+};
@@ -0,0 +1,60 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Collision made of simple shapes for the procedural examples
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "Components/PrimitiveComponent.h"
+#include "PhysicsEngine/AggregateGeom.h"
+#include "ProceduralCollisionComponent.generated.h"
+
+class UBodySetup;
+
+UENUM(BlueprintType)
+enum class EProceduralCollisionMode : uint8
+{
+	None,
+	// Capsules, boxes or a coarse grid that roughly follow the mesh, built in the background
+	Simple,
+	// The full triangle mesh, cooked on the game thread every time the mesh changes
+	Complex
+};
+
+// Has no mesh of its own, only a body made of simple shapes. Capsules and boxes don't need any cooking, so generating them
+// is just a few lines of math per shape, which is done on a worker thread and handed back to the game thread when it's done.
+UCLASS(ClassGroup = Procedural)
+class PROCEDURALMESHES_API UProceduralCollisionComponent : public UPrimitiveComponent
+{
+	GENERATED_BODY()
+
+public:
+	UProceduralCollisionComponent(const FObjectInitializer& ObjectInitializer);
+
+	// Runs BuildShapes on a worker thread and replaces the collision with the result on the game thread.
+	// BuildShapes must only use what it captured. If this is called again before it finishes, only the latest result is used.
+	void BuildCollisionAsync(TFunction<void(FKAggregateGeom&)> BuildShapes);
+
+	// Removes all shapes, and throws away the result of any build still running
+	void ClearCollision();
+
+	// Number of shapes in the current collision
+	int32 GetNumShapes() const;
+
+	// Adds a capsule around a line, Radius is also how far the rounded ends reach past Start and End
+	static void AddCapsule(FKAggregateGeom& Shapes, const FVector& Start, const FVector& End, float Radius);
+
+	// UPrimitiveComponent interface
+	virtual UBodySetup* GetBodySetup() override;
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+private:
+	void SetShapes(const FKAggregateGeom& Shapes);
+
+	UPROPERTY(Transient)
+	UBodySetup* CollisionBodySetup;
+
+	FBox LocalBounds;
+
+	// Incremented for every build, so results that arrive after a newer build was started can be ignored
+	int32 LatestBuildId;
+};
@@ -0,0 +1,19 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Base of every example that generates a mesh
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "GameFramework/Actor.h"
+#include "ProceduralMeshActor.generated.h"
+
+// Lets the benchmarks, the determinism check and the batch commandlet generate any of the examples without knowing its class
+UCLASS(Abstract)
+class PROCEDURALMESHES_API AProceduralMeshActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Builds the whole mesh from the current properties and uploads it before returning
+	virtual void GenerateMesh() PURE_VIRTUAL(AProceduralMeshActor::GenerateMesh, );
+};
@@ -0,0 +1,44 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Generates meshes from a parameter file without opening a map, and writes timing, memory and size statistics to CSV
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "Commandlets/Commandlet.h"
+#include "ProceduralMeshBatchCommandlet.generated.h"
+
+// UE4Editor-Cmd <Project> -run=ProceduralMeshBatch -Params=<File> [-Output=<Csv>] [-Threads=0,1,4] [-Repeat=<N>] [-DumpMeshes[=<Directory>]]
+//
+// Each section of the parameter file is a sweep over one generator. Class is the actor class without its A prefix, and every other key
+// sets the property of the same name, written the way it would be pasted into the details panel. Values separated by | are swept, and
+// every combination of the swept values is generated:
+//
+//   [Branches]
+//   Class=BranchingLinesActor
+//   Repeat=10
+//   Iterations=4|5|6|7
+//   RadialSegmentCount=8|16
+//   End=(X=0,Y=0,Z=500)
+//
+// Each combination is generated once untimed to warm up, then Repeat times (5 unless -Repeat or the section says otherwise) for every
+// thread count in -Threads, which sets ProceduralMeshes.MaxThreads (0 is every task graph thread). The CSV gets a row per combination and
+// thread count. -DumpMeshes also writes each combination's mesh as an OBJ file, to Saved/ProceduralMeshes/Meshes unless a directory is given.
+//
+// UE4Editor-Cmd <Project> -run=ProceduralMeshBatch -Benchmarks [-Extreme] [-WriteBaseline] [-AllowMissingBaseline] [-Baseline=<File>] [-Tolerance=<Percent>]
+//
+// Runs FProceduralMeshBenchmarks instead of a sweep, and returns 1 if any case regressed past the tolerance or has no baseline to compare
+// against. -AllowMissingBaseline only reports the cases without one.
+//
+// UE4Editor-Cmd <Project> -run=ProceduralMeshBatch -Determinism [-WriteGolden] [-Golden=<File>]
+//
+// Runs FProceduralMeshDeterminism instead of a sweep, and returns 1 if any mesh changed or came out differently on more threads.
+UCLASS()
+class PROCEDURALMESHES_API UProceduralMeshBatchCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UProceduralMeshBatchCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,121 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Merges many simple cube and cylinder actors into a single procedural mesh, with one section per material
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "GameFramework/Actor.h"
+#include "ProceduralMeshComponent.h"
+#include "ProceduralMeshData.h"
+#include "CompactMeshData.h"
+#include "ProceduralMeshStats.h"
+#include "ProceduralMeshMergeActor.generated.h"
+
+// The mesh of one source actor, already transformed into the space of the merge actor
+struct FProceduralMeshMergeChunk
+{
+	TWeakObjectPtr<AActor> SourceActor;
+	UMaterialInterface* Material;
+	FProceduralMeshData MeshData;
+
+	// Used instead of MeshData when the chunks are stored compactly
+	FCompactMeshData CompactMeshData;
+	FCompactMeshStats CompactStats;
+
+	int32 GetNumVertices() const { return MeshData.Vertices.Num() + CompactMeshData.GetNumVertices(); }
+	const TArray<int32>& GetTriangles() const { return MeshData.Triangles.Num() > 0 ? MeshData.Triangles : CompactMeshData.Triangles; }
+
+	FProceduralMeshMergeChunk()
+		: Material(nullptr)
+	{
+	}
+};
+
+UCLASS()
+class PROCEDURALMESHES_API AProceduralMeshMergeActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AProceduralMeshMergeActor();
+
+	// Actors to merge. Only simple cube and simple cylinder actors can be merged, anything else is ignored.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
+	TArray<AActor*> SourceActors;
+
+	// Merge every supported actor in the level instead of just SourceActors
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
+	bool bMergeAllInLevel = false;
+
+	// Hide the source actors once they are part of the merged mesh
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
+	bool bHideSourceActors = true;
+
+	// Store the mesh of each source actor with packed normals and tangents and half precision UVs between merges.
+	// Every chunk is kept around so a single actor can be remerged, which is most of the memory this actor uses.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Optimization")
+	bool bCompactChunkData = false;
+
+	// Also store chunk positions as 16 bits per axis within the bounds of each chunk
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Optimization")
+	bool bQuantizeChunkPositions = false;
+
+	// Memory held by the stored chunks
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Procedural Parameters|Statistics")
+	int32 ChunkMemoryBytes = 0;
+
+	// Regenerates every source actor and rebuilds the whole merged mesh
+	UFUNCTION(BlueprintCallable, Category = "Procedural Parameters")
+	void MergeAll();
+
+	// Regenerates a single source actor and only rebuilds the sections it belongs to
+	UFUNCTION(BlueprintCallable, Category = "Procedural Parameters")
+	void RemergeActor(AActor* SourceActor);
+
+	static bool CanMerge(const AActor* Actor);
+
+	virtual void BeginPlay() override;
+
+	virtual void BeginDestroy() override;
+
+	virtual void Destroyed() override;
+
+#if WITH_EDITOR
+	virtual void OnConstruction(const FTransform& Transform) override;
+#endif   // WITH_EDITOR
+
+protected:
+	UPROPERTY(Transient, DuplicateTransient)
+	UProceduralMeshComponent* ProcMesh;
+
+private:
+	void BuildChunk(FProceduralMeshMergeChunk& Chunk) const;
+	int32 FindOrAddSection(UMaterialInterface* InMaterial);
+	void MergeSection(int32 SectionIndex);
+	void UploadSection(int32 SectionIndex);
+	void UpdateChunkMemory();
+	void ShowHiddenSourceActors();
+
+	TArray<FProceduralMeshMergeChunk> Chunks;
+
+	// One entry per section, the merged mesh data and the material all its chunks share
+	TArray<FProceduralMeshData> MergedSections;
+
+	// The chunks and the merged sections
+	FProceduralMeshMemoryStat MeshDataMemory;
+
+	UPROPERTY(Transient)
+	TArray<UMaterialInterface*> SectionMaterials;
+
+	// The source actors we hid, so they can be shown again when they stop being merged. Saved with the map like their visibility is.
+	UPROPERTY()
+	TArray<AActor*> HiddenSourceActors;
+
+#if WITH_EDITOR
+	void OnObjectPropertyChanged(UObject* Object, FPropertyChangedEvent& PropertyChangedEvent);
+	void OnActorMoved(AActor* Actor);
+
+	FDelegateHandle OnObjectPropertyChangedHandle;
+	FDelegateHandle OnActorMovedHandle;
+#endif   // WITH_EDITOR
+};
@@ -0,0 +1,78 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Base of the examples that generate through FProceduralMeshPipeline
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshActor.h"
+#include "ProceduralMeshComponent.h"
+#include "ProceduralCollisionComponent.h"
+#include "ProceduralMeshPipeline.h"
+#include "EditorInteraction.h"
+#include "ProceduralMeshPipelineActor.generated.h"
+
+// Runs the pipeline when the actor is placed or edited, builds a cheap preview while a slider is dragged and switches LODs when ticked.
+// Subclasses only add their stages and say which of them the preview changes.
+UCLASS(Abstract)
+class PROCEDURALMESHES_API AProceduralMeshPipelineActor : public AProceduralMeshActor
+{
+	GENERATED_BODY()
+
+public:
+	AProceduralMeshPipelineActor();
+
+	virtual void BeginPlay() override;
+	virtual void BeginDestroy() override;
+
+	// Invalidates and runs every stage of the pipeline, and waits for it to finish
+	virtual void GenerateMesh() override;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	virtual bool ShouldTickIfViewportsOnly() const override;
+
+#if WITH_EDITOR
+	virtual void OnConstruction(const FTransform& Transform) override;
+	virtual void PreEditChange(UProperty* PropertyAboutToChange) override;
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+	virtual void PreEditUndo() override;
+	virtual void PostEditUndo() override;
+#endif   // WITH_EDITOR
+
+protected:
+	UPROPERTY(Transient, DuplicateTransient)
+	UProceduralMeshComponent* ProcMesh;
+
+	UPROPERTY(Transient, DuplicateTransient)
+	UProceduralCollisionComponent* Collision;
+
+	// Adds the stages and their property triggers, called once before the pipeline is first used
+	virtual void SetupStages() PURE_VIRTUAL(AProceduralMeshPipelineActor::SetupStages, );
+
+	// Properties that can't make a mesh leave the last one in place
+	virtual bool CanRunPipeline() const { return true; }
+
+	// The LOD to build while a slider is dragged, 0 builds the full mesh
+	virtual int32 GetEditorPreviewLOD() const { return 0; }
+
+	// Called before every run, after the preview LOD has been picked. Anything the stages read that isn't a property is set here.
+	virtual void PrepareRun() {}
+
+	// Called from Tick while the pipeline isn't running, lower LODs are built from what the stages wrote
+	virtual void UpdateLOD() {}
+
+	void SetupPipeline();
+	void RunPipeline(bool bAsync);
+
+	// The LOD the pipeline results are built at, only changed while the pipeline isn't running
+	int32 GetPreviewLOD() const { return PreviewLOD; }
+
+	// Invalidated when a preview starts or ends. Subclasses that work out what the preview changes in PrepareRun leave it at INDEX_NONE.
+	int32 PreviewStage;
+
+	FProceduralMeshPipeline Pipeline;
+
+private:
+	FEditorInteraction EditorInteraction;
+	int32 PreviewLOD;
+};
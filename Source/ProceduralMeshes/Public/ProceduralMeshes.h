@@ -5,6 +5,30 @@
 #include "Engine.h"
 #include "ModuleManager.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogProceduralMeshes, Log, All);
+
+// Running totals of how much generation work was avoided or thrown away when editing properties, shown with "stat ProceduralMeshes"
+DECLARE_STATS_GROUP(TEXT("ProceduralMeshes"), STATGROUP_ProceduralMeshes, STATCAT_Advanced);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Full regenerations skipped"), STAT_ProceduralMeshRegenerationsSkipped, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Regenerations cancelled"), STAT_ProceduralMeshRegenerationsCancelled, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Generation stages run"), STAT_ProceduralMeshStagesRun, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Generation stages skipped"), STAT_ProceduralMeshStagesSkipped, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Tube segments reused"), STAT_ProceduralMeshTubeSegmentsReused, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Scratch heap allocations"), STAT_ProceduralMeshScratchHeapAllocations, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+
+// The phases of a GenerateMesh. Each generator class has a cycle counter of its own that these nest under, and the pipeline stages
+// open it again on the task graph threads, so the hierarchy shows every phase per class. The counters also show up as named events
+// in external profilers with "stat NamedEvents". Normals are written in the same loops as the positions, so they count as vertex fill.
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Structure"), STAT_ProceduralMeshStructure, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Vertex fill and normals"), STAT_ProceduralMeshVertexFill, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Optimization"), STAT_ProceduralMeshOptimization, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Upload"), STAT_ProceduralMeshUpload, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Collision"), STAT_ProceduralMeshCollision, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+
+// Mesh data the actors keep between generations, and how much of it was handed to the components this frame
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Mesh data kept by actors"), STAT_ProceduralMeshDataMemory, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Mesh data bytes uploaded"), STAT_ProceduralMeshBytesUploaded, STATGROUP_ProceduralMeshes, PROCEDURALMESHES_API);
+
 class FProceduralMeshesModule : public IModuleInterface
 {
 public:
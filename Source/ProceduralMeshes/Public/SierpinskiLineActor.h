@@ -4,31 +4,40 @@
 #pragma once
 
 #include "ProceduralMeshesPrivatePCH.h"
-#include "GameFramework/Actor.h"
-#include "ProceduralMeshComponent.h"
+#include "ProceduralMeshPipelineActor.h"
 #include "ProceduralMeshData.h"
+#include "ProceduralMeshLOD.h"
+#include "ProceduralMeshStats.h"
+#include "TubeSegmentCache.h"
+#include "LineSegmentStreams.h"
 #include "SierpinskiLineActor.generated.h"
 
-// A simple struct to keep some data together
+// A simple struct to keep some data together. Generation keeps the lines in FLineSegmentStreams, this is only the view of them that
+// shows up in the details panel.
 USTRUCT()
 struct FPyramidLine
 {
 	GENERATED_BODY()
 
-	UPROPERTY()
+	UPROPERTY(VisibleAnywhere)
 	FVector Start;
 
-	UPROPERTY()
+	UPROPERTY(VisibleAnywhere)
 	FVector End;
 
-	UPROPERTY()
+	UPROPERTY(VisibleAnywhere)
 	float Width;
 
+	// Recursion depth that created this line, 0 for the outer pyramid
+	UPROPERTY(VisibleAnywhere)
+	int32 Depth;
+
 	FPyramidLine()
 	{
 		Start = FVector::ZeroVector;
 		End = FVector::ZeroVector;
 		Width = 1.0f;
+		Depth = 0;
 	}
 
 	FPyramidLine(FVector InStart, FVector InEnd)
@@ -36,6 +45,7 @@ struct FPyramidLine
 		Start = InStart;
 		End = InEnd;
 		Width = 1.0f;
+		Depth = 0;
 	}
 
 	FPyramidLine(FVector InStart, FVector InEnd, float InWidth)
@@ -43,11 +53,20 @@ struct FPyramidLine
 		Start = InStart;
 		End = InEnd;
 		Width = InWidth;
+		Depth = 0;
+	}
+
+	FPyramidLine(FVector InStart, FVector InEnd, float InWidth, int32 InDepth)
+	{
+		Start = InStart;
+		End = InEnd;
+		Width = InWidth;
+		Depth = InDepth;
 	}
 };
 
 UCLASS()
-class PROCEDURALMESHES_API ASierpinskiLineActor : public AActor
+class PROCEDURALMESHES_API ASierpinskiLineActor : public AProceduralMeshPipelineActor
 {
 	GENERATED_BODY()
 
@@ -66,7 +85,7 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
 	float ThicknessMultiplierPerGeneration = 0.8f;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "3"))
 	int32 RadialSegmentCount = 4;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
@@ -75,29 +94,64 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
 	UMaterialInterface* Material;
 
-	virtual void BeginPlay() override;
+	// Simple builds a capsule around every line in the background, Complex cooks the whole LOD0 mesh
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Collision")
+	EProceduralCollisionMode CollisionMode = EProceduralCollisionMode::None;
 
-#if WITH_EDITOR
-	virtual void OnConstruction(const FTransform& Transform) override;
-#endif   // WITH_EDITOR
+	// Each LOD halves RadialSegmentCount and drops the lines of the deepest iteration. Lower LODs are generated the first time they are needed.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|LOD", meta = (ClampMin = "1", ClampMax = "4"))
+	int32 NumLODs = 1;
+
+	// Screen size below which LOD1, LOD2 etc. are used
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|LOD")
+	TArray<float> LODScreenSizes;
+
+	// Merge the vertices that neighbouring quads write on top of each other before uploading, they only differ when bSmoothNormals is off
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Optimization")
+	bool bWeldVertices = false;
+
+	// While a slider is dragged in the editor the mesh is built at this LOD, and at full resolution once it is let go. 0 keeps full resolution.
+	UPROPERTY(EditAnywhere, Category = "Procedural Parameters|Editor", meta = (ClampMin = "0", ClampMax = "3"))
+	int32 EditorPreviewLOD = 2;
+
+	// The lines are kept in packed streams the editor can't show, this copies them into DebugLines after every generation
+	UPROPERTY(EditAnywhere, Category = "Procedural Parameters|Editor")
+	bool bShowLinesInDetails = false;
+
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Procedural Parameters|Editor")
+	TArray<FPyramidLine> DebugLines;
 
 protected:
-	UPROPERTY(Transient, DuplicateTransient)
-	UProceduralMeshComponent* ProcMesh;
+	virtual void SetupStages() override;
+	virtual int32 GetEditorPreviewLOD() const override { return EditorPreviewLOD; }
+	virtual void UpdateLOD() override;
 
 private:
-	void GenerateMesh();
+	friend class FProceduralMeshBenchmarks;
+
+	void CreateLines();
+	void GenerateCollision();
+	void GenerateLOD(int32 LODIndex);
+	void GetLODSegments(int32 LODIndex, FScratchLineSegmentStreams& OutSegments) const;
+	void UploadLOD(int32 LODIndex, const FProceduralMeshData& MeshData);
 
-	UPROPERTY(Transient)
-	TArray<FPyramidLine> Lines;
+	// Start, end, width and recursion depth of every line, one stream each
+	FLineSegmentStreams Lines;
 
 	void AddSection(FVector InBottomLeftPoint, FVector InTopPoint, FVector InBottomRightPoint, FVector InBottomMiddlePoint, int32 InDepth);
-	void GenerateCylinder(FProceduralMeshData& MeshData, FVector StartPoint, FVector EndPoint, float InWidth, int32 InCrossSectionCount, int32 InVertexIndexStart, bool bInSmoothNormals = true);
 
-	FVector RotatePointAroundPivot(FVector InPoint, FVector InPivot, FVector InAngles);
-	void PreCacheCrossSection();
+	FProceduralMeshLODChain LODChain;
+
+	// Lines -> geometry -> optimization -> upload -> material, with collision built from the lines alongside the geometry
+	int32 LinesStage;
+	int32 GeometryStage;
+	int32 OptimizationStage;
+	int32 UploadStage;
+	int32 MaterialStage;
+	int32 CollisionStage;
 
-	int32 LastCachedCrossSectionCount;
-	UPROPERTY(Transient)
-	TArray<FVector> CachedCrossSectionPoints;
+	// Kept between runs so the later stages can run again on their own, and so the geometry stage can copy the lines that didn't change
+	FTubeSegmentCache LOD0Tubes;
+	FProceduralMeshData LOD0WeldedMeshData;
+	FProceduralMeshMemoryStat MeshDataMemory;
 };
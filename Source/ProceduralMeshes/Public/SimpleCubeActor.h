@@ -4,13 +4,14 @@
 #pragma once
 
 #include "ProceduralMeshesPrivatePCH.h"
-#include "GameFramework/Actor.h"
+#include "ProceduralMeshActor.h"
 #include "ProceduralMeshComponent.h"
 #include "ProceduralMeshData.h"
+#include "ProceduralCollisionComponent.h"
 #include "SimpleCubeActor.generated.h"
 
 UCLASS()
-class PROCEDURALMESHES_API ASimpleCubeActor : public AActor
+class PROCEDURALMESHES_API ASimpleCubeActor : public AProceduralMeshActor
 {
 	GENERATED_BODY()
 
@@ -29,8 +30,22 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
 	UMaterialInterface* Material;
 
+	// Simple uses a single box, Complex cooks the triangles
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters|Collision")
+	EProceduralCollisionMode CollisionMode = EProceduralCollisionMode::None;
+
 	virtual void BeginPlay() override;
 
+	// Builds the mesh and its collision and uploads them
+	virtual void GenerateMesh() override;
+
+	// Builds the mesh in actor space without touching the component, safe to call from any thread
+	void BuildMeshData(FProceduralMeshData& MeshData) const;
+
+	// Writes one quad into buffers already sized for it, and returns the vertex offset for the next quad.
+	// UVScale repeats the texture across quads that cover more than one unit of it.
+	static int32 BuildQuad(FProceduralMeshData& MeshData, FVector BottomLeft, FVector BottomRight, FVector TopRight, FVector TopLeft, int32 VertexOffset, FVector Normal, FProcMeshTangent Tangent, FVector2D UVScale = FVector2D(1.0f, 1.0f));
+
 #if WITH_EDITOR
 	virtual void OnConstruction(const FTransform& Transform) override;
 #endif   // WITH_EDITOR
@@ -39,8 +54,12 @@ protected:
 	UPROPERTY(Transient, DuplicateTransient)
 	UProceduralMeshComponent* ProcMesh;
 
+	UPROPERTY(Transient, DuplicateTransient)
+	UProceduralCollisionComponent* Collision;
+
 private:
-	void GenerateMesh();
-	void GenerateCube(FProceduralMeshData& MeshData, float Depth, float Width, float Height);
-	int32 BuildQuad(FProceduralMeshData& MeshData, FVector BottomLeft, FVector BottomRight, FVector TopRight, FVector TopLeft, int32 VertexOffset, FVector Normal, FProcMeshTangent Tangent);
+	friend class FProceduralMeshBenchmarks;
+
+	void GenerateCollision();
+	void GenerateCube(FProceduralMeshData& MeshData, float Depth, float Width, float Height) const;
 };
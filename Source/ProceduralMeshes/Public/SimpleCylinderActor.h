@@ -4,13 +4,15 @@
 #pragma once
 
 #include "ProceduralMeshesPrivatePCH.h"
-#include "GameFramework/Actor.h"
+#include "ProceduralMeshActor.h"
 #include "ProceduralMeshComponent.h"
 #include "ProceduralMeshData.h"
+#include "CrossSectionCache.h"
+#include "CylinderKernels.h"
 #include "SimpleCylinderActor.generated.h"
 
 UCLASS()
-class PROCEDURALMESHES_API ASimpleCylinderActor : public AActor
+class PROCEDURALMESHES_API ASimpleCylinderActor : public AProceduralMeshActor
 {
 	GENERATED_BODY()
 
@@ -40,6 +42,12 @@ public:
 
 	virtual void BeginPlay() override;
 
+	// Builds the mesh and uploads it
+	virtual void GenerateMesh() override;
+
+	// Builds the mesh in actor space without touching the component, safe to call from any thread
+	void BuildMeshData(FProceduralMeshData& MeshData) const;
+
 #if WITH_EDITOR
 	virtual void OnConstruction(const FTransform& Transform) override;
 #endif   // WITH_EDITOR
@@ -49,6 +57,7 @@ protected:
 	UProceduralMeshComponent* ProcMesh;
 
 private:
-	void GenerateMesh();
-	void GenerateCylinder(FProceduralMeshData& MeshData, float Height, float InWidth, int32 InCrossSectionCount, bool bCapEnds = false, bool bDoubleSided = false, bool bInSmoothNormals = true);
+	friend class FProceduralMeshBenchmarks;
+
+	void GenerateCylinder(FProceduralMeshData& MeshData, float Height, float InWidth, int32 InCrossSectionCount, bool bCapEnds = false, bool bDoubleSided = false, bool bInSmoothNormals = true) const;
 };
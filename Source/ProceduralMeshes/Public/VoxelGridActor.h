@@ -0,0 +1,106 @@
+// Copyright 2016, Sigurdur Gunnarsson. All Rights Reserved.
+// Example voxel volume built from greedy meshed cube faces
+
+#pragma once
+
+#include "ProceduralMeshesPrivatePCH.h"
+#include "ProceduralMeshActor.h"
+#include "ProceduralMeshComponent.h"
+#include "ProceduralMeshData.h"
+#include "VoxelGridActor.generated.h"
+
+UCLASS()
+class PROCEDURALMESHES_API AVoxelGridActor : public AProceduralMeshActor
+{
+	GENERATED_BODY()
+
+public:
+	AVoxelGridActor();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "1", UIMin = "1"))
+	int32 SizeX = 32;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "1", UIMin = "1"))
+	int32 SizeY = 32;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "1", UIMin = "1"))
+	int32 SizeZ = 32;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "0.01", UIMin = "0.01"))
+	float VoxelSize = 50.0f;
+
+	// Chance for each voxel to start out filled
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "0", ClampMax = "100"))
+	float FillPercentage = 90.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
+	int32 RandomSeed = 1238;
+
+	// Each chunk is its own mesh section, and only chunks with changed voxels are rebuilt
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters", meta = (ClampMin = "1", UIMin = "4"))
+	int32 ChunkSize = 16;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Procedural Parameters")
+	UMaterialInterface* Material;
+
+	// Number of quads if every filled voxel was drawn as a whole cube
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Procedural Parameters|Statistics")
+	int32 NaiveQuadCount = 0;
+
+	// Number of quads between filled and empty voxels, before any of them are merged
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Procedural Parameters|Statistics")
+	int32 VisibleQuadCount = 0;
+
+	// Number of quads actually generated after merging
+	UPROPERTY(VisibleInstanceOnly, Transient, Category = "Procedural Parameters|Statistics")
+	int32 GeneratedQuadCount = 0;
+
+	UFUNCTION(BlueprintCallable, Category = "Procedural Parameters")
+	bool GetVoxel(int32 X, int32 Y, int32 Z) const;
+
+	// Changes a single voxel and re-meshes the chunks that can see it
+	UFUNCTION(BlueprintCallable, Category = "Procedural Parameters")
+	void SetVoxel(int32 X, int32 Y, int32 Z, bool bFilled);
+
+	virtual void BeginPlay() override;
+
+	// Fills the voxels again and rebuilds every chunk
+	virtual void GenerateMesh() override;
+
+#if WITH_EDITOR
+	virtual void OnConstruction(const FTransform& Transform) override;
+#endif   // WITH_EDITOR
+
+protected:
+	UPROPERTY(Transient, DuplicateTransient)
+	UProceduralMeshComponent* ProcMesh;
+
+private:
+	void FillVoxels();
+	void MarkChunkDirty(int32 X, int32 Y, int32 Z);
+	void RebuildDirtyChunks();
+	void GenerateChunk(int32 ChunkIndex, FProceduralMeshData& MeshData, int32& OutVisibleQuadCount) const;
+	void UpdateStatistics();
+
+	FORCEINLINE int32 GetVoxelIndex(int32 X, int32 Y, int32 Z) const { return X + SizeX * (Y + SizeY * Z); }
+	FORCEINLINE bool IsFilled(int32 X, int32 Y, int32 Z) const
+	{
+		return X >= 0 && Y >= 0 && Z >= 0 && X < SizeX && Y < SizeY && Z < SizeZ && Voxels[GetVoxelIndex(X, Y, Z)] != 0;
+	}
+
+	UPROPERTY(Transient)
+	FRandomStream RngStream = FRandomStream::FRandomStream();
+
+	// One byte per voxel, X first then Y then Z
+	TArray<uint8> Voxels;
+
+	// ChunkSize as it was when the chunks were laid out, at least one even if Blueprint set it lower
+	int32 ChunkLayoutSize = 1;
+	int32 NumChunksX = 0;
+	int32 NumChunksY = 0;
+	int32 NumChunksZ = 0;
+
+	TArray<bool> DirtyChunks;
+	TArray<int32> ChunkVisibleQuadCounts;
+	TArray<int32> ChunkGeneratedQuadCounts;
+};